@@ -0,0 +1,72 @@
+#include <cerrno>
+#include <cstddef>
+
+/*****************************************************************************
+ *  Per-thread allocation counters for the real-time self-check, see
+ *  RealTime::ThreadStats. The wrappers replace malloc and friends for the
+ *  whole process, so only binaries that run the self-check link this file
+ *  (UnscentedKF with -DUKF_COUNT_ALLOCATIONS=ON, and its test). glibc only;
+ *  a sanitizer brings its own allocator, the counters are then left out and
+ *  the self-check reports -1.
+ ****************************************************************************/
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+
+// allocations of the calling thread, a plain TLS slot so the wrappers work
+// before any constructor ran
+static __thread long long allocation_count = 0;
+
+// glibc's own entry points, the wrappers below replace the public ones
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+
+void* malloc(size_t size) {
+  ++allocation_count;
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+  ++allocation_count;
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+  ++allocation_count;
+  return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+  ++allocation_count;
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+  ++allocation_count;
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer_out, size_t alignment, size_t size) {
+  ++allocation_count;
+  void* pointer = __libc_memalign(alignment, size);
+  if (pointer == nullptr) {
+    return ENOMEM;
+  }
+  *pointer_out = pointer;
+  return 0;
+}
+
+void free(void* pointer) {
+  __libc_free(pointer);
+}
+
+// read by RealTime::ThreadStats
+long long UkfThreadAllocations() {
+  return allocation_count;
+}
+}
+
+#endif
@@ -0,0 +1,161 @@
+#include <cerrno>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "coro_runtime.h"
+#include "parallel_for.h"
+
+using namespace std;
+
+// I/O events handled per epoll_wait
+static const int kMaxEvents = 64;
+
+// the executor whose Worker runs on this thread
+static thread_local Executor* current_executor = nullptr;
+
+void Task::promise_type::FinalAwaiter::await_suspend(
+    coroutine_handle<promise_type> handle) noexcept {
+  Executor* executor = handle.promise().executor;
+  handle.destroy();
+  executor->TaskDone();
+}
+
+Executor::Executor(int num_threads)
+    : num_threads_(ThreadCount(num_threads, ~(size_t) 0)),
+      epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      wake_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      live_tasks_(0),
+      polling_(false) {
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.ptr = nullptr;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+}
+
+Executor::~Executor() {
+  close(wake_fd_);
+  close(epoll_fd_);
+}
+
+void Executor::Spawn(Task task) {
+  coroutine_handle<Task::promise_type> handle = task.handle_;
+  task.handle_ = nullptr;
+  handle.promise().executor = this;
+  {
+    lock_guard<mutex> lock(mutex_);
+    ++live_tasks_;
+  }
+  Schedule(handle);
+}
+
+void Executor::Run() {
+  vector<thread> workers;
+  for (int t = 1; t < num_threads_; ++t) {
+    workers.push_back(thread(&Executor::Worker, this));
+  }
+  Worker();
+  for (size_t t = 0; t < workers.size(); ++t) {
+    workers[t].join();
+  }
+}
+
+void Executor::Schedule(coroutine_handle<> handle) {
+  bool wake_poller;
+  {
+    lock_guard<mutex> lock(mutex_);
+    ready_.push_back(handle);
+    // a worker picks the handle up itself, other threads may have to
+    // interrupt the only running thread in epoll_wait
+    wake_poller = polling_ && current_executor != this;
+  }
+  ready_condition_.notify_one();
+  if (wake_poller) {
+    WakePoller();
+  }
+}
+
+Executor::IoAwaiter Executor::Readable(int fd) {
+  return IoAwaiter{this, fd, EPOLLIN | EPOLLRDHUP};
+}
+
+Executor::IoAwaiter Executor::Writable(int fd) {
+  return IoAwaiter{this, fd, EPOLLOUT};
+}
+
+void Executor::IoAwaiter::await_suspend(coroutine_handle<> handle) {
+  // one-shot: the event resumes the coroutine once and disarms the fd
+  epoll_event event = {};
+  event.events = events | EPOLLONESHOT;
+  event.data.ptr = handle.address();
+  // the coroutine may be resumed by the poller before this returns, so
+  // nothing of the awaiter is touched after epoll_ctl
+  const int epoll_fd = executor->epoll_fd_;
+  const int watched_fd = fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, watched_fd, &event) != 0 && errno == ENOENT) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, watched_fd, &event);
+  }
+}
+
+void Executor::Forget(int fd) {
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void Executor::TaskDone() {
+  bool all_done;
+  {
+    lock_guard<mutex> lock(mutex_);
+    all_done = --live_tasks_ == 0;
+  }
+  if (all_done) {
+    ready_condition_.notify_all();
+    WakePoller();
+  }
+}
+
+void Executor::WakePoller() {
+  const uint64_t one = 1;
+  ssize_t written = write(wake_fd_, &one, sizeof(one));
+  (void) written;
+}
+
+void Executor::Worker() {
+  current_executor = this;
+  epoll_event events[kMaxEvents];
+  unique_lock<mutex> lock(mutex_);
+  for (;;) {
+    if (!ready_.empty()) {
+      coroutine_handle<> handle = ready_.front();
+      ready_.pop_front();
+      lock.unlock();
+      handle.resume();
+      lock.lock();
+      continue;
+    }
+    if (live_tasks_ == 0) {
+      break;
+    }
+    if (polling_) {
+      ready_condition_.wait(lock);
+      continue;
+    }
+
+    // nothing ready: this thread waits for I/O, the others for it
+    polling_ = true;
+    lock.unlock();
+    const int n_events = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    lock.lock();
+    polling_ = false;
+    for (int i = 0; i < n_events; ++i) {
+      if (events[i].data.ptr == nullptr) {
+        uint64_t count;
+        ssize_t bytes = read(wake_fd_, &count, sizeof(count));
+        (void) bytes;
+      } else {
+        ready_.push_back(coroutine_handle<>::from_address(events[i].data.ptr));
+      }
+    }
+    ready_condition_.notify_all();
+  }
+  current_executor = nullptr;
+}
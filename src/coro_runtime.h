@@ -0,0 +1,330 @@
+#ifndef CORO_RUNTIME_H_
+#define CORO_RUNTIME_H_
+
+// C++20 coroutines and epoll; only the coroutine sources include this, the
+// rest of the tree stays C++11, see tracking_session.h for their interface
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+class Executor;
+
+/**
+* A detached coroutine, e.g. one stage of a tracking session. It starts
+* suspended and runs once handed to Executor::Spawn; its frame is freed when
+* it returns.
+*/
+class Task {
+public:
+  struct promise_type {
+    Executor* executor = nullptr;
+
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+    struct FinalAwaiter {
+      bool await_ready() noexcept {
+        return false;
+      }
+      void await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+      void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept {
+      return {};
+    }
+    void return_void() {}
+    void unhandled_exception() {
+      std::terminate();
+    }
+  };
+
+  Task(Task&& other) noexcept : handle_(other.handle_) {
+    other.handle_ = nullptr;
+  }
+
+  ~Task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+private:
+  friend class Executor;
+
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+/**
+* Runs coroutines on a pool of threads and resumes the ones waiting for file
+* descriptors. Ready coroutines are resumed in FIFO order by any thread;
+* when none is ready one thread waits in epoll for I/O while the others
+* sleep, so a few threads serve any number of sessions that mostly wait.
+* Linux only.
+*/
+class Executor {
+public:
+
+  /**
+  * @param num_threads Threads of Run, 0 for one per core
+  */
+  explicit Executor(int num_threads);
+
+  ~Executor();
+
+  /**
+  * Hands a task to the executor; it first runs in Run. Safe to call from
+  * coroutines of this executor.
+  * @param task The task
+  */
+  void Spawn(Task task);
+
+  /**
+  * Runs until every spawned task has returned.
+  */
+  void Run();
+
+  /**
+  * Makes a suspended coroutine ready. Safe to call from any thread.
+  * @param handle The coroutine
+  */
+  void Schedule(std::coroutine_handle<> handle);
+
+  /**
+  * Awaitable that suspends until fd is readable (or hung up). A descriptor
+  * has one waiting coroutine at a time: a second wait on it replaces the
+  * first, so a reader and a writer of one socket use separate descriptors
+  * (see dup).
+  */
+  struct IoAwaiter {
+    Executor* executor;
+    int fd;
+    unsigned events;
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() const noexcept {}
+  };
+
+  /**
+  * @param fd A non-blocking file descriptor that supports epoll
+  */
+  IoAwaiter Readable(int fd);
+
+  /**
+  * @param fd A non-blocking file descriptor that supports epoll
+  */
+  IoAwaiter Writable(int fd);
+
+  /**
+  * Awaitable that moves the coroutine to the back of the ready queue, so a
+  * long stage lets the others run.
+  */
+  struct YieldAwaiter {
+    Executor* executor;
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+    void await_suspend(std::coroutine_handle<> handle) {
+      executor->Schedule(handle);
+    }
+    void await_resume() const noexcept {}
+  };
+
+  YieldAwaiter Yield() {
+    return YieldAwaiter{this};
+  }
+
+  /**
+  * Stops watching fd, to be called before closing it.
+  * @param fd The file descriptor
+  */
+  void Forget(int fd);
+
+private:
+  friend struct Task::promise_type::FinalAwaiter;
+
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  void Worker();
+  void TaskDone();
+  void WakePoller();
+
+  int num_threads_;
+
+  ///* epoll instance and the eventfd that interrupts its wait
+  int epoll_fd_;
+  int wake_fd_;
+
+  ///* ready coroutines, live tasks and the thread in epoll_wait, guarded by
+  ///* mutex_
+  std::mutex mutex_;
+  std::condition_variable ready_condition_;
+  std::deque<std::coroutine_handle<> > ready_;
+  size_t live_tasks_;
+  bool polling_;
+};
+
+/**
+* Bounded queue between two coroutines of one executor, e.g. the stages of a
+* tracking session. Push suspends while the channel is full and Pop while it
+* is empty, so a slow stage throttles the ones before it without blocking a
+* thread. Single producer and single consumer coroutine.
+*/
+template <typename T>
+class Channel {
+public:
+
+  /**
+  * @param executor Executor of both coroutines
+  * @param capacity Most queued elements
+  */
+  Channel(Executor* executor, size_t capacity)
+      : executor_(executor), capacity_(capacity), closed_(false) {}
+
+  struct PushAwaiter {
+    Channel* channel;
+    T value;
+    bool waited = false;
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+    bool await_suspend(std::coroutine_handle<> handle) {
+      std::lock_guard<std::mutex> lock(channel->mutex_);
+      if (channel->queue_.size() >= channel->capacity_) {
+        waited = true;
+        channel->producer_ = handle;
+        return true;
+      }
+      channel->PushLocked(std::move(value));
+      return false;
+    }
+    void await_resume() {
+      // after a wait the consumer has made room, which only this producer
+      // can take
+      if (waited) {
+        std::lock_guard<std::mutex> lock(channel->mutex_);
+        channel->PushLocked(std::move(value));
+      }
+    }
+  };
+
+  struct PopAwaiter {
+    Channel* channel;
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+    bool await_suspend(std::coroutine_handle<> handle) {
+      std::lock_guard<std::mutex> lock(channel->mutex_);
+      if (!channel->queue_.empty() || channel->closed_) {
+        return false;
+      }
+      channel->consumer_ = handle;
+      return true;
+    }
+    std::optional<T> await_resume() {
+      return channel->PopReady();
+    }
+  };
+
+  /**
+  * co_await Push(value) queues the value, waiting for room first.
+  */
+  PushAwaiter Push(T value) {
+    return PushAwaiter{this, std::move(value)};
+  }
+
+  /**
+  * co_await Pop() yields the oldest value, or nothing once the channel is
+  * closed and drained.
+  */
+  PopAwaiter Pop() {
+    return PopAwaiter{this};
+  }
+
+  /**
+  * Pops without waiting.
+  * @return The oldest value, nothing if the channel is empty
+  */
+  std::optional<T> TryPop() {
+    return PopReady();
+  }
+
+  /**
+  * Ends the stream, the consumer drains what is queued.
+  */
+  void Close() {
+    std::coroutine_handle<> consumer;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+      std::swap(consumer, consumer_);
+    }
+    if (consumer) {
+      executor_->Schedule(consumer);
+    }
+  }
+
+private:
+  Channel(const Channel&) = delete;
+  Channel& operator=(const Channel&) = delete;
+
+  void PushLocked(T value) {
+    queue_.push_back(std::move(value));
+    if (consumer_) {
+      executor_->Schedule(consumer_);
+      consumer_ = nullptr;
+    }
+  }
+
+  std::optional<T> PopReady() {
+    std::coroutine_handle<> producer;
+    std::optional<T> value;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (queue_.empty()) {
+        return value;
+      }
+      value = std::move(queue_.front());
+      queue_.pop_front();
+      std::swap(producer, producer_);
+    }
+    if (producer) {
+      // the suspended Push still holds its value and queues it on resume
+      executor_->Schedule(producer);
+    }
+    return value;
+  }
+
+  Executor* executor_;
+  const size_t capacity_;
+
+  std::mutex mutex_;
+  std::deque<T> queue_;
+  bool closed_;
+
+  ///* the coroutines waiting for room and for a value
+  std::coroutine_handle<> producer_;
+  std::coroutine_handle<> consumer_;
+};
+
+#endif /* CORO_RUNTIME_H_ */
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include "ego_motion.h"
+#include "fast_math.h"
+#include "parallel_for.h"
+
+using namespace std;
+using Eigen::ArrayXd;
+
+// measurements per batch
+static const int kBatch = 1024;
+
+EgoMotion::EgoMotion() : max_gap_us_(500000), num_threads_(0), skipped_lines_(0) {
+  const Mount origin = {0.0, 0.0, 0.0};
+  lidar_mount_ = origin;
+  radar_mount_ = origin;
+}
+
+bool EgoMotion::AddPose(long long timestamp, double x, double y, double yaw) {
+  if (!time_.empty() && timestamp <= time_.back()) {
+    return false;
+  }
+  // continue the unwrapped heading, so interpolation never crosses +-pi
+  if (!yaw_.empty()) {
+    yaw = yaw_.back() + FastMath::WrapAngle(yaw - yaw_.back());
+  }
+  time_.push_back(timestamp);
+  x_.push_back(x);
+  y_.push_back(y);
+  yaw_.push_back(yaw);
+  return true;
+}
+
+void EgoMotion::ReadPoses(istream& in) {
+
+  string line;
+  while (getline(in, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    istringstream iss(line);
+    long long timestamp;
+    double x, y, yaw;
+    iss >> timestamp >> x >> y >> yaw;
+    if (iss.fail() || !AddPose(timestamp, x, y, yaw)) {
+      ++skipped_lines_;
+    }
+  }
+}
+
+size_t EgoMotion::Compensate(vector<LogRecord>* records) const {
+
+  const size_t n = records->size();
+  vector<char> valid(n, 0);
+  const size_t n_batches = (n + kBatch - 1) / kBatch;
+  ParallelFor(n_batches, num_threads_, [&](size_t b) {
+    const size_t begin = b * kBatch;
+    CompensateBatch(&(*records)[begin], min(n - begin, (size_t) kBatch), &valid[begin]);
+  });
+
+  // drop the records without a pose, keeping the order
+  size_t n_kept = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (valid[i]) {
+      if (n_kept != i) {
+        (*records)[n_kept] = (*records)[i];
+      }
+      ++n_kept;
+    }
+  }
+  records->resize(n_kept);
+  return n - n_kept;
+}
+
+/**
+ * Gathers pose, mount and measurement of every record into arrays,
+ * transforms all of them with array expressions and writes the results back.
+ */
+void EgoMotion::CompensateBatch(LogRecord* records, int n, char* valid_out) const {
+
+  ArrayXd pose_x = ArrayXd::Zero(n);
+  ArrayXd pose_y = ArrayXd::Zero(n);
+  ArrayXd pose_yaw = ArrayXd::Zero(n);
+  ArrayXd pose_vx = ArrayXd::Zero(n);
+  ArrayXd pose_vy = ArrayXd::Zero(n);
+  ArrayXd pose_yaw_rate = ArrayXd::Zero(n);
+  ArrayXd mount_x = ArrayXd::Zero(n);
+  ArrayXd mount_y = ArrayXd::Zero(n);
+  ArrayXd mount_yaw = ArrayXd::Zero(n);
+  ArrayXd z0 = ArrayXd::Zero(n);
+  ArrayXd z1 = ArrayXd::Zero(n);
+  ArrayXd z2 = ArrayXd::Zero(n);
+
+  for (int i = 0; i < n; ++i) {
+    const MeasurementPackage& meas_package = records[i].measurement;
+    const long long t = meas_package.timestamp_;
+
+    // bracketing poses k-1 and k, a measurement at the last pose uses the
+    // last segment
+    size_t k = upper_bound(time_.begin(), time_.end(), t) - time_.begin();
+    if (k == time_.size() && k > 0 && time_.back() == t) {
+      --k;
+    }
+    valid_out[i] = k > 0 && k < time_.size() && time_[k] - time_[k - 1] <= max_gap_us_;
+    if (!valid_out[i]) {
+      continue;
+    }
+
+    const double h = time_[k] - time_[k - 1];
+    const double u = (t - time_[k - 1]) / h;
+    pose_x(i) = x_[k - 1] + u * (x_[k] - x_[k - 1]);
+    pose_y(i) = y_[k - 1] + u * (y_[k] - y_[k - 1]);
+    pose_yaw(i) = yaw_[k - 1] + u * (yaw_[k] - yaw_[k - 1]);
+    pose_vx(i) = (x_[k] - x_[k - 1]) * 1e6 / h;
+    pose_vy(i) = (y_[k] - y_[k - 1]) * 1e6 / h;
+    pose_yaw_rate(i) = (yaw_[k] - yaw_[k - 1]) * 1e6 / h;
+
+    const bool is_laser = meas_package.sensor_type_ == MeasurementPackage::LASER;
+    const Mount& mount = is_laser ? lidar_mount_ : radar_mount_;
+    mount_x(i) = mount.x;
+    mount_y(i) = mount.y;
+    mount_yaw(i) = mount.yaw;
+    z0(i) = meas_package.raw_measurements_(0);
+    z1(i) = meas_package.raw_measurements_(1);
+    z2(i) = is_laser ? 0.0 : meas_package.raw_measurements_(2);
+  }
+
+  // world position, heading and velocity of the sensors, the lever arm adds
+  // the rotation of the vehicle to the sensor velocity
+  ArrayXd sin_yaw;
+  ArrayXd cos_yaw;
+  SinCos(pose_yaw, &sin_yaw, &cos_yaw);
+  const ArrayXd lever_x = cos_yaw * mount_x - sin_yaw * mount_y;
+  const ArrayXd lever_y = sin_yaw * mount_x + cos_yaw * mount_y;
+  const ArrayXd sensor_x = pose_x + lever_x;
+  const ArrayXd sensor_y = pose_y + lever_y;
+  const ArrayXd sensor_vx = pose_vx - pose_yaw_rate * lever_y;
+  const ArrayXd sensor_vy = pose_vy + pose_yaw_rate * lever_x;
+  const ArrayXd heading = pose_yaw + mount_yaw;
+  ArrayXd sin_heading;
+  ArrayXd cos_heading;
+  SinCos(heading, &sin_heading, &cos_heading);
+
+  // lidar: rotate and shift the position
+  const ArrayXd lidar_x = sensor_x + cos_heading * z0 - sin_heading * z1;
+  const ArrayXd lidar_y = sensor_y + sin_heading * z0 + cos_heading * z1;
+
+  // radar: world bearing, the measured range rate is relative to the moving
+  // sensor, add the sensor velocity along the line of sight
+  const ArrayXd bearing = z1 + heading;
+  ArrayXd sin_bearing;
+  ArrayXd cos_bearing;
+  SinCos(bearing, &sin_bearing, &cos_bearing);
+  const ArrayXd range_rate = z2 + sensor_vx * cos_bearing + sensor_vy * sin_bearing;
+
+  for (int i = 0; i < n; ++i) {
+    if (!valid_out[i]) {
+      continue;
+    }
+    MeasurementPackage& meas_package = records[i].measurement;
+    if (meas_package.sensor_type_ == MeasurementPackage::LASER) {
+      meas_package.raw_measurements_(0) = lidar_x(i);
+      meas_package.raw_measurements_(1) = lidar_y(i);
+      if (meas_package.noise_covariance_.size() > 0) {
+        Eigen::Matrix2d rotation;
+        rotation << cos_heading(i), -sin_heading(i),
+                    sin_heading(i), cos_heading(i);
+        meas_package.noise_covariance_ =
+            rotation * meas_package.noise_covariance_ * rotation.transpose();
+      }
+    } else {
+      meas_package.raw_measurements_(1) = FastMath::WrapAngle(bearing(i));
+      meas_package.raw_measurements_(2) = range_rate(i);
+      meas_package.sensor_origin_ = Eigen::Vector2d(sensor_x(i), sensor_y(i));
+    }
+  }
+}
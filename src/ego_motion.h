@@ -0,0 +1,94 @@
+#ifndef EGO_MOTION_H_
+#define EGO_MOTION_H_
+
+#include <istream>
+#include <vector>
+#include "object_log.h"
+
+/**
+* Ego-motion compensation for sensors on a moving platform. The filter works
+* in a fixed world frame; this stage takes the vehicle pose stream, puts the
+* pose at every measurement time and moves the measurements from the sensor
+* frames into the world frame before they reach the filter:
+*  - lidar positions are rotated and shifted, as are their own noise
+*    covariances (the filter's lidar noise is assumed isotropic),
+*  - radar bearings become world bearings, the range rate is compensated for
+*    the velocity of the sensor so it is over ground, and the world position
+*    of the radar becomes the measurement's sensor_origin_.
+* Poses are interpolated linearly between the bracketing samples; the
+* vehicle velocity and yaw rate are those of the bracketing segment.
+* Measurements are transformed in batches with array expressions, the
+* batches run on a thread pool.
+*/
+class EgoMotion {
+public:
+
+  /**
+  * Mounting pose of a sensor in the vehicle frame.
+  */
+  struct Mount {
+    ///* position in m, x forward, y left
+    double x;
+    double y;
+    ///* heading relative to the vehicle in rad
+    double yaw;
+  };
+
+  ///* mounting poses, default at the vehicle origin facing forward
+  Mount lidar_mount_;
+  Mount radar_mount_;
+
+  ///* measurements between poses further apart than this in us are dropped
+  long long max_gap_us_;
+
+  ///* worker threads, 0 for one per core
+  int num_threads_;
+
+  ///* malformed or out of order pose lines that were skipped
+  long long skipped_lines_;
+
+  EgoMotion();
+
+  /**
+  * Appends a pose of the vehicle.
+  * @param timestamp Time in us, later than the previous pose
+  * @param x World position of the vehicle origin in m
+  * @param y World position of the vehicle origin in m
+  * @param yaw World heading of the vehicle in rad
+  * @return false if the pose is not later than the previous one
+  */
+  bool AddPose(long long timestamp, double x, double y, double yaw);
+
+  /**
+  * Appends the poses of a log with one "timestamp_us x y yaw" line per
+  * pose; empty lines and lines starting with '#' are skipped.
+  * @param in The pose log
+  */
+  void ReadPoses(std::istream& in);
+
+  /**
+  * Number of poses.
+  */
+  size_t size() const {
+    return time_.size();
+  }
+
+  /**
+  * Moves measurements into the world frame.
+  * @param records The records, transformed in place; records outside the
+  * pose stream or inside a gap are removed, the others keep their order
+  * @return The number of removed records
+  */
+  size_t Compensate(std::vector<LogRecord>* records) const;
+
+private:
+  void CompensateBatch(LogRecord* records, int n, char* valid_out) const;
+
+  ///* the poses, yaw unwrapped so that neighbors differ by less than pi
+  std::vector<long long> time_;
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<double> yaw_;
+};
+
+#endif /* EGO_MOTION_H_ */
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cmath>
+#include "evaluation.h"
+#include "parallel_for.h"
+
+using Eigen::ArrayXd;
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+using std::vector;
+
+namespace {
+
+///* samples reduced by one task
+const long long kBlockSize = 1 << 14;
+
+/**
+* Partial sums of one block of samples.
+*/
+struct Accumulator {
+  long long count;
+  VectorXd squared_error;
+  long long nees_count;
+  double nees_sum;
+  long long nees_above;
+
+  void Reset(int dim) {
+    count = 0;
+    squared_error = VectorXd::Zero(dim);
+    nees_count = 0;
+    nees_sum = 0;
+    nees_above = 0;
+  }
+
+  void Merge(const Accumulator& other) {
+    count += other.count;
+    squared_error += other.squared_error;
+    nees_count += other.nees_count;
+    nees_sum += other.nees_sum;
+    nees_above += other.nees_above;
+  }
+};
+
+/**
+* Samples [begin, end), belonging to one segment.
+*/
+struct Block {
+  long long begin;
+  long long end;
+  size_t segment;
+};
+
+void AccumulateBlock(const double* estimates, const double* covariances,
+                     const double* ground_truth, int dim, const Block& block,
+                     double nees_bound, Accumulator* acc) {
+
+  const long long len = block.end - block.begin;
+  acc->Reset(dim);
+  acc->count = len;
+
+  //residuals of the whole block, one sample per column
+  Eigen::Map<const MatrixXd> est(estimates + block.begin * dim, dim, len);
+  Eigen::Map<const MatrixXd> gt(ground_truth + block.begin * dim, dim, len);
+  const MatrixXd residual = est - gt;
+  acc->squared_error = residual.array().square().rowwise().sum().matrix();
+
+  if (covariances == nullptr) {
+    return;
+  }
+
+  //NEES = |L^-1 e|^2 with P = L L^T
+  Eigen::LLT<MatrixXd> llt(dim);
+  VectorXd e(dim);
+  for (long long i = 0; i < len; ++i) {
+    llt.compute(Eigen::Map<const MatrixXd>(covariances + (block.begin + i) * dim * dim, dim, dim));
+    if (llt.info() != Eigen::Success) {
+      //singular covariance, e.g. an unobserved velocity right after init
+      continue;
+    }
+    e = residual.col(i);
+    llt.matrixL().solveInPlace(e);
+    const double nees = e.squaredNorm();
+    ++acc->nees_count;
+    acc->nees_sum += nees;
+    acc->nees_above += nees > nees_bound;
+  }
+}
+
+ErrorSummary Finish(const Accumulator& acc) {
+  ErrorSummary summary;
+  summary.count = acc.count;
+  summary.nees_count = acc.nees_count;
+  summary.rmse = VectorXd::Zero(acc.squared_error.size());
+  summary.nees_mean = 0;
+  summary.nees_above_95 = 0;
+  if (acc.count > 0) {
+    summary.rmse = (acc.squared_error / acc.count).cwiseSqrt();
+  }
+  if (acc.nees_count > 0) {
+    summary.nees_mean = acc.nees_sum / acc.nees_count;
+    summary.nees_above_95 = double(acc.nees_above) / acc.nees_count;
+  }
+  return summary;
+}
+
+}  // namespace
+
+ErrorSummary Evaluation::Evaluate(const double* estimates, const double* covariances,
+                                  const double* ground_truth, int dim, long long n,
+                                  int num_threads) {
+
+  vector<ErrorSummary> segments = EvaluateSegments(estimates, covariances, ground_truth,
+                                                   dim, n, std::max(n, 1LL), num_threads);
+  return segments[0];
+}
+
+vector<ErrorSummary> Evaluation::EvaluateSegments(const double* estimates,
+                                                  const double* covariances,
+                                                  const double* ground_truth,
+                                                  int dim, long long n,
+                                                  long long segment_length,
+                                                  int num_threads) {
+
+  segment_length = std::max(segment_length, 1LL);
+  const size_t num_segments = std::max(1LL, (n + segment_length - 1) / segment_length);
+
+  //split every segment into blocks so that long segments still spread
+  //over all threads
+  vector<Block> blocks;
+  for (size_t s = 0; s < num_segments; ++s) {
+    const long long segment_end = std::min(n, (long long) (s + 1) * segment_length);
+    for (long long b = s * segment_length; b < segment_end; b += kBlockSize) {
+      Block block = {b, std::min(segment_end, b + kBlockSize), s};
+      blocks.push_back(block);
+    }
+  }
+
+  const double nees_bound = ChiSquare95(dim);
+  vector<Accumulator> partial(blocks.size());
+  ParallelFor(blocks.size(), num_threads, [&](size_t i) {
+    AccumulateBlock(estimates, covariances, ground_truth, dim, blocks[i],
+                    nees_bound, &partial[i]);
+  });
+
+  //merge the blocks of each segment in order
+  vector<Accumulator> totals(num_segments);
+  for (size_t s = 0; s < num_segments; ++s) {
+    totals[s].Reset(dim);
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    totals[blocks[i].segment].Merge(partial[i]);
+  }
+
+  vector<ErrorSummary> summaries(num_segments);
+  for (size_t s = 0; s < num_segments; ++s) {
+    summaries[s] = Finish(totals[s]);
+  }
+  return summaries;
+}
+
+ConsistencySummary Evaluation::SummarizeNIS(const double* values, long long n, int dof,
+                                            int num_threads) {
+
+  const double bound = ChiSquare95(dof);
+  const size_t num_blocks = (n + kBlockSize - 1) / kBlockSize;
+  vector<double> sums(num_blocks);
+  vector<long long> above(num_blocks);
+
+  ParallelFor(num_blocks, num_threads, [&](size_t i) {
+    const long long begin = i * kBlockSize;
+    Eigen::Map<const ArrayXd> block(values + begin, std::min(kBlockSize, n - begin));
+    sums[i] = block.sum();
+    above[i] = (block > bound).count();
+  });
+
+  ConsistencySummary summary;
+  summary.count = n;
+  summary.mean = 0;
+  summary.above_95 = 0;
+  for (size_t i = 0; i < num_blocks; ++i) {
+    summary.mean += sums[i];
+    summary.above_95 += above[i];
+  }
+  if (n > 0) {
+    summary.mean /= n;
+    summary.above_95 /= n;
+  }
+  return summary;
+}
+
+double Evaluation::ChiSquare95(int dof) {
+  //tabulated for the usual measurement and state dimensions
+  static const double kTable[] = {3.841, 5.991, 7.815, 9.488, 11.070, 12.592};
+  if (dof >= 1 && dof <= 6) {
+    return kTable[dof - 1];
+  }
+
+  //Wilson-Hilferty: (X/k)^(1/3) is approximately normal
+  const double z_95 = 1.6448536269514722;
+  const double h = 2.0 / (9.0 * dof);
+  const double c = 1.0 - h + z_95 * std::sqrt(h);
+  return dof * c * c * c;
+}
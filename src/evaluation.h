@@ -0,0 +1,102 @@
+#ifndef EVALUATION_H_
+#define EVALUATION_H_
+
+#include <vector>
+#include "Eigen/Dense"
+
+/**
+* Accuracy and consistency of a run over a range of samples.
+*/
+struct ErrorSummary {
+  ///* number of samples
+  long long count;
+
+  ///* root mean squared error per dimension
+  Eigen::VectorXd rmse;
+
+  ///* number of samples in the NEES, samples with a singular covariance are
+  ///* left out
+  long long nees_count;
+
+  ///* mean normalized estimation error squared e^T P^-1 e, 0 without
+  ///* covariances
+  double nees_mean;
+
+  ///* fraction of samples whose NEES exceeds the chi-square 95-percentile
+  double nees_above_95;
+};
+
+/**
+* Mean and 95-percentile exceedance of a chi-square distributed statistic
+* such as the NIS.
+*/
+struct ConsistencySummary {
+  ///* number of samples
+  long long count;
+
+  ///* mean value, the degrees of freedom for a consistent filter
+  double mean;
+
+  ///* fraction of samples above the chi-square 95-percentile, about 0.05 for
+  ///* a consistent filter
+  double above_95;
+};
+
+/**
+* Offline evaluation of estimates against ground truth. The inputs are
+* contiguous arrays of n samples: sample i occupies dim doubles of the
+* estimates and the ground truth at offset i * dim, and dim * dim doubles
+* (column-major) of the covariances at offset i * dim * dim. The samples are
+* reduced in blocks spread over num_threads threads (0 uses all cores), each
+* block as one array expression.
+*/
+class Evaluation {
+public:
+
+  /**
+  * RMSE and NEES over all samples.
+  * @param estimates n x dim estimates
+  * @param covariances n x dim x dim covariances of the estimates, nullptr to
+  * skip the NEES
+  * @param ground_truth n x dim true values
+  * @param dim Dimension of one sample
+  * @param n Number of samples
+  * @param num_threads Worker threads, 0 for one per core
+  */
+  static ErrorSummary Evaluate(const double* estimates, const double* covariances,
+                               const double* ground_truth, int dim, long long n,
+                               int num_threads = 0);
+
+  /**
+  * RMSE and NEES per segment of segment_length consecutive samples; the
+  * last segment holds the remainder.
+  * @param segment_length Samples per segment
+  * @see Evaluate
+  */
+  static std::vector<ErrorSummary> EvaluateSegments(const double* estimates,
+                                                    const double* covariances,
+                                                    const double* ground_truth,
+                                                    int dim, long long n,
+                                                    long long segment_length,
+                                                    int num_threads = 0);
+
+  /**
+  * Summarizes NIS (or any chi-square distributed) values.
+  * @param values n values
+  * @param n Number of values
+  * @param dof Degrees of freedom, the measurement dimension for the NIS
+  * @param num_threads Worker threads, 0 for one per core
+  */
+  static ConsistencySummary SummarizeNIS(const double* values, long long n, int dof,
+                                         int num_threads = 0);
+
+  /**
+  * 95-percentile of the chi-square distribution, tabulated up to 6 degrees
+  * of freedom and from the Wilson-Hilferty approximation (within 0.5%)
+  * above.
+  * @param dof Degrees of freedom
+  */
+  static double ChiSquare95(int dof);
+};
+
+#endif /* EVALUATION_H_ */
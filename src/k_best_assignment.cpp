@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <limits>
+#include "k_best_assignment.h"
+
+using namespace std;
+using Eigen::MatrixXd;
+
+static const double kInfinity = numeric_limits<double>::infinity();
+
+KBestAssignment::KBestAssignment() {}
+
+double KBestAssignment::SolveBest(const Eigen::Ref<const MatrixXd>& cost,
+                                  vector<int>* row_to_col_out) {
+
+  const int n_rows = cost.rows();
+  const int n_cols = cost.cols();
+  vector<int>& row_to_col = *row_to_col_out;
+  row_to_col.assign(n_rows, -1);
+  if (n_rows == 0) {
+    return 0.0;
+  }
+  if (n_rows > n_cols) {
+    return kInfinity;
+  }
+
+  // potentials and the row of every column, index 0 is a virtual column
+  // that holds the row being inserted
+  u_.assign(n_rows + 1, 0.0);
+  v_.assign(n_cols + 1, 0.0);
+  col_row_.assign(n_cols + 1, 0);
+  way_.assign(n_cols + 1, 0);
+
+  for (int i = 1; i <= n_rows; ++i) {
+    col_row_[0] = i;
+    int j0 = 0;
+    min_slack_.assign(n_cols + 1, kInfinity);
+    used_.assign(n_cols + 1, 0);
+
+    // grow a shortest path tree from row i until it reaches a free column
+    do {
+      used_[j0] = 1;
+      const int i0 = col_row_[j0];
+      double delta = kInfinity;
+      int j1 = -1;
+      for (int j = 1; j <= n_cols; ++j) {
+        if (used_[j]) {
+          continue;
+        }
+        const double slack = cost(i0 - 1, j - 1) - u_[i0] - v_[j];
+        if (slack < min_slack_[j]) {
+          min_slack_[j] = slack;
+          way_[j] = j0;
+        }
+        if (min_slack_[j] < delta) {
+          delta = min_slack_[j];
+          j1 = j;
+        }
+      }
+
+      // every reachable column is forbidden
+      if (j1 < 0) {
+        return kInfinity;
+      }
+
+      for (int j = 0; j <= n_cols; ++j) {
+        if (used_[j]) {
+          u_[col_row_[j]] += delta;
+          v_[j] -= delta;
+        } else {
+          min_slack_[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (col_row_[j0] != 0);
+
+    // augment along the path
+    do {
+      const int j1 = way_[j0];
+      col_row_[j0] = col_row_[j1];
+      j0 = j1;
+    } while (j0 != 0);
+  }
+
+  double total = 0.0;
+  for (int j = 1; j <= n_cols; ++j) {
+    if (col_row_[j] != 0) {
+      row_to_col[col_row_[j] - 1] = j - 1;
+      total += cost(col_row_[j] - 1, j - 1);
+    }
+  }
+  return total;
+}
+
+int KBestAssignment::Solve(const Eigen::Ref<const MatrixXd>& cost, int k,
+                           vector<int>* assignments_out, vector<double>* costs_out) {
+
+  const int n_rows = cost.rows();
+  assignments_out->clear();
+  costs_out->clear();
+  heap_.clear();
+  free_nodes_.clear();
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    free_nodes_.push_back(i);
+  }
+  if (k <= 0) {
+    return 0;
+  }
+
+  const auto cheaper = [this](int a, int b) {
+    return nodes_[a].cost > nodes_[b].cost;
+  };
+
+  const int root = NewNode();
+  nodes_[root].fixed.assign(n_rows, -1);
+  nodes_[root].excluded.clear();
+  if (!SolveNode(cost, &nodes_[root])) {
+    return 0;
+  }
+  heap_.push_back(root);
+
+  int n_found = 0;
+  while (n_found < k && !heap_.empty()) {
+    pop_heap(heap_.begin(), heap_.end(), cheaper);
+    const int best = heap_.back();
+    heap_.pop_back();
+
+    assignments_out->insert(assignments_out->end(), nodes_[best].solution.begin(),
+                            nodes_[best].solution.end());
+    costs_out->push_back(nodes_[best].cost);
+    ++n_found;
+    if (n_found == k) {
+      break;
+    }
+
+    // partition the remaining solutions of the node: child r keeps the
+    // assignment of the free rows before r and excludes the one of row r
+    for (int r = 0; r < n_rows; ++r) {
+      if (nodes_[best].fixed[r] >= 0) {
+        continue;
+      }
+      const int child = NewNode();
+      Node& node = nodes_[best];
+      Node& child_node = nodes_[child];
+      child_node.fixed = node.fixed;
+      child_node.excluded = node.excluded;
+      child_node.excluded.push_back(make_pair(r, node.solution[r]));
+      if (SolveNode(cost, &child_node)) {
+        heap_.push_back(child);
+        push_heap(heap_.begin(), heap_.end(), cheaper);
+      } else {
+        free_nodes_.push_back(child);
+      }
+      nodes_[best].fixed[r] = nodes_[best].solution[r];
+    }
+    free_nodes_.push_back(best);
+  }
+
+  return n_found;
+}
+
+bool KBestAssignment::SolveNode(const Eigen::Ref<const MatrixXd>& cost, Node* node) {
+
+  // forbid everything that conflicts with the fixed rows and the excluded
+  // entries
+  work_.resize(cost.size());
+  Eigen::Map<MatrixXd> work(work_.data(), cost.rows(), cost.cols());
+  work = cost;
+  for (int r = 0; r < (int) node->fixed.size(); ++r) {
+    const int c = node->fixed[r];
+    if (c >= 0) {
+      work.row(r).setConstant(kInfinity);
+      work.col(c).setConstant(kInfinity);
+      work(r, c) = cost(r, c);
+    }
+  }
+  for (size_t e = 0; e < node->excluded.size(); ++e) {
+    work(node->excluded[e].first, node->excluded[e].second) = kInfinity;
+  }
+
+  node->cost = SolveBest(work, &node->solution);
+  return node->cost < kInfinity;
+}
+
+int KBestAssignment::NewNode() {
+  if (!free_nodes_.empty()) {
+    const int index = free_nodes_.back();
+    free_nodes_.pop_back();
+    return index;
+  }
+  nodes_.push_back(Node());
+  return nodes_.size() - 1;
+}
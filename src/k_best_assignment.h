@@ -0,0 +1,82 @@
+#ifndef K_BEST_ASSIGNMENT_H_
+#define K_BEST_ASSIGNMENT_H_
+
+#include <utility>
+#include <vector>
+#include "Eigen/Dense"
+
+/**
+* The k cheapest assignments of rows to columns (Murty's algorithm), e.g. of
+* measurements to tracks. Every row is assigned one column, every column at
+* most one row, so there must be at least as many columns as rows. Entries
+* of infinite cost are forbidden. Each candidate is solved with the shortest
+* augmenting path method (Jonker-Volgenant), O(rows^2 cols).
+*
+* The search nodes and all scratch buffers are kept between calls, so
+* repeated solves of similar size do not allocate; the cost matrix may be a
+* block of a larger caller-owned buffer for the same reason.
+*/
+class KBestAssignment {
+public:
+
+  KBestAssignment();
+
+  /**
+  * Enumerates assignments in order of increasing total cost.
+  * @param cost Cost of assigning row i to column j, rows <= cols
+  * @param k Maximum number of assignments
+  * @param assignments_out The column of every row, assignment a at
+  * a * rows .. (a + 1) * rows - 1
+  * @param costs_out The total cost of every assignment
+  * @return The number of assignments found, less than k if no more are
+  * feasible
+  */
+  int Solve(const Eigen::Ref<const Eigen::MatrixXd>& cost, int k,
+            std::vector<int>* assignments_out, std::vector<double>* costs_out);
+
+  /**
+  * Cheapest assignment only.
+  * @param cost Cost of assigning row i to column j, rows <= cols
+  * @param row_to_col_out The column of every row
+  * @return The total cost, infinity if no assignment is feasible
+  */
+  double SolveBest(const Eigen::Ref<const Eigen::MatrixXd>& cost,
+                   std::vector<int>* row_to_col_out);
+
+private:
+  /**
+  * Subproblem of the search: some rows are fixed to a column, some entries
+  * are excluded, the solution is the cheapest assignment under both.
+  */
+  struct Node {
+    double cost;
+    std::vector<int> solution;
+    ///* fixed column of every row, -1 if free
+    std::vector<int> fixed;
+    ///* excluded (row, col) entries
+    std::vector<std::pair<int, int> > excluded;
+  };
+
+  bool SolveNode(const Eigen::Ref<const Eigen::MatrixXd>& cost, Node* node);
+  int NewNode();
+
+  ///* node pool, nodes are reused through free_nodes_
+  std::vector<Node> nodes_;
+  std::vector<int> free_nodes_;
+
+  ///* open nodes, a min-heap by cost
+  std::vector<int> heap_;
+
+  ///* cost matrix of the current subproblem, column-major
+  std::vector<double> work_;
+
+  ///* shortest augmenting path state
+  std::vector<double> u_;
+  std::vector<double> v_;
+  std::vector<double> min_slack_;
+  std::vector<int> col_row_;
+  std::vector<int> way_;
+  std::vector<char> used_;
+};
+
+#endif /* K_BEST_ASSIGNMENT_H_ */
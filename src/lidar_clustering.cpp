@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "lidar_clustering.h"
+#include "parallel_for.h"
+
+using namespace std;
+
+// points or voxels per parallel task
+static const size_t kBlock = 4096;
+
+/**
+ * Runs f(begin, end) over blocks of [0, n) on the thread pool.
+ */
+template <typename F>
+static void ForBlocks(size_t n, int num_threads, const F& f) {
+  const size_t n_blocks = (n + kBlock - 1) / kBlock;
+  ParallelFor(n_blocks, num_threads, [&](size_t b) {
+    f(b * kBlock, min(n, (b + 1) * kBlock));
+  });
+}
+
+LidarClustering::LidarClustering() : n_neighbors_(0), parent_capacity_(0) {
+
+  // ground: lowest return of 1 m cells, 20 cm above it
+  remove_ground_ = true;
+  ground_cell_size_ = 1.0;
+  ground_tolerance_ = 0.2;
+  max_ground_height_ = 0.5;
+
+  // clusters: returns closer than 50 cm, at least 3 per core point
+  use_3d_ = true;
+  cluster_distance_ = 0.5;
+  min_neighbors_ = 3;
+  min_cluster_points_ = 5;
+
+  // centroid noise: at least the 15 cm of a single return, plus a tenth of
+  // the spread
+  min_position_noise_ = 0.15;
+  extent_noise_scale_ = 0.1;
+
+  num_threads_ = 0;
+}
+
+void LidarClustering::Process(const vector<LidarPoint>& sweep, long long timestamp,
+                              vector<MeasurementPackage>* detections_out) {
+
+  keep_.assign(sweep.size(), 1);
+  if (remove_ground_ && use_3d_) {
+    RemoveGround(sweep);
+  }
+  BuildVoxels(sweep);
+  ClusterPoints();
+  Summarize(sweep, timestamp, detections_out);
+}
+
+/**
+ * Marks the returns close above the lowest return of their ground cell.
+ */
+void LidarClustering::RemoveGround(const vector<LidarPoint>& sweep) {
+
+  const size_t n = sweep.size();
+  const double inv_cell = 1.0 / ground_cell_size_;
+
+  ground_cells_.Clear(n / 16);
+  point_cell_.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    point_cell_[i] = ground_cells_.Insert(VoxelHash::Key(floor(sweep[i].x * inv_cell),
+                                                         floor(sweep[i].y * inv_cell), 0));
+  }
+
+  cell_min_z_.assign(ground_cells_.size(), numeric_limits<float>::infinity());
+  for (size_t i = 0; i < n; ++i) {
+    cell_min_z_[point_cell_[i]] = min(cell_min_z_[point_cell_[i]], sweep[i].z);
+  }
+
+  ForBlocks(n, num_threads_, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const float ground_z = cell_min_z_[point_cell_[i]];
+      if (ground_z <= max_ground_height_ && sweep[i].z - ground_z < ground_tolerance_) {
+        keep_[i] = 0;
+      }
+    }
+  });
+}
+
+/**
+ * Sorts the remaining points into voxels of the cluster distance and looks
+ * up the occupied neighbors of every voxel.
+ */
+void LidarClustering::BuildVoxels(const vector<LidarPoint>& sweep) {
+
+  const size_t n = sweep.size();
+  const double inv_cell = 1.0 / cluster_distance_;
+
+  voxels_.Clear(n / 4);
+  point_slot_.resize(n);
+  size_t n_kept = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (!keep_[i]) {
+      point_slot_[i] = -1;
+      continue;
+    }
+    const int iz = use_3d_ ? (int) floor(sweep[i].z * inv_cell) : 0;
+    point_slot_[i] = voxels_.Insert(VoxelHash::Key(floor(sweep[i].x * inv_cell),
+                                                    floor(sweep[i].y * inv_cell), iz));
+    ++n_kept;
+  }
+
+  // counting sort by voxel, with a copy of the points in that order so the
+  // neighbor scans read contiguous memory
+  const int n_voxels = voxels_.size();
+  voxel_start_.assign(n_voxels + 1, 0);
+  for (size_t i = 0; i < n; ++i) {
+    if (point_slot_[i] >= 0) {
+      ++voxel_start_[point_slot_[i] + 1];
+    }
+  }
+  for (int v = 0; v < n_voxels; ++v) {
+    voxel_start_[v + 1] += voxel_start_[v];
+  }
+  voxel_fill_.assign(voxel_start_.begin(), voxel_start_.end() - 1);
+  voxel_points_.resize(n_kept);
+  for (size_t i = 0; i < n; ++i) {
+    if (point_slot_[i] >= 0) {
+      point_slot_[i] = voxel_fill_[point_slot_[i]]++;
+      voxel_points_[point_slot_[i]] = sweep[i];
+    }
+  }
+
+  // the 3x3 (x 3) block around every voxel
+  n_neighbors_ = use_3d_ ? 27 : 9;
+  const int dz_range = use_3d_ ? 1 : 0;
+  voxel_neighbors_.resize(n_voxels * n_neighbors_);
+  ForBlocks(n_voxels, num_threads_, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      const LidarPoint& p = voxel_points_[voxel_start_[v]];
+      const int ix = floor(p.x * inv_cell);
+      const int iy = floor(p.y * inv_cell);
+      const int iz = use_3d_ ? (int) floor(p.z * inv_cell) : 0;
+      int* neighbors = &voxel_neighbors_[v * n_neighbors_];
+      for (int dx = -1; dx <= 1; ++dx) {
+        for (int dy = -1; dy <= 1; ++dy) {
+          for (int dz = -dz_range; dz <= dz_range; ++dz) {
+            *neighbors++ = voxels_.Find(VoxelHash::Key(ix + dx, iy + dy, iz + dz));
+          }
+        }
+      }
+    }
+  });
+}
+
+/**
+ * DBSCAN over the voxels: core points, unions of neighboring core points,
+ * then border points.
+ */
+void LidarClustering::ClusterPoints() {
+
+  const size_t n = voxel_points_.size();
+  const LidarPoint* points = voxel_points_.data();
+  const int n_voxels = voxels_.size();
+  const float eps2 = cluster_distance_ * cluster_distance_;
+
+  const float z_scale = use_3d_ ? 1.0f : 0.0f;
+  const auto close = [points, eps2, z_scale](int a, int b) {
+    const float dx = points[a].x - points[b].x;
+    const float dy = points[a].y - points[b].y;
+    const float dz = (points[a].z - points[b].z) * z_scale;
+    return dx * dx + dy * dy + dz * dz <= eps2;
+  };
+
+  // core points have enough neighbors, stop counting once there are
+  core_.assign(n, 0);
+  ForBlocks(n_voxels, num_threads_, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      const int* neighbors = &voxel_neighbors_[v * n_neighbors_];
+      for (int p = voxel_start_[v]; p < voxel_start_[v + 1]; ++p) {
+        int count = 0;
+        for (int w = 0; w < n_neighbors_ && count < min_neighbors_; ++w) {
+          if (neighbors[w] < 0) {
+            continue;
+          }
+          for (int q = voxel_start_[neighbors[w]]; q < voxel_start_[neighbors[w] + 1]; ++q) {
+            if (close(p, q) && ++count >= min_neighbors_) {
+              break;
+            }
+          }
+        }
+        core_[p] = count >= min_neighbors_;
+      }
+    }
+  });
+
+  if (parent_capacity_ < n) {
+    parent_.reset(new atomic<int>[n]);
+    parent_capacity_ = n;
+  }
+  ForBlocks(n, num_threads_, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      parent_[i].store(i, memory_order_relaxed);
+    }
+  });
+
+  // join core points within the radius, each pair once: slots are sorted by
+  // voxel, so the later slots are the rest of the own voxel and the voxels
+  // with higher IDs
+  ForBlocks(n_voxels, num_threads_, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      const int* neighbors = &voxel_neighbors_[v * n_neighbors_];
+      for (int p = voxel_start_[v]; p < voxel_start_[v + 1]; ++p) {
+        if (!core_[p]) {
+          continue;
+        }
+        // most close pairs are already joined, a point whose parent is the
+        // root of p needs no union; the test is branch free, since whether a
+        // point is close is a coin flip in dense clusters
+        int root = Find(p);
+        for (int w = 0; w < n_neighbors_; ++w) {
+          const int neighbor = neighbors[w];
+          if (neighbor < (int) v) {
+            continue;
+          }
+          const int first = neighbor == (int) v ? p + 1 : voxel_start_[neighbor];
+          for (int q = first; q < voxel_start_[neighbor + 1]; ++q) {
+            if (core_[q] & close(p, q) & (parent_[q].load(memory_order_relaxed) != root)) {
+              Union(p, q);
+              root = Find(p);
+            }
+          }
+        }
+      }
+    }
+  });
+
+  // border points join the cluster of one core neighbor
+  border_of_.assign(n, -1);
+  ForBlocks(n_voxels, num_threads_, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      const int* neighbors = &voxel_neighbors_[v * n_neighbors_];
+      for (int p = voxel_start_[v]; p < voxel_start_[v + 1]; ++p) {
+        if (core_[p]) {
+          continue;
+        }
+        for (int w = 0; w < n_neighbors_ && border_of_[p] < 0; ++w) {
+          if (neighbors[w] < 0) {
+            continue;
+          }
+          for (int q = voxel_start_[neighbors[w]]; q < voxel_start_[neighbors[w] + 1]; ++q) {
+            if (core_[q] && close(p, q)) {
+              border_of_[p] = q;
+              break;
+            }
+          }
+        }
+      }
+    }
+  });
+}
+
+/**
+ * Numbers the clusters in sweep order and converts the large enough ones
+ * into centroid measurements.
+ */
+void LidarClustering::Summarize(const vector<LidarPoint>& sweep, long long timestamp,
+                                vector<MeasurementPackage>* detections_out) {
+
+  const size_t n = sweep.size();
+  labels_.assign(n, -1);
+  root_cluster_.assign(voxel_points_.size(), -1);
+  cluster_size_.clear();
+  cluster_sums_.clear();
+
+  // count, sum x, sum y, sum xx, sum xy, sum yy per cluster
+  for (size_t i = 0; i < n; ++i) {
+    const int p = point_slot_[i];
+    int root;
+    if (p < 0) {
+      continue;
+    } else if (core_[p]) {
+      root = Find(p);
+    } else if (border_of_[p] >= 0) {
+      root = Find(border_of_[p]);
+    } else {
+      continue;
+    }
+    if (root_cluster_[root] < 0) {
+      root_cluster_[root] = cluster_size_.size();
+      cluster_size_.push_back(0);
+      cluster_sums_.insert(cluster_sums_.end(), 5, 0.0);
+    }
+    const int c = root_cluster_[root];
+    const double x = sweep[i].x;
+    const double y = sweep[i].y;
+    double* sums = &cluster_sums_[5 * c];
+    sums[0] += x;
+    sums[1] += y;
+    sums[2] += x * x;
+    sums[3] += x * y;
+    sums[4] += y * y;
+    ++cluster_size_[c];
+    labels_[i] = c;
+  }
+
+  // one detection per large enough cluster, cluster_size_ becomes the index
+  // of the detection
+  detections_out->clear();
+  const double floor_variance = min_position_noise_ * min_position_noise_;
+  for (size_t c = 0; c < cluster_size_.size(); ++c) {
+    const int count = cluster_size_[c];
+    if (count < min_cluster_points_) {
+      cluster_size_[c] = -1;
+      continue;
+    }
+    const double* sums = &cluster_sums_[5 * c];
+    const double mean_x = sums[0] / count;
+    const double mean_y = sums[1] / count;
+    Eigen::Matrix2d spread;
+    spread << sums[2] / count - mean_x * mean_x, sums[3] / count - mean_x * mean_y,
+              sums[3] / count - mean_x * mean_y, sums[4] / count - mean_y * mean_y;
+
+    // error of the mean plus a share of the extent for partial views
+    MeasurementPackage detection;
+    detection.timestamp_ = timestamp;
+    detection.sensor_type_ = MeasurementPackage::LASER;
+    detection.raw_measurements_ = Eigen::VectorXd(2);
+    detection.raw_measurements_ << mean_x, mean_y;
+    detection.noise_covariance_ = spread * (1.0 / count + extent_noise_scale_) +
+                                  floor_variance * Eigen::Matrix2d::Identity();
+
+    cluster_size_[c] = detections_out->size();
+    detections_out->push_back(detection);
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    if (labels_[i] >= 0) {
+      labels_[i] = cluster_size_[labels_[i]];
+    }
+  }
+}
+
+/**
+ * Root of a point, with path halving. Safe to call concurrently with Union.
+ */
+int LidarClustering::Find(int i) {
+  for (;;) {
+    int p = parent_[i].load(memory_order_relaxed);
+    if (p == i) {
+      return i;
+    }
+    const int grandparent = parent_[p].load(memory_order_relaxed);
+    if (p != grandparent) {
+      parent_[i].compare_exchange_weak(p, grandparent, memory_order_relaxed);
+    }
+    i = grandparent;
+  }
+}
+
+/**
+ * Joins the sets of two points. Roots are linked to the smaller index, so
+ * concurrent unions cannot form cycles.
+ */
+void LidarClustering::Union(int a, int b) {
+  for (;;) {
+    a = Find(a);
+    b = Find(b);
+    if (a == b) {
+      return;
+    }
+    if (a < b) {
+      swap(a, b);
+    }
+    int expected = a;
+    if (parent_[a].compare_exchange_strong(expected, b)) {
+      return;
+    }
+  }
+}
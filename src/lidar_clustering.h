@@ -0,0 +1,139 @@
+#ifndef LIDAR_CLUSTERING_H_
+#define LIDAR_CLUSTERING_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "measurement_package.h"
+#include "voxel_hash.h"
+
+/**
+* One lidar return in the sensor frame, in m. 2D sweeps leave z at 0.
+*/
+struct LidarPoint {
+  float x;
+  float y;
+  float z;
+};
+
+/**
+* Detection front end for raw lidar sweeps: removes the ground, clusters the
+* remaining points with DBSCAN on a voxel hash and reports each cluster's
+* centroid as a lidar MeasurementPackage with its own noise covariance.
+*
+* Ground removal keeps per ground cell the lowest return; points close above
+* a low enough minimum are ground. DBSCAN uses voxels of the cluster distance,
+* so all neighbors of a point are in the surrounding 3x3 (3x3x3) voxels.
+* Core points are joined with a lock-free union-find, border points are
+* attached to a neighboring core point and noise points are dropped. All
+* per-point stages run on a thread pool; buffers are kept between sweeps.
+*/
+class LidarClustering {
+public:
+
+  ///* if this is true, ground returns are removed (3D sweeps only)
+  bool remove_ground_;
+
+  ///* ground cell size in m
+  double ground_cell_size_;
+
+  ///* points less than this above the lowest return of their ground cell
+  ///* are ground, in m
+  double ground_tolerance_;
+
+  ///* cells whose lowest return is higher than this are not ground, in m
+  double max_ground_height_;
+
+  ///* if this is true, distances are measured in 3D, otherwise in x-y
+  bool use_3d_;
+
+  ///* DBSCAN neighborhood radius in m
+  double cluster_distance_;
+
+  ///* DBSCAN minimum number of points within the radius, including the point
+  ///* itself, for a core point; 1 gives plain Euclidean clustering
+  int min_neighbors_;
+
+  ///* clusters with fewer points are dropped
+  int min_cluster_points_;
+
+  ///* lower bound of the centroid standard deviation in m
+  double min_position_noise_;
+
+  ///* share of the cluster spread added to the centroid covariance, models
+  ///* the bias of centroids of partially visible objects
+  double extent_noise_scale_;
+
+  ///* worker threads, 0 for one per core
+  int num_threads_;
+
+  LidarClustering();
+
+  /**
+  * Turns one sweep into detections.
+  * @param sweep The points
+  * @param timestamp Time of the sweep in us
+  * @param detections_out One lidar measurement per cluster, ordered by the
+  * cluster's first point in the sweep
+  */
+  void Process(const std::vector<LidarPoint>& sweep, long long timestamp,
+               std::vector<MeasurementPackage>* detections_out);
+
+  /**
+  * Cluster of every point of the last sweep, the index of its detection or
+  * -1 for ground, noise and dropped clusters.
+  */
+  const std::vector<int>& labels() const {
+    return labels_;
+  }
+
+private:
+  LidarClustering(const LidarClustering&);
+  LidarClustering& operator=(const LidarClustering&);
+
+  void RemoveGround(const std::vector<LidarPoint>& sweep);
+  void BuildVoxels(const std::vector<LidarPoint>& sweep);
+  void ClusterPoints();
+  void Summarize(const std::vector<LidarPoint>& sweep, long long timestamp,
+                 std::vector<MeasurementPackage>* detections_out);
+
+  int Find(int i);
+  void Union(int a, int b);
+
+  ///* 1 for points that take part in the clustering
+  std::vector<char> keep_;
+
+  ///* lowest return per ground cell
+  VoxelHash ground_cells_;
+  std::vector<int> point_cell_;
+  std::vector<float> cell_min_z_;
+
+  ///* remaining points sorted by voxel: voxel v holds
+  ///* voxel_points_[voxel_start_[v] .. voxel_start_[v + 1] - 1]; the
+  ///* clustering works on these slots
+  VoxelHash voxels_;
+  std::vector<int> voxel_start_;
+  std::vector<LidarPoint> voxel_points_;
+  std::vector<int> voxel_fill_;
+
+  ///* slot of every point of the sweep, -1 if removed
+  std::vector<int> point_slot_;
+
+  ///* neighbor voxels of every voxel, n_neighbors_ per voxel, -1 if empty
+  std::vector<int> voxel_neighbors_;
+  int n_neighbors_;
+
+  ///* DBSCAN state per slot
+  std::vector<char> core_;
+  std::vector<int> border_of_;
+  std::unique_ptr<std::atomic<int>[]> parent_;
+  size_t parent_capacity_;
+
+  ///* final labels per point and cluster index per root slot
+  std::vector<int> labels_;
+  std::vector<int> root_cluster_;
+  std::vector<int> cluster_size_;
+  std::vector<double> cluster_sums_;
+};
+
+#endif /* LIDAR_CLUSTERING_H_ */
@@ -1,236 +1,450 @@
-
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <vector>
+#include <stdio.h>
 #include <stdlib.h>
 #include "Eigen/Dense"
-#include "ukf.h"
-#include "ground_truth_package.h"
-#include "measurement_package.h"
+#include "ego_motion.h"
+#include "evaluation.h"
+#include "measurement_model.h"
+#include "ground_truth_join.h"
+#include "object_log.h"
+#include "replay.h"
+#include "tracking_session.h"
 
 using namespace std;
 using Eigen::MatrixXd;
 using Eigen::VectorXd;
 using std::vector;
 
-void check_arguments(int argc, char* argv[]) {
+/**
+ * Command line of the replay tool.
+ */
+struct Arguments {
+  string in_name;
+  string out_name;
+
+  // separate ground truth log, empty if the input has inline ground truth
+  string gt_name;
+
+  // worker threads for multi-object logs, 0 for one per core
+  int num_threads;
+
+  // write one output file per object instead of one merged file
+  bool per_object;
+
+  // also write the parsed input as a binary log
+  string binary_out_name;
+
+  // frame-synchronous processing of the track bank
+  bool frames;
+
+  // time budget per frame in us with load shedding, 0 for none, and the
+  // ranking of the tracks under overload
+  long long frame_budget_us;
+  OverloadPolicy::Priority priority;
+
+  // multi-hypothesis tracking without the object IDs
+  bool mht;
+
+  // pose log of the vehicle carrying the sensors, empty for static sensors
+  string ego_poses_name;
+
+  // real-time pipeline with locked memory and pinned threads
+  bool realtime;
+  RealTimeConfig realtime_config;
+
+  // independent coroutine tracking sessions of the log, 0 for none
+  int sessions;
+};
+
+void check_arguments(int argc, char* argv[], Arguments* args) {
   string usage_instructions = "Usage instructions: ";
   usage_instructions += argv[0];
-  usage_instructions += " path/to/input.txt output.txt";
-
-  bool has_valid_args = false;
+  usage_instructions += " path/to/input.txt output.txt [path/to/ground_truth.txt]"
+                        " [-j threads] [--per-object] [--frames [--frame-budget us]"
+                        " [--priority range|closing]] [--mht] [--ego-poses poses.txt]"
+                        " [--realtime [--cpus ingest,filter,output] [--fifo priority]"
+                        " [--pace factor] [--ingest-per-sensor] [--wait spin|park|block]]"
+                        " [--sessions N] [--write-binary log.bin]";
+
+  args->num_threads = 0;
+  args->per_object = false;
+  args->frames = false;
+  args->frame_budget_us = 0;
+  args->priority = OverloadPolicy::RANGE;
+  args->mht = false;
+  args->realtime = false;
+  args->sessions = 0;
+
+  vector<string> positional;
+  bool has_valid_args = true;
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      args->num_threads = atoi(argv[++i]);
+    } else if (arg == "--per-object") {
+      args->per_object = true;
+    } else if (arg == "--frames") {
+      args->frames = true;
+    } else if (arg == "--frame-budget" && i + 1 < argc) {
+      args->frames = true;
+      args->frame_budget_us = atoll(argv[++i]);
+    } else if (arg == "--priority" && i + 1 < argc) {
+      const string priority = argv[++i];
+      if (priority == "range") {
+        args->priority = OverloadPolicy::RANGE;
+      } else if (priority == "closing") {
+        args->priority = OverloadPolicy::CLOSING_TIME;
+      } else {
+        cerr << "--priority expects range or closing.\n";
+        has_valid_args = false;
+      }
+    } else if (arg == "--mht") {
+      args->mht = true;
+    } else if (arg == "--realtime") {
+      args->realtime = true;
+    } else if (arg == "--cpus" && i + 1 < argc) {
+      RealTimeConfig& config = args->realtime_config;
+      if (sscanf(argv[++i], "%d,%d,%d", &config.ingest_cpu, &config.filter_cpu,
+                 &config.output_cpu) != 3) {
+        cerr << "--cpus expects three CPUs, e.g. 1,2,3.\n";
+        has_valid_args = false;
+      }
+    } else if (arg == "--fifo" && i + 1 < argc) {
+      args->realtime_config.fifo_priority = atoi(argv[++i]);
+    } else if (arg == "--pace" && i + 1 < argc) {
+      args->realtime_config.pace = atof(argv[++i]);
+    } else if (arg == "--ingest-per-sensor") {
+      args->realtime_config.ingest_per_sensor = true;
+    } else if (arg == "--wait" && i + 1 < argc) {
+      const string wait = argv[++i];
+      if (wait == "spin") {
+        args->realtime_config.ingest_wait = MpscQueueBase::SPIN;
+      } else if (wait == "park") {
+        args->realtime_config.ingest_wait = MpscQueueBase::SPIN_THEN_PARK;
+      } else if (wait == "block") {
+        args->realtime_config.ingest_wait = MpscQueueBase::BLOCK;
+      } else {
+        cerr << "--wait expects spin, park or block.\n";
+        has_valid_args = false;
+      }
+    } else if (arg == "--sessions" && i + 1 < argc) {
+      args->sessions = atoi(argv[++i]);
+#ifndef UKF_COROUTINES
+      cerr << "--sessions needs a build with -DUKF_COROUTINES=ON.\n";
+      has_valid_args = false;
+#endif
+    } else if (arg == "--ego-poses" && i + 1 < argc) {
+      args->ego_poses_name = argv[++i];
+    } else if (arg == "--write-binary" && i + 1 < argc) {
+      args->binary_out_name = argv[++i];
+    } else if (arg[0] == '-') {
+      cerr << "Unknown option " << arg << ".\n";
+      has_valid_args = false;
+    } else {
+      positional.push_back(arg);
+    }
+  }
 
   // make sure the user has provided input and output files
-  if (argc == 1) {
+  if (positional.size() == 0) {
     cerr << usage_instructions << endl;
-  } else if (argc == 2) {
+    has_valid_args = false;
+  } else if (positional.size() == 1) {
     cerr << "Please include an output file.\n" << usage_instructions << endl;
-  } else if (argc == 3) {
-    has_valid_args = true;
-  } else if (argc > 3) {
+    has_valid_args = false;
+  } else if (positional.size() > 3) {
     cerr << "Too many arguments.\n" << usage_instructions << endl;
+    has_valid_args = false;
+  }
+
+  // unpaced sensor drivers have no common clock, one would run ahead of
+  // the other by the whole log
+  if (args->realtime_config.ingest_per_sensor && args->realtime_config.pace <= 0) {
+    cerr << "--ingest-per-sensor needs --pace.\n";
+    has_valid_args = false;
   }
 
   if (!has_valid_args) {
     exit(EXIT_FAILURE);
   }
+
+  args->in_name = positional[0];
+  args->out_name = positional[1];
+  if (positional.size() == 3) {
+    args->gt_name = positional[2];
+  }
 }
 
-void check_files(ifstream& in_file, string& in_name,
-                 ofstream& out_file, string& out_name) {
-  if (!in_file.is_open()) {
-    cerr << "Cannot open input file: " << in_name << endl;
+void check_file(ios& file, const string& name) {
+  if (!file.good()) {
+    cerr << "Cannot open file: " << name << endl;
     exit(EXIT_FAILURE);
   }
+}
 
-  if (!out_file.is_open()) {
-    cerr << "Cannot open output file: " << out_name << endl;
-    exit(EXIT_FAILURE);
+/**
+ * Output file of one object, out.txt -> out_<id>.txt
+ */
+string object_file_name(const string& out_name, long long object_id) {
+  const size_t dot = out_name.find_last_of('.');
+  const size_t slash = out_name.find_last_of('/');
+  ostringstream name;
+  if (dot == string::npos || (slash != string::npos && dot < slash)) {
+    name << out_name << "_" << object_id;
+  } else {
+    name << out_name.substr(0, dot) << "_" << object_id << out_name.substr(dot);
   }
+  return name.str();
 }
 
 int main(int argc, char* argv[]) {
 
-  check_arguments(argc, argv);
-
-  string in_file_name_ = argv[1];
-  ifstream in_file_(in_file_name_.c_str(), ifstream::in);
-
-  string out_file_name_ = argv[2];
-  ofstream out_file_(out_file_name_.c_str(), ofstream::out);
-
-  check_files(in_file_, in_file_name_, out_file_, out_file_name_);
+  Arguments args;
+  check_arguments(argc, argv, &args);
+
+#ifdef UKF_COROUTINES
+  // many clients on a few threads: every session streams the log text
+  // through its own coroutine pipeline, the first session's rows are written
+  if (args.sessions > 0) {
+    ifstream in_file_(args.in_name.c_str(), ifstream::in | ifstream::binary);
+    check_file(in_file_, args.in_name);
+    ostringstream log_text;
+    log_text << in_file_.rdbuf();
+
+    vector<string> outputs;
+    vector<SessionStats> stats;
+    if (!TrackingSessions::RunLocal(log_text.str(), args.sessions, args.num_threads,
+                                    SessionConfig(), &outputs, &stats)) {
+      cerr << "Not all sessions could be started." << endl;
+    }
+    ofstream out_file_(args.out_name.c_str(), ofstream::out);
+    check_file(out_file_, args.out_name);
+    out_file_ << outputs[0];
+
+    long long n_measurements = 0;
+    long long n_late = 0;
+    long long n_rows = 0;
+    int n_identical = 0;
+    for (size_t i = 0; i < stats.size(); ++i) {
+      n_measurements += stats[i].measurements;
+      n_late += stats[i].late;
+      n_rows += stats[i].rows;
+      n_identical += outputs[i] == outputs[0];
+    }
+    cout << "Sessions " << args.sessions << ", measurements " << n_measurements
+         << ", late " << n_late << ", rows " << n_rows << ", identical to the first "
+         << n_identical << endl;
+    return 0;
+  }
+#endif
 
   /**********************************************
    *  Set Measurements                          *
    **********************************************/
 
-  vector<MeasurementPackage> measurement_pack_list;
-  vector<GroundTruthPackage> gt_pack_list;
-
-  string line;
-
-  // prep the measurement packages (each line represents a measurement at a
-  // timestamp)
-  while (getline(in_file_, line)) {
-    string sensor_type;
-    MeasurementPackage meas_package;
-    GroundTruthPackage gt_package;
-    istringstream iss(line);
-    long long timestamp;
-
-    // reads first element from the current line
-    iss >> sensor_type;
-
-    if (sensor_type.compare("L") == 0) {
-      // laser measurement
-
-      // read measurements at this timestamp
-      meas_package.sensor_type_ = MeasurementPackage::LASER;
-      meas_package.raw_measurements_ = VectorXd(2);
-      float px;
-      float py;
-      iss >> px;
-      iss >> py;
-      meas_package.raw_measurements_ << px, py;
-      iss >> timestamp;
-      meas_package.timestamp_ = timestamp;
-      measurement_pack_list.push_back(meas_package);
-    } else if (sensor_type.compare("R") == 0) {
-      // radar measurement
-
-      // read measurements at this timestamp
-      meas_package.sensor_type_ = MeasurementPackage::RADAR;
-      meas_package.raw_measurements_ = VectorXd(3);
-      float ro;
-      float phi;
-      float ro_dot;
-      iss >> ro;
-      iss >> phi;
-      iss >> ro_dot;
-      meas_package.raw_measurements_ << ro, phi, ro_dot;
-      iss >> timestamp;
-      meas_package.timestamp_ = timestamp;
-      measurement_pack_list.push_back(meas_package);
-    }
+  // text or binary log, optionally with an object ID per measurement
+  vector<LogRecord> records;
+  if (!ObjectLog::Read(args.in_name, &records)) {
+    cerr << "Cannot read input file: " << args.in_name << endl;
+    exit(EXIT_FAILURE);
+  }
 
-      // read ground truth data to compare later
-      float x_gt;
-      float y_gt;
-      float vx_gt;
-      float vy_gt;
-      iss >> x_gt;
-      iss >> y_gt;
-      iss >> vx_gt;
-      iss >> vy_gt;
-      gt_package.gt_values_ = VectorXd(4);
-      gt_package.gt_values_ << x_gt, y_gt, vx_gt, vy_gt;
-      gt_pack_list.push_back(gt_package);
-  }
-
-  // Create a UKF instance
-  UKF ukf;
-
-  // used to compute the RMSE later
-  vector<VectorXd> estimations;
-  vector<VectorXd> ground_truth;
-
-  // start filtering from the second frame (the speed is unknown in the first
-  // frame)
-
-  size_t number_of_measurements = measurement_pack_list.size();
-
-  // column names for output file
-  out_file_ << "time_stamp" << "\t";  
-  out_file_ << "px_state" << "\t";
-  out_file_ << "py_state" << "\t";
-  out_file_ << "v_state" << "\t";
-  out_file_ << "yaw_angle_state" << "\t";
-  out_file_ << "yaw_rate_state" << "\t";
-  out_file_ << "sensor_type" << "\t";
-  out_file_ << "NIS" << "\t";  
-  out_file_ << "px_measured" << "\t";
-  out_file_ << "py_measured" << "\t";
-  out_file_ << "px_ground_truth" << "\t";
-  out_file_ << "py_ground_truth" << "\t";
-  out_file_ << "vx_ground_truth" << "\t";
-  out_file_ << "vy_ground_truth" << "\n";
-
-
-  for (size_t k = 0; k < number_of_measurements; ++k) {
-    // Call the UKF-based fusion
-    ukf.ProcessMeasurement(measurement_pack_list[k]);
-
-    // timestamp
-    out_file_ << measurement_pack_list[k].timestamp_ << "\t"; // pos1 - est
-
-    // output the state vector
-    out_file_ << ukf.x_(0) << "\t"; // pos1 - est
-    out_file_ << ukf.x_(1) << "\t"; // pos2 - est
-    out_file_ << ukf.x_(2) << "\t"; // vel_abs -est
-    out_file_ << ukf.x_(3) << "\t"; // yaw_angle -est
-    out_file_ << ukf.x_(4) << "\t"; // yaw_rate -est
-
-    // output lidar and radar specific data
-    if (measurement_pack_list[k].sensor_type_ == MeasurementPackage::LASER) {
-      // sensor type
-      out_file_ << "lidar" << "\t";
-
-      // NIS value
-      out_file_ << ukf.NIS_laser_ << "\t";
-
-      // output the lidar sensor measurement px and py
-      out_file_ << measurement_pack_list[k].raw_measurements_(0) << "\t";
-      out_file_ << measurement_pack_list[k].raw_measurements_(1) << "\t";
-
-    } else if (measurement_pack_list[k].sensor_type_ == MeasurementPackage::RADAR) {
-      // sensor type
-      out_file_ << "radar" << "\t";
-
-      // NIS value
-      out_file_ << ukf.NIS_radar_ << "\t";
-
-      // output radar measurement in cartesian coordinates
-      float ro = measurement_pack_list[k].raw_measurements_(0);
-      float phi = measurement_pack_list[k].raw_measurements_(1);
-      out_file_ << ro * cos(phi) << "\t"; // px measurement
-      out_file_ << ro * sin(phi) << "\t"; // py measurement
-    }
+  if (!args.binary_out_name.empty()) {
+    ofstream binary_file(args.binary_out_name.c_str(), ofstream::binary);
+    check_file(binary_file, args.binary_out_name);
+    ObjectLog::WriteBinary(records, binary_file);
+  }
 
-    // output the ground truth
-    out_file_ << gt_pack_list[k].gt_values_(0) << "\t";
-    out_file_ << gt_pack_list[k].gt_values_(1) << "\t";
-    out_file_ << gt_pack_list[k].gt_values_(2) << "\t";
-    out_file_ << gt_pack_list[k].gt_values_(3) << "\n";
+  // sensors on a moving vehicle measure in their own frames, move the
+  // measurements into the world frame of the filter
+  if (!args.ego_poses_name.empty()) {
+    ifstream ego_file(args.ego_poses_name.c_str());
+    check_file(ego_file, args.ego_poses_name);
+    EgoMotion ego_motion;
+    ego_motion.num_threads_ = args.num_threads;
+    ego_motion.ReadPoses(ego_file);
+    const size_t n_dropped = ego_motion.Compensate(&records);
+    cout << "Ego poses " << ego_motion.size() << ", " << n_dropped
+         << " measurements without a pose dropped, "
+         << ego_motion.skipped_lines_ << " log lines skipped" << endl;
+  }
 
-    // convert ukf x vector to cartesian to compare to ground truth
-    VectorXd ukf_x_cartesian_ = VectorXd(4);
+  // tracks of unlabeled measurements, the output is not comparable with the
+  // ground truth per row
+  if (args.mht) {
+    ofstream out_file_(args.out_name.c_str(), ofstream::out);
+    check_file(out_file_, args.out_name);
+    MHTTracker tracker;
+    const size_t n_tracks = Replay::ReplayMHT(records, &tracker, out_file_);
+    cout << "MHT confirmed tracks " << n_tracks << ", branches "
+         << tracker.branch_count() << ", hypotheses " << tracker.hypothesis_count() << endl;
+    return 0;
+  }
+
+  // streaming through the real-time pipeline, reports the latencies and
+  // whether anything allocated or faulted after the warm-up
+  if (args.realtime) {
+    ofstream out_file_(args.out_name.c_str(), ofstream::out);
+    check_file(out_file_, args.out_name);
+    RealTimeReport report;
+    Replay::ReplayRealTime(records, args.realtime_config, out_file_, &report);
+    for (size_t i = 0; i < report.warnings.size(); ++i) {
+      cerr << "Real-time setup: " << report.warnings[i] << endl;
+    }
+    cout << "Real-time updates " << report.updates << endl;
+    cout << "Latency p50 " << report.latency_p50 / 1000.0 << " us, p99 "
+         << report.latency_p99 / 1000.0 << " us, p99.9 " << report.latency_p999 / 1000.0
+         << " us, max " << report.latency_max / 1000.0 << " us" << endl;
+    cout << "Filter time p50 " << report.service_p50 / 1000.0 << " us, p99 "
+         << report.service_p99 / 1000.0 << " us, max " << report.service_max / 1000.0
+         << " us" << endl;
+    cout << "Ingest queue dropped " << report.ingest_drops << ", high water "
+         << report.ingest_high_water << " of " << args.realtime_config.queue_capacity
+         << ", late " << report.late_drops << endl;
+    const RealTimeThreadStats* threads[] = {&report.ingest, &report.filter, &report.output};
+    const char* names[] = {"ingest", "filter", "output"};
+    for (int i = 0; i < 3; ++i) {
+      cout << "After warm-up " << names[i] << ": allocations ";
+      if (threads[i]->allocations < 0) {
+        cout << "not counted";
+      } else {
+        cout << threads[i]->allocations;
+      }
+      cout << ", page faults " << threads[i]->minor_faults << " minor "
+           << threads[i]->major_faults << " major" << endl;
+    }
+    cout << "Self-check " << (report.Clean() ? "clean" : "FAILED") << endl;
+    return 0;
+  }
 
-    float x_estimate_ = ukf.x_(0);
-    float y_estimate_ = ukf.x_(1);
-    float vx_estimate_ = ukf.x_(2) * cos(ukf.x_(3));
-    float vy_estimate_ = ukf.x_(2) * sin(ukf.x_(3));
-    
-    ukf_x_cartesian_ << x_estimate_, y_estimate_, vx_estimate_, vy_estimate_;
-    
-    estimations.push_back(ukf_x_cartesian_);
-    ground_truth.push_back(gt_pack_list[k].gt_values_);
+  vector<long long> object_ids;
+  vector<vector<size_t> > object_rows;
+  ObjectLog::Partition(records, &object_ids, &object_rows);
+  const bool with_object_id = object_ids.size() > 1;
 
+  /**********************************************
+   *  Filter                                    *
+   **********************************************/
+
+  vector<ObjectReplay> results;
+  if (!args.gt_name.empty()) {
+    // optional separate ground truth log, one "timestamp px py vx vy" line per
+    // sample at its own rate, interpolated to the measurement times
+    if (object_ids.size() > 1) {
+      cerr << "A separate ground truth log needs a single object input." << endl;
+      exit(EXIT_FAILURE);
+    }
+    ifstream gt_file_(args.gt_name.c_str());
+    check_file(gt_file_, args.gt_name);
+
+    // no ground truth across gaps of more than 0.5 s in the log
+    GroundTruthJoin gt_join(&gt_file_, 4, GroundTruthJoin::HERMITE, 500000);
+    results.resize(object_rows.size());
+    if (!object_rows.empty()) {
+      Replay::ReplayObject(records, object_rows[0], false, &gt_join, &results[0]);
+    }
+    const size_t n_matched = results.empty() ? 0 : results[0].estimations.size() / 4;
+    cout << "Ground truth for " << n_matched << " of "
+         << records.size() << " measurements, "
+         << gt_join.skipped_lines_ << " log lines skipped" << endl;
+  } else if (args.frames) {
+    // all tracks of a frame are predicted together, then updated; with a
+    // frame budget the least urgent updates are shed under overload
+    OverloadPolicy overload;
+    overload.frame_budget_us_ = args.frame_budget_us;
+    overload.priority_ = args.priority;
+    Replay::ReplayFrames(records, object_rows, with_object_id && !args.per_object,
+                         args.num_threads, args.frame_budget_us > 0 ? &overload : nullptr,
+                         nullptr, &results);
+    if (args.frame_budget_us > 0) {
+      const OverloadStats& stats = overload.stats_;
+      cout << "Frames " << stats.frames << ", over budget " << stats.overloaded_frames
+           << ", frame time p50 " << overload.FrameTime(0.5) / 1000.0
+           << " us, p99 " << overload.FrameTime(0.99) / 1000.0
+           << " us, max " << overload.FrameTime(1.0) / 1000.0 << " us" << endl;
+      cout << "Measurements updated " << stats.updated_measurements
+           << ", shed " << stats.shed_measurements
+           << ", forced updates " << stats.forced_updates
+           << ", longest shed streak " << stats.longest_shed_streak << endl;
+    }
+  } else {
+    // one independent filter per object, spread over a thread pool
+    // per-object files need no ID column
+    Replay::ReplayObjects(records, object_rows, with_object_id && !args.per_object,
+                          args.num_threads, &results);
   }
 
-  // compute the accuracy (RMSE)
-  cout << "RMSE" << endl << Tools::CalculateRMSE(estimations, ground_truth) << endl;
+  /**********************************************
+   *  Output                                    *
+   **********************************************/
+
+  // objects in ascending ID order, independent of the scheduling
+  if (args.per_object) {
+    for (size_t i = 0; i < results.size(); ++i) {
+      const string name = object_file_name(args.out_name, object_ids[i]);
+      ofstream out_file_(name.c_str(), ofstream::out);
+      check_file(out_file_, name);
+      Replay::WriteHeader(out_file_, false);
+      out_file_ << results[i].output;
+    }
+  } else {
+    ofstream out_file_(args.out_name.c_str(), ofstream::out);
+    check_file(out_file_, args.out_name);
+    Replay::WriteHeader(out_file_, with_object_id);
+    for (size_t i = 0; i < results.size(); ++i) {
+      out_file_ << results[i].output;
+    }
+  }
 
-  // close files
-  if (out_file_.is_open()) {
-    out_file_.close();
+  // used to compute the RMSE and NEES, [px py vx vy] per row
+  vector<double> estimations;
+  vector<double> estimation_covariances;
+  vector<double> ground_truth;
+
+  // used to summarize the NIS
+  vector<double> nis_laser;
+  vector<double> nis_radar;
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    const ObjectReplay& result = results[i];
+    estimations.insert(estimations.end(), result.estimations.begin(), result.estimations.end());
+    estimation_covariances.insert(estimation_covariances.end(),
+                                  result.estimation_covariances.begin(),
+                                  result.estimation_covariances.end());
+    ground_truth.insert(ground_truth.end(), result.ground_truth.begin(), result.ground_truth.end());
+    nis_laser.insert(nis_laser.end(), result.nis_laser.begin(), result.nis_laser.end());
+    nis_radar.insert(nis_radar.end(), result.nis_radar.begin(), result.nis_radar.end());
   }
 
-  if (in_file_.is_open()) {
-    in_file_.close();
+  if (with_object_id) {
+    cout << "Objects " << object_ids.size() << endl;
   }
 
+  // compute the accuracy (RMSE) and the consistency (NEES, NIS)
+  const long long n_estimations = estimations.size() / 4;
+  const ErrorSummary summary = Evaluation::Evaluate(estimations.data(),
+                                                    estimation_covariances.data(),
+                                                    ground_truth.data(), 4, n_estimations,
+                                                    args.num_threads);
+  cout << "RMSE" << endl << summary.rmse << endl;
+  cout << "NEES mean " << summary.nees_mean
+       << ", above 95% bound " << summary.nees_above_95 << endl;
+
+  const ConsistencySummary nis_laser_summary =
+      Evaluation::SummarizeNIS(nis_laser.data(), nis_laser.size(), MeasurementModel::kLidarDim,
+                               args.num_threads);
+  const ConsistencySummary nis_radar_summary =
+      Evaluation::SummarizeNIS(nis_radar.data(), nis_radar.size(), MeasurementModel::kRadarDim,
+                               args.num_threads);
+  cout << "NIS lidar mean " << nis_laser_summary.mean
+       << ", above 95% bound " << nis_laser_summary.above_95 << endl;
+  cout << "NIS radar mean " << nis_radar_summary.mean
+       << ", above 95% bound " << nis_radar_summary.above_95 << endl;
+
 //  cout << "Done!" << endl;
   return 0;
 }
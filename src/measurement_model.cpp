@@ -0,0 +1,35 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "measurement_model.h"
+
+void MeasurementModel::RadarJacobian(const Eigen::Vector4d& k, RadarJacobianMatrix* H_out) {
+
+  const double p_x = k(0);
+  const double p_y = k(1);
+  const double v_x = k(2);
+  const double v_y = k(3);
+
+  // same near-origin guard as the projection
+  const double rho2 = std::max(p_x*p_x + p_y*p_y,
+                               std::numeric_limits<double>::epsilon());
+  const double rho = std::sqrt(rho2);
+  const double rho_dot = (p_x*v_x + p_y*v_y) / rho;
+
+  RadarJacobianMatrix& H = *H_out;
+  H.setZero();
+
+  // d rho
+  H(0,0) = p_x / rho;
+  H(0,1) = p_y / rho;
+
+  // d phi
+  H(1,0) = -p_y / rho2;
+  H(1,1) = p_x / rho2;
+
+  // d rho_dot
+  H(2,0) = v_x / rho - rho_dot*p_x / rho2;
+  H(2,1) = v_y / rho - rho_dot*p_y / rho2;
+  H(2,2) = p_x / rho;
+  H(2,3) = p_y / rho;
+}
@@ -0,0 +1,89 @@
+#ifndef MEASUREMENT_MODEL_H_
+#define MEASUREMENT_MODEL_H_
+
+#include <limits>
+#include "Eigen/Dense"
+#include "fast_math.h"
+
+class MeasurementModel {
+public:
+  /**
+  * Radar measurement dimension [rho phi rho_dot].
+  */
+  static const int kRadarDim = 3;
+
+  /**
+  * Lidar measurement dimension [px py].
+  */
+  static const int kLidarDim = 2;
+
+  /**
+  * Jacobian of the radar model with respect to [px py vx vy].
+  */
+  typedef Eigen::Matrix<double, kRadarDim, 4, Eigen::DontAlign> RadarJacobianMatrix;
+
+  /**
+  * Projects kinematic sigma points [px py vx vy] into radar measurement space
+  * (see the motion models' Kinematics). Works on any number of columns, so the
+  * sigma points of many tracks can be projected in one call. Fixed-size
+  * points are projected without heap allocations.
+  * @param Ksig Kinematic sigma points as columns
+  * @param Zsig_out Radar sigma points [rho phi rho_dot] as columns
+  */
+  template <typename KinematicsType, typename MeasurementType>
+  static void Radar(const Eigen::MatrixBase<KinematicsType>& Ksig,
+                    MeasurementType* Zsig_out);
+
+  /**
+  * Jacobian of the radar model with respect to [px py vx vy], used by the
+  * linearized (EKF) radar update.
+  * @param k Kinematic state [px py vx vy]
+  * @param H_out 3 x 4 Jacobian
+  */
+  static void RadarJacobian(const Eigen::Vector4d& k, RadarJacobianMatrix* H_out);
+
+  /**
+  * Projects sigma points [px py ...] into lidar measurement space.
+  * @param Xsig State sigma points as columns
+  * @param Zsig_out Lidar sigma points [px py] as columns
+  */
+  template <typename StateSigmaType, typename MeasurementType>
+  static void Lidar(const Eigen::MatrixBase<StateSigmaType>& Xsig,
+                    MeasurementType* Zsig_out);
+};
+
+template <typename KinematicsType, typename MeasurementType>
+void MeasurementModel::Radar(const Eigen::MatrixBase<KinematicsType>& Ksig,
+                             MeasurementType* Zsig_out) {
+
+  // one entry per column, sized like the columns of Ksig
+  typedef Eigen::Array<double, KinematicsType::ColsAtCompileTime, 1, Eigen::DontAlign,
+                       KinematicsType::MaxColsAtCompileTime, 1> RowArray;
+
+  // extract rows for better readability
+  const RowArray p_x = Ksig.row(0).transpose();
+  const RowArray p_y = Ksig.row(1).transpose();
+  const RowArray v_x = Ksig.row(2).transpose();
+  const RowArray v_y = Ksig.row(3).transpose();
+
+  // range is computed once and reused for r_dot
+  const RowArray rho = (p_x.square() + p_y.square()).sqrt();
+
+  // Avoid division by zero for r_dot without branching: near the origin the
+  // projected velocity is ~0 anyway, and atan2(0, 0) is defined as 0
+  const RowArray rho_safe = rho.max(std::numeric_limits<double>::epsilon());
+
+  MeasurementType& Zsig = *Zsig_out;
+  Zsig.resize(kRadarDim, Ksig.cols());
+  Zsig.row(0) = rho.transpose();                                          //r
+  Zsig.row(1) = p_y.binaryExpr(p_x, Atan2Op()).transpose();               //phi
+  Zsig.row(2) = ((p_x*v_x + p_y*v_y) / rho_safe).transpose();             //r_dot
+}
+
+template <typename StateSigmaType, typename MeasurementType>
+void MeasurementModel::Lidar(const Eigen::MatrixBase<StateSigmaType>& Xsig,
+                             MeasurementType* Zsig_out) {
+  *Zsig_out = Xsig.template topRows<kLidarDim>();
+}
+
+#endif /* MEASUREMENT_MODEL_H_ */
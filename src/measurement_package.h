@@ -5,6 +5,11 @@
 
 class MeasurementPackage {
 public:
+  MeasurementPackage() : object_id_(0) {}
+
+  ///* object (track) the measurement belongs to, 0 in single object logs
+  long long object_id_;
+
   long long timestamp_;
 
   enum SensorType{
@@ -14,6 +19,14 @@ public:
 
   Eigen::VectorXd raw_measurements_;
 
+  ///* measurement noise covariance of this measurement, e.g. estimated by a
+  ///* detection front end; empty to use the filter's sensor noise
+  Eigen::MatrixXd noise_covariance_;
+
+  ///* world position [x y] of a radar on a moving platform, the radar
+  ///* measures from there; empty for a radar at the origin
+  Eigen::VectorXd sensor_origin_;
+
 };
 
 #endif /* MEASUREMENT_PACKAGE_H_ */
@@ -0,0 +1,434 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "mht_tracker.h"
+
+using namespace std;
+using Eigen::MatrixXd;
+
+static const double kInfinity = numeric_limits<double>::infinity();
+
+MHTTracker::MHTTracker(const UKF& prototype)
+    : prototype_(prototype), filter_(prototype), filter_batch_(1, &filter_),
+      scan_(0), next_track_id_(0) {
+
+  // detections are missed in one of ten scans
+  p_detection_ = 0.9;
+
+  // about one false alarm per 100 m^2, and per 100 m x 1 rad x 10 m/s
+  clutter_density_laser_ = 0.01;
+  clutter_density_radar_ = 0.001;
+
+  // a lone measurement is slightly more likely a new object than clutter
+  new_track_log_ratio_ = 1.0;
+
+  // 99.9% of the correct associations fall inside the gates
+  gate_laser_ = 13.82;
+  gate_radar_ = 16.27;
+
+  max_hypotheses_ = 16;
+  max_log_ratio_ = 20.0;
+  n_scan_ = 3;
+  max_misses_ = 3;
+  confirm_score_ = 10.0;
+
+  // before the first scan: no tracks
+  Hypothesis empty;
+  empty.score = 0.0;
+  empty.begin = 0;
+  empty.count = 0;
+  hypotheses_.push_back(empty);
+}
+
+void MHTTracker::ProcessScan(const vector<MeasurementPackage>& scan) {
+
+  // an empty sweep carries no time to predict to
+  if (scan.empty()) {
+    return;
+  }
+  ++scan_;
+
+  const int n_meas = scan.size();
+  GateLeaves(scan);
+  ExpandHypotheses(n_meas);
+  BuildHypotheses(n_meas);
+  PruneNScan();
+
+  // new tracks of measurement m were numbered next_track_id_ + m
+  next_track_id_ += n_meas;
+}
+
+void MHTTracker::BestTracks(vector<MHTTrack>* tracks_out, bool confirmed_only) const {
+
+  tracks_out->clear();
+  const Hypothesis& best = hypotheses_[0];
+  for (size_t t = 0; t < best.count; ++t) {
+    const Branch& branch = *branches_.Get(hypothesis_tracks_[best.begin + t]);
+    if (confirmed_only && branch.score < confirm_score_) {
+      continue;
+    }
+    MHTTrack track;
+    track.track_id = branch.track_id;
+    track.state = branch.state;
+    track.score = branch.score;
+    track.hits = branch.hits;
+    track.misses = branch.misses;
+    tracks_out->push_back(track);
+  }
+}
+
+/**
+ * Predicts every distinct leaf branch to the scan time once, then updates
+ * the prediction with every measurement and keeps the updates inside the
+ * gate with their score gain over a missed detection. Also initializes the
+ * new track that every measurement may start.
+ */
+void MHTTracker::GateLeaves(const vector<MeasurementPackage>& scan) {
+
+  const int n_meas = scan.size();
+  const long long timestamp = scan[0].timestamp_;
+
+  // hypotheses share most of their leaves, number each leaf once
+  leaves_.clear();
+  for (size_t i = 0; i < hypothesis_tracks_.size(); ++i) {
+    Branch* branch = branches_.Get(hypothesis_tracks_[i]);
+    if (branch != nullptr && branch->gate_scan != scan_) {
+      branch->gate_scan = scan_;
+      branch->gate_index = leaves_.size();
+      leaves_.push_back(hypothesis_tracks_[i]);
+    }
+  }
+
+  const int n_leaves = leaves_.size();
+  predicted_.resize(n_leaves);
+  missed_.assign(n_leaves, SlotHandle());
+  gates_.resize(n_leaves * n_meas);
+  updated_.resize(n_leaves * n_meas);
+
+  clutter_log_density_.resize(n_meas);
+  for (int m = 0; m < n_meas; ++m) {
+    clutter_log_density_[m] = log(scan[m].sensor_type_ == MeasurementPackage::LASER ?
+                                  clutter_density_laser_ : clutter_density_radar_);
+  }
+
+  const double log_detection = log(p_detection_);
+  const double log_miss = log(1.0 - p_detection_);
+
+  for (int u = 0; u < n_leaves; ++u) {
+    filter_.LoadState(branches_.Get(leaves_[u])->state);
+    UKF::PredictFrame(filter_batch_, timestamp, &workspace_);
+    filter_.SaveState(&predicted_[u]);
+
+    for (int m = 0; m < n_meas; ++m) {
+      Gate& gate = gates_[u * n_meas + m];
+      gate.gain = -kInfinity;
+      gate.child = SlotHandle();
+
+      // every update starts from the same prediction
+      filter_.LoadState(predicted_[u]);
+      filter_.ProcessMeasurement(scan[m]);
+
+      const bool is_laser = scan[m].sensor_type_ == MeasurementPackage::LASER;
+      const double nis = is_laser ? filter_.NIS_laser_ : filter_.NIS_radar_;
+      const double gate_nis = is_laser ? gate_laser_ : gate_radar_;
+      if (nis > gate_nis || !std::isfinite(filter_.log_likelihood_)) {
+        continue;
+      }
+      gate.gain = log_detection + filter_.log_likelihood_ - clutter_log_density_[m] - log_miss;
+      filter_.SaveState(&updated_[u * n_meas + m]);
+    }
+  }
+
+  // the track every measurement would start, without touching the
+  // prototype's buffers
+  born_.resize(n_meas);
+  born_branch_.assign(n_meas, SlotHandle());
+  for (int m = 0; m < n_meas; ++m) {
+    filter_.is_initialized_ = false;
+    filter_.x_ = prototype_.x_;
+    filter_.P_ = prototype_.P_;
+    filter_.ProcessMeasurement(scan[m]);
+    filter_.SaveState(&born_[m]);
+  }
+}
+
+/**
+ * Scores the k best successors of every hypothesis. Measurements are rows,
+ * the columns are the hypothesis' tracks followed by one new track and one
+ * clutter column per measurement; costs are negated score gains relative to
+ * all tracks missing the scan.
+ */
+void MHTTracker::ExpandHypotheses(int n_meas) {
+
+  candidate_parent_.clear();
+  candidate_score_.clear();
+  candidate_assignment_.clear();
+
+  const double log_miss = log(1.0 - p_detection_);
+
+  for (size_t h = 0; h < hypotheses_.size(); ++h) {
+    const Hypothesis& hypothesis = hypotheses_[h];
+    const int n_tracks = hypothesis.count;
+    const int n_cols = n_tracks + 2 * n_meas;
+    const double all_missed = hypothesis.score + n_tracks * log_miss;
+
+    cost_.resize(n_meas * n_cols);
+    Eigen::Map<MatrixXd> cost(cost_.data(), n_meas, n_cols);
+    cost.setConstant(kInfinity);
+    for (int t = 0; t < n_tracks; ++t) {
+      const int u = branches_.Get(hypothesis_tracks_[hypothesis.begin + t])->gate_index;
+      for (int m = 0; m < n_meas; ++m) {
+        const double gain = gates_[u * n_meas + m].gain;
+        if (gain > -kInfinity) {
+          cost(m, t) = -gain;
+        }
+      }
+    }
+    for (int m = 0; m < n_meas; ++m) {
+      cost(m, n_tracks + m) = -new_track_log_ratio_;
+      cost(m, n_tracks + n_meas + m) = 0.0;
+    }
+
+    const int n_found = k_best_.Solve(cost, max_hypotheses_, &assignments_, &costs_);
+    for (int a = 0; a < n_found; ++a) {
+      candidate_parent_.push_back(h);
+      candidate_score_.push_back(all_missed - costs_[a]);
+      candidate_assignment_.insert(candidate_assignment_.end(),
+                                   assignments_.begin() + a * n_meas,
+                                   assignments_.begin() + (a + 1) * n_meas);
+    }
+  }
+}
+
+/**
+ * Keeps the best successors and creates the branches they use. Branches are
+ * shared: a leaf gets at most one child per measurement and one missed
+ * detection child, whichever hypotheses select it.
+ */
+void MHTTracker::BuildHypotheses(int n_meas) {
+
+  const int n_candidates = candidate_score_.size();
+  candidate_order_.resize(n_candidates);
+  for (int c = 0; c < n_candidates; ++c) {
+    candidate_order_[c] = c;
+  }
+  const int n_keep = min(n_candidates, max_hypotheses_);
+  partial_sort(candidate_order_.begin(), candidate_order_.begin() + n_keep,
+               candidate_order_.end(), [this](int a, int b) {
+    return candidate_score_[a] > candidate_score_[b];
+  });
+
+  const double log_miss = log(1.0 - p_detection_);
+
+  next_hypotheses_.clear();
+  next_hypothesis_tracks_.clear();
+  for (int k = 0; k < n_keep; ++k) {
+    const int c = candidate_order_[k];
+    if (candidate_score_[c] < candidate_score_[candidate_order_[0]] - max_log_ratio_) {
+      break;
+    }
+
+    const Hypothesis& parent = hypotheses_[candidate_parent_[c]];
+    const int* columns = &candidate_assignment_[c * n_meas];
+    const int n_tracks = parent.count;
+
+    Hypothesis child;
+    child.score = candidate_score_[c];
+    child.begin = next_hypothesis_tracks_.size();
+
+    track_measurement_.assign(n_tracks, -1);
+    for (int m = 0; m < n_meas; ++m) {
+      if (columns[m] < n_tracks) {
+        track_measurement_[columns[m]] = m;
+      }
+    }
+
+    // existing tracks, detected or missed, keep their order
+    for (int t = 0; t < n_tracks; ++t) {
+      const SlotHandle leaf_handle = hypothesis_tracks_[parent.begin + t];
+      const Branch& leaf = *branches_.Get(leaf_handle);
+      const int u = leaf.gate_index;
+      const int m = track_measurement_[t];
+
+      SlotHandle branch;
+      if (m >= 0) {
+        Gate& gate = gates_[u * n_meas + m];
+        if (!branches_.Contains(gate.child)) {
+          gate.child = NewBranch(updated_[u * n_meas + m], leaf_handle, leaf.track_id,
+                                 leaf.score + gate.gain + log_miss, leaf.hits + 1, 0);
+        }
+        branch = gate.child;
+      } else {
+        // terminated tracks leave the hypothesis
+        if (leaf.misses + 1 > max_misses_) {
+          continue;
+        }
+        if (!branches_.Contains(missed_[u])) {
+          missed_[u] = NewBranch(predicted_[u], leaf_handle, leaf.track_id,
+                                 leaf.score + log_miss, leaf.hits, leaf.misses + 1);
+        }
+        branch = missed_[u];
+      }
+      ++branches_.Get(branch)->references;
+      next_hypothesis_tracks_.push_back(branch);
+    }
+
+    // new tracks have higher IDs, so the order by ID is kept
+    for (int m = 0; m < n_meas; ++m) {
+      if (columns[m] != n_tracks + m) {
+        continue;
+      }
+      if (!branches_.Contains(born_branch_[m])) {
+        born_branch_[m] = NewBranch(born_[m], SlotHandle(), next_track_id_ + m,
+                                    new_track_log_ratio_, 1, 0);
+      }
+      ++branches_.Get(born_branch_[m])->references;
+      next_hypothesis_tracks_.push_back(born_branch_[m]);
+    }
+
+    child.count = next_hypothesis_tracks_.size() - child.begin;
+    next_hypotheses_.push_back(child);
+  }
+
+  // the previous leaves are only referenced by their children now
+  for (size_t i = 0; i < hypothesis_tracks_.size(); ++i) {
+    Release(hypothesis_tracks_[i]);
+  }
+  hypotheses_.swap(next_hypotheses_);
+  hypothesis_tracks_.swap(next_hypothesis_tracks_);
+}
+
+/**
+ * N-scan pruning: the associations up to n_scan_ scans ago are fixed to
+ * those of the best hypothesis. Disagreeing hypotheses are dropped and the
+ * trees of the others are cut above the horizon, which bounds their depth.
+ */
+void MHTTracker::PruneNScan() {
+
+  if (n_scan_ <= 0 || hypotheses_.empty()) {
+    return;
+  }
+  const long long horizon = scan_ - n_scan_;
+
+  Ancestors(hypotheses_[0], horizon, &best_ancestors_);
+
+  next_hypotheses_.clear();
+  next_hypothesis_tracks_.clear();
+  for (size_t h = 0; h < hypotheses_.size(); ++h) {
+    const Hypothesis& hypothesis = hypotheses_[h];
+    if (h > 0) {
+      Ancestors(hypothesis, horizon, &ancestors_);
+      if (!Consistent(hypothesis, ancestors_, hypotheses_[0], best_ancestors_)) {
+        for (size_t t = 0; t < hypothesis.count; ++t) {
+          Release(hypothesis_tracks_[hypothesis.begin + t]);
+        }
+        continue;
+      }
+    }
+
+    // nothing above the branches at the horizon is needed anymore
+    const vector<SlotHandle>& ancestors = h == 0 ? best_ancestors_ : ancestors_;
+    for (size_t t = 0; t < ancestors.size(); ++t) {
+      Branch* decided = branches_.Get(ancestors[t]);
+      if (decided != nullptr && branches_.Contains(decided->parent)) {
+        const SlotHandle parent = decided->parent;
+        decided->parent = SlotHandle();
+        Release(parent);
+      }
+    }
+
+    Hypothesis kept = hypothesis;
+    kept.begin = next_hypothesis_tracks_.size();
+    next_hypothesis_tracks_.insert(next_hypothesis_tracks_.end(),
+                                   hypothesis_tracks_.begin() + hypothesis.begin,
+                                   hypothesis_tracks_.begin() + hypothesis.begin + hypothesis.count);
+    next_hypotheses_.push_back(kept);
+  }
+  hypotheses_.swap(next_hypotheses_);
+  hypothesis_tracks_.swap(next_hypothesis_tracks_);
+}
+
+/**
+ * The branch of every track at the horizon scan, or an invalid handle for
+ * tracks started after it.
+ */
+void MHTTracker::Ancestors(const Hypothesis& hypothesis, long long horizon,
+                           vector<SlotHandle>* ancestors_out) {
+
+  ancestors_out->clear();
+  for (size_t t = 0; t < hypothesis.count; ++t) {
+    SlotHandle handle = hypothesis_tracks_[hypothesis.begin + t];
+    const Branch* branch = branches_.Get(handle);
+    while (branch->scan > horizon && branches_.Contains(branch->parent)) {
+      handle = branch->parent;
+      branch = branches_.Get(handle);
+    }
+    ancestors_out->push_back(branch->scan <= horizon ? handle : SlotHandle());
+  }
+}
+
+/**
+ * True if the tracks that both hypotheses contain went through the same
+ * branches up to the horizon.
+ */
+bool MHTTracker::Consistent(const Hypothesis& a, const vector<SlotHandle>& a_ancestors,
+                            const Hypothesis& b, const vector<SlotHandle>& b_ancestors) {
+
+  // both track lists are sorted by ID
+  size_t i = 0;
+  size_t j = 0;
+  while (i < a.count && j < b.count) {
+    const long long id_a = branches_.Get(hypothesis_tracks_[a.begin + i])->track_id;
+    const long long id_b = branches_.Get(hypothesis_tracks_[b.begin + j])->track_id;
+    if (id_a < id_b) {
+      ++i;
+    } else if (id_b < id_a) {
+      ++j;
+    } else {
+      if (a_ancestors[i] != b_ancestors[j]) {
+        return false;
+      }
+      ++i;
+      ++j;
+    }
+  }
+  return true;
+}
+
+SlotHandle MHTTracker::NewBranch(const TrackState<CTRVModel::kStateDim>& state,
+                                 SlotHandle parent, long long track_id, double score,
+                                 int hits, int misses) {
+  Branch branch;
+  branch.state = state;
+  branch.parent = parent;
+  branch.track_id = track_id;
+  branch.scan = scan_;
+  branch.score = score;
+  branch.hits = hits;
+  branch.misses = misses;
+  branch.references = 0;
+  branch.gate_scan = -1;
+  branch.gate_index = -1;
+
+  Branch* parent_branch = branches_.Get(parent);
+  if (parent_branch != nullptr) {
+    ++parent_branch->references;
+  }
+  return branches_.Insert(branch);
+}
+
+/**
+ * Drops one reference; branches without references are erased, which in
+ * turn releases their parent.
+ */
+void MHTTracker::Release(SlotHandle handle) {
+  for (;;) {
+    Branch* branch = branches_.Get(handle);
+    if (branch == nullptr || --branch->references > 0) {
+      return;
+    }
+    const SlotHandle parent = branch->parent;
+    branches_.Erase(handle);
+    handle = parent;
+  }
+}
@@ -0,0 +1,222 @@
+#ifndef MHT_TRACKER_H_
+#define MHT_TRACKER_H_
+
+#include <vector>
+#include "Eigen/Dense"
+#include "measurement_package.h"
+#include "k_best_assignment.h"
+#include "slot_map.h"
+#include "track_state.h"
+#include "ukf.h"
+
+/**
+* One track of the best global hypothesis.
+*/
+struct MHTTrack {
+  ///* track identity, stable across scans
+  long long track_id;
+
+  ///* time, state and packed covariance of the track's filter
+  TrackState<CTRVModel::kStateDim> state;
+
+  ///* log-likelihood ratio of the track against clutter
+  double score;
+
+  ///* number of detections
+  int hits;
+
+  ///* consecutive missed detections
+  int misses;
+};
+
+/**
+* Multi-hypothesis tracker for measurements without object IDs.
+*
+* Every track is a tree of branches, one per association history. Each branch
+* holds the compact state of the track's UKF after its history (a TrackState,
+* no Eigen heap blocks) in a pooled SlotMap, and the trees are shared by the
+* global hypotheses: consistent sets of branches, at most one per track, that
+* explain every measurement as a track detection, a new track or clutter.
+* Scores are log-likelihood ratios against clutter.
+*
+* Each scan gates every measurement against every branch in use, then
+* expands each global hypothesis into its k best successors with Murty's
+* algorithm over the gated likelihoods and keeps the max_hypotheses_ best.
+* N-scan pruning then drops hypotheses that disagree with the best one on
+* associations n_scan_ or more scans ago, and cuts the trees above that
+* depth. Branches, hypotheses and the assignment search reuse their storage,
+* so a scan allocates nothing once the tracker has warmed up to its working
+* set.
+*/
+class MHTTracker {
+public:
+
+  ///* probability that a track is detected in a scan
+  double p_detection_;
+
+  ///* clutter density per unit of measurement space, for lidar in 1/m^2 and
+  ///* for radar in 1/(m rad m/s)
+  double clutter_density_laser_;
+  double clutter_density_radar_;
+
+  ///* log ratio of the new track and clutter densities, the score of a
+  ///* new track
+  double new_track_log_ratio_;
+
+  ///* NIS gates for lidar and radar (99.9 percentiles of chi-square)
+  double gate_laser_;
+  double gate_radar_;
+
+  ///* global hypotheses kept after each scan
+  int max_hypotheses_;
+
+  ///* hypotheses scoring this much below the best one are dropped
+  double max_log_ratio_;
+
+  ///* associations this many scans ago are decided by the best hypothesis
+  int n_scan_;
+
+  ///* tracks are terminated after this many consecutive missed detections
+  int max_misses_;
+
+  ///* tracks with at least this score are reported as confirmed
+  double confirm_score_;
+
+  /**
+  * @param prototype Filter whose settings every track inherits
+  */
+  explicit MHTTracker(const UKF& prototype = UKF());
+
+  /**
+  * Processes one sensor scan.
+  * @param scan Measurements of one sensor sweep, all with the same timestamp
+  */
+  void ProcessScan(const std::vector<MeasurementPackage>& scan);
+
+  /**
+  * Tracks of the best global hypothesis.
+  * @param tracks_out The tracks, ascending by ID
+  * @param confirmed_only Only tracks with a score of at least confirm_score_
+  */
+  void BestTracks(std::vector<MHTTrack>* tracks_out, bool confirmed_only) const;
+
+  /**
+  * Number of branches held by all track trees.
+  */
+  size_t branch_count() const {
+    return branches_.size();
+  }
+
+  /**
+  * Number of global hypotheses.
+  */
+  size_t hypothesis_count() const {
+    return hypotheses_.size();
+  }
+
+private:
+  MHTTracker(const MHTTracker&);
+  MHTTracker& operator=(const MHTTracker&);
+
+  /**
+  * Node of a track tree.
+  */
+  struct Branch {
+    TrackState<CTRVModel::kStateDim> state;
+    ///* the branch before the last scan, none for a new track or once the
+    ///* tree was cut by N-scan pruning
+    SlotHandle parent;
+    long long track_id;
+    ///* scan that created the branch
+    long long scan;
+    double score;
+    int hits;
+    int misses;
+    ///* children plus hypotheses using the branch as their leaf
+    int references;
+    ///* position in leaves_ during the scan that last gated it
+    long long gate_scan;
+    int gate_index;
+  };
+
+  /**
+  * Global hypothesis: one leaf branch per live track, ascending by track ID,
+  * at tracks[begin .. begin + count - 1] of its hypothesis list.
+  */
+  struct Hypothesis {
+    double score;
+    size_t begin;
+    size_t count;
+  };
+
+  /**
+  * Gated association of a measurement with a leaf branch.
+  */
+  struct Gate {
+    ///* score gain over a missed detection, -infinity outside the gate
+    double gain;
+    ///* the child branch, once a selected hypothesis uses it
+    SlotHandle child;
+  };
+
+  void GateLeaves(const std::vector<MeasurementPackage>& scan);
+  void ExpandHypotheses(int n_meas);
+  void BuildHypotheses(int n_meas);
+  void PruneNScan();
+  void Ancestors(const Hypothesis& hypothesis, long long horizon,
+                 std::vector<SlotHandle>* ancestors_out);
+  bool Consistent(const Hypothesis& a, const std::vector<SlotHandle>& a_ancestors,
+                  const Hypothesis& b, const std::vector<SlotHandle>& b_ancestors);
+  SlotHandle NewBranch(const TrackState<CTRVModel::kStateDim>& state, SlotHandle parent,
+                       long long track_id, double score, int hits, int misses);
+  void Release(SlotHandle handle);
+
+  ///* settings of new tracks, and the filter that computes all branch updates
+  UKF prototype_;
+  UKF filter_;
+  std::vector<UKF*> filter_batch_;
+  UKF::Workspace workspace_;
+
+  ///* all track trees
+  SlotMap<Branch> branches_;
+
+  ///* best first, with the leaves of all hypotheses in one array each
+  std::vector<Hypothesis> hypotheses_;
+  std::vector<SlotHandle> hypothesis_tracks_;
+  std::vector<Hypothesis> next_hypotheses_;
+  std::vector<SlotHandle> next_hypothesis_tracks_;
+
+  long long scan_;
+  long long next_track_id_;
+
+  ///* per scan: the distinct leaves, their predicted states, missed
+  ///* detection children and gated updates (leaf * n_meas + measurement)
+  std::vector<SlotHandle> leaves_;
+  std::vector<TrackState<CTRVModel::kStateDim> > predicted_;
+  std::vector<SlotHandle> missed_;
+  std::vector<Gate> gates_;
+  std::vector<TrackState<CTRVModel::kStateDim> > updated_;
+
+  ///* per scan: new track states and branches of every measurement
+  std::vector<TrackState<CTRVModel::kStateDim> > born_;
+  std::vector<SlotHandle> born_branch_;
+  std::vector<double> clutter_log_density_;
+
+  ///* successor candidates: parent hypothesis, score, and the column of every
+  ///* measurement at candidate * n_meas
+  std::vector<int> candidate_parent_;
+  std::vector<double> candidate_score_;
+  std::vector<int> candidate_assignment_;
+  std::vector<int> candidate_order_;
+
+  ///* k-best search over the cost matrix of one hypothesis
+  KBestAssignment k_best_;
+  std::vector<double> cost_;
+  std::vector<int> assignments_;
+  std::vector<double> costs_;
+  std::vector<int> track_measurement_;
+  std::vector<SlotHandle> ancestors_;
+  std::vector<SlotHandle> best_ancestors_;
+};
+
+#endif /* MHT_TRACKER_H_ */
@@ -0,0 +1,422 @@
+#include <cmath>
+#include "motion_models.h"
+#include "sigma_points.h"
+#include "fast_math.h"
+
+namespace {
+
+/**
+* Transition Jacobians by central differences of the model's Propagate. All
+* perturbed points are propagated in one kernel call.
+*/
+template <class Model>
+void NumericLinearize(const typename Model::StateVector& x, double delta_t,
+                      typename Model::StateVector* x_out,
+                      typename Model::StateMatrix* F_out,
+                      typename Model::NoiseGain* G_out) {
+
+  const int n_x = Model::kStateDim;
+  const int n_aug = Model::kAugDim;
+  const int n_cols = 1 + 2 * n_aug;
+  const double h = 1e-6;
+
+  //column 0 is the mean, columns 1+2i and 2+2i are perturbed in +-e_i
+  typename Model::template AugSigma<n_cols> Xaug;
+  Xaug.setZero();
+  for (int j = 0; j < n_cols; ++j) {
+    Xaug.col(j).template head<n_x>() = x;
+  }
+  for (int i = 0; i < n_aug; ++i) {
+    Xaug(i, 1 + 2 * i) += h;
+    Xaug(i, 2 + 2 * i) -= h;
+  }
+
+  typename Model::template StateSigma<n_cols> Xpred;
+  const typename Model::template TimeSteps<n_cols> dt =
+      Model::template TimeSteps<n_cols>::Constant(delta_t);
+  Model::Propagate(Xaug, dt, &Xpred);
+
+  *x_out = Xpred.col(0);
+  for (int i = 0; i < n_aug; ++i) {
+    const typename Model::StateVector d = (Xpred.col(1 + 2 * i) - Xpred.col(2 + 2 * i)) / (2 * h);
+    if (i < n_x) {
+      F_out->col(i) = d;
+    } else {
+      G_out->col(i - n_x) = d;
+    }
+  }
+}
+
+/**
+* Yaw uncertainty plus the turn over the step, for the yaw based models.
+*/
+template <class Model>
+double YawSpread(const typename Model::StateVector& x,
+                 const typename Model::StateMatrix& P, double delta_t) {
+  return std::sqrt(P(3,3)) + (std::fabs(x(4)) + std::sqrt(P(4,4))) * std::fabs(delta_t);
+}
+
+/**
+* [px py v*cos(yaw) v*sin(yaw)] for the yaw based models.
+*/
+template <typename StateSigmaType, typename KinematicsSigmaType>
+void PolarKinematics(const StateSigmaType& Xsig, KinematicsSigmaType* K_out) {
+
+  typedef Eigen::Array<double, StateSigmaType::ColsAtCompileTime, 1> Row;
+  const Row v = Xsig.row(2).transpose();
+  const Row yaw = Xsig.row(3).transpose();
+
+  Row sin_yaw;
+  Row cos_yaw;
+  SinCos(yaw, &sin_yaw, &cos_yaw);
+
+  KinematicsSigmaType& K = *K_out;
+  K.resize(4, Xsig.cols());
+  K.topRows(2) = Xsig.topRows(2);
+  K.row(2) = (v * cos_yaw).transpose();
+  K.row(3) = (v * sin_yaw).transpose();
+}
+
+template <class Model>
+void PolarKinematicsJacobian(const typename Model::StateVector& x,
+                             typename Model::KinematicsJacobianMatrix* J_out) {
+
+  const double v = x(2);
+  double sin_yaw;
+  double cos_yaw;
+  SinCos(x(3), &sin_yaw, &cos_yaw);
+
+  typename Model::KinematicsJacobianMatrix& J = *J_out;
+  J.setZero();
+  J(0,0) = 1;
+  J(1,1) = 1;
+  J(2,2) = cos_yaw;
+  J(2,3) = -v*sin_yaw;
+  J(3,2) = sin_yaw;
+  J(3,3) = v*cos_yaw;
+}
+
+}  // namespace
+
+/*****************************************************************************
+ *  CV
+ ****************************************************************************/
+
+template <int Cols>
+void CVModel::Propagate(const AugSigma<Cols>& Xsig_aug, const TimeSteps<Cols>& delta_t,
+                        StateSigma<Cols>* Xsig_out) {
+
+  typedef Eigen::Array<double, Cols, 1> Row;
+  const Row dt2 = 0.5*delta_t*delta_t;
+  const Row nu_ax = Xsig_aug.row(4).transpose();
+  const Row nu_ay = Xsig_aug.row(5).transpose();
+  const Row v_x = Xsig_aug.row(2).transpose();
+  const Row v_y = Xsig_aug.row(3).transpose();
+
+  StateSigma<Cols>& Xsig_pred = *Xsig_out;
+  Xsig_pred.resize(kStateDim, Xsig_aug.cols());
+  Xsig_pred.row(0) = Xsig_aug.row(0) + (v_x*delta_t + nu_ax*dt2).matrix().transpose();
+  Xsig_pred.row(1) = Xsig_aug.row(1) + (v_y*delta_t + nu_ay*dt2).matrix().transpose();
+  Xsig_pred.row(2) = (v_x + nu_ax*delta_t).transpose();
+  Xsig_pred.row(3) = (v_y + nu_ay*delta_t).transpose();
+}
+
+void CVModel::Linearize(const StateVector& x, double delta_t, StateVector* x_out,
+                        StateMatrix* F_out, NoiseGain* G_out) {
+
+  StateMatrix& F = *F_out;
+  F.setIdentity();
+  F(0,2) = delta_t;
+  F(1,3) = delta_t;
+
+  NoiseGain& G = *G_out;
+  G.setZero();
+  G(0,0) = 0.5*delta_t*delta_t;
+  G(1,1) = 0.5*delta_t*delta_t;
+  G(2,0) = delta_t;
+  G(3,1) = delta_t;
+
+  *x_out = F * x;
+}
+
+double CVModel::Nonlinearity(const StateVector&, const StateMatrix&, double) {
+  // the transition is linear
+  return 0.0;
+}
+
+void CVModel::NoiseStd(double std_a, double, NoiseVector* std_out) {
+  *std_out << std_a, std_a;
+}
+
+template <int Cols>
+void CVModel::Kinematics(const StateSigma<Cols>& Xsig, KinematicsSigma<Cols>* K_out) {
+  *K_out = Xsig;
+}
+
+void CVModel::KinematicsJacobian(const StateVector&, KinematicsJacobianMatrix* J_out) {
+  J_out->setIdentity();
+}
+
+void CVModel::InitFromPosition(double p_x, double p_y, StateVector* x_out) {
+  *x_out << p_x, p_y, 0, 0;
+}
+
+void CVModel::InitFromRadar(double rho, double phi, double rho_dot, StateVector* x_out) {
+  // the range rate is the only velocity information, along the line of sight
+  *x_out << rho * cos(phi), rho * sin(phi), rho_dot * cos(phi), rho_dot * sin(phi);
+}
+
+/*****************************************************************************
+ *  CTRV
+ ****************************************************************************/
+
+/**
+* Predict sigma points while avoiding division by zero. All columns are
+* propagated at once with array expressions; both branches are evaluated and
+* selected per column, so the kernel has no data dependent branches.
+*/
+template <int Cols>
+void CTRVModel::Propagate(const AugSigma<Cols>& Xsig_aug, const TimeSteps<Cols>& delta_t,
+                          StateSigma<Cols>* Xsig_out) {
+
+  //extract values for better readability
+  typedef Eigen::Array<double, Cols, 1> Row;
+  const Row p_x = Xsig_aug.row(0).transpose();
+  const Row p_y = Xsig_aug.row(1).transpose();
+  const Row v = Xsig_aug.row(2).transpose();
+  const Row yaw = Xsig_aug.row(3).transpose();
+  const Row yawd = Xsig_aug.row(4).transpose();
+  const Row nu_a = Xsig_aug.row(5).transpose();
+  const Row nu_yawdd = Xsig_aug.row(6).transpose();
+
+  const Row yaw_p = yaw + yawd*delta_t;
+  const Row dt2 = 0.5*delta_t*delta_t;
+  Row sin_yaw;
+  Row cos_yaw;
+  Row sin_yaw_p;
+  Row cos_yaw_p;
+  SinCos(yaw, &sin_yaw, &cos_yaw);
+  SinCos(yaw_p, &sin_yaw_p, &cos_yaw_p);
+
+  //avoid division by zero
+  const Eigen::Array<bool, Cols, 1> turning = yawd.abs() > 0.001;
+  const Row v_yawd = v / turning.select(yawd, 1.0);
+
+  //predicted state values plus noise
+  const Row px_p = turning.select(p_x + v_yawd * (sin_yaw_p - sin_yaw),
+                                  p_x + v*delta_t*cos_yaw)
+                   + nu_a*dt2*cos_yaw;
+  const Row py_p = turning.select(p_y + v_yawd * (cos_yaw - cos_yaw_p),
+                                  p_y + v*delta_t*sin_yaw)
+                   + nu_a*dt2*sin_yaw;
+
+  //write predicted sigma points, one row per state
+  StateSigma<Cols>& Xsig_pred = *Xsig_out;
+  Xsig_pred.resize(kStateDim, Xsig_aug.cols());
+  Xsig_pred.row(0) = px_p.transpose();
+  Xsig_pred.row(1) = py_p.transpose();
+  Xsig_pred.row(2) = (v + nu_a*delta_t).transpose();
+  Xsig_pred.row(3) = (yaw_p + nu_yawdd*dt2).transpose();
+  Xsig_pred.row(4) = (yawd + nu_yawdd*delta_t).transpose();
+}
+
+/**
+* Analytic CTRV Jacobians.
+*/
+void CTRVModel::Linearize(const StateVector& x_in, double delta_t, StateVector* x_out,
+                          StateMatrix* F_out, NoiseGain* G_out) {
+
+  //extract values for better readability
+  const double v = x_in(2);
+  const double yaw = x_in(3);
+  const double yawd = x_in(4);
+  const double yaw_p = yaw + yawd*delta_t;
+
+  double sin_yaw;
+  double cos_yaw;
+  double sin_yaw_p;
+  double cos_yaw_p;
+  SinCos(yaw, &sin_yaw, &cos_yaw);
+  SinCos(yaw_p, &sin_yaw_p, &cos_yaw_p);
+
+  //state transition Jacobian F
+  StateMatrix& F = *F_out;
+  F.setIdentity();
+  StateVector& x = *x_out;
+  x = x_in;
+
+  //avoid division by zero
+  if (fabs(yawd) > 0.001) {
+    x(0) += v/yawd * (sin_yaw_p - sin_yaw);
+    x(1) += v/yawd * (cos_yaw - cos_yaw_p);
+
+    F(0,2) = (sin_yaw_p - sin_yaw) / yawd;
+    F(0,3) = v/yawd * (cos_yaw_p - cos_yaw);
+    F(0,4) = v*delta_t*cos_yaw_p/yawd - v/(yawd*yawd) * (sin_yaw_p - sin_yaw);
+    F(1,2) = (cos_yaw - cos_yaw_p) / yawd;
+    F(1,3) = v/yawd * (sin_yaw_p - sin_yaw);
+    F(1,4) = v*delta_t*sin_yaw_p/yawd - v/(yawd*yawd) * (cos_yaw - cos_yaw_p);
+  }
+  else {
+    x(0) += v*delta_t*cos_yaw;
+    x(1) += v*delta_t*sin_yaw;
+
+    F(0,2) = delta_t*cos_yaw;
+    F(0,3) = -v*delta_t*sin_yaw;
+    F(0,4) = -0.5*v*delta_t*delta_t*sin_yaw;
+    F(1,2) = delta_t*sin_yaw;
+    F(1,3) = v*delta_t*cos_yaw;
+    F(1,4) = 0.5*v*delta_t*delta_t*cos_yaw;
+  }
+  x(3) = yaw_p;
+  F(3,4) = delta_t;
+
+  //noise gain G for [nu_a nu_yawdd]
+  const double dt2 = 0.5*delta_t*delta_t;
+  NoiseGain& G = *G_out;
+  G.setZero();
+  G(0,0) = dt2*cos_yaw;
+  G(1,0) = dt2*sin_yaw;
+  G(2,0) = delta_t;
+  G(3,1) = dt2;
+  G(4,1) = delta_t;
+}
+
+double CTRVModel::Nonlinearity(const StateVector& x, const StateMatrix& P, double delta_t) {
+  return YawSpread<CTRVModel>(x, P, delta_t);
+}
+
+void CTRVModel::NoiseStd(double std_a, double std_yawdd, NoiseVector* std_out) {
+  *std_out << std_a, std_yawdd;
+}
+
+template <int Cols>
+void CTRVModel::Kinematics(const StateSigma<Cols>& Xsig, KinematicsSigma<Cols>* K_out) {
+  PolarKinematics(Xsig, K_out);
+}
+
+void CTRVModel::KinematicsJacobian(const StateVector& x, KinematicsJacobianMatrix* J_out) {
+  PolarKinematicsJacobian<CTRVModel>(x, J_out);
+}
+
+void CTRVModel::InitFromPosition(double p_x, double p_y, StateVector* x_out) {
+  //set the state with the initial location and zero velocity
+  *x_out << p_x, p_y, 0, 0, 0;
+}
+
+void CTRVModel::InitFromRadar(double rho, double phi, double rho_dot, StateVector* x_out) {
+  // NOTE: ro_dot is not the actual speed (magnitude or direction), it is the speed in the direction of ro (range) vector
+  *x_out << rho * cos(phi), rho * sin(phi), rho_dot, 0, 0; //estimate the initial speed, too.
+}
+
+/*****************************************************************************
+ *  CTRA
+ ****************************************************************************/
+
+template <int Cols>
+void CTRAModel::Propagate(const AugSigma<Cols>& Xsig_aug, const TimeSteps<Cols>& delta_t,
+                          StateSigma<Cols>* Xsig_out) {
+
+  //extract values for better readability
+  typedef Eigen::Array<double, Cols, 1> Row;
+  const Row p_x = Xsig_aug.row(0).transpose();
+  const Row p_y = Xsig_aug.row(1).transpose();
+  const Row v = Xsig_aug.row(2).transpose();
+  const Row yaw = Xsig_aug.row(3).transpose();
+  const Row yawd = Xsig_aug.row(4).transpose();
+  const Row a = Xsig_aug.row(5).transpose();
+  const Row nu_j = Xsig_aug.row(6).transpose();
+  const Row nu_yawdd = Xsig_aug.row(7).transpose();
+
+  const Row yaw_p = yaw + yawd*delta_t;
+  Row sin_yaw;
+  Row cos_yaw;
+  Row sin_yaw_p;
+  Row cos_yaw_p;
+  SinCos(yaw, &sin_yaw, &cos_yaw);
+  SinCos(yaw_p, &sin_yaw_p, &cos_yaw_p);
+  const Row v_p = v + a*delta_t;
+  const Row dt2 = 0.5*delta_t*delta_t;
+  const Row dt3 = dt2*delta_t/3.0;
+
+  //avoid division by zero
+  const Eigen::Array<bool, Cols, 1> turning = yawd.abs() > 0.001;
+  const Row w = turning.select(yawd, 1.0);
+  const Row w2 = w*w;
+
+  //closed form integration of (v + a*t) * [cos sin](yaw + yawd*t)
+  const Row dx_turn = (v_p*w*sin_yaw_p + a*cos_yaw_p - v*w*sin_yaw - a*cos_yaw) / w2;
+  const Row dy_turn = (-v_p*w*cos_yaw_p + a*sin_yaw_p + v*w*cos_yaw - a*sin_yaw) / w2;
+  const Row ds = v*delta_t + a*dt2;
+
+  //predicted state values plus noise
+  const Row px_p = p_x + turning.select(dx_turn, ds*cos_yaw) + nu_j*dt3*cos_yaw;
+  const Row py_p = p_y + turning.select(dy_turn, ds*sin_yaw) + nu_j*dt3*sin_yaw;
+
+  StateSigma<Cols>& Xsig_pred = *Xsig_out;
+  Xsig_pred.resize(kStateDim, Xsig_aug.cols());
+  Xsig_pred.row(0) = px_p.transpose();
+  Xsig_pred.row(1) = py_p.transpose();
+  Xsig_pred.row(2) = (v_p + nu_j*dt2).transpose();
+  Xsig_pred.row(3) = (yaw_p + nu_yawdd*dt2).transpose();
+  Xsig_pred.row(4) = (yawd + nu_yawdd*delta_t).transpose();
+  Xsig_pred.row(5) = (a + nu_j*delta_t).transpose();
+}
+
+/**
+* Numeric Jacobians, the closed form CTRA derivatives are lengthy.
+*/
+void CTRAModel::Linearize(const StateVector& x, double delta_t, StateVector* x_out,
+                          StateMatrix* F_out, NoiseGain* G_out) {
+  NumericLinearize<CTRAModel>(x, delta_t, x_out, F_out, G_out);
+}
+
+double CTRAModel::Nonlinearity(const StateVector& x, const StateMatrix& P, double delta_t) {
+  return YawSpread<CTRAModel>(x, P, delta_t);
+}
+
+void CTRAModel::NoiseStd(double std_a, double std_yawdd, NoiseVector* std_out) {
+  *std_out << std_a, std_yawdd;
+}
+
+template <int Cols>
+void CTRAModel::Kinematics(const StateSigma<Cols>& Xsig, KinematicsSigma<Cols>* K_out) {
+  PolarKinematics(Xsig, K_out);
+}
+
+void CTRAModel::KinematicsJacobian(const StateVector& x, KinematicsJacobianMatrix* J_out) {
+  PolarKinematicsJacobian<CTRAModel>(x, J_out);
+}
+
+void CTRAModel::InitFromPosition(double p_x, double p_y, StateVector* x_out) {
+  *x_out << p_x, p_y, 0, 0, 0, 0;
+}
+
+void CTRAModel::InitFromRadar(double rho, double phi, double rho_dot, StateVector* x_out) {
+  *x_out << rho * cos(phi), rho * sin(phi), rho_dot, 0, 0, 0;
+}
+
+/*****************************************************************************
+ *  Kernel instantiations
+ ****************************************************************************/
+
+// one state, the point count of each sigma point rule, batch chunks and
+// dynamic batches
+#define INSTANTIATE_KERNELS(Model, Cols) \
+  template void Model::Propagate<Cols>(const Model::AugSigma<Cols>&, \
+                                       const Model::TimeSteps<Cols>&, \
+                                       Model::StateSigma<Cols>*); \
+  template void Model::Kinematics<Cols>(const Model::StateSigma<Cols>&, \
+                                        Model::KinematicsSigma<Cols>*);
+
+#define INSTANTIATE_MODEL(Model) \
+  INSTANTIATE_KERNELS(Model, 1) \
+  INSTANTIATE_KERNELS(Model, UnscentedRule::Count(Model::kAugDim)) \
+  INSTANTIATE_KERNELS(Model, CubatureRule::Count(Model::kAugDim)) \
+  INSTANTIATE_KERNELS(Model, SimplexRule::Count(Model::kAugDim)) \
+  INSTANTIATE_KERNELS(Model, Model::kBatchChunk) \
+  INSTANTIATE_KERNELS(Model, Eigen::Dynamic)
+
+INSTANTIATE_MODEL(CVModel)
+INSTANTIATE_MODEL(CTRVModel)
+INSTANTIATE_MODEL(CTRAModel)
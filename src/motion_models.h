@@ -0,0 +1,127 @@
+#ifndef MOTION_MODELS_H_
+#define MOTION_MODELS_H_
+
+#include "Eigen/Dense"
+
+/**
+* Motion models for ModelUKF. A model declares
+*   kStateDim, kNoiseDim   state and process noise dimensions
+*   kAngleMask             bit i is set if state row i is an angle (normalized)
+*   StateVector, StateMatrix, NoiseVector, NoiseGain   fixed-size types
+*   Propagate              transition of augmented sigma points [x; nu], one
+*                          column per point, with a time step per column
+*   Linearize              transition of a mean and its Jacobians, used by the
+*                          hybrid (EKF) prediction
+*   Nonlinearity           cheap indicator of how nonlinear a step is
+*   NoiseStd               process noise standard deviations
+*   Kinematics             [px py vx vy] of state columns, used by the
+*                          measurement models, and its Jacobian
+*   InitFromPosition/InitFromRadar   state from a first measurement
+* All models keep px, py in rows 0 and 1.
+*
+* Propagate and Kinematics are templates over the number of columns: 1 for a
+* single state, the point count of a sigma point rule, kBatchChunk for
+* batches of many tracks, which are cut into chunks of that width, or
+* Eigen::Dynamic. The row counts always come from the model, so each model
+* and sigma point rule gets its own fixed-size kernel; only the dynamic one
+* allocates its temporaries.
+*
+* The fixed-size types are unaligned so filters can live in standard
+* containers without aligned allocators.
+*/
+
+/**
+* Dimensions and fixed-size types of a model with the given state and
+* process noise dimensions.
+*/
+template <int StateDim, int NoiseDim>
+struct MotionModelTypes {
+  static const int kStateDim = StateDim;
+  static const int kNoiseDim = NoiseDim;
+  static const int kAugDim = StateDim + NoiseDim;
+
+  ///* columns per kernel call of a batch
+  static const int kBatchChunk = 64;
+
+  typedef Eigen::Matrix<double, kStateDim, 1, Eigen::DontAlign> StateVector;
+  typedef Eigen::Matrix<double, kStateDim, kStateDim, Eigen::DontAlign> StateMatrix;
+  typedef Eigen::Matrix<double, kNoiseDim, 1, Eigen::DontAlign> NoiseVector;
+  typedef Eigen::Matrix<double, kStateDim, kNoiseDim, Eigen::DontAlign> NoiseGain;
+  typedef Eigen::Matrix<double, 4, kStateDim, Eigen::DontAlign> KinematicsJacobianMatrix;
+
+  ///* augmented sigma points, state sigma points, kinematic points [px py vx
+  ///* vy] and time steps, one column per point
+  template <int Cols>
+  using AugSigma = Eigen::Matrix<double, kAugDim, Cols, Eigen::DontAlign>;
+  template <int Cols>
+  using StateSigma = Eigen::Matrix<double, kStateDim, Cols, Eigen::DontAlign>;
+  template <int Cols>
+  using KinematicsSigma = Eigen::Matrix<double, 4, Cols, Eigen::DontAlign>;
+  template <int Cols>
+  using TimeSteps = Eigen::Array<double, Cols, 1, Eigen::DontAlign>;
+};
+
+/**
+* Constant velocity, state [px py vx vy], noise [ax ay] with std_a each.
+*/
+struct CVModel : MotionModelTypes<4, 2> {
+  static const int kAngleMask = 0;
+
+  template <int Cols>
+  static void Propagate(const AugSigma<Cols>& Xsig_aug, const TimeSteps<Cols>& delta_t,
+                        StateSigma<Cols>* Xsig_out);
+  static void Linearize(const StateVector& x, double delta_t, StateVector* x_out,
+                        StateMatrix* F_out, NoiseGain* G_out);
+  static double Nonlinearity(const StateVector& x, const StateMatrix& P, double delta_t);
+  static void NoiseStd(double std_a, double std_yawdd, NoiseVector* std_out);
+  template <int Cols>
+  static void Kinematics(const StateSigma<Cols>& Xsig, KinematicsSigma<Cols>* K_out);
+  static void KinematicsJacobian(const StateVector& x, KinematicsJacobianMatrix* J_out);
+  static void InitFromPosition(double p_x, double p_y, StateVector* x_out);
+  static void InitFromRadar(double rho, double phi, double rho_dot, StateVector* x_out);
+};
+
+/**
+* Constant turn rate and velocity, state [px py v yaw yawd], noise
+* [nu_a nu_yawdd] with std_a and std_yawdd.
+*/
+struct CTRVModel : MotionModelTypes<5, 2> {
+  static const int kAngleMask = 1 << 3;
+
+  template <int Cols>
+  static void Propagate(const AugSigma<Cols>& Xsig_aug, const TimeSteps<Cols>& delta_t,
+                        StateSigma<Cols>* Xsig_out);
+  static void Linearize(const StateVector& x, double delta_t, StateVector* x_out,
+                        StateMatrix* F_out, NoiseGain* G_out);
+  static double Nonlinearity(const StateVector& x, const StateMatrix& P, double delta_t);
+  static void NoiseStd(double std_a, double std_yawdd, NoiseVector* std_out);
+  template <int Cols>
+  static void Kinematics(const StateSigma<Cols>& Xsig, KinematicsSigma<Cols>* K_out);
+  static void KinematicsJacobian(const StateVector& x, KinematicsJacobianMatrix* J_out);
+  static void InitFromPosition(double p_x, double p_y, StateVector* x_out);
+  static void InitFromRadar(double rho, double phi, double rho_dot, StateVector* x_out);
+};
+
+/**
+* Constant turn rate and acceleration, state [px py v yaw yawd a], noise
+* [nu_j nu_yawdd]: longitudinal jerk with std_a (in m/s^3) and yaw
+* acceleration with std_yawdd.
+*/
+struct CTRAModel : MotionModelTypes<6, 2> {
+  static const int kAngleMask = 1 << 3;
+
+  template <int Cols>
+  static void Propagate(const AugSigma<Cols>& Xsig_aug, const TimeSteps<Cols>& delta_t,
+                        StateSigma<Cols>* Xsig_out);
+  static void Linearize(const StateVector& x, double delta_t, StateVector* x_out,
+                        StateMatrix* F_out, NoiseGain* G_out);
+  static double Nonlinearity(const StateVector& x, const StateMatrix& P, double delta_t);
+  static void NoiseStd(double std_a, double std_yawdd, NoiseVector* std_out);
+  template <int Cols>
+  static void Kinematics(const StateSigma<Cols>& Xsig, KinematicsSigma<Cols>* K_out);
+  static void KinematicsJacobian(const StateVector& x, KinematicsJacobianMatrix* J_out);
+  static void InitFromPosition(double p_x, double p_y, StateVector* x_out);
+  static void InitFromRadar(double rho, double phi, double rho_dot, StateVector* x_out);
+};
+
+#endif /* MOTION_MODELS_H_ */
@@ -0,0 +1,273 @@
+#ifndef MPSC_QUEUE_H_
+#define MPSC_QUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+* Settings of MpscQueue that do not depend on the element type.
+*/
+class MpscQueueBase {
+public:
+
+  ///* how the consumer waits for elements
+  enum WaitStrategy {
+    ///* busy-poll, lowest latency, burns a core
+    SPIN,
+    ///* busy-poll for a while, then sleep until a producer wakes it
+    SPIN_THEN_PARK,
+    ///* sleep until a producer wakes it
+    BLOCK
+  };
+};
+
+/**
+* Bounded lock-free queue from many producer threads, e.g. one per sensor
+* driver, to one consumer, the filter thread. Elements are stored inline in
+* slots allocated at construction, so pushing and popping never allocate.
+*
+* Each slot carries a sequence number that says whether it is free for the
+* producer claiming that position or holds an element for the consumer.
+* Producers claim positions with one compare-and-swap on a shared counter
+* and then publish through the slot, so they never wait for each other
+* except to retry a lost claim; the consumer reads no shared counter at all.
+*
+* A full queue is reported to the producer, which drops the element
+* (TryPush, counted in dropped()) or waits for space (Push). The consumer
+* waits for elements by the strategy given at construction; only a parked
+* consumer makes producers take a mutex, to wake it up.
+*/
+template <typename T>
+class MpscQueue : public MpscQueueBase {
+public:
+
+  /**
+  * @param capacity Number of elements, rounded up to a power of two
+  * @param wait Wait strategy of the consumer
+  */
+  MpscQueue(size_t capacity, WaitStrategy wait)
+      : wait_(wait),
+        tail_(0),
+        head_(0),
+        consumed_(0),
+        parked_(false),
+        dropped_(0),
+        high_water_(0) {
+    size_t size = 2;
+    while (size < capacity) {
+      size *= 2;
+    }
+    slots_.reset(new Slot[size]);
+    for (size_t i = 0; i < size; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mask_ = size - 1;
+  }
+
+  /**
+  * Producer side, safe to call concurrently.
+  * @param value The element
+  * @return false if the queue is full; the element is dropped and counted
+  */
+  bool TryPush(const T& value) {
+    if (Enqueue(value)) {
+      return true;
+    }
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  /**
+  * Producer side: like TryPush, but waits for space instead of dropping.
+  * @param value The element
+  */
+  void Push(const T& value) {
+    for (int spins = 0; !Enqueue(value); ++spins) {
+      if (spins >= 64) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  /**
+  * Consumer side, does not wait.
+  * @param values_out Room for max_values elements, oldest first
+  * @param max_values Most elements to pop
+  * @return Number of popped elements
+  */
+  size_t TryPopBatch(T* values_out, size_t max_values) {
+    size_t n = 0;
+    for (; n < max_values; ++n) {
+      Slot& slot = slots_[head_ & mask_];
+      if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+        break;
+      }
+      values_out[n] = slot.value;
+      // free the slot for the producer one lap ahead
+      slot.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+      ++head_;
+    }
+    if (n > 0) {
+      consumed_.store(head_, std::memory_order_relaxed);
+    }
+    return n;
+  }
+
+  /**
+  * Consumer side: waits by the wait strategy until at least one element is
+  * available.
+  * @param values_out Room for max_values elements, oldest first
+  * @param max_values Most elements to pop, at least 1
+  * @return Number of popped elements
+  */
+  size_t PopBatch(T* values_out, size_t max_values) {
+    const int spin_limit = wait_ == SPIN ? -1 : wait_ == SPIN_THEN_PARK ? kParkAfterSpins : 0;
+    for (int spins = 0;; ++spins) {
+      const size_t n = TryPopBatch(values_out, max_values);
+      if (n > 0) {
+        return n;
+      }
+      if (spin_limit >= 0 && spins >= spin_limit) {
+        Park();
+        spins = 0;
+      } else if (spins >= 64) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  /**
+  * Elements dropped by TryPush on a full queue.
+  */
+  size_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  /**
+  * Most elements the queue held at once, as seen by the producers. The
+  * consumer publishes its position once per batch, so this is an upper
+  * estimate, but never more than capacity().
+  */
+  size_t high_water() const {
+    return high_water_.load(std::memory_order_relaxed);
+  }
+
+private:
+  MpscQueue(const MpscQueue&);
+  MpscQueue& operator=(const MpscQueue&);
+
+  // consumer polls before parking with SPIN_THEN_PARK
+  static const int kParkAfterSpins = 4096;
+
+  struct Slot {
+    ///* position + 1 once the element of position is published, position
+    ///* while the slot is free for it
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  /**
+  * Claims the next position and publishes the element in its slot.
+  * @return false if the queue is full
+  */
+  bool Enqueue(const T& value) {
+    size_t position = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = slots_[position & mask_];
+      const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence == position) {
+        // the slot is free for this position, claim it
+        if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          slot.value = value;
+          slot.sequence.store(position + 1, std::memory_order_release);
+          UpdateHighWater(position + 1);
+          WakeConsumer();
+          return true;
+        }
+      } else if (sequence < position) {
+        // the slot still holds the element of the previous lap
+        return false;
+      } else {
+        // another producer claimed the position first
+        position = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void UpdateHighWater(size_t tail) {
+    // the consumer may already be past this element
+    const size_t consumed = consumed_.load(std::memory_order_relaxed);
+    if (consumed >= tail) {
+      return;
+    }
+    // consumed may lag behind a batch in progress; the queue never holds
+    // more than its slots
+    const size_t size = std::min(tail - consumed, capacity());
+    size_t high = high_water_.load(std::memory_order_relaxed);
+    while (size > high &&
+           !high_water_.compare_exchange_weak(high, size, std::memory_order_relaxed)) {
+    }
+  }
+
+  /**
+  * Producer side: wakes the consumer if it is parked. The fence pairs with
+  * the one in Park, so either the producer sees parked_ or the consumer
+  * sees the new element before it sleeps.
+  */
+  void WakeConsumer() {
+    if (wait_ == SPIN) {
+      return;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked_.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(park_mutex_);
+      park_condition_.notify_one();
+    }
+  }
+
+  /**
+  * Consumer side: sleeps until an element is published.
+  */
+  void Park() {
+    std::unique_lock<std::mutex> lock(park_mutex_);
+    parked_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    park_condition_.wait(lock, [this]() {
+      return slots_[head_ & mask_].sequence.load(std::memory_order_acquire) == head_ + 1;
+    });
+    parked_.store(false, std::memory_order_relaxed);
+  }
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  const WaitStrategy wait_;
+
+  ///* next position to claim, shared by the producers
+  alignas(64) std::atomic<size_t> tail_;
+
+  ///* next position to pop, owned by the consumer
+  alignas(64) size_t head_;
+
+  ///* head_ as last published by the consumer, for the high-water mark
+  std::atomic<size_t> consumed_;
+
+  ///* the consumer sleeps on park_condition_
+  alignas(64) std::atomic<bool> parked_;
+  std::mutex park_mutex_;
+  std::condition_variable park_condition_;
+
+  ///* counters, shared by the producers
+  alignas(64) std::atomic<size_t> dropped_;
+  std::atomic<size_t> high_water_;
+};
+
+#endif /* MPSC_QUEUE_H_ */
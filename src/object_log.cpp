@@ -0,0 +1,173 @@
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include "object_log.h"
+
+using Eigen::VectorXd;
+using std::string;
+using std::vector;
+
+namespace {
+
+const char kBinaryMagic[8] = {'U', 'K', 'F', 'L', 'O', 'G', '0', '1'};
+
+///* ground truth values per record, [px py vx vy]
+const int kGroundTruthDim = 4;
+
+/**
+* On-disk record of the binary format, 80 bytes.
+*/
+struct BinaryRecord {
+  int64_t object_id;
+  int64_t timestamp;
+  int32_t sensor_type;
+  int32_t num_measurements;
+  double measurements[3];
+  double ground_truth[kGroundTruthDim];
+};
+
+}  // namespace
+
+bool ObjectLog::Read(const string& path, vector<LogRecord>* records_out) {
+
+  std::ifstream in(path.c_str(), std::ios::binary);
+  if (!in.is_open()) {
+    return false;
+  }
+
+  char magic[sizeof(kBinaryMagic)];
+  in.read(magic, sizeof(magic));
+  if (in.gcount() == sizeof(magic) && memcmp(magic, kBinaryMagic, sizeof(magic)) == 0) {
+    return ReadBinary(in, records_out);
+  }
+
+  in.clear();
+  in.seekg(0);
+  ReadText(in, records_out);
+  return true;
+}
+
+void ObjectLog::ReadText(std::istream& in, vector<LogRecord>* records_out) {
+
+  string line;
+  while (getline(in, line)) {
+    LogRecord record = LogRecord();
+    MeasurementPackage& meas_package = record.measurement;
+    GroundTruthPackage& gt_package = record.ground_truth;
+    std::istringstream iss(line);
+    long long timestamp;
+
+    // reads first element from the current line, an object ID if present
+    string sensor_type;
+    iss >> sensor_type;
+    if (!sensor_type.empty() && (isdigit(sensor_type[0]) || sensor_type[0] == '-')) {
+      meas_package.object_id_ = atoll(sensor_type.c_str());
+      iss >> sensor_type;
+    }
+
+    if (sensor_type.compare("L") == 0) {
+      // laser measurement
+      meas_package.sensor_type_ = MeasurementPackage::LASER;
+      meas_package.raw_measurements_ = VectorXd(2);
+      float px;
+      float py;
+      iss >> px;
+      iss >> py;
+      meas_package.raw_measurements_ << px, py;
+    } else if (sensor_type.compare("R") == 0) {
+      // radar measurement
+      meas_package.sensor_type_ = MeasurementPackage::RADAR;
+      meas_package.raw_measurements_ = VectorXd(3);
+      float ro;
+      float phi;
+      float ro_dot;
+      iss >> ro;
+      iss >> phi;
+      iss >> ro_dot;
+      meas_package.raw_measurements_ << ro, phi, ro_dot;
+    } else {
+      continue;
+    }
+    iss >> timestamp;
+    if (!iss) {
+      continue;
+    }
+    meas_package.timestamp_ = timestamp;
+
+    // ground truth data to compare later, NaN if the line has none
+    gt_package.timestamp_ = timestamp;
+    gt_package.gt_values_ = VectorXd::Constant(kGroundTruthDim, NAN);
+    for (int i = 0; i < kGroundTruthDim; ++i) {
+      float value;
+      if (!(iss >> value)) {
+        break;
+      }
+      gt_package.gt_values_(i) = value;
+    }
+
+    records_out->push_back(record);
+  }
+}
+
+bool ObjectLog::ReadBinary(std::istream& in, vector<LogRecord>* records_out) {
+
+  BinaryRecord raw;
+  while (in.read(reinterpret_cast<char*>(&raw), sizeof(raw))) {
+    LogRecord record = LogRecord();
+    MeasurementPackage& meas_package = record.measurement;
+    meas_package.object_id_ = raw.object_id;
+    meas_package.timestamp_ = raw.timestamp;
+    meas_package.sensor_type_ = raw.sensor_type == MeasurementPackage::RADAR
+                              ? MeasurementPackage::RADAR : MeasurementPackage::LASER;
+    meas_package.raw_measurements_ =
+        Eigen::Map<const VectorXd>(raw.measurements, raw.num_measurements == 3 ? 3 : 2);
+
+    record.ground_truth.timestamp_ = raw.timestamp;
+    record.ground_truth.gt_values_ = Eigen::Map<const VectorXd>(raw.ground_truth, kGroundTruthDim);
+    records_out->push_back(record);
+  }
+
+  // a partial trailing record means the file is truncated
+  return in.gcount() == 0;
+}
+
+bool ObjectLog::WriteBinary(const vector<LogRecord>& records, std::ostream& out) {
+
+  out.write(kBinaryMagic, sizeof(kBinaryMagic));
+  for (size_t i = 0; i < records.size(); ++i) {
+    const MeasurementPackage& meas_package = records[i].measurement;
+    BinaryRecord raw;
+    memset(&raw, 0, sizeof(raw));
+    raw.object_id = meas_package.object_id_;
+    raw.timestamp = meas_package.timestamp_;
+    raw.sensor_type = meas_package.sensor_type_;
+    raw.num_measurements = meas_package.raw_measurements_.size();
+    Eigen::Map<VectorXd>(raw.measurements, raw.num_measurements) = meas_package.raw_measurements_;
+    Eigen::Map<VectorXd>(raw.ground_truth, kGroundTruthDim) = records[i].ground_truth.gt_values_;
+    out.write(reinterpret_cast<const char*>(&raw), sizeof(raw));
+  }
+  return out.good();
+}
+
+void ObjectLog::Partition(const vector<LogRecord>& records, vector<long long>* object_ids_out,
+                          vector<vector<size_t> >* rows_out) {
+
+  std::map<long long, vector<size_t> > rows_by_object;
+  for (size_t i = 0; i < records.size(); ++i) {
+    rows_by_object[records[i].measurement.object_id_].push_back(i);
+  }
+
+  object_ids_out->clear();
+  rows_out->clear();
+  for (std::map<long long, vector<size_t> >::iterator it = rows_by_object.begin();
+       it != rows_by_object.end(); ++it) {
+    object_ids_out->push_back(it->first);
+    rows_out->push_back(vector<size_t>());
+    rows_out->back().swap(it->second);
+  }
+}
@@ -0,0 +1,78 @@
+#ifndef OBJECT_LOG_H_
+#define OBJECT_LOG_H_
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "measurement_package.h"
+#include "ground_truth_package.h"
+
+/**
+* One row of a measurement log: the measurement and its ground truth.
+*/
+struct LogRecord {
+  MeasurementPackage measurement;
+  GroundTruthPackage ground_truth;
+};
+
+/**
+* Multi-object measurement logs.
+*
+* Text: one measurement per line, optionally prefixed by an object ID,
+*   [object_id] L px py timestamp [px_gt py_gt vx_gt vy_gt ...]
+*   [object_id] R rho phi rho_dot timestamp [px_gt py_gt vx_gt vy_gt ...]
+* Lines without an ID belong to object 0, so single object logs read as
+* before.
+*
+* Binary: the magic "UKFLOG01" followed by fixed size little endian records
+* (see BinaryRecord in object_log.cpp), several times faster to parse than
+* text for large logs.
+*/
+class ObjectLog {
+public:
+
+  /**
+  * Reads a text or binary log, detected by the binary magic.
+  * @param path The log file
+  * @param records_out The records in file order
+  * @return false if the file cannot be read
+  */
+  static bool Read(const std::string& path, std::vector<LogRecord>* records_out);
+
+  /**
+  * Reads a text log, unknown sensor types and lines whose measurement or
+  * timestamp do not parse are skipped.
+  * @param in The log
+  * @param records_out The records in file order, appended
+  */
+  static void ReadText(std::istream& in, std::vector<LogRecord>* records_out);
+
+  /**
+  * Reads the records of a binary log, after the magic.
+  * @param in The log
+  * @param records_out The records in file order, appended
+  * @return false on a truncated record
+  */
+  static bool ReadBinary(std::istream& in, std::vector<LogRecord>* records_out);
+
+  /**
+  * Writes a binary log including the magic.
+  * @param records The records
+  * @param out The binary log
+  * @return false on a write error
+  */
+  static bool WriteBinary(const std::vector<LogRecord>& records, std::ostream& out);
+
+  /**
+  * Groups the records by object.
+  * @param records The records
+  * @param object_ids_out The object IDs in ascending order
+  * @param rows_out The record indices of each object, in file order
+  */
+  static void Partition(const std::vector<LogRecord>& records,
+                        std::vector<long long>* object_ids_out,
+                        std::vector<std::vector<size_t> >* rows_out);
+};
+
+#endif /* OBJECT_LOG_H_ */
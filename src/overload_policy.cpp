@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include "overload_policy.h"
+
+using namespace std;
+
+// urgency of tracks that do not approach the sensor, plus their range
+static const double kNotClosing = 1e9;
+
+static long long NowNs() {
+  return chrono::duration_cast<chrono::nanoseconds>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+OverloadStats::OverloadStats()
+    : frames(0),
+      overloaded_frames(0),
+      updated_measurements(0),
+      shed_measurements(0),
+      forced_updates(0),
+      longest_shed_streak(0) {}
+
+OverloadPolicy::OverloadPolicy()
+    : frame_budget_us_(0),
+      priority_(RANGE),
+      min_track_updates_(3),
+      max_shed_streak_(10),
+      cost_smoothing_(0.2),
+      update_cost_ns_(0.0),
+      frame_start_ns_(0),
+      deadline_ns_(0) {}
+
+void OverloadPolicy::Reset(size_t num_tracks) {
+  stats_ = OverloadStats();
+  track_updates_.assign(num_tracks, 0);
+  shed_streak_.assign(num_tracks, 0);
+  update_cost_ns_ = 0.0;
+  frame_ns_.clear();
+}
+
+double OverloadPolicy::Urgency(const UKF& track) const {
+  const double px = track.x_(0);
+  const double py = track.x_(1);
+  const double range = sqrt(px * px + py * py);
+  if (priority_ == RANGE || range < 1e-6) {
+    return range;
+  }
+
+  // speed towards the sensor at the origin
+  const double vx = track.x_(2) * cos(track.x_(3));
+  const double vy = track.x_(2) * sin(track.x_(3));
+  const double closing = -(px * vx + py * vy) / range;
+  if (closing <= 1e-3) {
+    return kNotClosing + range;
+  }
+  return range / closing;
+}
+
+void OverloadPolicy::BeginFrame() {
+  frame_start_ns_ = NowNs();
+  deadline_ns_ = frame_start_ns_ + frame_budget_us_ * 1000;
+}
+
+void OverloadPolicy::Order(const vector<size_t>& objects, const vector<UKF*>& tracks,
+                           vector<size_t>* order_out) const {
+  vector<size_t>& order = *order_out;
+  order.resize(objects.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  if (frame_budget_us_ <= 0) {
+    return;
+  }
+
+  vector<pair<double, size_t> > keys(objects.size());
+  for (size_t i = 0; i < objects.size(); ++i) {
+    const bool forced = Forced(objects[i], *tracks[i]);
+    keys[i] = make_pair(forced ? -numeric_limits<double>::infinity() : Urgency(*tracks[i]), i);
+  }
+  stable_sort(keys.begin(), keys.end());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    order[i] = keys[i].second;
+  }
+}
+
+bool OverloadPolicy::Admit(size_t object, const UKF& track) const {
+  if (frame_budget_us_ <= 0 || Forced(object, track)) {
+    return true;
+  }
+  return NowNs() + update_cost_ns_ <= deadline_ns_;
+}
+
+bool OverloadPolicy::Forced(size_t object, const UKF& track) const {
+  return !track.is_initialized_ || track_updates_[object] < min_track_updates_ ||
+         (max_shed_streak_ > 0 && shed_streak_[object] >= max_shed_streak_);
+}
+
+void OverloadPolicy::EndFrame(const vector<size_t>& objects, const vector<char>& shed,
+                              const vector<size_t>& measurements, long long update_ns) {
+
+  frame_ns_.push_back(NowNs() - frame_start_ns_);
+  ++stats_.frames;
+
+  size_t n_updated = 0;
+  size_t n_shed = 0;
+  for (size_t i = 0; i < objects.size(); ++i) {
+    int& streak = shed_streak_[objects[i]];
+    if (shed[i]) {
+      ++n_shed;
+      stats_.shed_measurements += measurements[i];
+      stats_.longest_shed_streak = max(stats_.longest_shed_streak, ++streak);
+      continue;
+    }
+    ++n_updated;
+    stats_.updated_measurements += measurements[i];
+    if (frame_budget_us_ > 0 && (track_updates_[objects[i]] < min_track_updates_ ||
+                                 (max_shed_streak_ > 0 && streak >= max_shed_streak_))) {
+      ++stats_.forced_updates;
+    }
+    ++track_updates_[objects[i]];
+    streak = 0;
+  }
+  if (n_shed > 0) {
+    ++stats_.overloaded_frames;
+  }
+
+  if (n_updated > 0) {
+    const double cost = (double) update_ns / n_updated;
+    update_cost_ns_ = update_cost_ns_ == 0.0
+                          ? cost
+                          : (1.0 - cost_smoothing_) * update_cost_ns_ + cost_smoothing_ * cost;
+  }
+}
+
+long long OverloadPolicy::FrameTime(double q) const {
+  if (frame_ns_.empty()) {
+    return 0;
+  }
+  vector<long long> sorted(frame_ns_);
+  const size_t k = min(sorted.size() - 1, (size_t) (q * sorted.size()));
+  nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+  return sorted[k];
+}
@@ -0,0 +1,152 @@
+#ifndef OVERLOAD_POLICY_H_
+#define OVERLOAD_POLICY_H_
+
+#include <cstddef>
+#include <vector>
+#include "ukf.h"
+
+/**
+* Shedding counters of a replay under an OverloadPolicy.
+*/
+struct OverloadStats {
+  ///* frames processed and frames that shed at least one update
+  size_t frames;
+  size_t overloaded_frames;
+
+  ///* measurements used in an update and measurements only predicted to
+  size_t updated_measurements;
+  size_t shed_measurements;
+
+  ///* updates run past the budget because the track was new or shed too
+  ///* often
+  size_t forced_updates;
+
+  ///* most frames in a row one track was shed
+  int longest_shed_streak;
+
+  OverloadStats();
+};
+
+/**
+* Overload handling of the frame-synchronous track bank, see
+* Replay::ReplayFrames. Every frame gets a time budget; tracks are updated in
+* priority order, and once the remaining budget no longer covers the cost of
+* one more update the rest of the frame is shed: those tracks stay at their
+* prediction to the frame time, which is computed for every track anyway.
+* Shedding is thus bounded to the low-priority end of a burst instead of
+* delaying every track. New tracks are never shed before their first
+* min_track_updates_ updates, as their velocity is still unobserved, and a
+* track shed max_shed_streak_ frames in a row is updated in the next frame
+* regardless of the budget, which bounds how stale any track can get.
+*
+* The cost of one update is estimated from the previous frames, so a frame
+* overruns its budget by at most the error of that estimate.
+*/
+class OverloadPolicy {
+public:
+
+  ///* ranking of the tracks of a frame
+  enum Priority {
+    ///* closest to the sensor first
+    RANGE,
+    ///* shortest time to reach the sensor first, receding tracks last
+    CLOSING_TIME
+  };
+
+  ///* time budget of one frame in us, predictions included; 0 never sheds
+  long long frame_budget_us_;
+
+  ///* ranking of the tracks
+  Priority priority_;
+
+  ///* updates of a new track before it may be shed
+  int min_track_updates_;
+
+  ///* frames in a row a track may be shed, 0 for no limit
+  int max_shed_streak_;
+
+  ///* weight of the newest frame in the estimated cost of an update
+  double cost_smoothing_;
+
+  ///* shedding counters since the last Reset
+  OverloadStats stats_;
+
+  OverloadPolicy();
+
+  /**
+  * Clears the counters and the per-track state.
+  * @param num_tracks Number of tracks, i.e. objects of the log
+  */
+  void Reset(size_t num_tracks);
+
+  /**
+  * Urgency of a track predicted to the frame time, lower is more urgent.
+  * @param track The track
+  */
+  double Urgency(const UKF& track) const;
+
+  /**
+  * Starts the clock of a frame.
+  */
+  void BeginFrame();
+
+  /**
+  * Sorts the tracks of a frame into update order: tracks that must not be
+  * shed first, then by urgency.
+  * @param objects The tracks of the frame by their object index
+  * @param tracks The tracks, predicted to the frame time
+  * @param order_out Positions in objects, most urgent first
+  */
+  void Order(const std::vector<size_t>& objects, const std::vector<UKF*>& tracks,
+             std::vector<size_t>* order_out) const;
+
+  /**
+  * Decides whether the next update still fits the frame. Safe to call
+  * concurrently.
+  * @param object The track by its object index
+  * @param track The track
+  * @return false to shed the update
+  */
+  bool Admit(size_t object, const UKF& track) const;
+
+  /**
+  * Ends a frame: updates the shed streaks, the cost estimate and stats_.
+  * @param objects The tracks of the frame by their object index
+  * @param shed Per track of the frame, 1 if it was shed
+  * @param measurements Per track of the frame, its number of measurements
+  * @param update_ns Total time of the updates that ran
+  */
+  void EndFrame(const std::vector<size_t>& objects, const std::vector<char>& shed,
+                const std::vector<size_t>& measurements, long long update_ns);
+
+  /**
+  * Quantile of the frame times since the last Reset.
+  * @param q The quantile in [0, 1]
+  * @return The frame time in ns, 0 without frames
+  */
+  long long FrameTime(double q) const;
+
+private:
+  /**
+  * @return true if the track must be updated whatever the budget
+  */
+  bool Forced(size_t object, const UKF& track) const;
+
+  ///* updates of each track so far
+  std::vector<int> track_updates_;
+
+  ///* frames each track was shed in a row
+  std::vector<int> shed_streak_;
+
+  ///* estimated time of one update in ns
+  double update_cost_ns_;
+
+  ///* start and deadline of the current frame, steady clock in ns
+  long long frame_start_ns_;
+  long long deadline_ns_;
+
+  ///* wall time of every frame in ns
+  std::vector<long long> frame_ns_;
+};
+
+#endif /* OVERLOAD_POLICY_H_ */
@@ -0,0 +1,77 @@
+#ifndef PACKED_COVARIANCE_H_
+#define PACKED_COVARIANCE_H_
+
+#include "Eigen/Dense"
+
+/**
+* Symmetric N x N covariance stored as its N*(N+1)/2 unique entries (upper
+* triangle, column by column). Unpacking always writes both triangles from the
+* same entry, so an unpacked matrix is symmetric by construction. The storage
+* is a plain array without heap allocation.
+*/
+template <int N>
+class PackedCovariance {
+public:
+  ///* number of stored entries
+  static const int kSize = N * (N + 1) / 2;
+
+  ///* dense matrix type the packed form expands into
+  typedef Eigen::Matrix<double, N, N> DenseMatrix;
+
+  /**
+  * Position of entry (i, j) with i <= j in the packed array.
+  */
+  static int Index(int i, int j) {
+    return j * (j + 1) / 2 + i;
+  }
+
+  /**
+  * Symmetric element access.
+  */
+  double operator()(int i, int j) const {
+    return i <= j ? data_[Index(i, j)] : data_[Index(j, i)];
+  }
+
+  /**
+  * Stores the upper triangle of P, the lower triangle is not read.
+  * @param P N x N covariance
+  */
+  template <typename Derived>
+  void Pack(const Eigen::MatrixBase<Derived>& P) {
+    for (int j = 0; j < N; ++j) {
+      for (int i = 0; i <= j; ++i) {
+        data_[Index(i, j)] = P(i, j);
+      }
+    }
+  }
+
+  /**
+  * Expands into a dense symmetric matrix.
+  * @param P_out N x N output (fixed or dynamic size)
+  */
+  template <typename MatrixType>
+  void Unpack(MatrixType* P_out) const {
+    MatrixType& P = *P_out;
+    P.resize(N, N);
+    for (int j = 0; j < N; ++j) {
+      for (int i = 0; i < j; ++i) {
+        P(i, j) = P(j, i) = data_[Index(i, j)];
+      }
+      P(j, j) = data_[Index(j, j)];
+    }
+  }
+
+  DenseMatrix Unpacked() const {
+    DenseMatrix P;
+    Unpack(&P);
+    return P;
+  }
+
+  const double* data() const { return data_; }
+  double* data() { return data_; }
+
+private:
+  double data_[kSize];
+};
+
+#endif /* PACKED_COVARIANCE_H_ */
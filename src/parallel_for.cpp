@@ -0,0 +1,79 @@
+#include "parallel_for.h"
+
+using namespace std;
+
+// true on the threads of a worker pool
+static thread_local bool in_worker_pool = false;
+
+WorkerPool& WorkerPool::Shared() {
+  static WorkerPool pool;
+  return pool;
+}
+
+WorkerPool::WorkerPool()
+    : work_(nullptr),
+      context_(nullptr),
+      wanted_(0),
+      active_(0),
+      stopping_(false) {}
+
+WorkerPool::~WorkerPool() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (size_t t = 0; t < threads_.size(); ++t) {
+    threads_[t].join();
+  }
+}
+
+void WorkerPool::Run(int num_threads, void (*work)(void*), void* context) {
+
+  // nested or concurrent jobs run on the calling thread
+  unique_lock<mutex> run_lock(run_mutex_, defer_lock);
+  if (num_threads <= 1 || in_worker_pool || !run_lock.try_lock()) {
+    work(context);
+    return;
+  }
+
+  {
+    lock_guard<mutex> lock(mutex_);
+    while ((int) threads_.size() < num_threads - 1) {
+      threads_.push_back(thread(&WorkerPool::Worker, this));
+    }
+    work_ = work;
+    context_ = context;
+    wanted_ = num_threads - 1;
+  }
+  wake_.notify_all();
+
+  work(context);
+
+  // the tasks are all handed out: threads that have not joined yet are not
+  // needed any more, the ones working finish their last task
+  unique_lock<mutex> lock(mutex_);
+  wanted_ = 0;
+  done_.wait(lock, [this]() { return active_ == 0; });
+}
+
+void WorkerPool::Worker() {
+  in_worker_pool = true;
+  unique_lock<mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait(lock, [this]() { return stopping_ || wanted_ > 0; });
+    if (stopping_) {
+      return;
+    }
+    --wanted_;
+    ++active_;
+    void (*work)(void*) = work_;
+    void* context = context_;
+    lock.unlock();
+    work(context);
+    lock.lock();
+    if (--active_ == 0) {
+      done_.notify_all();
+    }
+  }
+}
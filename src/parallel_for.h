@@ -0,0 +1,116 @@
+#ifndef PARALLEL_FOR_H_
+#define PARALLEL_FOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+* Number of worker threads for num_tasks tasks.
+* @param num_threads Requested threads, 0 for one per core
+* @param num_tasks Number of tasks, no more threads than tasks are started
+*/
+inline int ThreadCount(int num_threads, size_t num_tasks) {
+  if (num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return std::max(1, (int) std::min((size_t) num_threads, num_tasks));
+}
+
+/**
+* Process-wide pool of worker threads behind ParallelFor. The threads are
+* started on first use, grow to the largest thread count asked for and then
+* sleep between jobs, so a call costs a wakeup instead of a thread start.
+* The pool runs one job at a time: a call from inside a job, or while
+* another thread's job runs, works on the calling thread alone.
+*/
+class WorkerPool {
+public:
+
+  /**
+  * The pool shared by all ParallelFor calls.
+  */
+  static WorkerPool& Shared();
+
+  /**
+  * Runs work(context) on the calling thread and on up to num_threads - 1
+  * pool threads, and returns when all of them have returned. Pool threads
+  * that only wake up after the calling thread finished skip the job, so
+  * work must hand out its tasks dynamically.
+  * @param num_threads Threads working on the job, the caller included
+  * @param work Called concurrently, returns when no tasks are left
+  * @param context Argument of work
+  */
+  void Run(int num_threads, void (*work)(void*), void* context);
+
+  ~WorkerPool();
+
+private:
+  WorkerPool();
+  WorkerPool(const WorkerPool&);
+  WorkerPool& operator=(const WorkerPool&);
+
+  void Worker();
+
+  ///* held by the thread whose job the pool runs
+  std::mutex run_mutex_;
+
+  ///* guards everything below
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::vector<std::thread> threads_;
+
+  ///* the current job
+  void (*work_)(void*);
+  void* context_;
+
+  ///* pool threads still to join the job, and pool threads working on it
+  int wanted_;
+  int active_;
+
+  bool stopping_;
+};
+
+/**
+* Runs task(i) for i = 0 .. num_tasks-1 on the worker pool. Tasks are handed
+* out one at a time from a shared counter, so tasks of very different cost
+* (e.g. objects with long and short tracks) still balance. The calling
+* thread works as one of the threads.
+* @param num_tasks Number of tasks
+* @param num_threads Worker threads, 0 for one per core
+* @param task Callable with a size_t argument, safe to call concurrently
+*/
+template <typename Task>
+void ParallelFor(size_t num_tasks, int num_threads, const Task& task) {
+
+  struct Job {
+    std::atomic<size_t> next;
+    size_t num_tasks;
+    const Task* task;
+
+    static void Work(void* context) {
+      Job& job = *static_cast<Job*>(context);
+      for (size_t i = job.next++; i < job.num_tasks; i = job.next++) {
+        (*job.task)(i);
+      }
+    }
+  };
+
+  Job job;
+  job.next = 0;
+  job.num_tasks = num_tasks;
+  job.task = &task;
+
+  const int n_threads = ThreadCount(num_threads, num_tasks);
+  if (n_threads == 1) {
+    Job::Work(&job);
+    return;
+  }
+  WorkerPool::Shared().Run(n_threads, &Job::Work, &job);
+}
+
+#endif /* PARALLEL_FOR_H_ */
@@ -0,0 +1,169 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include "realtime.h"
+
+#ifdef __linux__
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+RealTimeConfig::RealTimeConfig()
+    : lock_memory(true),
+      prefault_stack_bytes(512 * 1024),
+      prefault_heap_bytes(64 * 1024 * 1024),
+      ingest_cpu(-1),
+      filter_cpu(-1),
+      output_cpu(-1),
+      fifo_priority(0),
+      max_tracks(1024),
+      queue_capacity(4096),
+      ingest_per_sensor(false),
+      reorder_window_us(50000),
+      ingest_wait(MpscQueueBase::SPIN),
+      ingest_batch(32),
+      warmup_updates(100),
+      pace(0.0) {}
+
+bool RealTimeReport::Clean() const {
+  const RealTimeThreadStats* threads[] = {&ingest, &filter, &output};
+  for (int i = 0; i < 3; ++i) {
+    if (threads[i]->allocations > 0 || threads[i]->minor_faults > 0 ||
+        threads[i]->major_faults > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*****************************************************************************
+ *  Allocation counting
+ ****************************************************************************/
+
+// defined by allocation_counter.cpp in binaries that link it
+extern "C" long long UkfThreadAllocations() __attribute__((weak));
+
+static long long ThreadAllocations() {
+  return UkfThreadAllocations != nullptr ? UkfThreadAllocations() : -1;
+}
+
+/*****************************************************************************
+ *  Operating system setup
+ ****************************************************************************/
+
+#ifdef __linux__
+
+bool RealTime::LockMemory(string* error_out) {
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    *error_out = string("mlockall failed: ") + strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+void RealTime::PrefaultHeap(size_t bytes) {
+  // freed memory stays mapped, large blocks come from the heap instead of
+  // fresh mmaps, and all threads share the prefaulted main arena
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+  mallopt(M_ARENA_MAX, 1);
+
+  char* heap = static_cast<char*>(malloc(bytes));
+  if (heap == nullptr) {
+    return;
+  }
+  for (size_t i = 0; i < bytes; i += 4096) {
+    static_cast<volatile char*>(heap)[i] = 0;
+  }
+  free(heap);
+}
+
+void RealTime::PrefaultStack(size_t bytes) {
+  volatile char* stack = static_cast<volatile char*>(alloca(bytes));
+  for (size_t i = 0; i < bytes; i += 4096) {
+    stack[i] = 0;
+  }
+}
+
+bool RealTime::PinCurrentThread(int cpu, string* error_out) {
+  if (cpu < 0) {
+    return true;
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  const int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (error != 0) {
+    *error_out = "pinning to CPU " + to_string(cpu) + " failed: " + strerror(error);
+    return false;
+  }
+  return true;
+}
+
+bool RealTime::SetCurrentThreadFifo(int priority, string* error_out) {
+  if (priority <= 0) {
+    return true;
+  }
+  sched_param param;
+  memset(&param, 0, sizeof(param));
+  param.sched_priority = priority;
+  const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+  if (error != 0) {
+    *error_out = "SCHED_FIFO priority " + to_string(priority) + " failed: " + strerror(error);
+    return false;
+  }
+  return true;
+}
+
+RealTimeThreadStats RealTime::ThreadStats() {
+  RealTimeThreadStats stats;
+  rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  stats.allocations = ThreadAllocations();
+  stats.minor_faults = usage.ru_minflt;
+  stats.major_faults = usage.ru_majflt;
+  return stats;
+}
+
+#else
+
+bool RealTime::LockMemory(string* error_out) {
+  *error_out = "memory locking is not supported on this platform";
+  return false;
+}
+
+void RealTime::PrefaultHeap(size_t bytes) {}
+
+void RealTime::PrefaultStack(size_t bytes) {}
+
+bool RealTime::PinCurrentThread(int cpu, string* error_out) {
+  if (cpu < 0) {
+    return true;
+  }
+  *error_out = "thread pinning is not supported on this platform";
+  return false;
+}
+
+bool RealTime::SetCurrentThreadFifo(int priority, string* error_out) {
+  if (priority <= 0) {
+    return true;
+  }
+  *error_out = "SCHED_FIFO is not supported on this platform";
+  return false;
+}
+
+RealTimeThreadStats RealTime::ThreadStats() {
+  RealTimeThreadStats stats;
+  stats.allocations = ThreadAllocations();
+  stats.minor_faults = 0;
+  stats.major_faults = 0;
+  return stats;
+}
+
+#endif
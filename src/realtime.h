@@ -0,0 +1,164 @@
+#ifndef REALTIME_H_
+#define REALTIME_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "mpsc_queue.h"
+
+/**
+* Settings of the real-time mode, see Replay::ReplayRealTime.
+*/
+struct RealTimeConfig {
+  ///* lock all current and future pages into RAM (mlockall)
+  bool lock_memory;
+
+  ///* stack touched by every pipeline thread at startup, in bytes
+  size_t prefault_stack_bytes;
+
+  ///* heap touched at startup and kept mapped afterwards, in bytes
+  size_t prefault_heap_bytes;
+
+  ///* CPUs of the ingest, filter and output threads, -1 to not pin
+  int ingest_cpu;
+  int filter_cpu;
+  int output_cpu;
+
+  ///* SCHED_FIFO priority of the pipeline threads, 0 for the default
+  ///* scheduler
+  int fifo_priority;
+
+  ///* tracks and queue slots allocated at startup
+  size_t max_tracks;
+  size_t queue_capacity;
+
+  ///* one ingest thread per sensor, like separate sensor drivers, instead
+  ///* of one for the whole log; laser/radar pairs are then not fused
+  bool ingest_per_sensor;
+
+  ///* with ingest_per_sensor, how long the filter thread holds measurements
+  ///* back to restore their time order, in us of log time; measurements
+  ///* older than an update already made on their track are dropped
+  long long reorder_window_us;
+
+  ///* how the filter thread waits for measurements
+  MpscQueueBase::WaitStrategy ingest_wait;
+
+  ///* most measurements the filter thread takes from the queue at once
+  size_t ingest_batch;
+
+  ///* updates before the self-check starts counting
+  size_t warmup_updates;
+
+  ///* replay speed relative to the log timestamps, 0 for as fast as possible
+  double pace;
+
+  RealTimeConfig();
+};
+
+/**
+* Allocations and page faults of one thread.
+*/
+struct RealTimeThreadStats {
+  ///* heap allocations, -1 if the build does not count them
+  long long allocations;
+  long long minor_faults;
+  long long major_faults;
+};
+
+/**
+* Latencies and self-check of a real-time run.
+*/
+struct RealTimeReport {
+  ///* filter updates, fused laser/radar pairs count once
+  size_t updates;
+
+  ///* from the ingest of a measurement to its filtered state, in ns
+  long long latency_p50;
+  long long latency_p99;
+  long long latency_p999;
+  long long latency_max;
+
+  ///* filter time of one update, in ns
+  long long service_p50;
+  long long service_p99;
+  long long service_max;
+
+  ///* measurements dropped on a full ingest queue, and the most it held
+  size_t ingest_drops;
+  size_t ingest_high_water;
+
+  ///* measurements dropped as out of order behind the reorder window
+  size_t late_drops;
+
+  ///* per pipeline thread, counted after the warm-up; ingest sums the
+  ///* ingest threads
+  RealTimeThreadStats ingest;
+  RealTimeThreadStats filter;
+  RealTimeThreadStats output;
+
+  ///* settings that could not be applied, e.g. for lack of privileges
+  std::vector<std::string> warnings;
+
+  /**
+  * @return true if no thread allocated or faulted after the warm-up
+  */
+  bool Clean() const;
+};
+
+/**
+* Operating system setup of a real-time loop. Linux only; elsewhere the
+* calls fail with an error message and the loop runs as usual.
+*/
+class RealTime {
+public:
+
+  /**
+  * Locks all current and future pages into RAM, so no page of the process
+  * is ever swapped out or faulted in lazily.
+  * @param error_out Reason of a failure
+  * @return false on failure, e.g. over RLIMIT_MEMLOCK
+  */
+  static bool LockMemory(std::string* error_out);
+
+  /**
+  * Maps and touches heap memory, then keeps it: malloc is told never to
+  * return memory to the system and to serve all threads from one arena, so
+  * later allocations reuse the touched pages instead of faulting.
+  * @param bytes Heap size to touch
+  */
+  static void PrefaultHeap(size_t bytes);
+
+  /**
+  * Touches the stack of the calling thread below the current frame.
+  * @param bytes Stack size to touch
+  */
+  static void PrefaultStack(size_t bytes);
+
+  /**
+  * Pins the calling thread to one CPU.
+  * @param cpu The CPU, -1 does nothing
+  * @param error_out Reason of a failure
+  * @return false on failure
+  */
+  static bool PinCurrentThread(int cpu, std::string* error_out);
+
+  /**
+  * Runs the calling thread with the SCHED_FIFO policy.
+  * @param priority The priority, 0 does nothing
+  * @param error_out Reason of a failure, usually missing CAP_SYS_NICE
+  * @return false on failure
+  */
+  static bool SetCurrentThreadFifo(int priority, std::string* error_out);
+
+  /**
+  * Allocations and page faults of the calling thread since it started.
+  * Allocations are counted in binaries that link allocation_counter.cpp
+  * (UnscentedKF built with UKF_COUNT_ALLOCATIONS, glibc only), where malloc,
+  * calloc, realloc and the aligned variants are wrapped; this covers
+  * operator new and Eigen.
+  */
+  static RealTimeThreadStats ThreadStats();
+};
+
+#endif /* REALTIME_H_ */
@@ -0,0 +1,832 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include "replay.h"
+#include "ukf.h"
+#include "parallel_for.h"
+#include "slot_map.h"
+#include "mpsc_queue.h"
+#include "spsc_ring.h"
+#include "track_snapshot.h"
+
+using namespace std;
+using Eigen::VectorXd;
+
+// tracks per batched prediction kernel call of a frame
+static const size_t kFrameBlock = 64;
+
+// smaller frames are processed by the calling thread alone
+static const size_t kParallelFrameTracks = 256;
+
+// setup time of the real-time ingest threads before the paced replay starts
+static const long long kIngestStartupNs = 20000000;
+
+void Replay::WriteHeader(ostream& out, bool with_object_id) {
+
+  // column names for output file
+  if (with_object_id) {
+    out << "object_id" << "\t";
+  }
+  out << "time_stamp" << "\t";
+  out << "px_state" << "\t";
+  out << "py_state" << "\t";
+  out << "v_state" << "\t";
+  out << "yaw_angle_state" << "\t";
+  out << "yaw_rate_state" << "\t";
+  out << "sensor_type" << "\t";
+  out << "NIS" << "\t";
+  out << "px_measured" << "\t";
+  out << "py_measured" << "\t";
+  out << "px_ground_truth" << "\t";
+  out << "py_ground_truth" << "\t";
+  out << "vx_ground_truth" << "\t";
+  out << "vy_ground_truth" << "\n";
+}
+
+namespace {
+
+/**
+ * Processes the measurement rows[k] of one object, coalesced with rows[k+1]
+ * into one fused update if they are a laser/radar pair sharing a timestamp,
+ * and writes one output row per consumed measurement. With predict_only the
+ * update is shed: the rows get the state as it is, already predicted to the
+ * measurement time, and no NIS.
+ * @return The number of consumed measurements
+ */
+size_t FilterStep(const vector<LogRecord>& records, const vector<size_t>& rows,
+                  size_t k, size_t end, bool with_object_id, GroundTruthJoin* gt_join,
+                  bool predict_only, UKF* ukf_in, ostream& out, ObjectReplay* result_out) {
+
+  UKF& ukf = *ukf_in;
+  ObjectReplay& result = *result_out;
+  const MeasurementPackage& meas_k = records[rows[k]].measurement;
+
+  // number of measurements consumed by this filter step
+  size_t n_step = 1;
+
+  // coalesce a laser/radar pair that shares a timestamp into one update
+  if (ukf.use_fused_update_ && k + 1 < end) {
+    const MeasurementPackage& meas_next = records[rows[k + 1]].measurement;
+    if (meas_k.sensor_type_ != meas_next.sensor_type_ &&
+        fabs(meas_next.timestamp_ - meas_k.timestamp_) / 1000000.0 < ukf.fusion_dt_threshold_) {
+      const bool laser_first = meas_k.sensor_type_ == MeasurementPackage::LASER;
+      if (!predict_only) {
+        ukf.ProcessFusedMeasurement(laser_first ? meas_k : meas_next,
+                                    laser_first ? meas_next : meas_k);
+      }
+      n_step = 2;
+    }
+  }
+  if (n_step == 1 && !predict_only) {
+    // Call the UKF-based fusion
+    ukf.ProcessMeasurement(meas_k);
+  }
+
+  // write one output row per consumed measurement
+  for (size_t j = k; j < k + n_step; ++j) {
+    const MeasurementPackage& meas_package = records[rows[j]].measurement;
+
+    if (with_object_id) {
+      out << meas_package.object_id_ << "\t";
+    }
+
+    // timestamp
+    out << meas_package.timestamp_ << "\t";
+
+    // output the state vector
+    out << ukf.x_(0) << "\t"; // pos1 - est
+    out << ukf.x_(1) << "\t"; // pos2 - est
+    out << ukf.x_(2) << "\t"; // vel_abs -est
+    out << ukf.x_(3) << "\t"; // yaw_angle -est
+    out << ukf.x_(4) << "\t"; // yaw_rate -est
+
+    // output lidar and radar specific data
+    if (meas_package.sensor_type_ == MeasurementPackage::LASER) {
+      // sensor type
+      out << "lidar" << "\t";
+
+      // NIS value
+      if (predict_only) {
+        out << NAN << "\t";
+      } else {
+        out << ukf.NIS_laser_ << "\t";
+        result.nis_laser.push_back(ukf.NIS_laser_);
+      }
+
+      // output the lidar sensor measurement px and py
+      out << meas_package.raw_measurements_(0) << "\t";
+      out << meas_package.raw_measurements_(1) << "\t";
+
+    } else if (meas_package.sensor_type_ == MeasurementPackage::RADAR) {
+      // sensor type
+      out << "radar" << "\t";
+
+      // NIS value
+      if (predict_only) {
+        out << NAN << "\t";
+      } else {
+        out << ukf.NIS_radar_ << "\t";
+        result.nis_radar.push_back(ukf.NIS_radar_);
+      }
+
+      // output radar measurement in cartesian coordinates
+      float ro = meas_package.raw_measurements_(0);
+      float phi = meas_package.raw_measurements_(1);
+      float origin_x = 0;
+      float origin_y = 0;
+      if (meas_package.sensor_origin_.size() > 0) {
+        origin_x = meas_package.sensor_origin_(0);
+        origin_y = meas_package.sensor_origin_(1);
+      }
+      out << origin_x + ro * cos(phi) << "\t"; // px measurement
+      out << origin_y + ro * sin(phi) << "\t"; // py measurement
+    }
+
+    // ground truth from the log record or the separate ground truth log
+    VectorXd gt_values = records[rows[j]].ground_truth.gt_values_;
+    bool has_gt = gt_values.allFinite();
+    if (gt_join != nullptr) {
+      has_gt = gt_join->Lookup(meas_package.timestamp_, &gt_values);
+      if (!has_gt) {
+        gt_values = VectorXd::Constant(4, NAN);
+      }
+    }
+
+    // output the ground truth
+    out << gt_values(0) << "\t";
+    out << gt_values(1) << "\t";
+    out << gt_values(2) << "\t";
+    out << gt_values(3) << "\n";
+
+    // rows without ground truth are left out of the evaluation
+    if (!has_gt) {
+      continue;
+    }
+
+    // convert ukf x vector to cartesian to compare to ground truth
+    float x_estimate_ = ukf.x_(0);
+    float y_estimate_ = ukf.x_(1);
+    float vx_estimate_ = ukf.x_(2) * cos(ukf.x_(3));
+    float vy_estimate_ = ukf.x_(2) * sin(ukf.x_(3));
+
+    result.estimations.push_back(x_estimate_);
+    result.estimations.push_back(y_estimate_);
+    result.estimations.push_back(vx_estimate_);
+    result.estimations.push_back(vy_estimate_);
+
+    // covariance of [px py vx vy], J * P * J^T
+    CTRVModel::KinematicsJacobianMatrix J;
+    CTRVModel::KinematicsJacobian(ukf.x_, &J);
+    const Eigen::Matrix4d P_cartesian = J * ukf.P_ * J.transpose();
+    result.estimation_covariances.insert(result.estimation_covariances.end(),
+                                         P_cartesian.data(), P_cartesian.data() + 16);
+
+    for (int i = 0; i < 4; ++i) {
+      result.ground_truth.push_back(gt_values(i));
+    }
+  }
+
+  return n_step;
+}
+
+/**
+ * Work item of the real-time pipeline: one measurement or a fused
+ * laser/radar pair, and when it was ingested. A count of 0 ends the stream.
+ */
+struct RealTimeItem {
+  size_t row;
+  int count;
+  long long ingest_ns;
+};
+
+/**
+ * Track of the real-time bank, published after every update. written is the
+ * last publication the output thread has written, released_us the newest
+ * measurement time the filter thread has taken out of the reorder window.
+ */
+struct RealTimeTrack : PublishedTrack<UKF, CTRVModel::kStateDim> {
+  explicit RealTimeTrack(const UKF& prototype)
+      : PublishedTrack<UKF, CTRVModel::kStateDim>(prototype),
+        written(0),
+        released_us(numeric_limits<long long>::min()) {}
+
+  atomic<uint64_t> written;
+  long long released_us;
+};
+
+/**
+ * Item held back by the reorder window of the real-time filter thread.
+ */
+struct RealTimePending {
+  long long time_us;
+  size_t sequence;
+  RealTimeItem item;
+  SlotHandle track;
+};
+
+/**
+ * Heap order of the reorder window: oldest first, arrival order among equal
+ * timestamps.
+ */
+bool LaterPending(const RealTimePending& a, const RealTimePending& b) {
+  return a.time_us != b.time_us ? a.time_us > b.time_us : a.sequence > b.sequence;
+}
+
+/**
+ * Notice of one filtered item for the output thread, which reads the state
+ * from the published track. The version is the publication of this update.
+ */
+struct RealTimeRow {
+  long long time_us;
+  long long object_id;
+  RealTimeTrack* track;
+  uint64_t version;
+  int count;
+};
+
+long long NowNs() {
+  return chrono::duration_cast<chrono::nanoseconds>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Busy-waits until done() holds, so a stage on its own CPU reacts within
+ * microseconds. Long waits back off to yielding and then to short sleeps,
+ * which lets stages sharing a CPU, or SCHED_FIFO stages above a spinning
+ * one, make progress.
+ */
+template <typename F>
+void SpinUntil(F done) {
+  for (int spins = 0; !done(); ++spins) {
+    if (spins >= 1024) {
+      this_thread::sleep_for(chrono::microseconds(20));
+    } else if (spins >= 64) {
+      this_thread::yield();
+    }
+  }
+}
+
+/**
+ * Startup of a pipeline thread: CPU, scheduling policy and stack.
+ */
+void StartPipelineThread(const RealTimeConfig& config, int cpu, vector<string>* errors_out) {
+  string error;
+  if (!RealTime::PinCurrentThread(cpu, &error)) {
+    errors_out->push_back(error);
+  }
+  if (!RealTime::SetCurrentThreadFifo(config.fifo_priority, &error)) {
+    errors_out->push_back(error);
+  }
+  RealTime::PrefaultStack(config.prefault_stack_bytes);
+}
+
+/**
+ * Difference of two counter readings.
+ */
+RealTimeThreadStats StatsSince(const RealTimeThreadStats& start, const RealTimeThreadStats& end) {
+  RealTimeThreadStats stats;
+  stats.allocations = end.allocations < 0 ? -1 : end.allocations - start.allocations;
+  stats.minor_faults = end.minor_faults - start.minor_faults;
+  stats.major_faults = end.major_faults - start.major_faults;
+  return stats;
+}
+
+/**
+ * q-quantile of the values, reorders them.
+ */
+long long Quantile(vector<long long>* values, double q) {
+  if (values->empty()) {
+    return 0;
+  }
+  const size_t rank = ceil(q * values->size());
+  const size_t k = rank == 0 ? 0 : min(rank, values->size()) - 1;
+  nth_element(values->begin(), values->begin() + k, values->end());
+  return (*values)[k];
+}
+
+}  // namespace
+
+void Replay::ReplayObject(const vector<LogRecord>& records, const vector<size_t>& rows,
+                          bool with_object_id, GroundTruthJoin* gt_join,
+                          ObjectReplay* result_out) {
+
+  // Create a UKF instance
+  UKF ukf;
+
+  ostringstream out;
+  const size_t number_of_measurements = rows.size();
+  for (size_t k = 0; k < number_of_measurements;) {
+    k += FilterStep(records, rows, k, number_of_measurements, with_object_id, gt_join, false,
+                    &ukf, out, result_out);
+  }
+
+  result_out->output = out.str();
+}
+
+void Replay::ReplayObjects(const vector<LogRecord>& records,
+                           const vector<vector<size_t> >& object_rows,
+                           bool with_object_id, int num_threads,
+                           vector<ObjectReplay>* results_out) {
+
+  results_out->clear();
+  results_out->resize(object_rows.size());
+
+  // objects are independent, each task filters one object into its own slot
+  ParallelFor(object_rows.size(), num_threads, [&](size_t i) {
+    ReplayObject(records, object_rows[i], with_object_id, nullptr, &(*results_out)[i]);
+  });
+}
+
+void Replay::ReplayFrames(const vector<LogRecord>& records,
+                          const vector<vector<size_t> >& object_rows,
+                          bool with_object_id, int num_threads, OverloadPolicy* overload,
+                          TrackSnapshots<CTRVModel::kStateDim>* snapshots,
+                          vector<ObjectReplay>* results_out) {
+
+  const size_t n_objects = object_rows.size();
+  results_out->clear();
+  results_out->resize(n_objects);
+  if (overload != nullptr) {
+    overload->Reset(n_objects);
+  }
+
+  // association: every measurement belongs to the track of its object
+  vector<size_t> record_object(records.size());
+  for (size_t i = 0; i < n_objects; ++i) {
+    for (size_t k = 0; k < object_rows[i].size(); ++k) {
+      record_object[object_rows[i][k]] = i;
+    }
+  }
+
+  // frames are the runs of equal timestamps, measurements of a frame stay in
+  // log order
+  vector<size_t> order(records.size());
+  iota(order.begin(), order.end(), 0);
+  stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return records[a].measurement.timestamp_ < records[b].measurement.timestamp_;
+  });
+
+  // the track bank, a track is created when its object first appears
+  SlotMap<UKF> tracks;
+  vector<SlotHandle> object_tracks(n_objects);
+  vector<ostringstream> outputs(n_objects);
+
+  // the objects of the current frame, their tracks and measurements
+  vector<size_t> frame_objects;
+  vector<UKF*> frame_tracks;
+  vector<vector<size_t> > frame_rows(n_objects);
+  vector<UKF::Workspace> workspaces;
+
+  // update order and shed updates of the frame, for the overload policy
+  vector<size_t> update_order;
+  vector<char> frame_shed;
+  vector<size_t> frame_measurements;
+
+  for (size_t begin = 0; begin < order.size();) {
+    const long long timestamp = records[order[begin]].measurement.timestamp_;
+    if (overload != nullptr) {
+      overload->BeginFrame();
+    }
+
+    frame_objects.clear();
+    frame_tracks.clear();
+    size_t end = begin;
+    for (; end < order.size() && records[order[end]].measurement.timestamp_ == timestamp; ++end) {
+      const size_t object = record_object[order[end]];
+      if (frame_rows[object].empty()) {
+        if (!tracks.Contains(object_tracks[object])) {
+          object_tracks[object] = tracks.Emplace();
+        }
+        frame_objects.push_back(object);
+        frame_tracks.push_back(tracks.Get(object_tracks[object]));
+      }
+      frame_rows[object].push_back(order[end]);
+    }
+
+    const int frame_threads =
+        frame_tracks.size() < kParallelFrameTracks ? 1 : num_threads;
+
+    // first pass: predict every track of the frame to the frame time, one
+    // kernel call per block of tracks
+    const size_t n_blocks = (frame_tracks.size() + kFrameBlock - 1) / kFrameBlock;
+    if (workspaces.size() < n_blocks) {
+      workspaces.resize(n_blocks);
+    }
+    ParallelFor(n_blocks, frame_threads, [&](size_t b) {
+      UKF::PredictFrame(frame_tracks, b * kFrameBlock,
+                        min((b + 1) * kFrameBlock, frame_tracks.size()), timestamp,
+                        &workspaces[b]);
+    });
+
+    // second pass: the updates, the tracks are already at the frame time so
+    // no measurement predicts again. Under overload the tracks are updated
+    // most urgent first, the ones past the budget keep their prediction.
+    update_order.resize(frame_objects.size());
+    iota(update_order.begin(), update_order.end(), 0);
+    if (overload != nullptr) {
+      overload->Order(frame_objects, frame_tracks, &update_order);
+    }
+    frame_shed.assign(frame_objects.size(), 0);
+    atomic<long long> update_ns(0);
+    ParallelFor(frame_objects.size(), frame_threads, [&](size_t j) {
+      const size_t i = update_order[j];
+      const size_t object = frame_objects[i];
+      const vector<size_t>& rows = frame_rows[object];
+      const bool shed = overload != nullptr && !overload->Admit(object, *frame_tracks[i]);
+      const long long start_ns = overload != nullptr && !shed ? NowNs() : 0;
+      for (size_t k = 0; k < rows.size();) {
+        k += FilterStep(records, rows, k, rows.size(), with_object_id, nullptr, shed,
+                        frame_tracks[i], outputs[object], &(*results_out)[object]);
+      }
+      if (shed) {
+        frame_shed[i] = 1;
+      } else if (overload != nullptr) {
+        update_ns += NowNs() - start_ns;
+      }
+    });
+
+    frame_measurements.resize(frame_objects.size());
+    for (size_t i = 0; i < frame_objects.size(); ++i) {
+      frame_measurements[i] = frame_rows[frame_objects[i]].size();
+      frame_rows[frame_objects[i]].clear();
+    }
+    if (overload != nullptr) {
+      overload->EndFrame(frame_objects, frame_shed, frame_measurements, update_ns);
+    }
+    if (snapshots != nullptr) {
+      snapshots->Publish(tracks, timestamp);
+    }
+    begin = end;
+  }
+
+  for (size_t i = 0; i < n_objects; ++i) {
+    (*results_out)[i].output = outputs[i].str();
+  }
+}
+
+size_t Replay::ReplayMHT(const vector<LogRecord>& records, MHTTracker* tracker,
+                         ostream& out) {
+
+  out << "time_stamp" << "\t";
+  out << "track_id" << "\t";
+  out << "px_state" << "\t";
+  out << "py_state" << "\t";
+  out << "v_state" << "\t";
+  out << "yaw_angle_state" << "\t";
+  out << "yaw_rate_state" << "\t";
+  out << "score" << "\n";
+
+  // scans in time order, measurements of a scan stay in log order
+  vector<size_t> order(records.size());
+  iota(order.begin(), order.end(), 0);
+  stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return records[a].measurement.timestamp_ < records[b].measurement.timestamp_;
+  });
+
+  vector<MeasurementPackage> scan;
+  vector<MHTTrack> tracks;
+  set<long long> confirmed;
+  for (size_t begin = 0; begin < order.size();) {
+    const MeasurementPackage& first = records[order[begin]].measurement;
+    scan.clear();
+
+    // the sensors of a frame are separate sweeps
+    size_t end = begin;
+    for (; end < order.size(); ++end) {
+      const MeasurementPackage& meas = records[order[end]].measurement;
+      if (meas.timestamp_ != first.timestamp_ || meas.sensor_type_ != first.sensor_type_) {
+        break;
+      }
+      scan.push_back(meas);
+    }
+    tracker->ProcessScan(scan);
+
+    tracker->BestTracks(&tracks, true);
+    for (size_t t = 0; t < tracks.size(); ++t) {
+      const MHTTrack& track = tracks[t];
+      out << first.timestamp_ << "\t";
+      out << track.track_id << "\t";
+      for (int i = 0; i < CTRVModel::kStateDim; ++i) {
+        out << track.state.x[i] << "\t";
+      }
+      out << track.score << "\n";
+      confirmed.insert(track.track_id);
+    }
+    begin = end;
+  }
+
+  return confirmed.size();
+}
+
+void Replay::ReplayRealTime(const vector<LogRecord>& records, const RealTimeConfig& config,
+                            ostream& out, RealTimeReport* report_out) {
+
+  RealTimeReport& report = *report_out;
+  report.warnings.clear();
+
+  /**********************************************
+   *  Startup: memory and buffers               *
+   **********************************************/
+
+  string error;
+  if (config.lock_memory && !RealTime::LockMemory(&error)) {
+    report.warnings.push_back(error);
+  }
+  RealTime::PrefaultHeap(config.prefault_heap_bytes);
+
+  // everything the loop touches is allocated before it starts
+  const UKF prototype;
+  SlotMap<RealTimeTrack> tracks;
+  tracks.Reserve(config.max_tracks);
+  MpscQueue<RealTimeItem> ingest_queue(config.queue_capacity, config.ingest_wait);
+  vector<RealTimeItem> ingest_batch(max((size_t) 1, config.ingest_batch));
+  vector<RealTimePending> pending;
+  pending.reserve(max((size_t) 1, config.queue_capacity));
+  SpscRing<RealTimeRow> output_queue(config.queue_capacity);
+  vector<long long> latencies(records.size(), 0);
+  vector<long long> service_times(records.size(), 0);
+
+  // association by object ID: the log is known up front, so every object
+  // gets its track here and the filter thread only looks up its row
+  vector<SlotHandle> track_of_row(records.size());
+  {
+    unordered_map<long long, SlotHandle> track_of;
+    for (size_t row = 0; row < records.size(); ++row) {
+      const long long object_id = records[row].measurement.object_id_;
+      unordered_map<long long, SlotHandle>::iterator found = track_of.find(object_id);
+      if (found == track_of.end()) {
+        found = track_of.insert(make_pair(object_id, tracks.Emplace(prototype))).first;
+      }
+      track_of_row[row] = found->second;
+    }
+  }
+
+  out << "time_stamp" << "\t";
+  out << "object_id" << "\t";
+  out << "px_state" << "\t";
+  out << "py_state" << "\t";
+  out << "v_state" << "\t";
+  out << "yaw_angle_state" << "\t";
+  out << "yaw_rate_state" << "\n";
+
+  // the ingest threads: one for the log, or one per sensor
+  const int n_drivers = config.ingest_per_sensor ? 2 : 1;
+  const MeasurementPackage::SensorType driver_sensors[2] = {MeasurementPackage::LASER,
+                                                            MeasurementPackage::RADAR};
+
+  // counters of each thread after the warm-up and at its end
+  enum { kFilter, kOutput, kIngest, kThreads = kIngest + 2 };
+  RealTimeThreadStats warm[kThreads];
+  RealTimeThreadStats done[kThreads];
+  vector<string> thread_errors[kThreads];
+  size_t n_updates = 0;
+  size_t n_late = 0;
+
+  /**********************************************
+   *  Ingest                                    *
+   **********************************************/
+
+  // the common clock of the paced ingest threads, started once they had
+  // time to set up
+  const long long log_start = records.empty() ? 0 : records[0].measurement.timestamp_;
+  const long long start_ns = NowNs() + (config.pace > 0 ? kIngestStartupNs : 0);
+
+  auto driver = [&](int d) {
+    StartPipelineThread(config, config.ingest_cpu, &thread_errors[kIngest + d]);
+    warm[kIngest + d] = RealTime::ThreadStats();
+
+    size_t n_items = 0;
+    for (size_t row = 0; row < records.size();) {
+      const MeasurementPackage& meas = records[row].measurement;
+      if (n_drivers > 1 && meas.sensor_type_ != driver_sensors[d]) {
+        ++row;
+        continue;
+      }
+      RealTimeItem item = {row, 1, 0};
+
+      // a laser/radar pair of the same object sharing its timestamp
+      if (n_drivers == 1 && prototype.use_fused_update_ && row + 1 < records.size()) {
+        const MeasurementPackage& next = records[row + 1].measurement;
+        if (next.object_id_ == meas.object_id_ && next.sensor_type_ != meas.sensor_type_ &&
+            fabs(next.timestamp_ - meas.timestamp_) / 1000000.0 < prototype.fusion_dt_threshold_) {
+          item.count = 2;
+        }
+      }
+
+      // sleep through most of the gap to the next measurement, spin the rest
+      if (config.pace > 0) {
+        const long long due_ns = start_ns + (meas.timestamp_ - log_start) * 1000 / config.pace;
+        const long long sleep_ns = due_ns - NowNs() - 200000;
+        if (sleep_ns > 0) {
+          this_thread::sleep_for(chrono::nanoseconds(sleep_ns));
+        }
+        SpinUntil([&]() { return NowNs() >= due_ns; });
+      }
+
+      // a paced sensor cannot wait for the filter, its measurement is
+      // dropped on a full queue; an unpaced replay waits instead
+      item.ingest_ns = NowNs();
+      if (config.pace > 0) {
+        ingest_queue.TryPush(item);
+      } else {
+        ingest_queue.Push(item);
+      }
+      row += item.count;
+
+      if (++n_items == config.warmup_updates) {
+        warm[kIngest + d] = RealTime::ThreadStats();
+      }
+    }
+
+    const RealTimeItem end_item = {0, 0, 0};
+    ingest_queue.Push(end_item);
+    done[kIngest + d] = RealTime::ThreadStats();
+  };
+
+  vector<thread> ingest;
+  for (int d = 0; d < n_drivers; ++d) {
+    ingest.push_back(thread(driver, d));
+  }
+
+  /**********************************************
+   *  Filter                                    *
+   **********************************************/
+
+  thread filter([&]() {
+    StartPipelineThread(config, config.filter_cpu, &thread_errors[kFilter]);
+    warm[kFilter] = RealTime::ThreadStats();
+
+    // separate sensor drivers deliver out of time order, a reorder window
+    // restores it; a single ingest thread keeps the log order
+    const long long window = n_drivers > 1 ? config.reorder_window_us : 0;
+    long long newest = numeric_limits<long long>::min();
+    size_t sequence = 0;
+
+    RealTimeRow row;
+    auto update = [&](const RealTimePending& next_item) {
+      const RealTimeItem& item = next_item.item;
+      const MeasurementPackage& meas = records[item.row].measurement;
+      RealTimeTrack& track = *tracks.Get(next_item.track);
+      UKF& ukf = track.filter;
+
+      // the last publication of the track must be written before it is
+      // replaced
+      SpinUntil([&]() {
+        return track.written.load(memory_order_acquire) == track.published.version();
+      });
+      const long long begin_ns = NowNs();
+
+      row.time_us = meas.timestamp_;
+      if (item.count == 2) {
+        const MeasurementPackage& next = records[item.row + 1].measurement;
+        const bool laser_first = meas.sensor_type_ == MeasurementPackage::LASER;
+        ukf.ProcessFusedMeasurement(laser_first ? meas : next, laser_first ? next : meas);
+        row.time_us = max(row.time_us, next.timestamp_);
+      } else {
+        ukf.ProcessMeasurement(meas);
+      }
+      track.released_us = max(track.released_us, row.time_us);
+
+      track.published.Publish(ukf, next_item.track);
+      row.object_id = meas.object_id_;
+      row.track = &track;
+      row.version = track.published.version();
+      row.count = item.count;
+
+      const long long end_ns = NowNs();
+      service_times[n_updates] = end_ns - begin_ns;
+      latencies[n_updates] = end_ns - item.ingest_ns;
+      SpinUntil([&]() { return output_queue.TryPush(row); });
+
+      if (++n_updates == config.warmup_updates) {
+        warm[kFilter] = RealTime::ThreadStats();
+      }
+    };
+    auto release_oldest = [&]() {
+      pop_heap(pending.begin(), pending.end(), LaterPending);
+      update(pending.back());
+      pending.pop_back();
+    };
+
+    for (int n_running = n_drivers; n_running > 0;) {
+      const size_t n_items = ingest_queue.PopBatch(ingest_batch.data(), ingest_batch.size());
+      for (size_t b = 0; b < n_items; ++b) {
+        const RealTimeItem& item = ingest_batch[b];
+        if (item.count == 0) {
+          --n_running;
+          continue;
+        }
+        const MeasurementPackage& meas = records[item.row].measurement;
+        const SlotHandle track = track_of_row[item.row];
+
+        // the track has already been updated past this measurement
+        if (meas.timestamp_ < tracks.Get(track)->released_us) {
+          ++n_late;
+          continue;
+        }
+        newest = max(newest, meas.timestamp_);
+
+        // a full window releases its oldest item early
+        if (pending.size() == pending.capacity()) {
+          release_oldest();
+        }
+        const RealTimePending held = {meas.timestamp_, sequence++, item, track};
+        pending.push_back(held);
+        push_heap(pending.begin(), pending.end(), LaterPending);
+
+        // release what the window has passed
+        while (!pending.empty() && pending.front().time_us <= newest - window) {
+          release_oldest();
+        }
+      }
+    }
+    while (!pending.empty()) {
+      release_oldest();
+    }
+
+    row.count = 0;
+    SpinUntil([&]() { return output_queue.TryPush(row); });
+    done[kFilter] = RealTime::ThreadStats();
+  });
+
+  /**********************************************
+   *  Output                                    *
+   **********************************************/
+
+  thread output([&]() {
+    StartPipelineThread(config, config.output_cpu, &thread_errors[kOutput]);
+    warm[kOutput] = RealTime::ThreadStats();
+
+    // formatted into a fixed buffer, the stream only copies it
+    char line[512];
+    RealTimeRow row;
+    TrackRecord<CTRVModel::kStateDim> record;
+    size_t n_rows = 0;
+    for (;;) {
+      SpinUntil([&]() { return output_queue.TryPop(&row); });
+      if (row.count == 0) {
+        break;
+      }
+
+      // the filter thread leaves the track alone until the row is written
+      row.track->published.Read(&record);
+      row.track->written.store(row.version, memory_order_release);
+      const double* x = record.state.x;
+      const int length = snprintf(line, sizeof(line), "%lld\t%lld\t%g\t%g\t%g\t%g\t%g\n",
+                                  row.time_us, row.object_id, x[0], x[1], x[2], x[3], x[4]);
+      out.write(line, length);
+
+      if (++n_rows == config.warmup_updates) {
+        warm[kOutput] = RealTime::ThreadStats();
+      }
+    }
+    done[kOutput] = RealTime::ThreadStats();
+  });
+
+  for (int d = 0; d < n_drivers; ++d) {
+    ingest[d].join();
+  }
+  filter.join();
+  output.join();
+
+  /**********************************************
+   *  Report                                    *
+   **********************************************/
+
+  for (int i = 0; i < kIngest + n_drivers; ++i) {
+    report.warnings.insert(report.warnings.end(), thread_errors[i].begin(), thread_errors[i].end());
+  }
+  report.ingest = StatsSince(warm[kIngest], done[kIngest]);
+  for (int d = 1; d < n_drivers; ++d) {
+    const RealTimeThreadStats driver_stats = StatsSince(warm[kIngest + d], done[kIngest + d]);
+    if (report.ingest.allocations >= 0) {
+      report.ingest.allocations += driver_stats.allocations;
+    }
+    report.ingest.minor_faults += driver_stats.minor_faults;
+    report.ingest.major_faults += driver_stats.major_faults;
+  }
+  report.ingest_drops = ingest_queue.dropped();
+  report.late_drops = n_late;
+  report.ingest_high_water = ingest_queue.high_water();
+  report.filter = StatsSince(warm[kFilter], done[kFilter]);
+  report.output = StatsSince(warm[kOutput], done[kOutput]);
+
+  report.updates = n_updates;
+  latencies.resize(n_updates);
+  service_times.resize(n_updates);
+  report.latency_p50 = Quantile(&latencies, 0.5);
+  report.latency_p99 = Quantile(&latencies, 0.99);
+  report.latency_p999 = Quantile(&latencies, 0.999);
+  report.latency_max = Quantile(&latencies, 1.0);
+  report.service_p50 = Quantile(&service_times, 0.5);
+  report.service_p99 = Quantile(&service_times, 0.99);
+  report.service_max = Quantile(&service_times, 1.0);
+}
@@ -0,0 +1,142 @@
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "object_log.h"
+#include "ground_truth_join.h"
+#include "mht_tracker.h"
+#include "overload_policy.h"
+#include "realtime.h"
+#include "track_snapshot.h"
+
+/**
+* Output rows and evaluation data of one replayed object.
+*/
+struct ObjectReplay {
+  ///* formatted output rows, see Replay::WriteHeader
+  std::string output;
+
+  ///* [px py vx vy] per row with ground truth, its covariance (column-major)
+  ///* and the ground truth, for Evaluation
+  std::vector<double> estimations;
+  std::vector<double> estimation_covariances;
+  std::vector<double> ground_truth;
+
+  ///* NIS of every lidar and radar row
+  std::vector<double> nis_laser;
+  std::vector<double> nis_radar;
+};
+
+/**
+* Replays logged measurements through one UKF per object.
+*/
+class Replay {
+public:
+
+  /**
+  * Writes the column names of the output rows.
+  * @param out The output
+  * @param with_object_id Rows start with the object ID
+  */
+  static void WriteHeader(std::ostream& out, bool with_object_id);
+
+  /**
+  * Filters the records of one object in log order.
+  * @param records All records of the log
+  * @param rows The record indices of the object
+  * @param with_object_id Rows start with the object ID
+  * @param gt_join Separate ground truth for the object, nullptr to use the
+  * ground truth of the records
+  * @param result_out Output rows and evaluation data
+  */
+  static void ReplayObject(const std::vector<LogRecord>& records,
+                           const std::vector<size_t>& rows, bool with_object_id,
+                           GroundTruthJoin* gt_join, ObjectReplay* result_out);
+
+  /**
+  * Filters every object with its own UKF, objects are spread over a thread
+  * pool. Results are indexed like the objects, so the output order does not
+  * depend on the scheduling.
+  * @param records All records of the log
+  * @param object_rows The record indices of each object, see
+  * ObjectLog::Partition
+  * @param with_object_id Rows start with the object ID
+  * @param num_threads Worker threads, 0 for one per core
+  * @param results_out One result per object
+  */
+  static void ReplayObjects(const std::vector<LogRecord>& records,
+                            const std::vector<std::vector<size_t> >& object_rows,
+                            bool with_object_id, int num_threads,
+                            std::vector<ObjectReplay>* results_out);
+
+  /**
+  * Frame-synchronous replay of a track bank: the log is cut into frames of
+  * measurements sharing a timestamp. Every track with a measurement in the
+  * frame is first predicted to the frame time in batched kernel calls, then
+  * all updates run in a second pass. Measurements are associated with the
+  * track of their object ID. Gives the same results as ReplayObjects as long
+  * as the timestamps of each object increase and laser/radar pairs to be
+  * fused share their timestamp exactly.
+  * @param records All records of the log
+  * @param object_rows The record indices of each object, see
+  * ObjectLog::Partition
+  * @param with_object_id Rows start with the object ID
+  * @param num_threads Worker threads for large frames, 0 for one per core
+  * @param overload Frame budget and load shedding, nullptr to update every
+  * track in every frame; shed rows have no NIS
+  * @param snapshots The track bank is published here after every frame,
+  * for readers on other threads; nullptr to not publish
+  * @param results_out One result per object
+  */
+  static void ReplayFrames(const std::vector<LogRecord>& records,
+                           const std::vector<std::vector<size_t> >& object_rows,
+                           bool with_object_id, int num_threads, OverloadPolicy* overload,
+                           TrackSnapshots<CTRVModel::kStateDim>* snapshots,
+                           std::vector<ObjectReplay>* results_out);
+
+  /**
+  * Tracks the log with a multi-hypothesis tracker, ignoring the object IDs.
+  * Every run of measurements with the same timestamp and sensor is one scan;
+  * after each scan the confirmed tracks of the best hypothesis are written as
+  *   time_stamp track_id px py v yaw yawd score
+  * @param records All records of the log
+  * @param tracker The tracker
+  * @param out The output
+  * @return Number of distinct confirmed tracks
+  */
+  static size_t ReplayMHT(const std::vector<LogRecord>& records, MHTTracker* tracker,
+                          std::ostream& out);
+
+  /**
+  * Runs the log through a three stage real-time pipeline: ingest threads
+  * feed the measurements (paced by their timestamps or as fast as
+  * possible), a filter thread keeps one UKF per object ID and publishes
+  * each track through a seqlock after every update, and an output thread
+  * writes one row per update from the published state,
+  *   time_stamp object_id px py v yaw yawd
+  * A track is only updated again once the output thread has written the
+  * row of its last publication.
+  * There is one ingest thread for the log, or one per sensor like separate
+  * sensor drivers; they share a lock-free multi-producer queue that the
+  * filter thread drains in batches, and a paced ingest thread drops its
+  * measurement when the queue is full. The filter thread holds separate
+  * sensor streams back in a reorder window (see
+  * RealTimeConfig::reorder_window_us) and drops measurements that arrive
+  * after their track was updated past them. Memory is locked and prefaulted,
+  * tracks and queues are allocated before the threads start, and each
+  * thread is pinned and scheduled as configured. With a single ingest
+  * thread a laser/radar pair of one object is fused if the two are adjacent
+  * in the log.
+  * @param records All records of the log
+  * @param config Real-time settings
+  * @param out The output
+  * @param report_out Latencies, self-check and settings that failed
+  */
+  static void ReplayRealTime(const std::vector<LogRecord>& records,
+                             const RealTimeConfig& config, std::ostream& out,
+                             RealTimeReport* report_out);
+};
+
+#endif /* REPLAY_H_ */
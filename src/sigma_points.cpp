@@ -0,0 +1,57 @@
+#include <cmath>
+#include "sigma_points.h"
+
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+
+void UnscentedRule::Generate(int n, MatrixXd* U_out, VectorXd* weights_out) {
+
+  //define spreading parameter
+  const double lambda = 3 - n;
+  const double spread = std::sqrt(lambda + n);
+
+  //centre, then +- the scaled axes
+  MatrixXd& U = *U_out;
+  U.setZero(n, 2 * n + 1);
+  U.block(0, 1, n, n).diagonal().setConstant(spread);
+  U.block(0, n + 1, n, n).diagonal().setConstant(-spread);
+
+  // set weights
+  VectorXd& weights = *weights_out;
+  weights.setConstant(2 * n + 1, 0.5 / (lambda + n));
+  weights(0) = lambda / (lambda + n);
+}
+
+void CubatureRule::Generate(int n, MatrixXd* U_out, VectorXd* weights_out) {
+
+  const double spread = std::sqrt(static_cast<double>(n));
+
+  MatrixXd& U = *U_out;
+  U.setZero(n, 2 * n);
+  U.leftCols(n).diagonal().setConstant(spread);
+  U.rightCols(n).diagonal().setConstant(-spread);
+
+  weights_out->setConstant(2 * n, 0.5 / n);
+}
+
+void SimplexRule::Generate(int n, MatrixXd* U_out, VectorXd* weights_out) {
+
+  //equal weights for the centre and the n+1 simplex points
+  const double w = 1.0 / (n + 2);
+
+  //column 0 is the centre, columns 1..n+1 the simplex vertices, built one
+  //dimension at a time
+  MatrixXd& U = *U_out;
+  U.setZero(n, n + 2);
+  U(0, 1) = -1.0 / std::sqrt(2.0 * w);
+  U(0, 2) = 1.0 / std::sqrt(2.0 * w);
+  for (int j = 2; j <= n; ++j) {
+    const double scale = 1.0 / std::sqrt(j * (j + 1) * w);
+    for (int i = 1; i <= j; ++i) {
+      U(j - 1, i) = -scale;
+    }
+    U(j - 1, j + 1) = j * scale;
+  }
+
+  weights_out->setConstant(n + 2, w);
+}
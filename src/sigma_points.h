@@ -0,0 +1,42 @@
+#ifndef SIGMA_POINTS_H_
+#define SIGMA_POINTS_H_
+
+#include "Eigen/Dense"
+
+/**
+* Sigma point rules. Each rule defines unit sigma points U (n x m) and
+* weights w with sum_i w_i U_i = 0 and sum_i w_i U_i U_i^T = I, so the sigma
+* points of a Gaussian N(x, L*L^T) are x + L*U.
+*
+* The rule is a template argument of the filter (see ModelUKF), so Count is
+* a compile-time constant and the sigma point matrices have a fixed size.
+*/
+
+/**
+* Scaled unscented transform, 2n+1 points with lambda = 3 - n. The centre
+* weight lambda / (lambda + n) is negative for n > 3.
+*/
+struct UnscentedRule {
+  static constexpr int Count(int n) { return 2 * n + 1; }
+  static void Generate(int n, Eigen::MatrixXd* U_out, Eigen::VectorXd* weights_out);
+};
+
+/**
+* Third-degree spherical-radial cubature rule, 2n points at +-sqrt(n) along
+* the axes, all weights 1/(2n).
+*/
+struct CubatureRule {
+  static constexpr int Count(int n) { return 2 * n; }
+  static void Generate(int n, Eigen::MatrixXd* U_out, Eigen::VectorXd* weights_out);
+};
+
+/**
+* Spherical simplex rule (Julier 2003), n+2 points: the centre plus n+1
+* points on a hypersphere. All weights equal 1/(n+2).
+*/
+struct SimplexRule {
+  static constexpr int Count(int n) { return n + 2; }
+  static void Generate(int n, Eigen::MatrixXd* U_out, Eigen::VectorXd* weights_out);
+};
+
+#endif /* SIGMA_POINTS_H_ */
@@ -0,0 +1,276 @@
+#ifndef SLOT_MAP_H_
+#define SLOT_MAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+* Generation-checked reference to an element of a SlotMap. A handle stays
+* valid until its element is erased; afterwards, even if the slot is reused,
+* lookups with the old handle fail instead of returning the new element.
+*/
+struct SlotHandle {
+  ///* slot index
+  uint32_t index;
+
+  ///* generation of the slot when the element was inserted, 0 is never used
+  uint32_t generation;
+
+  SlotHandle() : index(0), generation(0) {}
+  SlotHandle(uint32_t i, uint32_t g) : index(i), generation(g) {}
+
+  bool operator==(const SlotHandle& other) const {
+    return index == other.index && generation == other.generation;
+  }
+  bool operator!=(const SlotHandle& other) const {
+    return !(*this == other);
+  }
+};
+
+/**
+* Segmented slot map, e.g. for the tracks of a multi-object tracker.
+*
+* Elements live in fixed-size chunks that are allocated as the map grows and
+* never move, so growth copies no element (no Eigen buffers are reallocated
+* when a crowd enters) and pointers and handles stay valid. Insert and erase
+* are O(1): freed slots are reused from a free list, and a dense array of
+* slot indices is kept compact by swapping the last entry into the erased
+* position. Kernels iterate over the dense array, i.e. only over live
+* elements, in chunk order until erasures shuffle it.
+*/
+template <typename T, int kChunkSize = 256>
+class SlotMap {
+public:
+
+  SlotMap() : size_(0) {}
+
+  ~SlotMap() {
+    Clear();
+  }
+
+  /**
+  * Constructs an element in place.
+  * @param args Constructor arguments of T
+  * @return The handle of the new element
+  */
+  template <typename... Args>
+  SlotHandle Emplace(Args&&... args) {
+    uint32_t index;
+    if (!free_.empty()) {
+      index = free_.back();
+      free_.pop_back();
+    } else {
+      //the next unused slot, in a new chunk if the last one is full
+      if (chunks_.empty() || chunks_.back()->used == kChunkSize) {
+        chunks_.push_back(std::unique_ptr<Chunk>(new Chunk()));
+      }
+      index = (chunks_.size() - 1) * kChunkSize + chunks_.back()->used++;
+    }
+
+    Chunk& chunk = *chunks_[index / kChunkSize];
+    const int offset = index % kChunkSize;
+    new (&chunk.storage[offset]) T(std::forward<Args>(args)...);
+    chunk.dense_position[offset] = dense_.size();
+    dense_.push_back(index);
+    ++size_;
+    return SlotHandle(index, chunk.generation[offset]);
+  }
+
+  /**
+  * Copies an element into the map.
+  * @param value The element
+  * @return The handle of the new element
+  */
+  SlotHandle Insert(const T& value) {
+    return Emplace(value);
+  }
+
+  /**
+  * Destroys an element and frees its slot.
+  * @param handle The element
+  * @return false if the handle is stale
+  */
+  bool Erase(SlotHandle handle) {
+    if (Get(handle) == nullptr) {
+      return false;
+    }
+
+    Chunk& chunk = *chunks_[handle.index / kChunkSize];
+    const int offset = handle.index % kChunkSize;
+    Element(chunk, offset)->~T();
+
+    //keep the dense array compact
+    const uint32_t position = chunk.dense_position[offset];
+    const uint32_t last = dense_.back();
+    dense_[position] = last;
+    chunks_[last / kChunkSize]->dense_position[last % kChunkSize] = position;
+    dense_.pop_back();
+
+    //invalidate outstanding handles, generation 0 is reserved
+    chunk.dense_position[offset] = kFree;
+    if (++chunk.generation[offset] == 0) {
+      chunk.generation[offset] = 1;
+    }
+    free_.push_back(handle.index);
+    --size_;
+    return true;
+  }
+
+  /**
+  * @param handle The element
+  * @return The element, nullptr if the handle is stale
+  */
+  T* Get(SlotHandle handle) {
+    const uint32_t chunk_index = handle.index / kChunkSize;
+    if (chunk_index >= chunks_.size()) {
+      return nullptr;
+    }
+    Chunk& chunk = *chunks_[chunk_index];
+    const int offset = handle.index % kChunkSize;
+    if (chunk.dense_position[offset] == kFree || chunk.generation[offset] != handle.generation) {
+      return nullptr;
+    }
+    return Element(chunk, offset);
+  }
+
+  const T* Get(SlotHandle handle) const {
+    return const_cast<SlotMap*>(this)->Get(handle);
+  }
+
+  /**
+  * @param handle The element
+  * @return true if the handle refers to a live element
+  */
+  bool Contains(SlotHandle handle) const {
+    return Get(handle) != nullptr;
+  }
+
+  /**
+  * Number of live elements, also the length of the dense iteration range.
+  */
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  /**
+  * Number of slots allocated in chunks.
+  */
+  size_t capacity() const {
+    return chunks_.size() * kChunkSize;
+  }
+
+  /**
+  * Allocates chunks for at least n elements up front, e.g. at the startup of
+  * a real-time loop, so later inserts up to n elements allocate no chunk.
+  * @param n Number of elements
+  */
+  void Reserve(size_t n) {
+    //the unused slots of the last chunk and of the new chunks go to the free
+    //list, so all chunks can be marked as fully used
+    const uint32_t first_unused = chunks_.empty()
+        ? 0 : (chunks_.size() - 1) * kChunkSize + chunks_.back()->used;
+    if (!chunks_.empty()) {
+      chunks_.back()->used = kChunkSize;
+    }
+    while (capacity() < n) {
+      chunks_.push_back(std::unique_ptr<Chunk>(new Chunk()));
+      chunks_.back()->used = kChunkSize;
+    }
+    free_.reserve(capacity());
+    //highest slot first, so inserts take the slots in ascending order across
+    //chunks, as they would without the reserve
+    for (uint32_t index = capacity(); index > first_unused; --index) {
+      free_.push_back(index - 1);
+    }
+    dense_.reserve(n);
+  }
+
+  /**
+  * Dense access, i = 0 .. size()-1 visits every live element once. The order
+  * changes when elements are erased.
+  * @param i Dense position
+  */
+  T& AtDense(size_t i) {
+    const uint32_t index = dense_[i];
+    return *Element(*chunks_[index / kChunkSize], index % kChunkSize);
+  }
+
+  const T& AtDense(size_t i) const {
+    return const_cast<SlotMap*>(this)->AtDense(i);
+  }
+
+  /**
+  * @param i Dense position
+  * @return The handle of the element at dense position i
+  */
+  SlotHandle HandleAtDense(size_t i) const {
+    const uint32_t index = dense_[i];
+    return SlotHandle(index, chunks_[index / kChunkSize]->generation[index % kChunkSize]);
+  }
+
+  /**
+  * Calls f(element) for every live element in dense order.
+  */
+  template <typename F>
+  void ForEach(F f) {
+    for (size_t i = 0; i < dense_.size(); ++i) {
+      f(AtDense(i));
+    }
+  }
+
+  /**
+  * Destroys all elements; the chunks are kept for reuse and all handles
+  * become stale.
+  */
+  void Clear() {
+    while (!dense_.empty()) {
+      Erase(HandleAtDense(dense_.size() - 1));
+    }
+  }
+
+private:
+  SlotMap(const SlotMap&);
+  SlotMap& operator=(const SlotMap&);
+
+  static const uint32_t kFree = 0xffffffffu;
+
+  struct Chunk {
+    Chunk() : used(0) {
+      for (int i = 0; i < kChunkSize; ++i) {
+        generation[i] = 1;
+        dense_position[i] = kFree;
+      }
+    }
+
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage[kChunkSize];
+    uint32_t generation[kChunkSize];
+    uint32_t dense_position[kChunkSize];
+    int used;
+  };
+
+  static T* Element(Chunk& chunk, int offset) {
+    return reinterpret_cast<T*>(&chunk.storage[offset]);
+  }
+
+  ///* chunks in slot order, chunk c holds slots c*kChunkSize ..
+  std::vector<std::unique_ptr<Chunk> > chunks_;
+
+  ///* slot indices of the live elements
+  std::vector<uint32_t> dense_;
+
+  ///* erased slots available for reuse
+  std::vector<uint32_t> free_;
+
+  size_t size_;
+};
+
+#endif /* SLOT_MAP_H_ */
@@ -0,0 +1,92 @@
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+* Bounded lock-free queue between one producer and one consumer thread, e.g.
+* the stages of the real-time pipeline. The buffer is allocated once at
+* construction; pushing and popping never allocate or block, a full or
+* empty ring is reported to the caller instead. The two indices live on
+* separate cache lines, and each side caches the other side's index so it
+* only reads the shared line when the cached value says full or empty.
+*/
+template <typename T>
+class SpscRing {
+public:
+
+  /**
+  * @param capacity Number of elements, rounded up to a power of two
+  */
+  explicit SpscRing(size_t capacity) : head_(0), tail_(0), cached_head_(0), cached_tail_(0) {
+    size_t size = 2;
+    while (size < capacity) {
+      size *= 2;
+    }
+    buffer_.resize(size);
+    mask_ = size - 1;
+  }
+
+  /**
+  * Producer side.
+  * @param value The element
+  * @return false if the ring is full
+  */
+  bool TryPush(const T& value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ > mask_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ > mask_) {
+        return false;
+      }
+    }
+    buffer_[tail & mask_] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+  * Consumer side.
+  * @param value_out The oldest element
+  * @return false if the ring is empty
+  */
+  bool TryPop(T* value_out) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return false;
+      }
+    }
+    *value_out = buffer_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t capacity() const {
+    return buffer_.size();
+  }
+
+private:
+  SpscRing(const SpscRing&);
+  SpscRing& operator=(const SpscRing&);
+
+  std::vector<T> buffer_;
+  size_t mask_;
+
+  ///* next element to pop, written by the consumer
+  alignas(64) std::atomic<size_t> head_;
+
+  ///* next free element, written by the producer
+  alignas(64) std::atomic<size_t> tail_;
+
+  ///* the producer's last read of head_
+  alignas(64) size_t cached_head_;
+
+  ///* the consumer's last read of tail_
+  alignas(64) size_t cached_tail_;
+};
+
+#endif /* SPSC_RING_H_ */
@@ -0,0 +1,47 @@
+#ifndef TEST_CHECK_H_
+#define TEST_CHECK_H_
+
+#include <cmath>
+#include <iostream>
+
+/**
+* Checks of the unit tests in this directory. A failed check prints its
+* location and the test goes on; main returns TestResult(), so ctest sees a
+* non-zero exit code if any check failed.
+*/
+
+static int test_failures = 0;
+
+#define CHECK(condition)                                                     \
+  do {                                                                       \
+    if (!(condition)) {                                                      \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ")"  \
+                << " failed" << std::endl;                                   \
+      ++test_failures;                                                       \
+    }                                                                        \
+  } while (0)
+
+#define CHECK_NEAR(a, b, tolerance)                                          \
+  do {                                                                       \
+    const double check_a = (a);                                              \
+    const double check_b = (b);                                              \
+    if (!(std::fabs(check_a - check_b) <= (tolerance))) {                    \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_NEAR(" #a ", " #b \
+                << ") failed, " << check_a << " vs " << check_b              \
+                << std::endl;                                                \
+      ++test_failures;                                                       \
+    }                                                                        \
+  } while (0)
+
+/**
+* Exit code of a test: 0 if all checks passed.
+*/
+inline int TestResult() {
+  if (test_failures > 0) {
+    std::cerr << test_failures << " checks failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+#endif /* TEST_CHECK_H_ */
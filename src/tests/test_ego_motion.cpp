@@ -0,0 +1,107 @@
+#include <cmath>
+#include <vector>
+#include "test_check.h"
+#include "ego_motion.h"
+
+using namespace std;
+
+namespace {
+
+const long long kStart = 1477010443000000LL;
+
+LogRecord Laser(long long timestamp, double px, double py) {
+  LogRecord record;
+  record.measurement.timestamp_ = timestamp;
+  record.measurement.sensor_type_ = MeasurementPackage::LASER;
+  record.measurement.raw_measurements_ = Eigen::Vector2d(px, py);
+  return record;
+}
+
+LogRecord Radar(long long timestamp, double rho, double phi, double rho_dot) {
+  LogRecord record;
+  record.measurement.timestamp_ = timestamp;
+  record.measurement.sensor_type_ = MeasurementPackage::RADAR;
+  record.measurement.raw_measurements_ = Eigen::Vector3d(rho, phi, rho_dot);
+  return record;
+}
+
+/**
+ * A vehicle at (10, 5) heading north (yaw pi/2), driving north at 10 m/s
+ * and turning left at 1 rad/s, with offset and rotated sensor mounts. The
+ * results are worked out by hand:
+ *  - lidar at (2, 0) facing forward sits at (10, 7) in the world and sees
+ *    (3, 1) at (10 - 1, 7 + 3); its noise axes swap,
+ *  - radar at (0, -1) facing left sits at (11, 5), facing backwards (yaw
+ *    pi); the lever arm adds 1 rad/s * 1 m to its velocity, so it moves at
+ *    (0, 11) m/s, and a bearing of 0.5 becomes 0.5 + pi.
+ */
+void TestRotatingPlatform() {
+  EgoMotion ego;
+  ego.lidar_mount_.x = 2.0;
+  ego.radar_mount_.y = -1.0;
+  ego.radar_mount_.yaw = M_PI / 2;
+  CHECK(ego.AddPose(kStart, 10.0, 5.0, M_PI / 2));
+  CHECK(ego.AddPose(kStart + 100000, 10.0, 6.0, M_PI / 2 + 0.1));
+
+  vector<LogRecord> records;
+  records.push_back(Laser(kStart, 3.0, 1.0));
+  records.back().measurement.noise_covariance_ = Eigen::Vector2d(0.04, 0.01).asDiagonal();
+  records.push_back(Radar(kStart, 5.0, 0.5, -2.0));
+  CHECK(ego.Compensate(&records) == 0);
+  CHECK(records.size() == 2);
+
+  const MeasurementPackage& lidar = records[0].measurement;
+  CHECK_NEAR(lidar.raw_measurements_(0), 9.0, 1e-9);
+  CHECK_NEAR(lidar.raw_measurements_(1), 10.0, 1e-9);
+  CHECK_NEAR(lidar.noise_covariance_(0, 0), 0.01, 1e-9);
+  CHECK_NEAR(lidar.noise_covariance_(1, 1), 0.04, 1e-9);
+  CHECK_NEAR(lidar.noise_covariance_(0, 1), 0.0, 1e-9);
+
+  const MeasurementPackage& radar = records[1].measurement;
+  CHECK_NEAR(radar.raw_measurements_(0), 5.0, 1e-12);
+  CHECK_NEAR(radar.raw_measurements_(1), 0.5 - M_PI, 1e-9);
+  CHECK_NEAR(radar.raw_measurements_(2), -2.0 - 11.0 * sin(0.5), 1e-9);
+  CHECK(radar.sensor_origin_.size() == 2);
+  CHECK_NEAR(radar.sensor_origin_(0), 11.0, 1e-9);
+  CHECK_NEAR(radar.sensor_origin_(1), 5.0, 1e-9);
+}
+
+/**
+ * Records before the first pose, after the last one and inside a gap
+ * longer than max_gap_us_ are removed, the others keep their order; a
+ * record at the last pose is still inside the stream.
+ */
+void TestRecordsWithoutPose() {
+  EgoMotion ego;
+  const long long gap_end = kStart + 100000 + 2 * ego.max_gap_us_;
+  CHECK(ego.AddPose(kStart, 0.0, 0.0, 0.0));
+  CHECK(ego.AddPose(kStart + 100000, 1.0, 0.0, 0.0));
+  CHECK(ego.AddPose(gap_end, 2.0, 0.0, 0.0));
+  CHECK(ego.AddPose(gap_end + 100000, 3.0, 0.0, 0.0));
+  CHECK(!ego.AddPose(kStart, 4.0, 0.0, 0.0));
+  CHECK(ego.size() == 4);
+
+  vector<LogRecord> records;
+  records.push_back(Laser(kStart - 1, 1.0, 0.0));
+  records.push_back(Laser(kStart + 50000, 2.0, 0.0));
+  records.push_back(Laser(kStart + 100000 + ego.max_gap_us_, 3.0, 0.0));
+  records.push_back(Radar(kStart + 99999, 4.0, 0.0, 0.0));
+  records.push_back(Laser(gap_end + 100000, 5.0, 0.0));
+  records.push_back(Laser(gap_end + 100001, 6.0, 0.0));
+  CHECK(ego.Compensate(&records) == 3);
+  CHECK(records.size() == 3);
+
+  // a platform moving along x without rotation only shifts the lidar
+  CHECK(records[0].measurement.timestamp_ == kStart + 50000);
+  CHECK_NEAR(records[0].measurement.raw_measurements_(0), 2.0 + 0.5, 1e-9);
+  CHECK(records[1].measurement.sensor_type_ == MeasurementPackage::RADAR);
+  CHECK_NEAR(records[2].measurement.raw_measurements_(0), 5.0 + 3.0, 1e-9);
+}
+
+}  // namespace
+
+int main() {
+  TestRotatingPlatform();
+  TestRecordsWithoutPose();
+  return TestResult();
+}
@@ -0,0 +1,102 @@
+#include <cmath>
+#include <sstream>
+#include <vector>
+#include "test_check.h"
+#include "ground_truth_join.h"
+
+using namespace std;
+using Eigen::VectorXd;
+
+namespace {
+
+// a dense ground truth log: one sample per ms of a curve, for 10 s
+const long long kStepUs = 1000;
+const int kSamples = 10000;
+
+double Curve(long long t_us) {
+  const double t = t_us / 1e6;
+  return sin(t) + 0.1 * t * t;
+}
+
+string DenseLog() {
+  ostringstream log;
+  log.precision(17);
+  log << "# timestamp value\n";
+  for (int i = 0; i < kSamples; ++i) {
+    log << i * kStepUs << " " << Curve(i * kStepUs) << "\n";
+  }
+  return log.str();
+}
+
+/**
+ * Catmull-Rom interpolation of the dense log with all samples at hand, the
+ * reference for the streaming join.
+ */
+double HermiteReference(long long timestamp) {
+  const int i0 = timestamp / kStepUs;
+  const double u = (timestamp - i0 * kStepUs) / (double) kStepUs;
+  const double p0 = Curve(i0 * kStepUs);
+  const double p1 = Curve((i0 + 1) * kStepUs);
+  const double m0 = i0 > 0 ? (p1 - Curve((i0 - 1) * kStepUs)) / 2 : p1 - p0;
+  const double m1 = i0 + 2 < kSamples ? (Curve((i0 + 2) * kStepUs) - p0) / 2 : p1 - p0;
+  const double u2 = u * u;
+  const double u3 = u2 * u;
+  return (2*u3 - 3*u2 + 1) * p0 + (u3 - 2*u2 + u) * m0 + (-2*u3 + 3*u2) * p1 + (u3 - u2) * m1;
+}
+
+/**
+ * Sparse lookups across the dense log, so long stretches of samples are
+ * read and dropped between two lookups.
+ */
+void TestSparseLookups() {
+  istringstream linear_log(DenseLog());
+  istringstream hermite_log(DenseLog());
+  GroundTruthJoin linear(&linear_log, 1, GroundTruthJoin::LINEAR, 5000);
+  GroundTruthJoin hermite(&hermite_log, 1, GroundTruthJoin::HERMITE, 5000);
+
+  VectorXd gt;
+  for (long long t = 250; t < (kSamples - 1) * kStepUs; t += 777777) {
+    const long long i0 = t / kStepUs;
+    const double u = (t - i0 * kStepUs) / (double) kStepUs;
+    CHECK(linear.Lookup(t, &gt));
+    CHECK_NEAR(gt(0), (1 - u) * Curve(i0 * kStepUs) + u * Curve((i0 + 1) * kStepUs), 1e-12);
+    CHECK(hermite.Lookup(t, &gt));
+    CHECK_NEAR(gt(0), HermiteReference(t), 1e-12);
+  }
+  CHECK(linear.skipped_lines_ == 0);
+
+  // exact hits and the end of the log
+  CHECK(linear.Lookup((kSamples - 1) * kStepUs, &gt));
+  CHECK(gt(0) == Curve((kSamples - 1) * kStepUs));
+  CHECK(!linear.Lookup(kSamples * kStepUs, &gt));
+}
+
+void TestGapsAndBadLines() {
+  istringstream log("1000 1.0\n"
+                    "garbage\n"
+                    "2000 2.0\n"
+                    "1500 9.0\n"
+                    "\n"
+                    "9000 9.0\n"
+                    "10000 10.0\n");
+  GroundTruthJoin join(&log, 1, GroundTruthJoin::LINEAR, 2000);
+
+  VectorXd gt;
+  CHECK(!join.Lookup(500, &gt));
+  CHECK(join.Lookup(1500, &gt));
+  CHECK_NEAR(gt(0), 1.5, 1e-15);
+
+  // 2000 .. 9000 is wider than the allowed gap
+  CHECK(!join.Lookup(5000, &gt));
+  CHECK(join.Lookup(9500, &gt));
+  CHECK_NEAR(gt(0), 9.5, 1e-15);
+  CHECK(join.skipped_lines_ == 2);
+}
+
+}  // namespace
+
+int main() {
+  TestSparseLookups();
+  TestGapsAndBadLines();
+  return TestResult();
+}
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <set>
+#include <vector>
+#include "test_check.h"
+#include "k_best_assignment.h"
+
+using namespace std;
+using Eigen::MatrixXd;
+
+namespace {
+
+const double kInfinity = numeric_limits<double>::infinity();
+
+/**
+ * Costs of all feasible assignments, ascending, by enumerating every
+ * injective map from rows to columns.
+ */
+void AllCosts(const MatrixXd& cost, int row, vector<char>* used, double partial,
+              vector<double>* costs_out) {
+  if (row == cost.rows()) {
+    costs_out->push_back(partial);
+    return;
+  }
+  for (int j = 0; j < cost.cols(); ++j) {
+    if ((*used)[j] || cost(row, j) == kInfinity) {
+      continue;
+    }
+    (*used)[j] = 1;
+    AllCosts(cost, row + 1, used, partial + cost(row, j), costs_out);
+    (*used)[j] = 0;
+  }
+}
+
+/**
+ * Random square and wide cost matrices with some forbidden entries: Solve
+ * returns the k cheapest costs of the brute-force enumeration in order, each
+ * assignment is feasible, sums to its cost and is returned once.
+ */
+void TestAgainstBruteForce() {
+  mt19937 rng(11);
+  uniform_real_distribution<double> uniform(0.0, 10.0);
+  KBestAssignment solver;
+
+  for (int trial = 0; trial < 300; ++trial) {
+    const int n_rows = 1 + rng() % 5;
+    const int n_cols = n_rows + rng() % 3;
+    const double forbidden_share = (trial % 4) * 0.15;
+    MatrixXd cost(n_rows, n_cols);
+    for (int i = 0; i < n_rows; ++i) {
+      for (int j = 0; j < n_cols; ++j) {
+        // integers in half of the trials, so there are ties
+        const double c = trial % 2 ? uniform(rng) : floor(uniform(rng));
+        cost(i, j) = uniform(rng) < 10.0 * forbidden_share ? kInfinity : c;
+      }
+    }
+
+    vector<double> expected;
+    vector<char> used(n_cols, 0);
+    AllCosts(cost, 0, &used, 0.0, &expected);
+    sort(expected.begin(), expected.end());
+
+    const int k = 1 + rng() % 30;
+    vector<int> assignments;
+    vector<double> costs;
+    const int found = solver.Solve(cost, k, &assignments, &costs);
+    CHECK(found == min(k, (int) expected.size()));
+    CHECK((int) costs.size() >= found);
+    CHECK((int) assignments.size() >= found * n_rows);
+
+    set<vector<int> > distinct;
+    for (int a = 0; a < found; ++a) {
+      CHECK_NEAR(costs[a], expected[a], 1e-9);
+      const vector<int> assignment(assignments.begin() + a * n_rows,
+                                   assignments.begin() + (a + 1) * n_rows);
+      vector<char> taken(n_cols, 0);
+      double sum = 0.0;
+      for (int i = 0; i < n_rows; ++i) {
+        const int j = assignment[i];
+        CHECK(j >= 0 && j < n_cols);
+        if (j < 0 || j >= n_cols) {
+          continue;
+        }
+        CHECK(!taken[j]);
+        taken[j] = 1;
+        sum += cost(i, j);
+      }
+      CHECK_NEAR(sum, costs[a], 1e-9);
+      CHECK(distinct.insert(assignment).second);
+    }
+
+    // the best assignment alone
+    vector<int> best;
+    const double best_cost = solver.SolveBest(cost, &best);
+    if (expected.empty()) {
+      CHECK(best_cost == kInfinity);
+    } else {
+      CHECK_NEAR(best_cost, expected[0], 1e-9);
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestAgainstBruteForce();
+  return TestResult();
+}
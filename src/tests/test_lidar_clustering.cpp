@@ -0,0 +1,254 @@
+#include <map>
+#include <random>
+#include <vector>
+#include "test_check.h"
+#include "lidar_clustering.h"
+
+using namespace std;
+
+namespace {
+
+/**
+ * Random sweep: Gaussian blobs of different densities plus uniform clutter.
+ * The blobs touch now and then, so some clusters merge through a chain of
+ * core points.
+ */
+vector<LidarPoint> RandomSweep(mt19937* rng, int n_blobs, int n_clutter, bool flat) {
+  uniform_real_distribution<float> position(-20.0f, 20.0f);
+  uniform_real_distribution<float> height(0.0f, 3.0f);
+  uniform_real_distribution<float> spread(0.1f, 0.6f);
+  uniform_int_distribution<int> blob_size(5, 300);
+  vector<LidarPoint> sweep;
+  for (int b = 0; b < n_blobs; ++b) {
+    const LidarPoint center = {position(*rng), position(*rng), flat ? 0.0f : height(*rng)};
+    normal_distribution<float> offset(0.0f, spread(*rng));
+    const int size = blob_size(*rng);
+    for (int i = 0; i < size; ++i) {
+      const LidarPoint p = {center.x + offset(*rng), center.y + offset(*rng),
+                            flat ? 0.0f : center.z + offset(*rng)};
+      sweep.push_back(p);
+    }
+  }
+  for (int i = 0; i < n_clutter; ++i) {
+    const LidarPoint p = {position(*rng), position(*rng), flat ? 0.0f : height(*rng)};
+    sweep.push_back(p);
+  }
+  shuffle(sweep.begin(), sweep.end(), *rng);
+  return sweep;
+}
+
+/**
+ * Textbook DBSCAN with an O(n^2) neighbor search. The distance is evaluated
+ * in float like in LidarClustering, so points on the radius agree.
+ * @param neighbors_out Points within the radius of each point
+ * @param core_out 1 for core points
+ * @param cluster_out Cluster of each core point, -1 for the others
+ */
+void BruteForceDBSCAN(const vector<LidarPoint>& sweep, const LidarClustering& clustering,
+                      vector<vector<int> >* neighbors_out, vector<char>* core_out,
+                      vector<int>* cluster_out) {
+  const int n = sweep.size();
+  const float eps2 = clustering.cluster_distance_ * clustering.cluster_distance_;
+  const float z_scale = clustering.use_3d_ ? 1.0f : 0.0f;
+  vector<vector<int> >& neighbors = *neighbors_out;
+  neighbors.assign(n, vector<int>());
+  for (int a = 0; a < n; ++a) {
+    for (int b = 0; b < n; ++b) {
+      const float dx = sweep[a].x - sweep[b].x;
+      const float dy = sweep[a].y - sweep[b].y;
+      const float dz = (sweep[a].z - sweep[b].z) * z_scale;
+      if (dx * dx + dy * dy + dz * dz <= eps2) {
+        neighbors[a].push_back(b);
+      }
+    }
+  }
+
+  vector<char>& core = *core_out;
+  core.assign(n, 0);
+  for (int i = 0; i < n; ++i) {
+    core[i] = (int) neighbors[i].size() >= clustering.min_neighbors_;
+  }
+
+  // flood fill over core points
+  vector<int>& cluster = *cluster_out;
+  cluster.assign(n, -1);
+  int n_clusters = 0;
+  for (int seed = 0; seed < n; ++seed) {
+    if (!core[seed] || cluster[seed] >= 0) {
+      continue;
+    }
+    vector<int> stack(1, seed);
+    cluster[seed] = n_clusters;
+    while (!stack.empty()) {
+      const int p = stack.back();
+      stack.pop_back();
+      for (size_t k = 0; k < neighbors[p].size(); ++k) {
+        const int q = neighbors[p][k];
+        if (core[q] && cluster[q] < 0) {
+          cluster[q] = n_clusters;
+          stack.push_back(q);
+        }
+      }
+    }
+    ++n_clusters;
+  }
+}
+
+/**
+ * The labels match brute-force DBSCAN: core points are partitioned the same
+ * way, a border point is in the cluster of one of its core neighbors and
+ * points without a core neighbor are noise. Border points may be reachable
+ * from several clusters, any of them is right.
+ */
+void CheckAgainstBruteForce(const vector<LidarPoint>& sweep, LidarClustering* clustering) {
+  vector<MeasurementPackage> detections;
+  clustering->Process(sweep, 0, &detections);
+  const vector<int>& labels = clustering->labels();
+  CHECK(labels.size() == sweep.size());
+
+  vector<vector<int> > neighbors;
+  vector<char> core;
+  vector<int> cluster;
+  BruteForceDBSCAN(sweep, *clustering, &neighbors, &core, &cluster);
+
+  // core points: a one-to-one map between reference clusters and labels
+  map<int, int> label_of;
+  map<int, int> cluster_of;
+  for (size_t i = 0; i < sweep.size(); ++i) {
+    if (!core[i]) {
+      continue;
+    }
+    CHECK(labels[i] >= 0);
+    if (label_of.count(cluster[i]) == 0) {
+      label_of[cluster[i]] = labels[i];
+    }
+    if (cluster_of.count(labels[i]) == 0) {
+      cluster_of[labels[i]] = cluster[i];
+    }
+    CHECK(label_of[cluster[i]] == labels[i]);
+    CHECK(cluster_of[labels[i]] == cluster[i]);
+  }
+  CHECK(detections.size() == label_of.size());
+
+  // border and noise points
+  for (size_t i = 0; i < sweep.size(); ++i) {
+    if (core[i]) {
+      continue;
+    }
+    bool any_core = false;
+    bool label_reachable = false;
+    for (size_t k = 0; k < neighbors[i].size(); ++k) {
+      const int j = neighbors[i][k];
+      if (core[j]) {
+        any_core = true;
+        label_reachable = label_reachable || labels[j] == labels[i];
+      }
+    }
+    CHECK(any_core == (labels[i] >= 0));
+    CHECK(!any_core || label_reachable);
+  }
+
+  // detections are ordered by the first point of their cluster
+  int next_label = 0;
+  for (size_t i = 0; i < labels.size(); ++i) {
+    if (labels[i] == next_label) {
+      ++next_label;
+    }
+    CHECK(labels[i] < next_label);
+  }
+}
+
+/**
+ * Random 2D and 3D sweeps against brute-force DBSCAN, serial and with
+ * several threads. The sweeps span several parallel blocks.
+ */
+void TestAgainstBruteForce() {
+  mt19937 rng(7);
+  for (int trial = 0; trial < 6; ++trial) {
+    const bool use_3d = trial % 2 == 0;
+    const vector<LidarPoint> sweep = RandomSweep(&rng, 25, 1000, !use_3d);
+
+    LidarClustering clustering;
+    clustering.remove_ground_ = false;
+    clustering.use_3d_ = use_3d;
+    clustering.min_neighbors_ = 2 + trial;
+    clustering.min_cluster_points_ = 1;
+    clustering.num_threads_ = trial < 2 ? 1 : 4;
+    CheckAgainstBruteForce(sweep, &clustering);
+
+    // buffers are reused for a second sweep
+    const vector<LidarPoint> next = RandomSweep(&rng, 10, 200, !use_3d);
+    CheckAgainstBruteForce(next, &clustering);
+  }
+}
+
+/**
+ * Flat ground with two objects: a box standing on the ground and a sign over
+ * a region without ground returns. The ground is removed, both objects are
+ * detected at their centers.
+ */
+void TestGroundRemoval() {
+  mt19937 rng(3);
+  uniform_real_distribution<float> jitter(-0.03f, 0.03f);
+  vector<LidarPoint> sweep;
+  vector<char> is_ground;
+
+  // ground returns for x in [0, 10], y in [-5, 5]
+  for (float x = 0.0f; x <= 10.0f; x += 0.25f) {
+    for (float y = -5.0f; y <= 5.0f; y += 0.25f) {
+      const LidarPoint p = {x, y, jitter(rng)};
+      sweep.push_back(p);
+      is_ground.push_back(1);
+    }
+  }
+  // box around (5, 2), 0.75 to 1.75 m high, clear of the ground
+  for (float x = 4.6f; x <= 5.41f; x += 0.1f) {
+    for (float y = 1.6f; y <= 2.41f; y += 0.1f) {
+      for (float z = 0.75f; z <= 1.76f; z += 0.25f) {
+        const LidarPoint p = {x, y, z};
+        sweep.push_back(p);
+        is_ground.push_back(0);
+      }
+    }
+  }
+  // sign around (-4, 0), 1 to 1.4 m high, no ground below
+  for (float y = -0.5f; y <= 0.51f; y += 0.1f) {
+    for (float z = 1.0f; z <= 1.41f; z += 0.1f) {
+      const LidarPoint p = {-4.0f, y, z};
+      sweep.push_back(p);
+      is_ground.push_back(0);
+    }
+  }
+
+  LidarClustering clustering;
+  clustering.num_threads_ = 2;
+  vector<MeasurementPackage> detections;
+  clustering.Process(sweep, 1000, &detections);
+
+  for (size_t i = 0; i < sweep.size(); ++i) {
+    CHECK((clustering.labels()[i] < 0) == (is_ground[i] != 0));
+  }
+  CHECK(detections.size() == 2);
+  if (detections.size() == 2) {
+    // the box points come first in the sweep
+    CHECK_NEAR(detections[0].raw_measurements_(0), 5.0, 0.05);
+    CHECK_NEAR(detections[0].raw_measurements_(1), 2.0, 0.05);
+    CHECK_NEAR(detections[1].raw_measurements_(0), -4.0, 0.05);
+    CHECK_NEAR(detections[1].raw_measurements_(1), 0.0, 0.05);
+    CHECK(detections[0].timestamp_ == 1000);
+    CHECK(detections[0].sensor_type_ == MeasurementPackage::LASER);
+  }
+
+  // without ground removal the ground is one large cluster
+  clustering.remove_ground_ = false;
+  clustering.Process(sweep, 1000, &detections);
+  CHECK(detections.size() == 3);
+}
+
+}  // namespace
+
+int main() {
+  TestAgainstBruteForce();
+  TestGroundRemoval();
+  return TestResult();
+}
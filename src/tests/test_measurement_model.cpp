@@ -0,0 +1,116 @@
+#include <cmath>
+#include "test_check.h"
+#include "measurement_model.h"
+#include "ukf.h"
+
+using namespace std;
+using Eigen::MatrixXd;
+
+namespace {
+
+/**
+ * Kinematic sigma points of a filter after one laser and one radar update.
+ */
+MatrixXd TrackKinematics(double px, double py, double speed, double yaw) {
+  UKF ukf;
+  MeasurementPackage laser;
+  laser.timestamp_ = 0;
+  laser.sensor_type_ = MeasurementPackage::LASER;
+  laser.raw_measurements_ = Eigen::Vector2d(px, py);
+  ukf.ProcessMeasurement(laser);
+  ukf.x_(2) = speed;
+  ukf.x_(3) = yaw;
+
+  MeasurementPackage radar;
+  radar.timestamp_ = 50000;
+  radar.sensor_type_ = MeasurementPackage::RADAR;
+  radar.raw_measurements_ = Eigen::Vector3d(sqrt(px * px + py * py), atan2(py, px), speed);
+  ukf.ProcessMeasurement(radar);
+
+  CTRVModel::KinematicsSigma<UKF::kSigmaCount> Ksig;
+  CTRVModel::Kinematics(ukf.Xsig_pred_, &Ksig);
+  return Ksig;
+}
+
+/**
+ * Projecting the sigma points of a whole bank in one call gives exactly the
+ * per-track projections, and both match the scalar radar model.
+ */
+void TestBankProjection() {
+  const MatrixXd tracks[3] = {TrackKinematics(5.0, 1.0, 3.0, 0.2),
+                              TrackKinematics(-2.0, 7.5, 1.0, 2.9),
+                              TrackKinematics(-0.5, -30.0, 12.0, -1.7)};
+
+  MatrixXd Ksig_bank(4, 3 * tracks[0].cols());
+  for (int t = 0; t < 3; ++t) {
+    Ksig_bank.middleCols(t * tracks[0].cols(), tracks[t].cols()) = tracks[t];
+  }
+  MatrixXd Zsig_bank;
+  MeasurementModel::Radar(Ksig_bank, &Zsig_bank);
+  CHECK(Zsig_bank.cols() == Ksig_bank.cols());
+
+  for (int t = 0; t < 3; ++t) {
+    MatrixXd Zsig;
+    MeasurementModel::Radar(tracks[t], &Zsig);
+    CHECK(Zsig == Zsig_bank.middleCols(t * tracks[0].cols(), tracks[t].cols()));
+
+    for (int i = 0; i < tracks[t].cols(); ++i) {
+      const double p_x = tracks[t](0, i);
+      const double p_y = tracks[t](1, i);
+      const double rho = sqrt(p_x * p_x + p_y * p_y);
+      CHECK_NEAR(Zsig(0, i), rho, 1e-12);
+      CHECK_NEAR(Zsig(1, i), atan2(p_y, p_x), 1e-7);
+      CHECK_NEAR(Zsig(2, i), (p_x * tracks[t](2, i) + p_y * tracks[t](3, i)) / rho, 1e-12);
+    }
+  }
+}
+
+/**
+ * A point at the radar gives a finite measurement.
+ */
+void TestNearOrigin() {
+  MatrixXd Ksig = MatrixXd::Zero(4, 2);
+  Ksig(2, 0) = 1.0;
+  Ksig(0, 1) = 1e-300;
+  Ksig(3, 1) = -2.0;
+  MatrixXd Zsig;
+  MeasurementModel::Radar(Ksig, &Zsig);
+  CHECK(Zsig.allFinite());
+  CHECK(Zsig(0, 0) == 0.0);
+  CHECK(Zsig(1, 0) == 0.0);
+  CHECK(Zsig(2, 0) == 0.0);
+}
+
+/**
+ * The Jacobian of the linearized update matches finite differences of the
+ * projection.
+ */
+void TestJacobian() {
+  const Eigen::Vector4d k(4.0, -3.0, 1.5, 2.0);
+  MeasurementModel::RadarJacobianMatrix H;
+  MeasurementModel::RadarJacobian(k, &H);
+
+  const double h = 1e-6;
+  MatrixXd z_plus;
+  MatrixXd z_minus;
+  for (int j = 0; j < 4; ++j) {
+    Eigen::Vector4d k_plus = k;
+    Eigen::Vector4d k_minus = k;
+    k_plus(j) += h;
+    k_minus(j) -= h;
+    MeasurementModel::Radar(k_plus, &z_plus);
+    MeasurementModel::Radar(k_minus, &z_minus);
+    for (int i = 0; i < 3; ++i) {
+      CHECK_NEAR(H(i, j), (z_plus(i, 0) - z_minus(i, 0)) / (2 * h), 1e-6);
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestBankProjection();
+  TestNearOrigin();
+  TestJacobian();
+  return TestResult();
+}
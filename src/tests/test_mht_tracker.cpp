@@ -0,0 +1,117 @@
+#include <cmath>
+#include <random>
+#include <vector>
+#include "test_check.h"
+#include "mht_tracker.h"
+
+using namespace std;
+
+namespace {
+
+/**
+ * Two targets on crossing straight lines, seen by a lidar without object IDs
+ * every 100 ms, with missed detections and clutter. Once confirmed, each
+ * track keeps following its own target through the crossing, and the
+ * number of branches stays bounded by the pruning.
+ */
+void TestCrossingTargets() {
+  mt19937 rng(5);
+  normal_distribution<double> noise(0.0, 0.1);
+  uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  MHTTracker tracker;
+  vector<MeasurementPackage> scan;
+  vector<MHTTrack> tracks;
+
+  // both pass (0, 0) at t = 5 s
+  const double start[2][2] = {{-10.0, -3.0}, {-10.0, 3.0}};
+  const double velocity[2][2] = {{2.0, 0.6}, {2.0, -0.6}};
+
+  long long track_of[2] = {-1, -1};
+  size_t max_branches = 0;
+  size_t max_branches_early = 0;
+  const int n_scans = 200;
+  for (int k = 1; k <= n_scans; ++k) {
+    const double t = 0.1 * k;
+    double truth[2][2];
+    scan.clear();
+    for (int target = 0; target < 2; ++target) {
+      truth[target][0] = start[target][0] + velocity[target][0] * t;
+      truth[target][1] = start[target][1] + velocity[target][1] * t;
+      if (k > 10 && uniform(rng) > 0.9) {
+        continue;
+      }
+      MeasurementPackage meas;
+      meas.timestamp_ = k * 100000LL;
+      meas.sensor_type_ = MeasurementPackage::LASER;
+      meas.raw_measurements_ = Eigen::Vector2d(truth[target][0] + noise(rng),
+                                               truth[target][1] + noise(rng));
+      scan.push_back(meas);
+    }
+    // a false alarm in every fifth scan
+    if (k % 5 == 0) {
+      MeasurementPackage meas;
+      meas.timestamp_ = k * 100000LL;
+      meas.sensor_type_ = MeasurementPackage::LASER;
+      meas.raw_measurements_ = Eigen::Vector2d(40.0 * uniform(rng) - 20.0,
+                                               40.0 * uniform(rng) - 20.0);
+      scan.push_back(meas);
+    }
+    tracker.ProcessScan(scan);
+
+    if (k <= 50) {
+      max_branches_early = max(max_branches_early, tracker.branch_count());
+    } else {
+      max_branches = max(max_branches, tracker.branch_count());
+    }
+
+    // tie each target to the confirmed track nearest to it at t = 2 s, the
+    // targets are 4 m apart then
+    tracker.BestTracks(&tracks, true);
+    if (k == 20) {
+      for (int target = 0; target < 2; ++target) {
+        double best = 1.0;
+        for (size_t i = 0; i < tracks.size(); ++i) {
+          const double d = hypot(tracks[i].state.x[0] - truth[target][0],
+                                 tracks[i].state.x[1] - truth[target][1]);
+          if (d < best) {
+            best = d;
+            track_of[target] = tracks[i].track_id;
+          }
+        }
+      }
+      CHECK(track_of[0] >= 0);
+      CHECK(track_of[1] >= 0);
+      CHECK(track_of[0] != track_of[1]);
+    }
+
+    // from then on both tracks exist and follow their targets
+    if (k >= 20) {
+      for (int target = 0; target < 2; ++target) {
+        bool found = false;
+        for (size_t i = 0; i < tracks.size(); ++i) {
+          if (tracks[i].track_id != track_of[target]) {
+            continue;
+          }
+          found = true;
+          CHECK_NEAR(tracks[i].state.x[0], truth[target][0], 1.0);
+          CHECK_NEAR(tracks[i].state.x[1], truth[target][1], 1.0);
+        }
+        CHECK(found);
+      }
+    }
+  }
+
+  // the trees are cut n_scan_ scans back, so steady state holds no more
+  // branches than the warm-up did, and far fewer than one per measurement
+  CHECK(max_branches > 0);
+  CHECK(max_branches <= max(max_branches_early, (size_t) 4 * tracker.max_hypotheses_));
+  CHECK(tracker.hypothesis_count() <= (size_t) tracker.max_hypotheses_);
+}
+
+}  // namespace
+
+int main() {
+  TestCrossingTargets();
+  return TestResult();
+}
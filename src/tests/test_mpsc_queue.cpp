@@ -0,0 +1,201 @@
+#include <thread>
+#include <vector>
+#include "test_check.h"
+#include "mpsc_queue.h"
+
+using namespace std;
+
+namespace {
+
+const int kProducers = 4;
+
+struct Item {
+  int producer;
+  int sequence;
+};
+
+/**
+ * Several producers push concurrently into a small queue, waiting for
+ * space; the consumer must see every element once, each producer's in its
+ * push order. The consumer pops batches larger than the queue, so the
+ * producers refill slots while a batch is still in progress.
+ */
+void TestFifoPerProducer(MpscQueueBase::WaitStrategy wait) {
+  const int n_items = 20000;
+  MpscQueue<Item> queue(16, wait);
+
+  vector<thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.push_back(thread([&queue, p]() {
+      for (int i = 0; i < n_items; ++i) {
+        const Item item = {p, i};
+        queue.Push(item);
+      }
+    }));
+  }
+
+  vector<int> next(kProducers, 0);
+  bool in_order = true;
+  Item batch[64];
+  for (int received = 0; received < kProducers * n_items;) {
+    const size_t n = queue.PopBatch(batch, 64);
+    for (size_t b = 0; b < n; ++b) {
+      in_order = in_order && batch[b].sequence == next[batch[b].producer];
+      ++next[batch[b].producer];
+    }
+    received += n;
+  }
+  for (int p = 0; p < kProducers; ++p) {
+    producers[p].join();
+    CHECK(next[p] == n_items);
+  }
+  CHECK(in_order);
+
+  Item rest;
+  CHECK(queue.TryPopBatch(&rest, 1) == 0);
+  CHECK(queue.dropped() == 0);
+  CHECK(queue.high_water() >= 1);
+  CHECK(queue.high_water() <= queue.capacity());
+}
+
+/**
+ * Producers that drop on a full queue: every element is either received or
+ * counted as dropped, and the received ones keep the order of each producer.
+ * A last element per producer is pushed with waiting, so the consumer knows
+ * when all are done.
+ */
+void TestDropsCounted(MpscQueueBase::WaitStrategy wait) {
+  const int n_items = 20000;
+  MpscQueue<Item> queue(8, wait);
+
+  vector<thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.push_back(thread([&queue, p]() {
+      for (int i = 0; i < n_items; ++i) {
+        const Item item = {p, i};
+        queue.TryPush(item);
+      }
+      const Item end_item = {p, -1};
+      queue.Push(end_item);
+    }));
+  }
+
+  vector<int> last(kProducers, -1);
+  bool in_order = true;
+  size_t received = 0;
+  Item batch[4];
+  for (int running = kProducers; running > 0;) {
+    const size_t n = queue.PopBatch(batch, 4);
+    for (size_t b = 0; b < n; ++b) {
+      if (batch[b].sequence < 0) {
+        --running;
+        continue;
+      }
+      in_order = in_order && batch[b].sequence > last[batch[b].producer];
+      last[batch[b].producer] = batch[b].sequence;
+      ++received;
+    }
+  }
+  for (int p = 0; p < kProducers; ++p) {
+    producers[p].join();
+  }
+  CHECK(in_order);
+  CHECK(received + queue.dropped() == (size_t) kProducers * n_items);
+  CHECK(queue.high_water() <= queue.capacity());
+}
+
+/**
+ * A queue nobody pops: exactly capacity() elements fit, the rest are
+ * dropped, and popping frees the slots for the next lap.
+ */
+void TestFullQueue() {
+  MpscQueue<Item> queue(5, MpscQueueBase::SPIN);
+  CHECK(queue.capacity() == 8);
+
+  for (int i = 0; i < 12; ++i) {
+    const Item item = {0, i};
+    CHECK(queue.TryPush(item) == (i < 8));
+  }
+  CHECK(queue.dropped() == 4);
+  CHECK(queue.high_water() == 8);
+
+  Item batch[8];
+  CHECK(queue.TryPopBatch(batch, 8) == 8);
+  for (int i = 0; i < 8; ++i) {
+    CHECK(batch[i].sequence == i);
+  }
+
+  // the next lap after a full one
+  for (int i = 0; i < 8; ++i) {
+    const Item item = {0, 100 + i};
+    CHECK(queue.TryPush(item));
+  }
+  CHECK(queue.TryPopBatch(batch, 3) == 3);
+  CHECK(batch[0].sequence == 100);
+  CHECK(queue.dropped() == 4);
+  CHECK(queue.high_water() == 8);
+}
+
+/**
+ * Element that pushes the next element into refill whenever it is copied,
+ * so a single thread can refill slots in the middle of a popped batch.
+ */
+struct RefillingItem {
+  int sequence;
+
+  static MpscQueue<RefillingItem>* refill;
+
+  RefillingItem& operator=(const RefillingItem& other) {
+    sequence = other.sequence;
+    MpscQueue<RefillingItem>* queue = refill;
+    if (queue != nullptr) {
+      refill = nullptr;
+      const RefillingItem next = {other.sequence + 100};
+      queue->TryPush(next);
+      refill = queue;
+    }
+    return *this;
+  }
+};
+
+MpscQueue<RefillingItem>* RefillingItem::refill = nullptr;
+
+/**
+ * Slots freed and refilled during one batch do not push the high-water mark
+ * over the capacity, although the consumer publishes its position only
+ * after the batch.
+ */
+void TestHighWaterWithinCapacity() {
+  MpscQueue<RefillingItem> queue(8, MpscQueueBase::SPIN);
+  for (int i = 0; i < 8; ++i) {
+    const RefillingItem item = {i};
+    CHECK(queue.TryPush(item));
+  }
+
+  // the first refill finds the queue full, the others take the slots the
+  // batch has freed
+  RefillingItem batch[8];
+  RefillingItem::refill = &queue;
+  CHECK(queue.TryPopBatch(batch, 8) == 8);
+  RefillingItem::refill = nullptr;
+  CHECK(queue.dropped() == 1);
+  CHECK(queue.high_water() == queue.capacity());
+
+  CHECK(queue.TryPopBatch(batch, 8) == 7);
+  CHECK(batch[0].sequence == 101);
+}
+
+}  // namespace
+
+int main() {
+  const MpscQueueBase::WaitStrategy waits[3] = {MpscQueueBase::SPIN,
+                                                MpscQueueBase::SPIN_THEN_PARK,
+                                                MpscQueueBase::BLOCK};
+  for (int w = 0; w < 3; ++w) {
+    TestFifoPerProducer(waits[w]);
+    TestDropsCounted(waits[w]);
+  }
+  TestFullQueue();
+  TestHighWaterWithinCapacity();
+  return TestResult();
+}
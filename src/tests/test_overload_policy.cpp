@@ -0,0 +1,145 @@
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "test_check.h"
+#include "object_log.h"
+#include "overload_policy.h"
+#include "replay.h"
+#include "ukf.h"
+
+using namespace std;
+
+namespace {
+
+const char kSampleLog[] = "../data/obj_pose-laser-radar-synthetic-input.txt";
+
+/**
+ * With a budget no update fits, Admit still lets through uninitialized
+ * tracks, tracks with fewer than min_track_updates_ updates and tracks shed
+ * max_shed_streak_ frames in a row; EndFrame counts those as forced.
+ */
+void TestForcedUpdates() {
+  OverloadPolicy policy;
+  policy.frame_budget_us_ = 1;
+  policy.max_shed_streak_ = 4;
+  policy.Reset(2);
+
+  UKF fresh;
+  UKF tracked;
+  MeasurementPackage meas;
+  meas.timestamp_ = 1477010443000000LL;
+  meas.sensor_type_ = MeasurementPackage::LASER;
+  meas.raw_measurements_ = Eigen::Vector2d(5.0, 1.0);
+  tracked.ProcessMeasurement(meas);
+
+  // every update of object 1 is reported to take a second
+  const vector<size_t> objects(1, 1);
+  const vector<size_t> measurements(1, 1);
+  const vector<char> updated(1, 0);
+  const vector<char> shed(1, 1);
+  for (int i = 0; i < policy.min_track_updates_; ++i) {
+    policy.BeginFrame();
+    CHECK(policy.Admit(1, tracked));
+    policy.EndFrame(objects, updated, measurements, 1000000000LL);
+  }
+  CHECK(policy.stats_.forced_updates == (size_t) policy.min_track_updates_);
+
+  policy.BeginFrame();
+  CHECK(policy.Admit(0, fresh));
+  CHECK(!policy.Admit(1, tracked));
+  for (int streak = 1; streak <= policy.max_shed_streak_; ++streak) {
+    policy.EndFrame(objects, shed, measurements, 0);
+    policy.BeginFrame();
+    CHECK(policy.Admit(1, tracked) == (streak == policy.max_shed_streak_));
+  }
+  policy.EndFrame(objects, updated, measurements, 1000000000LL);
+
+  const OverloadStats& stats = policy.stats_;
+  CHECK(stats.frames == (size_t) (policy.min_track_updates_ + policy.max_shed_streak_ + 1));
+  CHECK(stats.overloaded_frames == (size_t) policy.max_shed_streak_);
+  CHECK(stats.forced_updates == (size_t) policy.min_track_updates_ + 1);
+  CHECK(stats.shed_measurements == (size_t) policy.max_shed_streak_);
+  CHECK(stats.updated_measurements == (size_t) policy.min_track_updates_ + 1);
+  CHECK(stats.longest_shed_streak == policy.max_shed_streak_);
+}
+
+/**
+ * A track bank of copies of the sample object under a 1 us frame budget.
+ * Shed rows have a NaN NIS: every object is updated in its first frames,
+ * no object is shed more than max_shed_streak_ frames in a row, and each
+ * measurement is either updated or shed.
+ */
+void TestReplayFramesShedding() {
+  vector<LogRecord> log;
+  CHECK(ObjectLog::Read(kSampleLog, &log));
+
+  const int n_objects = 8;
+  vector<LogRecord> records;
+  for (size_t row = 0; row < log.size(); ++row) {
+    for (int object = 0; object < n_objects; ++object) {
+      records.push_back(log[row]);
+      records.back().measurement.object_id_ = object;
+    }
+  }
+  vector<long long> object_ids;
+  vector<vector<size_t> > object_rows;
+  ObjectLog::Partition(records, &object_ids, &object_rows);
+  CHECK(object_rows.size() == (size_t) n_objects);
+
+  OverloadPolicy policy;
+  policy.frame_budget_us_ = 1;
+  policy.priority_ = OverloadPolicy::CLOSING_TIME;
+  policy.max_shed_streak_ = 4;
+  vector<ObjectReplay> results;
+  Replay::ReplayFrames(records, object_rows, false, 1, &policy, nullptr, &results);
+  CHECK(results.size() == (size_t) n_objects);
+
+  size_t n_updated = 0;
+  size_t n_shed = 0;
+  for (int object = 0; object < n_objects; ++object) {
+    istringstream rows(results[object].output);
+    string line;
+    int n_rows = 0;
+    int streak = 0;
+    int longest_streak = 0;
+    bool new_track_updated = true;
+    while (getline(rows, line)) {
+      // time_stamp, five states, sensor type, NIS
+      istringstream fields(line);
+      string field;
+      for (int f = 0; f < 8; ++f) {
+        fields >> field;
+      }
+      const bool shed = field == "nan";
+      if (n_rows < policy.min_track_updates_) {
+        new_track_updated = new_track_updated && !shed;
+      }
+      streak = shed ? streak + 1 : 0;
+      longest_streak = max(longest_streak, streak);
+      ++(shed ? n_shed : n_updated);
+      ++n_rows;
+    }
+    CHECK(n_rows == (int) log.size());
+    CHECK(new_track_updated);
+    CHECK(longest_streak <= policy.max_shed_streak_);
+  }
+
+  const OverloadStats& stats = policy.stats_;
+  CHECK(stats.frames == log.size());
+  CHECK(stats.overloaded_frames > 0);
+  CHECK(stats.shed_measurements > 0);
+  CHECK(stats.forced_updates > 0);
+  CHECK(stats.longest_shed_streak <= policy.max_shed_streak_);
+  CHECK(stats.updated_measurements == n_updated);
+  CHECK(stats.shed_measurements == n_shed);
+  CHECK(stats.updated_measurements + stats.shed_measurements == records.size());
+}
+
+}  // namespace
+
+int main() {
+  TestForcedUpdates();
+  TestReplayFramesShedding();
+  return TestResult();
+}
@@ -0,0 +1,91 @@
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "test_check.h"
+#include "parallel_for.h"
+
+using namespace std;
+
+namespace {
+
+/**
+ * Every task runs exactly once, also when the thread count exceeds the
+ * number of tasks or the cores.
+ */
+void TestEveryTaskOnce() {
+  const size_t sizes[] = {0, 1, 3, 64, 1000};
+  const int threads[] = {1, 2, 4, 8};
+  for (size_t n : sizes) {
+    for (int num_threads : threads) {
+      vector<atomic<int> > counts(n);
+      for (size_t i = 0; i < n; ++i) {
+        counts[i] = 0;
+      }
+      ParallelFor(n, num_threads, [&](size_t i) { ++counts[i]; });
+      for (size_t i = 0; i < n; ++i) {
+        CHECK(counts[i] == 1);
+      }
+    }
+  }
+}
+
+/**
+ * Repeated calls reuse the same pool threads instead of starting new ones.
+ */
+void TestThreadsAreReused() {
+  mutex ids_mutex;
+  set<thread::id> ids;
+  for (int call = 0; call < 200; ++call) {
+    ParallelFor(4, 4, [&](size_t) {
+      // keep every thread busy for a moment so all of them join the job
+      this_thread::sleep_for(chrono::microseconds(50));
+      lock_guard<mutex> lock(ids_mutex);
+      ids.insert(this_thread::get_id());
+    });
+  }
+  // the caller plus the pool threads, whatever earlier tests started
+  CHECK(ids.size() <= 8);
+  CHECK(ids.count(this_thread::get_id()) == 1);
+}
+
+/**
+ * A ParallelFor inside a task runs on that task's thread.
+ */
+void TestNested() {
+  atomic<long long> sum(0);
+  ParallelFor(8, 4, [&](size_t i) {
+    ParallelFor(100, 4, [&](size_t j) { sum += i * 100 + j; });
+  });
+  CHECK(sum == 800 * 799 / 2);
+}
+
+/**
+ * Calls from several threads at once all complete.
+ */
+void TestConcurrentCallers() {
+  atomic<long long> sum(0);
+  vector<thread> callers;
+  for (int c = 0; c < 4; ++c) {
+    callers.push_back(thread([&]() {
+      for (int call = 0; call < 50; ++call) {
+        ParallelFor(100, 3, [&](size_t i) { sum += i; });
+      }
+    }));
+  }
+  for (size_t c = 0; c < callers.size(); ++c) {
+    callers[c].join();
+  }
+  CHECK(sum == 4 * 50 * (100 * 99 / 2));
+}
+
+}  // namespace
+
+int main() {
+  TestEveryTaskOnce();
+  TestThreadsAreReused();
+  TestNested();
+  TestConcurrentCallers();
+  return TestResult();
+}
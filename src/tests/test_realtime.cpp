@@ -0,0 +1,245 @@
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "test_check.h"
+#include "object_log.h"
+#include "realtime.h"
+#include "replay.h"
+#include "ukf.h"
+
+using namespace std;
+
+namespace {
+
+const char kSampleLog[] = "../data/obj_pose-laser-radar-synthetic-input.txt";
+
+MeasurementPackage Laser(long long timestamp, double px, double py) {
+  MeasurementPackage meas;
+  meas.timestamp_ = timestamp;
+  meas.sensor_type_ = MeasurementPackage::LASER;
+  meas.raw_measurements_ = Eigen::Vector2d(px, py);
+  return meas;
+}
+
+MeasurementPackage Radar(long long timestamp, double px, double py, double rho_dot) {
+  MeasurementPackage meas;
+  meas.timestamp_ = timestamp;
+  meas.sensor_type_ = MeasurementPackage::RADAR;
+  meas.raw_measurements_ = Eigen::Vector3d(sqrt(px * px + py * py), atan2(py, px), rho_dot);
+  return meas;
+}
+
+/**
+ * Heap allocations of the calling thread while running f.
+ */
+template <typename Function>
+long long AllocationsOf(Function f) {
+  const long long before = RealTime::ThreadStats().allocations;
+  f();
+  return RealTime::ThreadStats().allocations - before;
+}
+
+/**
+ * Predictions and laser, radar and fused updates do not allocate, on the
+ * unscented and on the linearized path, with and without per-measurement
+ * noise and a moved radar.
+ */
+template <class Filter>
+void TestUpdatesDoNotAllocate() {
+  const long long start = 1477010443000000LL;
+  const int n_steps = 40;
+
+  // all measurements are built before counting
+  vector<MeasurementPackage> lasers;
+  vector<MeasurementPackage> radars;
+  for (int i = 0; i < n_steps; ++i) {
+    const double t = 0.05 * i;
+    lasers.push_back(Laser(start + 50000LL * i, 5.0 + 2.0 * t, 1.0 + 0.5 * t));
+    radars.push_back(Radar(start + 50000LL * i + 200, 5.0 + 2.0 * t, 1.0 + 0.5 * t, 2.0));
+    if (i % 3 == 0) {
+      lasers.back().noise_covariance_ = 0.04 * Eigen::Matrix2d::Identity();
+    }
+    if (i % 4 == 0) {
+      radars.back().sensor_origin_ = Eigen::Vector2d(0.5, -0.2);
+    }
+  }
+
+  for (int hybrid = 0; hybrid < 2; ++hybrid) {
+    Filter ukf;
+    ukf.use_hybrid_ = hybrid != 0;
+    ukf.ProcessMeasurement(lasers[0]);
+    const long long allocations = AllocationsOf([&]() {
+      for (int i = 1; i < n_steps; ++i) {
+        switch (i % 3) {
+          case 0:
+            ukf.ProcessMeasurement(lasers[i]);
+            break;
+          case 1:
+            ukf.ProcessMeasurement(radars[i]);
+            break;
+          default:
+            ukf.ProcessFusedMeasurement(lasers[i], radars[i]);
+        }
+      }
+    });
+    CHECK(allocations == 0);
+    CHECK(ukf.x_.allFinite());
+  }
+}
+
+/**
+ * Frame predictions of changing batch sizes reuse the workspace once it has
+ * grown to the largest batch.
+ */
+void TestPredictFrameDoesNotAllocate() {
+  const long long start = 1477010443000000LL;
+  vector<UKF> tracks(12);
+  vector<UKF*> frame;
+  for (size_t t = 0; t < tracks.size(); ++t) {
+    tracks[t].ProcessMeasurement(Laser(start, 5.0 + t, 1.0));
+    frame.push_back(&tracks[t]);
+  }
+  UKF::Workspace workspace;
+  UKF::PredictFrame(frame, start + 50000, &workspace);
+
+  const long long allocations = AllocationsOf([&]() {
+    for (int k = 2; k < 20; ++k) {
+      const size_t end = k % 2 == 0 ? tracks.size() : 3;
+      UKF::PredictFrame(frame, 0, end, start + 50000LL * k, &workspace);
+    }
+  });
+  CHECK(allocations == 0);
+}
+
+/**
+ * The real-time replay of the sample log passes its self-check. The rows go
+ * to a file like those of UnscentedKF, a string stream would grow. Page
+ * faults are only checked if the memory could be locked.
+ */
+void TestRealTimeSelfCheck() {
+  vector<LogRecord> records;
+  CHECK(ObjectLog::Read(kSampleLog, &records));
+
+  RealTimeConfig config;
+  config.prefault_heap_bytes = 16 * 1024 * 1024;
+  ofstream out("/dev/null");
+  RealTimeReport report;
+  Replay::ReplayRealTime(records, config, out, &report);
+  CHECK(report.updates == records.size());
+
+  CHECK(report.ingest.allocations == 0);
+  CHECK(report.filter.allocations == 0);
+  CHECK(report.output.allocations == 0);
+  if (report.warnings.empty()) {
+    CHECK(report.Clean());
+  }
+}
+
+/**
+ * An object that first appears after the warm-up gets its track without an
+ * allocation on the filter thread. The second object repeats the rows of
+ * the first, starting late in the log.
+ */
+void TestLateObjectDoesNotAllocate() {
+  vector<LogRecord> log;
+  CHECK(ObjectLog::Read(kSampleLog, &log));
+
+  RealTimeConfig config;
+  config.prefault_heap_bytes = 16 * 1024 * 1024;
+  const size_t first_late = 2 * config.warmup_updates;
+  CHECK(first_late < log.size());
+
+  vector<LogRecord> records;
+  for (size_t row = 0; row < log.size(); ++row) {
+    records.push_back(log[row]);
+    if (row >= first_late) {
+      records.push_back(log[row]);
+      records.back().measurement.object_id_ = 2;
+    }
+  }
+
+  ofstream out("/dev/null");
+  RealTimeReport report;
+  Replay::ReplayRealTime(records, config, out, &report);
+  CHECK(report.updates == records.size());
+  CHECK(report.filter.allocations == 0);
+}
+
+/**
+ * With one ingest thread per sensor every row is finite, the rows of each
+ * object are in time order and every measurement is either filtered or
+ * counted as late. Paced, the reorder window restores the order of the
+ * log; unpaced, the laser driver runs ahead and the radar rows behind it
+ * are dropped instead of predicting backwards.
+ */
+void TestPerSensorOrder(double pace) {
+  vector<LogRecord> records;
+  CHECK(ObjectLog::Read(kSampleLog, &records));
+
+  RealTimeConfig config;
+  config.lock_memory = false;
+  config.prefault_heap_bytes = 0;
+  config.ingest_per_sensor = true;
+  config.pace = pace;
+  if (pace > 0) {
+    // 10 ms of wall time, so a descheduled driver on a loaded machine is
+    // not counted as late
+    config.reorder_window_us = (long long) (pace * 10000);
+  }
+  ostringstream out;
+  RealTimeReport report;
+  Replay::ReplayRealTime(records, config, out, &report);
+  CHECK(report.ingest_drops == 0);
+  CHECK(report.updates + report.late_drops == records.size());
+  if (pace > 0) {
+    CHECK(report.late_drops == 0);
+  }
+
+  istringstream rows(out.str());
+  string header;
+  getline(rows, header);
+  size_t n_rows = 0;
+  bool finite = true;
+  bool ordered = true;
+  map<long long, long long> last_time;
+  long long time_us;
+  long long object_id;
+  double x[CTRVModel::kStateDim];
+  while (rows >> time_us >> object_id >> x[0] >> x[1] >> x[2] >> x[3] >> x[4]) {
+    for (int i = 0; i < CTRVModel::kStateDim; ++i) {
+      finite = finite && std::isfinite(x[i]);
+    }
+    if (last_time.count(object_id) > 0) {
+      ordered = ordered && time_us >= last_time[object_id];
+    }
+    last_time[object_id] = time_us;
+    ++n_rows;
+  }
+  CHECK(finite);
+  CHECK(ordered);
+  CHECK(n_rows == report.updates);
+}
+
+}  // namespace
+
+int main() {
+  TestPerSensorOrder(50.0);
+  TestPerSensorOrder(0.0);
+
+  // a sanitizer replaces malloc, the counters are then not linked
+  if (RealTime::ThreadStats().allocations < 0) {
+    cout << "allocations are not counted in this build, skipped" << endl;
+    return TestResult();
+  }
+  TestUpdatesDoNotAllocate<UKF>();
+  TestUpdatesDoNotAllocate<CubatureUKF>();
+  TestUpdatesDoNotAllocate<CTRAUKF>();
+  TestPredictFrameDoesNotAllocate();
+  TestRealTimeSelfCheck();
+  TestLateObjectDoesNotAllocate();
+  return TestResult();
+}
@@ -0,0 +1,53 @@
+#include <numeric>
+#include <vector>
+#include "test_check.h"
+#include "evaluation.h"
+#include "object_log.h"
+#include "replay.h"
+
+using namespace std;
+
+/**
+ * Accuracy of the filter on the sample log. The reference values are those
+ * of the libm build; the fast math build (-DUKF_FAST_MATH=ON) must stay
+ * within the tolerance, see fast_math.h.
+ */
+
+namespace {
+
+const char kSampleLog[] = "../data/obj_pose-laser-radar-synthetic-input.txt";
+
+// RMSE of [px py vx vy] and the NEES mean of the libm build
+const double kReferenceRMSE[4] = {0.0583419, 0.0965347, 0.333375, 0.220301};
+const double kReferenceNEES = 5.5633;
+
+// the approximations change the results far below this
+const double kTolerance = 1e-4;
+
+void TestSampleLog() {
+  vector<LogRecord> records;
+  CHECK(ObjectLog::Read(kSampleLog, &records));
+  CHECK(records.size() == 500);
+
+  vector<size_t> rows(records.size());
+  iota(rows.begin(), rows.end(), 0);
+  ObjectReplay result;
+  Replay::ReplayObject(records, rows, false, nullptr, &result);
+
+  const long long n = result.estimations.size() / 4;
+  CHECK(n == 500);
+  const ErrorSummary summary =
+      Evaluation::Evaluate(result.estimations.data(), result.estimation_covariances.data(),
+                           result.ground_truth.data(), 4, n, 1);
+  for (int i = 0; i < 4; ++i) {
+    CHECK_NEAR(summary.rmse(i), kReferenceRMSE[i], kTolerance);
+  }
+  CHECK_NEAR(summary.nees_mean, kReferenceNEES, 1e-3);
+}
+
+}  // namespace
+
+int main() {
+  TestSampleLog();
+  return TestResult();
+}
@@ -0,0 +1,123 @@
+#include <map>
+#include <random>
+#include <vector>
+#include "test_check.h"
+#include "slot_map.h"
+
+using namespace std;
+
+namespace {
+
+// small chunks, so the operations cross many chunk boundaries
+typedef SlotMap<long long, 4> SmallMap;
+
+long long Key(SlotHandle handle) {
+  return ((long long) handle.index << 32) | handle.generation;
+}
+
+/**
+ * Checks the slot map against a std::map from handle to value: the same
+ * elements are live, and iterating the dense range visits each exactly once.
+ */
+void CheckSame(const SmallMap& slots, const map<long long, long long>& reference) {
+  CHECK(slots.size() == reference.size());
+  map<long long, long long> visited;
+  for (size_t i = 0; i < slots.size(); ++i) {
+    const SlotHandle handle = slots.HandleAtDense(i);
+    CHECK(slots.Get(handle) == &slots.AtDense(i));
+    visited[Key(handle)] = slots.AtDense(i);
+  }
+  CHECK(visited == reference);
+}
+
+/**
+ * Random inserts and erases, mirrored in a std::map. Erased handles must stay
+ * stale after their slots are reused.
+ */
+void TestAgainstStdMap() {
+  mt19937 rng(42);
+  SmallMap slots;
+  map<long long, long long> reference;
+  vector<SlotHandle> live;
+  vector<SlotHandle> erased;
+
+  for (int step = 0; step < 20000; ++step) {
+    // grow in the first half, shrink in the second
+    const int insert_percent = step < 10000 ? 60 : 40;
+    if (live.empty() || (int) (rng() % 100) < insert_percent) {
+      const long long value = rng();
+      const SlotHandle handle = slots.Insert(value);
+      CHECK(handle.generation != 0);
+      CHECK(reference.count(Key(handle)) == 0);
+      reference[Key(handle)] = value;
+      live.push_back(handle);
+    } else {
+      const size_t k = rng() % live.size();
+      const SlotHandle handle = live[k];
+      CHECK(slots.Erase(handle));
+      CHECK(!slots.Erase(handle));
+      reference.erase(Key(handle));
+      live[k] = live.back();
+      live.pop_back();
+      erased.push_back(handle);
+    }
+
+    if (step % 97 == 0) {
+      CheckSame(slots, reference);
+      for (size_t i = 0; i < live.size(); ++i) {
+        CHECK(slots.Contains(live[i]));
+        CHECK(*slots.Get(live[i]) == reference[Key(live[i])]);
+      }
+      for (size_t i = 0; i < erased.size(); ++i) {
+        CHECK(!slots.Contains(erased[i]));
+      }
+    }
+  }
+  CheckSame(slots, reference);
+
+  slots.Clear();
+  CHECK(slots.empty());
+  for (size_t i = 0; i < live.size(); ++i) {
+    CHECK(!slots.Contains(live[i]));
+  }
+  CHECK(!slots.Contains(SlotHandle(1000000, 1)));
+}
+
+/**
+ * After a reserve, inserts take the slots in ascending order across chunks,
+ * the same order as without the reserve, and allocate no chunk.
+ */
+void TestReserveOrder() {
+  SmallMap reserved;
+  SmallMap grown;
+  // a partly used last chunk, then three more chunks
+  for (int i = 0; i < 2; ++i) {
+    reserved.Insert(i);
+    grown.Insert(i);
+  }
+  reserved.Reserve(14);
+  CHECK(reserved.capacity() == 16);
+  for (int i = 2; i < 16; ++i) {
+    const SlotHandle a = reserved.Insert(i);
+    const SlotHandle b = grown.Insert(i);
+    CHECK(a == b);
+    CHECK(a.index == (uint32_t) i);
+  }
+  CHECK(reserved.capacity() == 16);
+
+  // an empty map
+  SmallMap empty;
+  empty.Reserve(9);
+  CHECK(empty.capacity() == 12);
+  for (uint32_t i = 0; i < 12; ++i) {
+    CHECK(empty.Insert(i).index == i);
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestAgainstStdMap();
+  TestReserveOrder();
+  return TestResult();
+}
@@ -0,0 +1,143 @@
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "test_check.h"
+#include "tools.h"
+
+using namespace std;
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+
+namespace {
+
+/**
+ * Wraps x as the middle row of a 3 x 1 matrix, so the stride is exercised
+ * and the neighbouring rows can be checked to stay unchanged.
+ */
+double WrapInRow(double x) {
+  MatrixXd M(3, 1);
+  M << 7.0, x, -7.0;
+  Tools::NormalizeAngleRow(&M, 1);
+  CHECK(M(0, 0) == 7.0);
+  CHECK(M(2, 0) == -7.0);
+  return M(1, 0);
+}
+
+void TestWrapBoundaries() {
+  // angles inside the range are kept, +-pi stays on the boundary
+  CHECK(WrapInRow(0.0) == 0.0);
+  CHECK(WrapInRow(1.0) == 1.0);
+  CHECK(WrapInRow(-3.0) == -3.0);
+  CHECK_NEAR(fabs(WrapInRow(M_PI)), M_PI, 1e-15);
+  CHECK_NEAR(fabs(WrapInRow(-M_PI)), M_PI, 1e-15);
+
+  // just past +-pi wraps to the other side
+  CHECK_NEAR(WrapInRow(M_PI + 0.01), -M_PI + 0.01, 1e-12);
+  CHECK_NEAR(WrapInRow(-M_PI - 0.01), M_PI - 0.01, 1e-12);
+  CHECK_NEAR(WrapInRow(1.5 * M_PI), -0.5 * M_PI, 1e-12);
+  CHECK_NEAR(WrapInRow(-1.5 * M_PI), 0.5 * M_PI, 1e-12);
+}
+
+void TestWrapLargeMultiples() {
+  const double k_values[] = {1, -1, 2, 17, -250, 1e4, -1e6, 1e9};
+  for (double k : k_values) {
+    const double x = 0.3 + k * 2 * M_PI;
+    // the error grows with the rounding error of x itself
+    const double tolerance = 1e-12 + 4 * numeric_limits<double>::epsilon() * fabs(x);
+    CHECK_NEAR(WrapInRow(x), 0.3, tolerance);
+    CHECK_NEAR(Tools::NormalizeAngle(x), 0.3, tolerance);
+  }
+}
+
+void TestWrapNonFinite() {
+  CHECK(std::isnan(WrapInRow(numeric_limits<double>::quiet_NaN())));
+  CHECK(std::isnan(WrapInRow(numeric_limits<double>::infinity())));
+  CHECK(std::isnan(Tools::NormalizeAngle(numeric_limits<double>::quiet_NaN())));
+}
+
+/**
+ * The row version agrees with the scalar one over many turns.
+ */
+void TestRowMatchesScalar() {
+  const int n = 2001;
+  MatrixXd M(2, n);
+  for (int i = 0; i < n; ++i) {
+    M(0, i) = -50.0 + 0.05 * i;
+    M(1, i) = 0.0;
+  }
+  MatrixXd wrapped = M;
+  Tools::NormalizeAngleRow(&wrapped, 0);
+  for (int i = 0; i < n; ++i) {
+    CHECK(fabs(wrapped(0, i)) <= M_PI + 1e-12);
+    CHECK_NEAR(cos(wrapped(0, i)), cos(M(0, i)), 1e-12);
+    CHECK_NEAR(sin(wrapped(0, i)), sin(M(0, i)), 1e-12);
+    const double scalar = Tools::NormalizeAngle(M(0, i));
+    // both ends of the range name the same angle
+    const double difference = fabs(wrapped(0, i) - scalar);
+    CHECK(difference < 1e-12 || fabs(difference - 2 * M_PI) < 1e-12);
+  }
+}
+
+/**
+ * Fixed-size matrices wrap their row through a stack buffer, with the same
+ * result as the contiguous version.
+ */
+void TestFixedSizeRow() {
+  Eigen::Matrix<double, 3, 4> M;
+  M << 1.0, 2.0, 3.0, 4.0,
+       4.0, -7.0, 0.5, 100.0,
+       5.0, 6.0, 7.0, 8.0;
+  const Eigen::Matrix<double, 3, 4> original = M;
+  Tools::NormalizeAngleRow(&M, 1);
+
+  double angles[4] = {4.0, -7.0, 0.5, 100.0};
+  Tools::NormalizeAngles(angles, 4);
+  for (int i = 0; i < 4; ++i) {
+    CHECK(M(1, i) == angles[i]);
+    CHECK(M(0, i) == original(0, i));
+    CHECK(M(2, i) == original(2, i));
+    CHECK_NEAR(sin(M(1, i)), sin(original(1, i)), 1e-12);
+  }
+}
+
+void TestRMSE() {
+  vector<VectorXd> estimations;
+  vector<VectorXd> ground_truth;
+  estimations.push_back(Eigen::Vector2d(1.0, 2.0));
+  estimations.push_back(Eigen::Vector2d(3.0, 4.0));
+  ground_truth.push_back(Eigen::Vector2d(2.0, 2.0));
+  ground_truth.push_back(Eigen::Vector2d(0.0, 4.0));
+  const VectorXd rmse = Tools::CalculateRMSE(estimations, ground_truth);
+  CHECK(rmse.size() == 2);
+  CHECK_NEAR(rmse(0), sqrt(5.0), 1e-15);
+  CHECK(rmse(1) == 0.0);
+}
+
+/**
+ * Invalid input gives zeros that can still be indexed.
+ */
+void TestRMSEInvalid() {
+  vector<VectorXd> estimations;
+  vector<VectorXd> ground_truth;
+  const VectorXd empty = Tools::CalculateRMSE(estimations, ground_truth);
+  CHECK(empty.size() == 4);
+  CHECK(empty.isZero());
+
+  estimations.push_back(Eigen::Vector3d(1.0, 2.0, 3.0));
+  const VectorXd mismatched = Tools::CalculateRMSE(estimations, ground_truth);
+  CHECK(mismatched.size() == 3);
+  CHECK(mismatched.isZero());
+}
+
+}  // namespace
+
+int main() {
+  TestWrapBoundaries();
+  TestWrapLargeMultiples();
+  TestWrapNonFinite();
+  TestRowMatchesScalar();
+  TestFixedSizeRow();
+  TestRMSE();
+  TestRMSEInvalid();
+  return TestResult();
+}
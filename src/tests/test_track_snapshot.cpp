@@ -0,0 +1,291 @@
+#include <atomic>
+#include <cmath>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "test_check.h"
+#include "object_log.h"
+#include "replay.h"
+#include "track_snapshot.h"
+#include "ukf.h"
+
+using namespace std;
+
+namespace {
+
+const int kN = CTRVModel::kStateDim;
+
+const char kSampleLog[] = "../data/obj_pose-laser-radar-synthetic-input.txt";
+
+/**
+ * A track state in which every field is derived from k, so a reader can
+ * tell a torn copy from a consistent one.
+ */
+TrackState<kN> StateOf(long long k) {
+  TrackState<kN> state;
+  state.time_us = k;
+  for (int i = 0; i < kN; ++i) {
+    state.x[i] = k + i;
+  }
+  state.P.Pack(Eigen::Matrix<double, kN, kN>::Identity() * (k + 1.0));
+  return state;
+}
+
+bool Consistent(const TrackRecord<kN>& record, long long k) {
+  bool ok = record.state.time_us == k && record.nis_laser == k && record.nis_radar == -k;
+  for (int i = 0; i < kN; ++i) {
+    ok = ok && record.state.x[i] == k + i;
+    for (int j = 0; j < kN; ++j) {
+      ok = ok && record.state.P(i, j) == (i == j ? k + 1.0 : 0.0);
+    }
+  }
+  return ok;
+}
+
+void SetFilter(UKF* ukf, long long k) {
+  ukf->LoadState(StateOf(k));
+  ukf->NIS_laser_ = k;
+  ukf->NIS_radar_ = -k;
+}
+
+/**
+ * One writer publishes a single track as fast as it can while several
+ * readers copy it; every copy is a whole publication, never a mix.
+ */
+void TestSeqlockConcurrentReaders() {
+  const long long kPublications = 200000;
+  TrackSeqlock<kN> seqlock;
+  UKF ukf;
+  SetFilter(&ukf, 0);
+  seqlock.Publish(ukf, SlotHandle(0, 1));
+
+  atomic<bool> done(false);
+  atomic<int> torn(0);
+  atomic<int> backwards(0);
+  vector<thread> readers;
+  for (int r = 0; r < 3; ++r) {
+    readers.push_back(thread([&]() {
+      long long last = 0;
+      do {
+        TrackRecord<kN> record;
+        seqlock.Read(&record);
+        const long long k = record.state.time_us;
+        if (!Consistent(record, k) || record.handle != SlotHandle(k % 7, 1)) {
+          ++torn;
+        }
+        if (k < last) {
+          ++backwards;
+        }
+        last = k;
+      } while (!done);
+    }));
+  }
+
+  for (long long k = 1; k <= kPublications; ++k) {
+    TrackRecord<kN> record;
+    record.handle = SlotHandle(k % 7, 1);
+    record.state = StateOf(k);
+    record.nis_laser = k;
+    record.nis_radar = -k;
+    seqlock.Publish(record);
+  }
+  done = true;
+  for (size_t r = 0; r < readers.size(); ++r) {
+    readers[r].join();
+  }
+
+  CHECK(torn == 0);
+  CHECK(backwards == 0);
+  CHECK(seqlock.version() == (uint64_t) kPublications + 1);
+  TrackRecord<kN> last;
+  CHECK(seqlock.TryRead(&last));
+  CHECK(Consistent(last, kPublications));
+}
+
+/**
+ * One writer publishes a whole track table while several readers pin
+ * snapshots: a pinned snapshot is complete, stays unchanged while it is
+ * held, and epochs only grow.
+ */
+void TestSnapshotsConcurrentReaders() {
+  const int kTracks = 20;
+  const long long kPublications = 5000;
+  SlotMap<UKF> tracks;
+  for (int t = 0; t < kTracks; ++t) {
+    SetFilter(tracks.Get(tracks.Emplace()), 0);
+  }
+  TrackSnapshots<kN> snapshots;
+
+  atomic<bool> done(false);
+  atomic<int> bad(0);
+  atomic<long long> reads(0);
+  vector<thread> readers;
+  for (int r = 0; r < 3; ++r) {
+    readers.push_back(thread([&]() {
+      uint64_t last_epoch = 0;
+      do {
+        TrackSnapshots<kN>::Reader snapshot = snapshots.Read();
+        const long long k = snapshot->time_us;
+        const uint64_t epoch = snapshot->epoch;
+        bool ok = epoch >= last_epoch && (epoch == 0 || snapshot->tracks.size() == kTracks);
+        for (size_t t = 0; t < snapshot->tracks.size(); ++t) {
+          ok = ok && Consistent(snapshot->tracks[t], k);
+        }
+        // still the same after the writer had time to move on
+        this_thread::yield();
+        ok = ok && snapshot->epoch == epoch && snapshot->time_us == k;
+        for (size_t t = 0; t < snapshot->tracks.size(); ++t) {
+          ok = ok && Consistent(snapshot->tracks[t], k);
+        }
+        if (!ok) {
+          ++bad;
+        }
+        last_epoch = epoch;
+        ++reads;
+      } while (!done);
+    }));
+  }
+
+  long long published = 0;
+  for (long long k = 1; k <= kPublications; ++k) {
+    for (size_t t = 0; t < tracks.size(); ++t) {
+      SetFilter(&tracks.AtDense(t), k);
+    }
+    if (snapshots.Publish(tracks, k)) {
+      ++published;
+    }
+  }
+  done = true;
+  for (size_t r = 0; r < readers.size(); ++r) {
+    readers[r].join();
+  }
+
+  CHECK(bad == 0);
+  CHECK(reads > 0);
+  CHECK(published > 0);
+  const TrackSnapshots<kN>::Reader last = snapshots.Read();
+  CHECK(last->epoch == (uint64_t) published);
+  for (size_t t = 0; t < tracks.size(); ++t) {
+    CHECK(last->tracks[t].handle == tracks.HandleAtDense(t));
+  }
+}
+
+/**
+ * Readers holding every spare buffer make the writer skip a publication
+ * instead of waiting.
+ */
+void TestSnapshotsSkipWhenPinned() {
+  SlotMap<UKF> tracks;
+  SetFilter(tracks.Get(tracks.Emplace()), 1);
+  TrackSnapshots<kN> snapshots;
+
+  CHECK(snapshots.Publish(tracks, 1));
+  {
+    const TrackSnapshots<kN>::Reader first = snapshots.Read();
+    CHECK(snapshots.Publish(tracks, 2));
+    const TrackSnapshots<kN>::Reader second = snapshots.Read();
+    // the writer never rewrites the current buffer, and readers hold the
+    // two others
+    CHECK(snapshots.Publish(tracks, 3));
+    CHECK(!snapshots.Publish(tracks, 4));
+    CHECK(first->time_us == 1);
+    CHECK(second->time_us == 2);
+    CHECK(snapshots.Read()->time_us == 3);
+  }
+  CHECK(snapshots.Publish(tracks, 4));
+  CHECK(snapshots.Read()->epoch == 4);
+  CHECK(snapshots.Read()->time_us == 4);
+}
+
+
+/**
+ * The frame replay publishes its track bank after every frame while a
+ * reader pins snapshots: epochs and times only grow, and the last snapshot
+ * holds the final estimate of the object.
+ */
+void TestFramesPublish() {
+  vector<LogRecord> records;
+  CHECK(ObjectLog::Read(kSampleLog, &records));
+  vector<long long> object_ids;
+  vector<vector<size_t> > object_rows;
+  ObjectLog::Partition(records, &object_ids, &object_rows);
+
+  TrackSnapshots<kN> snapshots;
+  atomic<bool> done(false);
+  atomic<int> bad(0);
+  thread reader([&]() {
+    uint64_t last_epoch = 0;
+    long long last_time = 0;
+    do {
+      TrackSnapshots<kN>::Reader snapshot = snapshots.Read();
+      if (snapshot->epoch < last_epoch || snapshot->time_us < last_time ||
+          (snapshot->epoch > 0 && snapshot->tracks.size() != 1)) {
+        ++bad;
+      }
+      last_epoch = snapshot->epoch;
+      last_time = snapshot->time_us;
+    } while (!done);
+  });
+
+  vector<ObjectReplay> results;
+  Replay::ReplayFrames(records, object_rows, false, 1, nullptr, &snapshots, &results);
+  done = true;
+  reader.join();
+
+  CHECK(bad == 0);
+  const TrackSnapshots<kN>::Reader last = snapshots.Read();
+  CHECK(last->epoch == records.size());
+  CHECK(last->time_us == records.back().measurement.timestamp_);
+  CHECK(last->tracks.size() == 1);
+  const vector<double>& estimations = results[0].estimations;
+  if (last->tracks.size() == 1 && estimations.size() >= 4) {
+    // the estimations are stored as float
+    CHECK((float) last->tracks[0].state.x[0] == estimations[estimations.size() - 4]);
+    CHECK((float) last->tracks[0].state.x[1] == estimations[estimations.size() - 3]);
+  }
+}
+
+/**
+ * The real-time output thread writes its rows from the published tracks:
+ * one row per update, each with the state of that update.
+ */
+void TestRealTimeOutput() {
+  vector<LogRecord> records;
+  CHECK(ObjectLog::Read(kSampleLog, &records));
+
+  RealTimeConfig config;
+  config.lock_memory = false;
+  ostringstream out;
+  RealTimeReport report;
+  Replay::ReplayRealTime(records, config, out, &report);
+  CHECK(report.updates == records.size());
+
+  istringstream rows(out.str());
+  string header;
+  getline(rows, header);
+  size_t n_rows = 0;
+  long long time_us;
+  long long object_id;
+  double x[kN];
+  while (rows >> time_us >> object_id >> x[0] >> x[1] >> x[2] >> x[3] >> x[4]) {
+    bool finite = true;
+    for (int i = 0; i < kN; ++i) {
+      finite = finite && std::isfinite(x[i]);
+    }
+    CHECK(finite);
+    ++n_rows;
+  }
+  CHECK(n_rows == report.updates);
+  CHECK(time_us == records.back().measurement.timestamp_);
+}
+
+}  // namespace
+
+int main() {
+  TestSeqlockConcurrentReaders();
+  TestSnapshotsConcurrentReaders();
+  TestSnapshotsSkipWhenPinned();
+  TestFramesPublish();
+  TestRealTimeOutput();
+  return TestResult();
+}
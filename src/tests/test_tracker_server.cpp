@@ -0,0 +1,190 @@
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "test_check.h"
+#include "object_log.h"
+#include "replay.h"
+#include "tracker_server.h"
+
+using namespace std;
+
+namespace {
+
+const char kSampleLog[] = "../data/obj_pose-laser-radar-synthetic-input.txt";
+
+/**
+ * A blocking client: connects to the server, sends the requests while it
+ * reads the responses and returns all of them once the server has closed
+ * the connection.
+ */
+string Exchange(int port, const string& requests) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    close(fd);
+    return "";
+  }
+
+  // the server may close before all requests are sent, e.g. at a limit
+  thread writer([&]() {
+    size_t sent = 0;
+    while (sent < requests.size()) {
+      const ssize_t n = send(fd, requests.data() + sent, requests.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) {
+        break;
+      }
+      sent += n;
+    }
+    shutdown(fd, SHUT_WR);
+  });
+  string responses;
+  char buffer[16 * 1024];
+  for (ssize_t n; (n = recv(fd, buffer, sizeof(buffer), 0)) > 0;) {
+    responses.append(buffer, n);
+  }
+  writer.join();
+  close(fd);
+  return responses;
+}
+
+vector<string> Lines(const string& text) {
+  istringstream in(text);
+  vector<string> lines;
+  for (string line; getline(in, line);) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+/**
+ * Pipelined requests of the sample log: every response carries the
+ * estimate of ReplayObjects and a finite RMSE. A reset answers "ok" and
+ * starts over, so the first request gets its first answer again.
+ */
+void CheckPipelined(const string& responses) {
+  vector<LogRecord> records;
+  CHECK(ObjectLog::Read(kSampleLog, &records));
+  vector<long long> object_ids;
+  vector<vector<size_t> > object_rows;
+  ObjectLog::Partition(records, &object_ids, &object_rows);
+  vector<ObjectReplay> replays;
+  Replay::ReplayObjects(records, object_rows, false, 1, &replays);
+  const vector<string> expected = Lines(replays[0].output);
+
+  const vector<string> lines = Lines(responses);
+  CHECK(lines.size() == records.size() + 2);
+  CHECK(expected.size() == records.size());
+  if (lines.size() != records.size() + 2 || expected.size() != records.size()) {
+    return;
+  }
+  for (size_t i = 0; i < records.size(); ++i) {
+    // time_stamp px py ... of the replay, px py rmse_px rmse_py rmse_vx
+    // rmse_vy of the server
+    long long time_us;
+    double replay_px, replay_py;
+    istringstream(expected[i]) >> time_us >> replay_px >> replay_py;
+    double px, py, rmse[4];
+    istringstream(lines[i]) >> px >> py >> rmse[0] >> rmse[1] >> rmse[2] >> rmse[3];
+    CHECK_NEAR(px, replay_px, 1e-5 * max(1.0, fabs(replay_px)));
+    CHECK_NEAR(py, replay_py, 1e-5 * max(1.0, fabs(replay_py)));
+    for (int k = 0; k < 4; ++k) {
+      CHECK(std::isfinite(rmse[k]));
+    }
+  }
+  CHECK(lines[records.size()] == "ok");
+  CHECK(lines[records.size() + 1] == lines[0]);
+}
+
+/**
+ * Four concurrent clients on a server with small limits, which stops after
+ * their sessions: pipelined requests with a reset, more objects than
+ * max_tracks, a request longer than max_request_bytes and more requests
+ * than max_requests.
+ */
+void TestServer() {
+  ifstream in(kSampleLog);
+  ostringstream text;
+  text << in.rdbuf();
+  const string log_text = text.str();
+  const string first_line = log_text.substr(0, log_text.find('\n') + 1);
+  const size_t n_log_lines = Lines(log_text).size();
+
+  TrackerServer server;
+  server.port_ = 0;
+  server.num_threads_ = 2;
+  server.stop_after_sessions_ = 4;
+  server.limits_.max_tracks = 2;
+  server.limits_.max_request_bytes = 200;
+  server.limits_.max_requests = 600;
+  string error;
+  CHECK(server.Listen(&error));
+  CHECK(server.port() > 0);
+
+  ServerStats stats;
+  thread run([&]() { server.Run(&stats); });
+
+  string requests[4];
+  requests[0] = log_text + "reset\n" + first_line;
+  for (int object = 1; object <= 4; ++object) {
+    requests[1] += to_string(object == 4 ? 1 : object) + "\t" + first_line;
+  }
+  // nothing may follow a request that ends the session: unread data makes
+  // the server's close reset the connection
+  requests[2] = string(300, 'x') + "\n";
+  for (int i = 0; i < 600; ++i) {
+    requests[3] += "reset\n";
+  }
+  string responses[4];
+  vector<thread> clients;
+  for (int c = 0; c < 4; ++c) {
+    clients.push_back(thread([&, c]() { responses[c] = Exchange(server.port(), requests[c]); }));
+  }
+  for (size_t c = 0; c < clients.size(); ++c) {
+    clients[c].join();
+  }
+  run.join();
+
+  CheckPipelined(responses[0]);
+
+  const vector<string> track_limit = Lines(responses[1]);
+  CHECK(track_limit.size() == 4);
+  if (track_limit.size() == 4) {
+    CHECK(track_limit[0].substr(0, 6) != "error ");
+    CHECK(track_limit[1].substr(0, 6) != "error ");
+    CHECK(track_limit[2] == "error track limit");
+    CHECK(track_limit[3].substr(0, 6) != "error ");
+  }
+
+  CHECK(responses[2] == "error request too long\n");
+
+  const vector<string> request_limit = Lines(responses[3]);
+  CHECK(request_limit.size() == 601);
+  if (request_limit.size() == 601) {
+    CHECK(request_limit[599] == "ok");
+    CHECK(request_limit[600] == "error request limit");
+  }
+
+  CHECK(stats.sessions == 4);
+  CHECK(stats.refused_sessions == 0);
+  CHECK(stats.requests == (long long) (n_log_lines + 2 + 4 + 600));
+  CHECK(stats.errors == 2);
+}
+
+}  // namespace
+
+int main() {
+  TestServer();
+  return TestResult();
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "test_check.h"
+#include "coro_runtime.h"
+#include "object_log.h"
+#include "tracking_session.h"
+#include "ukf.h"
+
+using namespace std;
+
+namespace {
+
+const char kSampleLog[] = "../data/obj_pose-laser-radar-synthetic-input.txt";
+
+string ReadFile(const char* path) {
+  ifstream in(path);
+  ostringstream text;
+  text << in.rdbuf();
+  return text.str();
+}
+
+/**
+ * The rows of a session over the log, computed in order on this thread:
+ * one UKF per object ID, every measurement on its own.
+ */
+string ExpectedRows(const string& log_text) {
+  istringstream lines(log_text);
+  vector<LogRecord> records;
+  ObjectLog::ReadText(lines, &records);
+
+  string rows =
+      "time_stamp\tobject_id\tpx_state\tpy_state\tv_state\tyaw_angle_state\tyaw_rate_state\n";
+  unordered_map<long long, UKF> tracks;
+  char line[512];
+  for (size_t i = 0; i < records.size(); ++i) {
+    const MeasurementPackage& meas = records[i].measurement;
+    UKF& ukf = tracks[meas.object_id_];
+    ukf.ProcessMeasurement(meas);
+    const int length = snprintf(line, sizeof(line), "%lld\t%lld\t%g\t%g\t%g\t%g\t%g\n",
+                                meas.timestamp_, meas.object_id_, ukf.x_(0), ukf.x_(1),
+                                ukf.x_(2), ukf.x_(3), ukf.x_(4));
+    rows.append(line, length);
+  }
+  return rows;
+}
+
+/**
+ * A session reading and writing one socket. The socket buffers are small,
+ * so ingest waits for the client to write while publish waits for it to
+ * read, both on the same socket.
+ */
+void TestSessionOverSocket(const string& log_text) {
+  int fds[2];
+  CHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+  CHECK(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+  const int buffer_bytes = 4096;
+  for (int i = 0; i < 2; ++i) {
+    setsockopt(fds[i], SOL_SOCKET, SO_SNDBUF, &buffer_bytes, sizeof(buffer_bytes));
+    setsockopt(fds[i], SOL_SOCKET, SO_RCVBUF, &buffer_bytes, sizeof(buffer_bytes));
+  }
+
+  // the client blocks, its reader and writer run on separate threads; both
+  // move small pieces with pauses, so the session often waits for each
+  const size_t piece = 512;
+  string output;
+  thread reader([&]() {
+    char buffer[piece];
+    for (ssize_t n; (n = read(fds[1], buffer, sizeof(buffer))) > 0;) {
+      output.append(buffer, n);
+      this_thread::sleep_for(chrono::microseconds(1000));
+    }
+  });
+  thread writer([&]() {
+    size_t written = 0;
+    while (written < log_text.size()) {
+      const ssize_t n = write(fds[1], log_text.data() + written,
+                              min(piece, log_text.size() - written));
+      if (n <= 0) {
+        break;
+      }
+      written += n;
+      this_thread::sleep_for(chrono::microseconds(100));
+    }
+    shutdown(fds[1], SHUT_WR);
+  });
+
+  const SessionConfig config;
+  SessionStats stats;
+  Executor executor(2);
+  CHECK(SpawnTrackingSession(&executor, fds[0], fds[0], &config, &stats, function<void()>()));
+  executor.Run();
+  writer.join();
+  reader.join();
+  close(fds[1]);
+
+  CHECK(stats.late == 0);
+  CHECK(stats.rows == stats.measurements);
+  CHECK(output == ExpectedRows(log_text));
+}
+
+/**
+ * Many local sessions on a few executor threads: every session yields the
+ * rows of the in-order replay.
+ */
+void TestRunLocal(const string& log_text) {
+  const int n_sessions = 16;
+  const SessionConfig config;
+  vector<string> outputs;
+  vector<SessionStats> stats;
+  CHECK(TrackingSessions::RunLocal(log_text, n_sessions, 3, config, &outputs, &stats));
+  CHECK(outputs.size() == (size_t) n_sessions);
+  CHECK(stats.size() == (size_t) n_sessions);
+
+  const string expected = ExpectedRows(log_text);
+  for (int s = 0; s < n_sessions; ++s) {
+    CHECK(stats[s].late == 0);
+    CHECK(stats[s].rows == stats[s].measurements);
+    CHECK(outputs[s] == expected);
+  }
+}
+
+}  // namespace
+
+int main() {
+  const string log_text = ReadFile(kSampleLog);
+  CHECK(!log_text.empty());
+
+  TestSessionOverSocket(log_text);
+  TestRunLocal(log_text);
+  return TestResult();
+}
@@ -0,0 +1,474 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "test_check.h"
+#include "ukf.h"
+
+using namespace std;
+
+namespace {
+
+MeasurementPackage Laser(long long timestamp, double px, double py) {
+  MeasurementPackage meas;
+  meas.timestamp_ = timestamp;
+  meas.sensor_type_ = MeasurementPackage::LASER;
+  meas.raw_measurements_ = Eigen::Vector2d(px, py);
+  return meas;
+}
+
+MeasurementPackage Radar(long long timestamp, double rho, double phi, double rho_dot) {
+  MeasurementPackage meas;
+  meas.timestamp_ = timestamp;
+  meas.sensor_type_ = MeasurementPackage::RADAR;
+  meas.raw_measurements_ = Eigen::Vector3d(rho, phi, rho_dot);
+  return meas;
+}
+
+/**
+ * A filter that has seen a few measurements of an object moving along x.
+ */
+template <class Filter = UKF>
+Filter MovingTrack(long long start_us) {
+  Filter ukf;
+  for (int k = 0; k < 6; ++k) {
+    const long long t = start_us + k * 50000;
+    if (k % 2 == 0) {
+      ukf.ProcessMeasurement(Laser(t, 1.0 + 0.25 * k, 0.5));
+    } else {
+      const double px = 1.0 + 0.25 * k;
+      const double rho = sqrt(px * px + 0.25);
+      ukf.ProcessMeasurement(Radar(t, rho, atan2(0.5, px), 5.0 * px / rho));
+    }
+  }
+  return ukf;
+}
+
+/**
+ * Steps below the fusion threshold skip the prediction but must not lose the
+ * elapsed time: a run of 0.5 ms steps still predicts every other step.
+ */
+void TestSmallStepsAccumulate() {
+  UKF ukf;
+  ukf.ProcessMeasurement(Laser(0, 1.0, 1.0));
+  for (int k = 1; k <= 10; ++k) {
+    ukf.ProcessMeasurement(Laser(k * 500, 1.0, 1.0));
+  }
+  CHECK(ukf.hybrid_stats_.ukf_predictions == 5);
+  CHECK(ukf.time_us_ == 5000);
+
+  // a skipped step keeps the state time
+  ukf.ProcessMeasurement(Laser(5400, 1.0, 1.0));
+  CHECK(ukf.time_us_ == 5000);
+  CHECK(ukf.hybrid_stats_.ukf_predictions == 5);
+}
+
+/**
+ * The prediction uses the time step in double precision, also on absolute
+ * microsecond timestamps.
+ */
+void TestTimeStepPrecision() {
+  const long long start = 1477010443000000LL;
+  const UKF track = MovingTrack(start);
+  const MeasurementPackage next = Laser(track.time_us_ + 50000, 2.6, 0.52);
+
+  UKF processed = track;
+  processed.ProcessMeasurement(next);
+
+  UKF manual = track;
+  manual.Prediction(0.05);
+  manual.UpdateLidar(next);
+
+  CHECK(processed.x_ == manual.x_);
+  CHECK(processed.P_ == manual.P_);
+  CHECK(processed.time_us_ == next.timestamp_);
+}
+
+/**
+ * Every track's block of a rollout batch equals its own rollout and the
+ * single-query prediction at each step, for each sigma point rule.
+ */
+template <class Filter>
+void TestRolloutBatch() {
+  const long long start = 1477010443000000LL;
+  Filter tracks[3] = {MovingTrack<Filter>(start), MovingTrack<Filter>(start),
+                      MovingTrack<Filter>(start)};
+  tracks[1].x_(3) = -0.2;
+  tracks[2].x_(4) = 0.3;
+
+  const vector<const Filter*> batch = {&tracks[2], &tracks[0], &tracks[1]};
+  const int n_steps = 4;
+  const int stride = tracks[0].RolloutStride();
+  const long long first_step = tracks[0].time_us_ + 100000;
+  typename Filter::Workspace workspace;
+  vector<double> batch_buffer(batch.size() * n_steps * stride);
+  Filter::RolloutBatch(batch, first_step, 0.1, n_steps, &workspace, batch_buffer.data());
+
+  vector<double> single_buffer(n_steps * stride);
+  for (size_t t = 0; t < batch.size(); ++t) {
+    batch[t]->Rollout(first_step, 0.1, n_steps, &workspace, single_buffer.data());
+    const double* block = batch_buffer.data() + t * n_steps * stride;
+    CHECK(equal(single_buffer.begin(), single_buffer.end(), block));
+
+    for (int k = 0; k < n_steps; ++k) {
+      CTRVModel::StateVector x;
+      CTRVModel::StateMatrix P;
+      batch[t]->PredictAt(first_step + k * 100000, &x, &P);
+      const double* step = block + k * stride;
+      for (int i = 0; i < CTRVModel::kStateDim; ++i) {
+        CHECK_NEAR(step[i], x(i), 1e-9);
+      }
+      for (int i = 0; i < CTRVModel::kStateDim * CTRVModel::kStateDim; ++i) {
+        CHECK_NEAR(step[CTRVModel::kStateDim + i], P.data()[i], 1e-9);
+      }
+    }
+  }
+}
+
+/**
+ * A frame prediction of a range of tracks equals each track's own prediction
+ * step; the batch spans several kernel chunks and the workspace is reused
+ * for a smaller batch. Tracks outside the range and uninitialized tracks are
+ * left alone.
+ */
+template <class Filter>
+void TestPredictFrame() {
+  const long long start = 1477010443000000LL;
+  const int n_tracks = 10;
+  vector<Filter> tracks(n_tracks, MovingTrack<Filter>(start));
+  for (int t = 0; t < n_tracks; ++t) {
+    tracks[t].x_(0) += t;
+    tracks[t].x_(3) = -0.5 + 0.1 * t;
+  }
+  tracks[2] = Filter();
+  const vector<Filter> before = tracks;
+
+  vector<Filter*> frame;
+  for (int t = 0; t < n_tracks; ++t) {
+    frame.push_back(&tracks[t]);
+  }
+  typename Filter::Workspace workspace;
+  const long long first_frame = before[0].time_us_ + 100000;
+  Filter::PredictFrame(frame, 1, n_tracks, first_frame, &workspace);
+  Filter::PredictFrame(frame, 0, 1, first_frame + 50000, &workspace);
+
+  for (int t = 0; t < n_tracks; ++t) {
+    Filter expected = before[t];
+    if (t != 2) {
+      expected.Prediction(t == 0 ? 0.15 : 0.1);
+    }
+    CHECK(tracks[t].is_initialized_ == expected.is_initialized_);
+    for (int i = 0; i < expected.x_.size(); ++i) {
+      CHECK_NEAR(tracks[t].x_(i), expected.x_(i), 1e-12);
+    }
+    CHECK((tracks[t].P_ - expected.P_).cwiseAbs().maxCoeff() <= 1e-12);
+  }
+  CHECK(tracks[0].time_us_ == first_frame + 50000);
+  CHECK(tracks[1].time_us_ == first_frame);
+  CHECK(tracks[2].time_us_ == before[2].time_us_);
+}
+
+/**
+ * The constant velocity filter follows a straight track: its velocity
+ * converges to that of the track and a prediction stays on the line.
+ */
+void TestCVStraightTrack() {
+  CVUKF ukf;
+  for (int k = 0; k <= 60; ++k) {
+    const double t = 0.05 * k;
+    ukf.ProcessMeasurement(Laser(k * 50000LL, 1.0 + 3.0 * t, 2.0 + t));
+  }
+  CHECK_NEAR(ukf.x_(2), 3.0, 0.05);
+  CHECK_NEAR(ukf.x_(3), 1.0, 0.05);
+
+  const CVModel::StateVector before = ukf.x_;
+  ukf.Prediction(1.0);
+  CHECK_NEAR(ukf.x_(0), before(0) + before(2), 1e-9);
+  CHECK_NEAR(ukf.x_(1), before(1) + before(3), 1e-9);
+  CHECK_NEAR(ukf.x_(2), before(2), 1e-9);
+  CHECK_NEAR(ukf.x_(3), before(3), 1e-9);
+  CHECK_NEAR(ukf.x_(1) - 2.0, (ukf.x_(0) - 1.0) / 3.0, 0.05);
+}
+
+/**
+ * The CTRA transition of a single state without noise.
+ */
+CTRAModel::StateVector PropagateCTRA(const CTRAModel::StateVector& x, double delta_t) {
+  CTRAModel::AugSigma<1> x_aug;
+  x_aug << x, 0.0, 0.0;
+  const CTRAModel::TimeSteps<1> dt = CTRAModel::TimeSteps<1>::Constant(delta_t);
+  CTRAModel::StateSigma<1> x_pred;
+  CTRAModel::Propagate(x_aug, dt, &x_pred);
+  return x_pred;
+}
+
+/**
+ * CTRA moves a turning, accelerating state to the position of the integral
+ * of (v + a t) [cos sin](yaw + yawd t), here by Simpson's rule, and a
+ * straight one by v t + a t^2 / 2 along its heading.
+ */
+void TestCTRAClosedForm() {
+  const double dt = 0.8;
+  CTRAModel::StateVector x;
+  x << 1.0, 2.0, 3.0, 0.4, 0.5, 1.0;
+  const CTRAModel::StateVector x_pred = PropagateCTRA(x, dt);
+
+  const int n = 2000;
+  double px = x(0);
+  double py = x(1);
+  for (int i = 0; i <= n; ++i) {
+    const double t = dt * i / n;
+    const double weight = (i == 0 || i == n ? 1.0 : (i % 2 == 1 ? 4.0 : 2.0)) * dt / (3.0 * n);
+    px += weight * (x(2) + x(5) * t) * cos(x(3) + x(4) * t);
+    py += weight * (x(2) + x(5) * t) * sin(x(3) + x(4) * t);
+  }
+  CHECK_NEAR(x_pred(0), px, 1e-9);
+  CHECK_NEAR(x_pred(1), py, 1e-9);
+  CHECK_NEAR(x_pred(2), x(2) + x(5) * dt, 1e-12);
+  CHECK_NEAR(x_pred(3), x(3) + x(4) * dt, 1e-12);
+  CHECK_NEAR(x_pred(4), x(4), 1e-12);
+  CHECK_NEAR(x_pred(5), x(5), 1e-12);
+
+  x(4) = 0.0;
+  const CTRAModel::StateVector straight = PropagateCTRA(x, dt);
+  const double distance = x(2) * dt + 0.5 * x(5) * dt * dt;
+  CHECK_NEAR(straight(0), x(0) + distance * cos(x(3)), 1e-12);
+  CHECK_NEAR(straight(1), x(1) + distance * sin(x(3)), 1e-12);
+}
+
+/**
+ * The Jacobians of Linearize agree with central differences of Propagate,
+ * and its mean with the noise-free transition.
+ */
+template <class Model>
+void TestLinearize(const typename Model::StateVector& x, double delta_t) {
+  typename Model::StateVector x_lin;
+  typename Model::StateMatrix F;
+  typename Model::NoiseGain G;
+  Model::Linearize(x, delta_t, &x_lin, &F, &G);
+
+  const int n_aug = Model::kAugDim;
+  const double h = 1e-6;
+  const typename Model::template TimeSteps<1> dt =
+      Model::template TimeSteps<1>::Constant(delta_t);
+  typename Model::template AugSigma<1> x_aug;
+  x_aug.setZero();
+  x_aug.template head<Model::kStateDim>() = x;
+  typename Model::template StateSigma<1> mean;
+  Model::Propagate(x_aug, dt, &mean);
+  CHECK((x_lin - mean).cwiseAbs().maxCoeff() <= 1e-12);
+
+  for (int i = 0; i < n_aug; ++i) {
+    typename Model::template AugSigma<1> plus = x_aug;
+    typename Model::template AugSigma<1> minus = x_aug;
+    plus(i) += h;
+    minus(i) -= h;
+    typename Model::template StateSigma<1> x_plus;
+    typename Model::template StateSigma<1> x_minus;
+    Model::Propagate(plus, dt, &x_plus);
+    Model::Propagate(minus, dt, &x_minus);
+    const typename Model::StateVector derivative = (x_plus - x_minus) / (2 * h);
+    typename Model::StateVector analytic;
+    if (i < Model::kStateDim) {
+      analytic = F.col(i);
+    } else {
+      analytic = G.col(i - Model::kStateDim);
+    }
+    CHECK((analytic - derivative).cwiseAbs().maxCoeff() <= 1e-6);
+  }
+}
+
+/**
+ * Laser and radar measurements, alternating every 50 ms, of an object
+ * driving straight along y = 0.5 at 5 m/s.
+ */
+vector<MeasurementPackage> StraightTrack(long long start_us, int n_steps) {
+  vector<MeasurementPackage> track;
+  for (int k = 0; k < n_steps; ++k) {
+    const long long t = start_us + k * 50000;
+    const double px = 1.0 + 0.25 * k;
+    if (k % 2 == 0) {
+      track.push_back(Laser(t, px, 0.5));
+    } else {
+      const double rho = sqrt(px * px + 0.25);
+      track.push_back(Radar(t, rho, atan2(0.5, px), 5.0 * px / rho));
+    }
+  }
+  return track;
+}
+
+/**
+ * On a nearly linear track the hybrid filter takes the linearized paths and
+ * ends close to the sigma point filter. The yaw spread of this track settles
+ * around 0.065 rad per step, so the prediction threshold is raised.
+ */
+void TestHybridAgreesOnLinearTrack() {
+  const vector<MeasurementPackage> track = StraightTrack(1477010443000000LL, 60);
+  UKF sigma_points;
+  UKF hybrid;
+  hybrid.use_hybrid_ = true;
+  hybrid.hybrid_max_yaw_spread_ = 0.1;
+  for (size_t k = 0; k < track.size(); ++k) {
+    sigma_points.ProcessMeasurement(track[k]);
+    hybrid.ProcessMeasurement(track[k]);
+  }
+
+  CHECK(sigma_points.hybrid_stats_.ekf_predictions == 0);
+  CHECK(sigma_points.hybrid_stats_.ekf_updates == 0);
+  CHECK(hybrid.hybrid_stats_.ekf_predictions > 0);
+  CHECK(hybrid.hybrid_stats_.ekf_updates > 0);
+  CHECK(hybrid.hybrid_stats_.ekf_predictions + hybrid.hybrid_stats_.ukf_predictions ==
+        sigma_points.hybrid_stats_.ukf_predictions);
+
+  CHECK_NEAR(hybrid.x_(0), sigma_points.x_(0), 0.02);
+  CHECK_NEAR(hybrid.x_(1), sigma_points.x_(1), 0.02);
+  CHECK_NEAR(hybrid.x_(2), sigma_points.x_(2), 0.05);
+  CHECK_NEAR(hybrid.x_(3), sigma_points.x_(3), 0.02);
+  CHECK((hybrid.P_ - sigma_points.P_).cwiseAbs().maxCoeff() <= 0.01);
+}
+
+/**
+ * The hybrid filter linearizes a prediction only below
+ * hybrid_max_yaw_spread_ and a radar update only below
+ * hybrid_max_range_spread_; lidar updates are always linear.
+ */
+void TestHybridThresholds() {
+  const vector<MeasurementPackage> track = StraightTrack(1477010443000000LL, 20);
+  UKF trained;
+  trained.use_hybrid_ = true;
+  for (size_t k = 0; k < track.size(); ++k) {
+    trained.ProcessMeasurement(track[k]);
+  }
+  const double dt = 0.05;
+  const double yaw_spread = CTRVModel::Nonlinearity(trained.x_, trained.P_, dt);
+  CHECK(yaw_spread > 0.0);
+
+  for (int above = 0; above < 2; ++above) {
+    UKF ukf = trained;
+    const HybridStatistics before = ukf.hybrid_stats_;
+    ukf.hybrid_max_yaw_spread_ = yaw_spread * (above ? 0.99 : 1.01);
+    ukf.Prediction(dt);
+    CHECK(ukf.hybrid_stats_.ekf_predictions == before.ekf_predictions + (above ? 0 : 1));
+    CHECK(ukf.hybrid_stats_.ukf_predictions == before.ukf_predictions + (above ? 1 : 0));
+
+    // the radar sits at the origin
+    const double range = sqrt(ukf.x_(0) * ukf.x_(0) + ukf.x_(1) * ukf.x_(1));
+    const double range_spread = sqrt(ukf.P_(0, 0) + ukf.P_(1, 1)) / range;
+    const MeasurementPackage radar = track[track.size() - 1];
+    UKF radar_update = ukf;
+    radar_update.hybrid_max_range_spread_ = range_spread * (above ? 0.99 : 1.01);
+    radar_update.UpdateRadar(radar);
+    CHECK(radar_update.hybrid_stats_.ekf_updates == before.ekf_updates + (above ? 0 : 1));
+    CHECK(radar_update.hybrid_stats_.ukf_updates == before.ukf_updates + (above ? 1 : 0));
+
+    UKF lidar_update = ukf;
+    lidar_update.hybrid_max_range_spread_ = 0.0;
+    lidar_update.UpdateLidar(track[0]);
+    CHECK(lidar_update.hybrid_stats_.ekf_updates == before.ekf_updates + 1);
+  }
+}
+
+/**
+ * A joint laser/radar update agrees with a laser update followed by a radar
+ * update, for a shared timestamp and for timestamps closer than
+ * fusion_dt_threshold_, with either sensor first; the next step continues
+ * from the later timestamp.
+ */
+void TestFusedMatchesSequential(long long radar_offset_us) {
+  const vector<MeasurementPackage> track = StraightTrack(1477010443000000LL, 20);
+  UKF trained;
+  for (size_t k = 0; k < track.size(); ++k) {
+    trained.ProcessMeasurement(track[k]);
+  }
+  CHECK(fabs(radar_offset_us / 1000000.0) < trained.fusion_dt_threshold_);
+
+  const long long t = trained.time_us_ + 50000;
+  const double px = 6.0;
+  const double rho = sqrt(px * px + 0.25);
+  const MeasurementPackage laser = Laser(t, px, 0.5);
+  const MeasurementPackage radar =
+      Radar(t + radar_offset_us, rho, atan2(0.5, px), 5.0 * px / rho);
+
+  UKF fused = trained;
+  fused.ProcessFusedMeasurement(laser, radar);
+  UKF sequential = trained;
+  if (radar_offset_us < 0) {
+    sequential.ProcessMeasurement(radar);
+    sequential.ProcessMeasurement(laser);
+  } else {
+    sequential.ProcessMeasurement(laser);
+    sequential.ProcessMeasurement(radar);
+  }
+
+  CHECK(fused.hybrid_stats_.ukf_predictions == trained.hybrid_stats_.ukf_predictions + 1);
+  CHECK(fused.hybrid_stats_.ukf_updates == trained.hybrid_stats_.ukf_updates + 1);
+  CHECK(sequential.hybrid_stats_.ukf_predictions == trained.hybrid_stats_.ukf_predictions + 1);
+  CHECK(fused.time_us_ == max(laser.timestamp_, radar.timestamp_));
+  CHECK(std::isfinite(fused.NIS_laser_) && std::isfinite(fused.NIS_radar_));
+  for (int i = 0; i < CTRVModel::kStateDim; ++i) {
+    CHECK_NEAR(fused.x_(i), sequential.x_(i), 0.005);
+  }
+  CHECK((fused.P_ - sequential.P_).cwiseAbs().maxCoeff() <= 1e-4);
+
+  // the next step predicts over the full time since the fused pair
+  const MeasurementPackage next = Laser(t + 50000, px + 0.25, 0.5);
+  fused.ProcessMeasurement(next);
+  sequential.ProcessMeasurement(next);
+  CHECK(fused.time_us_ == next.timestamp_);
+  for (int i = 0; i < CTRVModel::kStateDim; ++i) {
+    CHECK_NEAR(fused.x_(i), sequential.x_(i), 0.005);
+  }
+}
+
+/**
+ * Each rule has its point count as a compile-time constant, and all rules
+ * agree on the first step of a nearly linear track.
+ */
+void TestRulePointCounts() {
+  static_assert(UKF::kSigmaCount == 15, "unscented: 2n+1 points");
+  static_assert(CubatureUKF::kSigmaCount == 14, "cubature: 2n points");
+  static_assert(SimplexUKF::kSigmaCount == 9, "simplex: n+2 points");
+
+  const long long start = 1477010443000000LL;
+  const UKF unscented = MovingTrack<UKF>(start);
+  const CubatureUKF cubature = MovingTrack<CubatureUKF>(start);
+  CHECK(unscented.Xsig_pred_.cols() == 15);
+  CHECK(cubature.Xsig_pred_.cols() == 14);
+  CHECK_NEAR(unscented.x_(0), cubature.x_(0), 0.05);
+  CHECK_NEAR(unscented.x_(1), cubature.x_(1), 0.05);
+}
+
+}  // namespace
+
+int main() {
+  TestSmallStepsAccumulate();
+  TestTimeStepPrecision();
+  TestRolloutBatch<UKF>();
+  TestRolloutBatch<CubatureUKF>();
+  TestRolloutBatch<SimplexUKF>();
+  TestPredictFrame<UKF>();
+  TestPredictFrame<SimplexUKF>();
+  TestPredictFrame<CTRAUKF>();
+  TestRulePointCounts();
+
+  TestCVStraightTrack();
+  TestCTRAClosedForm();
+  CVModel::StateVector x_cv;
+  x_cv << 1.0, 2.0, 3.0, -1.0;
+  TestLinearize<CVModel>(x_cv, 0.1);
+  CTRVModel::StateVector x_ctrv;
+  x_ctrv << 1.0, 2.0, 3.0, 0.4, 0.3;
+  TestLinearize<CTRVModel>(x_ctrv, 0.1);
+  x_ctrv(4) = -0.7;
+  TestLinearize<CTRVModel>(x_ctrv, 0.5);
+  CTRAModel::StateVector x_ctra;
+  x_ctra << 1.0, 2.0, 3.0, 0.4, 0.5, 1.0;
+  TestLinearize<CTRAModel>(x_ctra, 0.1);
+
+  TestHybridAgreesOnLinearTrack();
+  TestHybridThresholds();
+
+  TestFusedMatchesSequential(0);
+  TestFusedMatchesSequential(400);
+  TestFusedMatchesSequential(-400);
+  return TestResult();
+}
@@ -1,9 +1,10 @@
+#include <cmath>
 #include <iostream>
 //#include <math.h>
 #include "tools.h"
+#include "fast_math.h"
 
 using Eigen::VectorXd;
-using Eigen::MatrixXd;
 using std::vector;
 using std::cout;
 
@@ -16,8 +17,11 @@ VectorXd Tools::CalculateRMSE(const vector<VectorXd> &estimations,
   /**
     * Calculate the RMSE here.
   */
-   VectorXd rmse(4);
-  rmse << 0, 0, 0, 0;
+  // zeros on invalid input, of the dimension of the data if there is any
+  // and of [px py vx vy] otherwise
+  const int dim = !estimations.empty() ? estimations[0].size() :
+                  !ground_truth.empty() ? ground_truth[0].size() : 4;
+  VectorXd rmse = VectorXd::Zero(dim);
 
   // check the validity of the following inputs:
   //  * the estimation vector size should not be zero
@@ -27,14 +31,9 @@ VectorXd Tools::CalculateRMSE(const vector<VectorXd> &estimations,
     return rmse;
   }
 
-  //accumulate squared residuals
+  //accumulate squared residuals, any dimension
   for (unsigned int i = 0; i < estimations.size(); ++i) {
-
-    VectorXd residual = estimations[i] - ground_truth[i];
-
-    //coefficient-wise multiplication
-    residual = residual.array() * residual.array();
-    rmse += residual;
+    rmse.array() += (estimations[i] - ground_truth[i]).array().square();
   }
 
   //calculate the mean
@@ -48,8 +47,23 @@ VectorXd Tools::CalculateRMSE(const vector<VectorXd> &estimations,
 }
 
 double Tools::NormalizeAngle(double x){
+#ifdef UKF_FAST_MATH
+    return FastMath::WrapAngle(x);
+#else
     x = fmod(x + M_PI,2*M_PI);
     if (x < 0)
         x += 2*M_PI;
     return x - M_PI;
+#endif
+}
+
+void Tools::NormalizeAngles(double* angles, int n){
+    //subtract the nearest multiple of 2 pi, nearbyint rounds without
+    //branches and stays correct under -ffast-math
+    const double kTwoPi = 2*M_PI;
+    const double kInvTwoPi = 1.0/kTwoPi;
+
+    for (int i = 0; i < n; ++i) {
+        angles[i] -= std::nearbyint(angles[i]*kInvTwoPi)*kTwoPi;
+    }
 }
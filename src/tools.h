@@ -17,9 +17,40 @@ public:
 
   /**
   * A helper method to calculate RMSE.
+  * Returns zeros on invalid input (no data or different counts), of the
+  * dimension of the data if there is any, otherwise 4 [px py vx vy].
   */
   static Eigen::VectorXd CalculateRMSE(const std::vector<Eigen::VectorXd> &estimations, const std::vector<Eigen::VectorXd> &ground_truth);
   static double NormalizeAngle(double x);
+
+  /**
+  * Wraps n contiguous angles to [-pi, pi] in place by subtracting the
+  * nearest multiple of 2 pi. The loop has unit stride and no branches, so
+  * it vectorizes on targets with a vector rounding instruction (SSE4.1,
+  * AVX, NEON). NaN stays NaN.
+  * @param angles The angles
+  * @param n Number of angles
+  */
+  static void NormalizeAngles(double* angles, int n);
+
+  /**
+  * Wraps every angle in one row of a matrix to [-pi, pi] in place. The row
+  * is strided in the column-major matrix, so it is copied to a contiguous
+  * buffer, wrapped by NormalizeAngles and copied back; the buffer is on the
+  * stack for fixed-size matrices.
+  * @param M Matrix holding angles in one row, e.g. sigma point deviations
+  * @param row The row to normalize
+  */
+  template <typename Derived>
+  static void NormalizeAngleRow(Eigen::MatrixBase<Derived>* M, int row);
 };
 
+template <typename Derived>
+void Tools::NormalizeAngleRow(Eigen::MatrixBase<Derived>* M, int row) {
+  Eigen::Matrix<double, Derived::ColsAtCompileTime, 1, Eigen::DontAlign,
+                Derived::MaxColsAtCompileTime, 1> angles = M->row(row).transpose();
+  NormalizeAngles(angles.data(), angles.size());
+  M->row(row) = angles.transpose();
+}
+
 #endif /* TOOLS_H_ */
@@ -0,0 +1,303 @@
+#ifndef TRACK_SNAPSHOT_H_
+#define TRACK_SNAPSHOT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "track_state.h"
+#include "slot_map.h"
+
+/**
+* What readers see of one track: its compact state and the latest NIS.
+*/
+template <int N>
+struct TrackRecord {
+  ///* the track in its table
+  SlotHandle handle;
+
+  ///* time, state and packed covariance
+  TrackState<N> state;
+
+  ///* the current NIS for laser and radar
+  double nis_laser;
+  double nis_radar;
+};
+
+/**
+* Seqlock around the published record of a single track. The filter thread
+* publishes after each update without waiting; readers copy the record and
+* retry if a publication overlapped, so they never block the writer. The
+* record is stored as relaxed atomic words, which compile to plain moves.
+* Only one thread may publish.
+*/
+template <int N>
+class TrackSeqlock {
+public:
+
+  TrackSeqlock() : sequence_(0) {
+    for (int i = 0; i < kWords; ++i) {
+      words_[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+  * Publishes the current state of a filter.
+  * @param filter A ModelUKF with a state dimension of N
+  * @param handle The track in its table
+  */
+  template <class Filter>
+  void Publish(const Filter& filter, SlotHandle handle = SlotHandle()) {
+    TrackRecord<N> record;
+    record.handle = handle;
+    filter.SaveState(&record.state);
+    record.nis_laser = filter.NIS_laser_;
+    record.nis_radar = filter.NIS_radar_;
+    Publish(record);
+  }
+
+  /**
+  * Publishes a record.
+  * @param record The record
+  */
+  void Publish(const TrackRecord<N>& record) {
+    uint64_t words[kWords];
+    memcpy(words, &record, sizeof(record));
+
+    //odd while writing
+    const uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < kWords; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  /**
+  * Copies the record if no publication overlaps.
+  * @param record_out The record
+  * @param version_out Number of the publication copied, see version; may be
+  * nullptr
+  * @return false if a publication overlapped, record_out is then undefined
+  */
+  bool TryRead(TrackRecord<N>* record_out, uint64_t* version_out = nullptr) const {
+    const uint64_t before = sequence_.load(std::memory_order_acquire);
+    if (before & 1) {
+      return false;
+    }
+    uint64_t words[kWords];
+    for (int i = 0; i < kWords; ++i) {
+      words[i] = words_[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) != before) {
+      return false;
+    }
+    memcpy(record_out, words, sizeof(*record_out));
+    if (version_out != nullptr) {
+      *version_out = before / 2;
+    }
+    return true;
+  }
+
+  /**
+  * Copies a consistent record, retrying while publications overlap.
+  * @param record_out The record
+  * @return Number of the publication copied, see version
+  */
+  uint64_t Read(TrackRecord<N>* record_out) const {
+    uint64_t version;
+    while (!TryRead(record_out, &version)) {
+    }
+    return version;
+  }
+
+  /**
+  * Number of publications so far.
+  */
+  uint64_t version() const {
+    return sequence_.load(std::memory_order_acquire) / 2;
+  }
+
+private:
+  static const int kWords = (sizeof(TrackRecord<N>) + 7) / 8;
+
+  std::atomic<uint64_t> sequence_;
+  std::atomic<uint64_t> words_[kWords];
+};
+
+/**
+* A filter next to the seqlock it is published through. Track banks keep
+* these in a SlotMap, whose elements never move, so a reader on another
+* thread may hold a pointer to the seqlock while the bank grows.
+*/
+template <class Filter, int N>
+struct PublishedTrack {
+  explicit PublishedTrack(const Filter& prototype) : filter(prototype) {}
+
+  ///* the track's filter, only touched by the thread that publishes
+  Filter filter;
+
+  ///* its state after the last update
+  TrackSeqlock<N> published;
+
+private:
+  PublishedTrack(const PublishedTrack&);
+  PublishedTrack& operator=(const PublishedTrack&);
+};
+
+/**
+* Consistent view of a whole track table at one point of the filter loop.
+*/
+template <int N>
+struct TrackTableSnapshot {
+  ///* publication counter of the writer
+  uint64_t epoch;
+
+  ///* time of the last processed measurement in us
+  long long time_us;
+
+  ///* all tracks, in the dense order of the table
+  std::vector<TrackRecord<N> > tracks;
+};
+
+/**
+* Lock-free snapshots of a track table for many reader threads, RCU-style
+* with a fixed ring of buffers. The writer (filter thread) fills a buffer
+* that no reader holds and publishes it with one atomic store; readers pin
+* the current buffer with a reference count and never wait. A buffer is
+* only rewritten once all its readers left, so a pinned snapshot stays
+* consistent for as long as it is held. With kBuffers >= 3 the writer
+* always finds a free buffer unless readers hold two old snapshots at once;
+* then the publication is skipped instead of blocking the filter. Buffers
+* keep their capacity, so steady-state publishing does not allocate.
+* Only one thread may publish.
+*/
+template <int N, int kBuffers = 3>
+class TrackSnapshots {
+public:
+
+  /**
+  * Pins a snapshot while in scope.
+  */
+  class Reader {
+  public:
+    Reader(const TrackSnapshots* owner, int buffer) : owner_(owner), buffer_(buffer) {}
+    Reader(Reader&& other) : owner_(other.owner_), buffer_(other.buffer_) {
+      other.owner_ = nullptr;
+    }
+    ~Reader() {
+      if (owner_ != nullptr) {
+        owner_->readers_[buffer_].fetch_sub(1);
+      }
+    }
+
+    const TrackTableSnapshot<N>& operator*() const {
+      return owner_->buffers_[buffer_];
+    }
+    const TrackTableSnapshot<N>* operator->() const {
+      return &owner_->buffers_[buffer_];
+    }
+
+  private:
+    Reader(const Reader&);
+    Reader& operator=(const Reader&);
+
+    const TrackSnapshots* owner_;
+    int buffer_;
+  };
+
+  TrackSnapshots() : current_(0), epoch_(0) {
+    for (int i = 0; i < kBuffers; ++i) {
+      readers_[i].store(0);
+      buffers_[i].epoch = 0;
+      buffers_[i].time_us = 0;
+    }
+  }
+
+  /**
+  * Publishes the state of every filter in a track table.
+  * @param tracks The filters, ModelUKFs with a state dimension of N
+  * @param time_us Time of the last processed measurement in us
+  * @return false if readers held every spare buffer and the publication
+  * was skipped
+  */
+  template <class Filter, int kChunkSize>
+  bool Publish(const SlotMap<Filter, kChunkSize>& tracks, long long time_us) {
+
+    TrackTableSnapshot<N>* snapshot = BeginPublish();
+    if (snapshot == nullptr) {
+      return false;
+    }
+
+    snapshot->time_us = time_us;
+    snapshot->tracks.resize(tracks.size());
+    for (size_t i = 0; i < tracks.size(); ++i) {
+      const Filter& filter = tracks.AtDense(i);
+      TrackRecord<N>& record = snapshot->tracks[i];
+      record.handle = tracks.HandleAtDense(i);
+      filter.SaveState(&record.state);
+      record.nis_laser = filter.NIS_laser_;
+      record.nis_radar = filter.NIS_radar_;
+    }
+
+    EndPublish();
+    return true;
+  }
+
+  /**
+  * Low-level publication: returns a buffer no reader holds, to be filled
+  * and then published with EndPublish.
+  * @return The buffer, nullptr if readers hold all spare buffers
+  */
+  TrackTableSnapshot<N>* BeginPublish() {
+    const int current = current_.load();
+    for (int i = 1; i < kBuffers; ++i) {
+      const int candidate = (current + i) % kBuffers;
+      if (readers_[candidate].load() == 0) {
+        writing_ = candidate;
+        return &buffers_[candidate];
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+  * Makes the buffer of the last BeginPublish the current snapshot.
+  */
+  void EndPublish() {
+    buffers_[writing_].epoch = ++epoch_;
+    current_.store(writing_);
+  }
+
+  /**
+  * Pins the latest snapshot; never blocks.
+  */
+  Reader Read() const {
+    for (;;) {
+      const int buffer = current_.load();
+      readers_[buffer].fetch_add(1);
+      //the writer may have moved on and started to reuse the buffer between
+      //the two loads, only keep the pin if it is still current
+      if (current_.load() == buffer) {
+        return Reader(this, buffer);
+      }
+      readers_[buffer].fetch_sub(1);
+    }
+  }
+
+private:
+  TrackSnapshots(const TrackSnapshots&);
+  TrackSnapshots& operator=(const TrackSnapshots&);
+
+  TrackTableSnapshot<N> buffers_[kBuffers];
+  mutable std::atomic<int> readers_[kBuffers];
+  std::atomic<int> current_;
+
+  ///* writer only
+  int writing_;
+  uint64_t epoch_;
+};
+
+#endif /* TRACK_SNAPSHOT_H_ */
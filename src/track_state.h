@@ -0,0 +1,27 @@
+#ifndef TRACK_STATE_H_
+#define TRACK_STATE_H_
+
+#include "packed_covariance.h"
+
+/**
+* Compact stored state of one track: timestamp, state vector and the packed
+* state covariance. Plain data without heap allocations, so large track
+* tables stay contiguous (168 bytes per CTRV track instead of two Eigen heap
+* blocks plus headers).
+*/
+template <int N>
+struct TrackState {
+  ///* state dimension
+  static const int kStateDim = N;
+
+  ///* time when the state is true, in us
+  long long time_us;
+
+  ///* state vector
+  double x[N];
+
+  ///* state covariance matrix, upper triangle
+  PackedCovariance<N> P;
+};
+
+#endif /* TRACK_STATE_H_ */
@@ -0,0 +1,207 @@
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "coro_runtime.h"
+
+using namespace std;
+
+/**
+ * Local stand-in for the simulator: runs many sessions of one log against a
+ * tracker server, see tracker_server.h, and checks that they agree.
+ */
+
+namespace {
+
+/**
+ * Outcome of one client session.
+ */
+struct ClientResult {
+  bool connected;
+  long long replies;
+  long long errors;
+  string last_reply;
+};
+
+/**
+ * One session: sends the log in windows of pipelined requests and reads the
+ * replies of each window before sending the next.
+ */
+Task RunClient(Executor* executor, const sockaddr_in* address, const vector<string>* lines,
+               size_t window, ClientResult* result) {
+  result->connected = false;
+  result->replies = 0;
+  result->errors = 0;
+
+  const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    co_return;
+  }
+  if (connect(fd, reinterpret_cast<const sockaddr*>(address), sizeof(*address)) != 0) {
+    if (errno != EINPROGRESS) {
+      close(fd);
+      co_return;
+    }
+    co_await executor->Writable(fd);
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+    if (error != 0) {
+      executor->Forget(fd);
+      close(fd);
+      co_return;
+    }
+  }
+  result->connected = true;
+  const int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  string requests;
+  string received;
+  char buffer[16 * 1024];
+  bool open = true;
+  for (size_t first = 0; first < lines->size() && open; first += window) {
+    const size_t last = min(first + window, lines->size());
+    requests.clear();
+    for (size_t i = first; i < last; ++i) {
+      requests += (*lines)[i];
+      requests += '\n';
+    }
+
+    size_t sent = 0;
+    while (sent < requests.size()) {
+      const ssize_t n = send(fd, requests.data() + sent, requests.size() - sent, MSG_NOSIGNAL);
+      if (n >= 0) {
+        sent += n;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        co_await executor->Writable(fd);
+      } else if (errno != EINTR) {
+        open = false;
+        break;
+      }
+    }
+
+    // one reply per request
+    size_t expected = last - first;
+    while (open && expected > 0) {
+      const size_t newline = received.find('\n');
+      if (newline != string::npos) {
+        result->last_reply = received.substr(0, newline);
+        received.erase(0, newline + 1);
+        ++result->replies;
+        result->errors += result->last_reply.compare(0, 5, "error") == 0;
+        --expected;
+        continue;
+      }
+      const ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+      if (n > 0) {
+        received.append(buffer, n);
+      } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        co_await executor->Readable(fd);
+      } else if (n == 0 || errno != EINTR) {
+        open = false;
+      }
+    }
+  }
+
+  executor->Forget(fd);
+  close(fd);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  string usage_instructions = "Usage instructions: ";
+  usage_instructions += argv[0];
+  usage_instructions += " path/to/input.txt [--host 127.0.0.1] [--port P] [-n sessions]"
+                        " [-j threads] [--window requests]";
+
+  string in_name;
+  string host = "127.0.0.1";
+  int port = 4567;
+  int num_sessions = 1;
+  int num_threads = 0;
+  size_t window = 1;
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (arg == "--host" && i + 1 < argc) {
+      host = argv[++i];
+    } else if (arg == "--port" && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if (arg == "-n" && i + 1 < argc) {
+      num_sessions = atoi(argv[++i]);
+    } else if (arg == "-j" && i + 1 < argc) {
+      num_threads = atoi(argv[++i]);
+    } else if (arg == "--window" && i + 1 < argc) {
+      window = max(atoi(argv[++i]), 1);
+    } else if (arg[0] != '-' && in_name.empty()) {
+      in_name = arg;
+    } else {
+      cerr << "Unknown option " << arg << ".\n" << usage_instructions << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (in_name.empty()) {
+    cerr << usage_instructions << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  ifstream in_file(in_name.c_str(), ifstream::in);
+  if (!in_file.good()) {
+    cerr << "Cannot open file: " << in_name << endl;
+    exit(EXIT_FAILURE);
+  }
+  vector<string> lines;
+  string line;
+  while (getline(in_file, line)) {
+    if (!line.empty()) {
+      lines.push_back(line);
+    }
+  }
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+    cerr << "Not an IPv4 address: " << host << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  vector<ClientResult> results(num_sessions);
+  const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  {
+    Executor executor(num_threads);
+    for (int s = 0; s < num_sessions; ++s) {
+      executor.Spawn(RunClient(&executor, &address, &lines, window, &results[s]));
+    }
+    executor.Run();
+  }
+  const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  int n_connected = 0;
+  int n_identical = 0;
+  long long n_replies = 0;
+  long long n_errors = 0;
+  for (size_t s = 0; s < results.size(); ++s) {
+    n_connected += results[s].connected;
+    n_identical += results[s].last_reply == results[0].last_reply;
+    n_replies += results[s].replies;
+    n_errors += results[s].errors;
+  }
+  cout << "Sessions " << num_sessions << ", connected " << n_connected << ", replies "
+       << n_replies << ", errors " << n_errors << ", " << n_replies / seconds
+       << " requests/s" << endl;
+  cout << "Last reply " << results[0].last_reply << ", identical in " << n_identical
+       << " sessions" << endl;
+  return n_connected == num_sessions && n_errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,344 @@
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "coro_runtime.h"
+#include "object_log.h"
+#include "slot_map.h"
+#include "tracker_server.h"
+#include "ukf.h"
+
+using namespace std;
+
+// bytes read from a client at a time
+static const size_t kReadChunk = 16 * 1024;
+
+SessionLimits::SessionLimits()
+    : max_tracks(256),
+      max_request_bytes(1024),
+      max_requests(0) {}
+
+ServerStats::ServerStats() : sessions(0), refused_sessions(0), requests(0), errors(0) {}
+
+TrackerServer::TrackerServer()
+    : port_(4567),
+      num_threads_(0),
+      max_sessions_(1024),
+      stop_after_sessions_(0),
+      listen_fd_(-1),
+      bound_port_(0) {}
+
+namespace {
+
+/**
+ * State shared by the accept loop and the sessions of a run.
+ */
+struct ServerState {
+  Executor* executor;
+  const TrackerServer* server;
+  int listen_fd;
+
+  atomic<long long> active;
+  atomic<long long> ended;
+  atomic<bool> stopping;
+
+  atomic<long long> sessions;
+  atomic<long long> refused_sessions;
+  atomic<long long> requests;
+  atomic<long long> errors;
+
+  /**
+   * Called by every session when it has closed its connection.
+   */
+  void SessionEnded() {
+    --active;
+    const long long stop_after = server->stop_after_sessions_;
+    if (stop_after > 0 && ++ended >= stop_after && !stopping.exchange(true)) {
+      // wakes the accept loop, whose next accept fails
+      shutdown(listen_fd, SHUT_RDWR);
+    }
+  }
+};
+
+/**
+ * The track bank and RMSE accumulator of one client. A session only runs on
+ * one thread at a time and nothing else reads its tracks, so replies are
+ * formed from the filters directly.
+ */
+class ClientSession {
+public:
+  explicit ClientSession(const SessionLimits& limits) : limits_(limits), n_ground_truth_(0) {
+    Reset();
+  }
+
+  /**
+   * Answers one request line.
+   * @return false if the request was refused
+   */
+  bool Handle(const string& line, string* reply_out) {
+    if (line == "reset") {
+      Reset();
+      reply_out->append("ok\n");
+      return true;
+    }
+
+    records_.clear();
+    istringstream in(line);
+    ObjectLog::ReadText(in, &records_);
+    if (records_.size() != 1) {
+      reply_out->append("error malformed request\n");
+      return false;
+    }
+    const MeasurementPackage& meas = records_[0].measurement;
+
+    // association by object ID, within the track limit
+    unordered_map<long long, SlotHandle>::iterator found = track_of_.find(meas.object_id_);
+    if (found == track_of_.end()) {
+      if (tracks_.size() >= limits_.max_tracks) {
+        reply_out->append("error track limit\n");
+        return false;
+      }
+      found = track_of_.insert(make_pair(meas.object_id_, tracks_.Emplace(prototype_))).first;
+    }
+    UKF& ukf = *tracks_.Get(found->second);
+    ukf.ProcessMeasurement(meas);
+    const UKF::StateVector& x = ukf.x_;
+
+    // squared errors of [px py vx vy] against the ground truth, if given
+    const Eigen::VectorXd& gt = records_[0].ground_truth.gt_values_;
+    if (gt.allFinite()) {
+      const double estimate[4] = {x[0], x[1], x[2] * cos(x[3]), x[2] * sin(x[3])};
+      for (int i = 0; i < 4; ++i) {
+        squared_error_[i] += (estimate[i] - gt(i)) * (estimate[i] - gt(i));
+      }
+      ++n_ground_truth_;
+    }
+
+    double rmse[4];
+    for (int i = 0; i < 4; ++i) {
+      rmse[i] = n_ground_truth_ > 0 ? sqrt(squared_error_[i] / n_ground_truth_) : NAN;
+    }
+    char line_out[256];
+    const int length = snprintf(line_out, sizeof(line_out), "%.9g %.9g %.9g %.9g %.9g %.9g\n",
+                                x[0], x[1], rmse[0], rmse[1], rmse[2], rmse[3]);
+    reply_out->append(line_out, length);
+    return true;
+  }
+
+private:
+  void Reset() {
+    tracks_.Clear();
+    track_of_.clear();
+    for (int i = 0; i < 4; ++i) {
+      squared_error_[i] = 0.0;
+    }
+    n_ground_truth_ = 0;
+  }
+
+  const SessionLimits& limits_;
+  const UKF prototype_;
+  SlotMap<UKF> tracks_;
+  unordered_map<long long, SlotHandle> track_of_;
+  vector<LogRecord> records_;
+
+  double squared_error_[4];
+  long long n_ground_truth_;
+};
+
+/**
+ * One client connection: reads request lines, answers each in order and
+ * closes once the client has closed its side or broke a limit.
+ */
+Task Serve(ServerState* state, int fd) {
+  Executor& executor = *state->executor;
+  const SessionLimits& limits = state->server->limits_;
+  ClientSession session(limits);
+  vector<char> buffer(kReadChunk);
+  string pending;
+  string replies;
+  long long n_requests = 0;
+
+  for (bool open = true; open;) {
+    const ssize_t n = recv(fd, buffer.data(), buffer.size(), 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      co_await executor.Readable(fd);
+      continue;
+    }
+    if (n > 0) {
+      pending.append(buffer.data(), n);
+    } else {
+      // the client is done, a last line may lack its newline
+      open = false;
+      if (!pending.empty()) {
+        pending.push_back('\n');
+      }
+    }
+
+    // answer every complete line
+    size_t begin = 0;
+    for (size_t end; open || begin < pending.size(); begin = end + 1) {
+      end = pending.find('\n', begin);
+      if (end == string::npos) {
+        break;
+      }
+      string line = pending.substr(begin, end - begin);
+      if (!line.empty() && line[line.size() - 1] == '\r') {
+        line.resize(line.size() - 1);
+      }
+      if (line.empty()) {
+        continue;
+      }
+      if (line.size() > limits.max_request_bytes) {
+        replies.append("error request too long\n");
+        ++state->errors;
+        open = false;
+        break;
+      }
+      ++state->requests;
+      if (!session.Handle(line, &replies)) {
+        ++state->errors;
+      }
+      if (limits.max_requests > 0 && ++n_requests >= limits.max_requests) {
+        replies.append("error request limit\n");
+        open = false;
+        break;
+      }
+    }
+    pending.erase(0, min(begin, pending.size()));
+    // an unfinished line that is already too long, unless a complete one
+    // has just ended the session
+    if (open && pending.size() > limits.max_request_bytes) {
+      replies.append("error request too long\n");
+      ++state->errors;
+      open = false;
+    }
+
+    // send the answers, suspending while the client is behind
+    size_t sent = 0;
+    while (sent < replies.size()) {
+      const ssize_t m = send(fd, replies.data() + sent, replies.size() - sent, MSG_NOSIGNAL);
+      if (m >= 0) {
+        sent += m;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        co_await executor.Writable(fd);
+      } else if (errno != EINTR) {
+        open = false;
+        break;
+      }
+    }
+    replies.clear();
+  }
+
+  executor.Forget(fd);
+  close(fd);
+  state->SessionEnded();
+}
+
+Task Accept(ServerState* state) {
+  Executor& executor = *state->executor;
+  const TrackerServer& server = *state->server;
+
+  for (;;) {
+    const int fd = accept4(state->listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd >= 0) {
+      if ((size_t) state->active.load() >= server.max_sessions_) {
+        static const char kFull[] = "error server full\n";
+        ssize_t sent = send(fd, kFull, sizeof(kFull) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+        (void) sent;
+        close(fd);
+        ++state->refused_sessions;
+        continue;
+      }
+      // responses are small and should leave at once
+      const int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      ++state->active;
+      ++state->sessions;
+      executor.Spawn(Serve(state, fd));
+      continue;
+    }
+    if (state->stopping) {
+      break;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      co_await executor.Readable(state->listen_fd);
+    } else if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+      // out of descriptors or memory: let the sessions run and end first
+      co_await executor.Yield();
+    } else if (errno != EINTR && errno != ECONNABORTED) {
+      break;
+    }
+  }
+  executor.Forget(state->listen_fd);
+}
+
+}  // namespace
+
+bool TrackerServer::Listen(string* error_out) {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    *error_out = string("socket failed: ") + strerror(errno);
+    return false;
+  }
+  const int one = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port_);
+  if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(listen_fd_, SOMAXCONN) != 0) {
+    *error_out = "cannot listen on port " + to_string(port_) + ": " + strerror(errno);
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+
+  socklen_t length = sizeof(address);
+  getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+  bound_port_ = ntohs(address.sin_port);
+  return true;
+}
+
+void TrackerServer::Run(ServerStats* stats_out) {
+
+  // a client that goes away must not kill the server
+  signal(SIGPIPE, SIG_IGN);
+
+  Executor executor(num_threads_);
+  ServerState state;
+  state.executor = &executor;
+  state.server = this;
+  state.listen_fd = listen_fd_;
+  state.active = 0;
+  state.ended = 0;
+  state.stopping = false;
+  state.sessions = 0;
+  state.refused_sessions = 0;
+  state.requests = 0;
+  state.errors = 0;
+
+  executor.Spawn(Accept(&state));
+  executor.Run();
+  close(listen_fd_);
+  listen_fd_ = -1;
+
+  stats_out->sessions = state.sessions;
+  stats_out->refused_sessions = state.refused_sessions;
+  stats_out->requests = state.requests;
+  stats_out->errors = state.errors;
+}
@@ -0,0 +1,105 @@
+#ifndef TRACKER_SERVER_H_
+#define TRACKER_SERVER_H_
+
+#include <cstddef>
+#include <string>
+
+/**
+* Limits of one client session.
+*/
+struct SessionLimits {
+  ///* objects tracked at once, measurements of further objects are refused
+  size_t max_tracks;
+
+  ///* longest request line in bytes, a longer one ends the session
+  size_t max_request_bytes;
+
+  ///* requests per session, 0 for no limit
+  long long max_requests;
+
+  SessionLimits();
+};
+
+/**
+* Counters of a server run.
+*/
+struct ServerStats {
+  ///* sessions served, and sessions turned away at max_sessions_
+  long long sessions;
+  long long refused_sessions;
+
+  ///* requests answered, and those answered with an error
+  long long requests;
+  long long errors;
+
+  ServerStats();
+};
+
+/**
+* Tracker server for many concurrent simulator clients. Every TCP connection
+* is a session with its own track bank (one UKF per object ID) and its own
+* RMSE accumulator; sessions are coroutines on an epoll executor, see
+* coro_runtime.h, so a few threads serve many parallel scenarios.
+*
+* Protocol, one text line per request and one per response, requests may be
+* pipelined:
+*   request   a measurement in the log format, see ObjectLog,
+*               [object_id] L px py timestamp [px_gt py_gt vx_gt vy_gt]
+*               [object_id] R rho phi rho_dot timestamp [px_gt py_gt vx_gt vy_gt]
+*             or "reset" to drop the tracks and the RMSE of the session
+*   response  "px py rmse_px rmse_py rmse_vx rmse_vy" with the estimate of the
+*             measured object and the session RMSE over all requests with
+*             ground truth (nan before the first), "ok" after a reset, or
+*             "error <reason>"
+* A session ends when the client closes its side, after the pending
+* responses are sent.
+*/
+class TrackerServer {
+public:
+
+  ///* TCP port, 0 for any free port
+  int port_;
+
+  ///* executor threads, 0 for one per core
+  int num_threads_;
+
+  ///* sessions at once, further clients get an error and are closed
+  size_t max_sessions_;
+
+  ///* the server returns after this many sessions, 0 to serve forever
+  long long stop_after_sessions_;
+
+  ///* limits of every session
+  SessionLimits limits_;
+
+  TrackerServer();
+
+  /**
+  * Binds the listening socket.
+  * @param error_out Reason of a failure
+  * @return false on failure
+  */
+  bool Listen(std::string* error_out);
+
+  /**
+  * The bound port, after Listen.
+  */
+  int port() const {
+    return bound_port_;
+  }
+
+  /**
+  * Serves clients until stop_after_sessions_ sessions have ended.
+  * @param stats_out Counters of the run
+  */
+  void Run(ServerStats* stats_out);
+
+private:
+  TrackerServer(const TrackerServer&);
+  TrackerServer& operator=(const TrackerServer&);
+
+  int listen_fd_;
+  int bound_port_;
+};
+
+#endif /* TRACKER_SERVER_H_ */
@@ -0,0 +1,47 @@
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+#include "tracker_server.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+  string usage_instructions = "Usage instructions: ";
+  usage_instructions += argv[0];
+  usage_instructions += " [--port P] [-j threads] [--max-sessions N] [--max-tracks N]"
+                        " [--max-requests N] [--stop-after N]";
+
+  TrackerServer server;
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (arg == "--port" && i + 1 < argc) {
+      server.port_ = atoi(argv[++i]);
+    } else if (arg == "-j" && i + 1 < argc) {
+      server.num_threads_ = atoi(argv[++i]);
+    } else if (arg == "--max-sessions" && i + 1 < argc) {
+      server.max_sessions_ = atoll(argv[++i]);
+    } else if (arg == "--max-tracks" && i + 1 < argc) {
+      server.limits_.max_tracks = atoll(argv[++i]);
+    } else if (arg == "--max-requests" && i + 1 < argc) {
+      server.limits_.max_requests = atoll(argv[++i]);
+    } else if (arg == "--stop-after" && i + 1 < argc) {
+      server.stop_after_sessions_ = atoll(argv[++i]);
+    } else {
+      cerr << "Unknown option " << arg << ".\n" << usage_instructions << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  string error;
+  if (!server.Listen(&error)) {
+    cerr << error << endl;
+    exit(EXIT_FAILURE);
+  }
+  cout << "Listening on port " << server.port() << endl;
+
+  ServerStats stats;
+  server.Run(&stats);
+  cout << "Sessions " << stats.sessions << ", refused " << stats.refused_sessions
+       << ", requests " << stats.requests << ", errors " << stats.errors << endl;
+  return 0;
+}
@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <queue>
+#include <sstream>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include "coro_runtime.h"
+#include "object_log.h"
+#include "slot_map.h"
+#include "tracking_session.h"
+#include "ukf.h"
+
+using namespace std;
+
+SessionConfig::SessionConfig()
+    : reorder_window_us(100000),
+      channel_capacity(64),
+      read_chunk(64 * 1024) {}
+
+SessionStats::SessionStats() : measurements(0), late(0), rows(0) {}
+
+namespace {
+
+// publish writes once this much output is buffered or its input is empty
+const size_t kPublishChunk = 16 * 1024;
+
+/**
+ * Filtered state after one measurement.
+ */
+struct EstimateRow {
+  long long time_us;
+  long long object_id;
+  double x[CTRVModel::kStateDim];
+};
+
+/**
+ * A measurement waiting in the reorder window, ties keep the arrival order.
+ */
+struct Pending {
+  MeasurementPackage measurement;
+  long long sequence;
+
+  bool operator>(const Pending& other) const {
+    if (measurement.timestamp_ != other.measurement.timestamp_) {
+      return measurement.timestamp_ > other.measurement.timestamp_;
+    }
+    return sequence > other.sequence;
+  }
+};
+
+/**
+ * The channels and file descriptors of one session, freed by the last stage
+ * to finish.
+ */
+struct Session {
+  Session(Executor* executor_in, int in, int out, const SessionConfig* config_in,
+          SessionStats* stats_in, function<void()> on_done_in)
+      : executor(executor_in),
+        in_fd(in),
+        out_fd(out),
+        config(config_in),
+        stats(stats_in),
+        on_done(on_done_in),
+        measurements(executor_in, config_in->channel_capacity),
+        ordered(executor_in, config_in->channel_capacity),
+        rows(executor_in, config_in->channel_capacity),
+        running(4) {}
+
+  /**
+   * Called by every stage when it returns.
+   */
+  void StageDone() {
+    if (--running > 0) {
+      return;
+    }
+    executor->Forget(in_fd);
+    close(in_fd);
+    executor->Forget(out_fd);
+    close(out_fd);
+    function<void()> done = on_done;
+    delete this;
+    if (done) {
+      done();
+    }
+  }
+
+  Executor* executor;
+  int in_fd;
+  int out_fd;
+  const SessionConfig* config;
+  SessionStats* stats;
+  function<void()> on_done;
+
+  Channel<MeasurementPackage> measurements;
+  Channel<MeasurementPackage> ordered;
+  Channel<EstimateRow> rows;
+  atomic<int> running;
+};
+
+Task Ingest(Session* session) {
+  Executor& executor = *session->executor;
+  vector<char> buffer(session->config->read_chunk);
+  string pending;
+  vector<LogRecord> records;
+
+  for (bool more = true; more;) {
+    const ssize_t n = read(session->in_fd, buffer.data(), buffer.size());
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      co_await executor.Readable(session->in_fd);
+      continue;
+    }
+
+    // complete lines are parsed, the rest waits for the next read; at the
+    // end the last line may lack its newline
+    size_t parse_end;
+    if (n > 0) {
+      pending.append(buffer.data(), n);
+      const size_t newline = pending.find_last_of('\n');
+      parse_end = newline == string::npos ? 0 : newline + 1;
+    } else {
+      more = false;
+      parse_end = pending.size();
+    }
+    if (parse_end == 0) {
+      continue;
+    }
+
+    istringstream lines(pending.substr(0, parse_end));
+    pending.erase(0, parse_end);
+    records.clear();
+    ObjectLog::ReadText(lines, &records);
+    for (size_t i = 0; i < records.size(); ++i) {
+      ++session->stats->measurements;
+      co_await session->measurements.Push(records[i].measurement);
+    }
+  }
+
+  session->measurements.Close();
+  session->StageDone();
+}
+
+Task Order(Session* session) {
+  const long long window = session->config->reorder_window_us;
+  priority_queue<Pending, vector<Pending>, greater<Pending> > window_queue;
+  long long sequence = 0;
+  long long newest = 0;
+  long long released = 0;
+  bool any_released = false;
+
+  while (optional<MeasurementPackage> meas = co_await session->measurements.Pop()) {
+    if (any_released && meas->timestamp_ < released) {
+      ++session->stats->late;
+      continue;
+    }
+    newest = max(newest, meas->timestamp_);
+    Pending item = {*meas, sequence++};
+    window_queue.push(item);
+
+    // release what the window has passed
+    while (!window_queue.empty() &&
+           window_queue.top().measurement.timestamp_ <= newest - window) {
+      Pending next = window_queue.top();
+      window_queue.pop();
+      released = next.measurement.timestamp_;
+      any_released = true;
+      co_await session->ordered.Push(next.measurement);
+    }
+  }
+  while (!window_queue.empty()) {
+    Pending next = window_queue.top();
+    window_queue.pop();
+    co_await session->ordered.Push(next.measurement);
+  }
+
+  session->ordered.Close();
+  session->StageDone();
+}
+
+Task Filter(Session* session) {
+  const UKF prototype;
+  SlotMap<UKF> tracks;
+  unordered_map<long long, SlotHandle> track_of;
+
+  while (optional<MeasurementPackage> meas = co_await session->ordered.Pop()) {
+    // association by object ID
+    unordered_map<long long, SlotHandle>::iterator found = track_of.find(meas->object_id_);
+    if (found == track_of.end()) {
+      found = track_of.insert(make_pair(meas->object_id_, tracks.Insert(prototype))).first;
+    }
+    UKF& ukf = *tracks.Get(found->second);
+    ukf.ProcessMeasurement(*meas);
+
+    EstimateRow row;
+    row.time_us = meas->timestamp_;
+    row.object_id = meas->object_id_;
+    for (int i = 0; i < CTRVModel::kStateDim; ++i) {
+      row.x[i] = ukf.x_(i);
+    }
+    co_await session->rows.Push(row);
+  }
+
+  session->rows.Close();
+  session->StageDone();
+}
+
+Task Publish(Session* session) {
+  Executor& executor = *session->executor;
+  string buffer =
+      "time_stamp\tobject_id\tpx_state\tpy_state\tv_state\tyaw_angle_state\tyaw_rate_state\n";
+  char line[512];
+  bool writable = true;
+
+  for (bool more = true; more && writable;) {
+    // wait for one row, then take whatever else is queued; the header and
+    // the rows go out together
+    optional<EstimateRow> row = co_await session->rows.Pop();
+    more = row.has_value();
+    while (row) {
+      const int length = snprintf(line, sizeof(line), "%lld\t%lld\t%g\t%g\t%g\t%g\t%g\n",
+                                  row->time_us, row->object_id, row->x[0], row->x[1],
+                                  row->x[2], row->x[3], row->x[4]);
+      buffer.append(line, length);
+      ++session->stats->rows;
+      if (buffer.size() >= kPublishChunk) {
+        break;
+      }
+      row = session->rows.TryPop();
+    }
+
+    // write it all, suspending while the reader is behind
+    size_t written = 0;
+    while (written < buffer.size()) {
+      const ssize_t n = write(session->out_fd, buffer.data() + written, buffer.size() - written);
+      if (n >= 0) {
+        written += n;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        co_await executor.Writable(session->out_fd);
+      } else if (errno != EINTR) {
+        // the reader is gone, drain the input without writing
+        writable = false;
+        break;
+      }
+    }
+    buffer.clear();
+  }
+
+  // let the filter finish if the reader went away
+  while (co_await session->rows.Pop()) {
+  }
+  session->StageDone();
+}
+
+/**
+ * Simulated client: writes the log into the session.
+ */
+Task Feed(Executor* executor, int fd, const string* log_text) {
+  size_t written = 0;
+  while (written < log_text->size()) {
+    const ssize_t n = write(fd, log_text->data() + written, log_text->size() - written);
+    if (n >= 0) {
+      written += n;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      co_await executor->Writable(fd);
+    } else if (errno != EINTR) {
+      break;
+    }
+  }
+  executor->Forget(fd);
+  close(fd);
+}
+
+/**
+ * Simulated client: reads the rows of the session until it ends.
+ */
+Task Collect(Executor* executor, int fd, string* output) {
+  char buffer[16 * 1024];
+  for (;;) {
+    const ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n > 0) {
+      output->append(buffer, n);
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      co_await executor->Readable(fd);
+    } else if (n == 0 || errno != EINTR) {
+      break;
+    }
+  }
+  executor->Forget(fd);
+  close(fd);
+}
+
+bool NonBlockingPipe(int fds[2]) {
+  return pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0;
+}
+
+}  // namespace
+
+bool SpawnTrackingSession(Executor* executor, int in_fd, int out_fd,
+                          const SessionConfig* config, SessionStats* stats_out,
+                          function<void()> on_done) {
+  // the executor keeps one waiting coroutine per descriptor, ingest and
+  // publish of one socket would replace each other's wait
+  if (out_fd == in_fd) {
+    out_fd = fcntl(in_fd, F_DUPFD_CLOEXEC, 0);
+    if (out_fd < 0) {
+      return false;
+    }
+  }
+  Session* session = new Session(executor, in_fd, out_fd, config, stats_out, on_done);
+  executor->Spawn(Ingest(session));
+  executor->Spawn(Order(session));
+  executor->Spawn(Filter(session));
+  executor->Spawn(Publish(session));
+  return true;
+}
+
+bool TrackingSessions::RunLocal(const string& log_text, int num_sessions, int num_threads,
+                                const SessionConfig& config, vector<string>* outputs_out,
+                                vector<SessionStats>* stats_out) {
+
+  // a client that goes away must not kill the process
+  signal(SIGPIPE, SIG_IGN);
+
+  outputs_out->assign(num_sessions, string());
+  stats_out->assign(num_sessions, SessionStats());
+
+  // sessions that got their pipes run, the others stay empty
+  bool ok = true;
+  Executor executor(num_threads);
+  for (int s = 0; s < num_sessions && ok; ++s) {
+    int to_session[2];
+    int from_session[2];
+    if (!NonBlockingPipe(to_session)) {
+      ok = false;
+      break;
+    }
+    if (!NonBlockingPipe(from_session)) {
+      close(to_session[0]);
+      close(to_session[1]);
+      ok = false;
+      break;
+    }
+    SpawnTrackingSession(&executor, to_session[0], from_session[1], &config, &(*stats_out)[s],
+                         function<void()>());
+    executor.Spawn(Feed(&executor, to_session[1], &log_text));
+    executor.Spawn(Collect(&executor, from_session[0], &(*outputs_out)[s]));
+  }
+  executor.Run();
+  return ok;
+}
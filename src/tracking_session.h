@@ -0,0 +1,102 @@
+#ifndef TRACKING_SESSION_H_
+#define TRACKING_SESSION_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+* Settings of a tracking session.
+*/
+struct SessionConfig {
+  ///* measurements are held back this long to restore timestamp order, in
+  ///* us; older arrivals are dropped as late
+  long long reorder_window_us;
+
+  ///* capacity of the channels between the stages
+  size_t channel_capacity;
+
+  ///* bytes read from the input at a time
+  size_t read_chunk;
+
+  SessionConfig();
+};
+
+/**
+* Counters of one tracking session.
+*/
+struct SessionStats {
+  ///* parsed measurements
+  long long measurements;
+
+  ///* measurements that arrived after the reorder window had passed them
+  long long late;
+
+  ///* published estimate rows
+  long long rows;
+
+  SessionStats();
+};
+
+/**
+* Tracking sessions as coroutine pipelines on a shared executor, one session
+* per simulator client. Each session is four stages connected by channels:
+*   ingest   reads the log text from a file descriptor, suspending while no
+*            data is available, and parses it into MeasurementPackages,
+*   order    restores the timestamp order within the reorder window,
+*   filter   runs one UKF per object ID,
+*   publish  writes one row per update to a file descriptor,
+*              time_stamp object_id px py v yaw yawd
+*            suspending while the reader is behind.
+* No stage blocks a thread, so a few executor threads serve hundreds of
+* sessions. The coroutine sources are built as C++20 with
+* -DUKF_COROUTINES=ON (Linux); this interface is plain C++11.
+*/
+class TrackingSessions {
+public:
+
+  /**
+  * Runs num_sessions independent sessions of one log on local simulated
+  * clients: each client feeds the log through a pipe and reads the rows
+  * back through another, all on the same executor.
+  * @param log_text The log, see ObjectLog
+  * @param num_sessions Number of sessions
+  * @param num_threads Executor threads, 0 for one per core
+  * @param config Session settings
+  * @param outputs_out The rows of each session, header included
+  * @param stats_out The counters of each session
+  * @return false if the pipes cannot be created, e.g. for lack of file
+  * descriptors
+  */
+  static bool RunLocal(const std::string& log_text, int num_sessions, int num_threads,
+                       const SessionConfig& config, std::vector<std::string>* outputs_out,
+                       std::vector<SessionStats>* stats_out);
+};
+
+#if __cplusplus >= 202002L
+
+#include <functional>
+
+class Executor;
+
+/**
+* Spawns the stages of one session on an executor. The session owns the
+* file descriptors, which are closed after the last row is written; in_fd
+* and out_fd may be the same socket, which is then duplicated so that
+* ingest and publish each wait on their own descriptor.
+* @param executor The executor
+* @param in_fd Non-blocking source of the log text
+* @param out_fd Non-blocking sink of the rows
+* @param config Session settings, must outlive the session
+* @param stats_out Counters of the session, must outlive the session
+* @param on_done Called when the session has ended, may be empty
+* @return false if the socket cannot be duplicated; nothing is spawned and
+* the file descriptors stay with the caller
+*/
+bool SpawnTrackingSession(Executor* executor, int in_fd, int out_fd,
+                          const SessionConfig* config, SessionStats* stats_out,
+                          std::function<void()> on_done);
+
+#endif
+
+#endif /* TRACKING_SESSION_H_ */
@@ -1,29 +1,33 @@
 #include "ukf.h"
 #include "tools.h"
+#include "measurement_model.h"
+#include "fast_math.h"
+#include "motion_models.h"
 #include "Eigen/Dense"
 #include <iostream>
+#include <algorithm>
+#include <limits>
 
 using namespace std;
 using Eigen::MatrixXd;
 using Eigen::VectorXd;
+using Eigen::ArrayXd;
 using std::vector;
 
 /**
  * Initializes Unscented Kalman filter
  */
-UKF::UKF() {
+template <class MotionModel, class SigmaRule>
+ModelUKF<MotionModel, SigmaRule>::ModelUKF() {
 
   // set to false initially, set to true in first call of ProcessMeasurement
   is_initialized_ = false;
 
   //set state dimension
-  n_x_ = 5;
+  n_x_ = MotionModel::kStateDim;
 
   //set augmented dimension
-  n_aug_ = 7;
-
-  //set number of sigma points
-  n_sig_ = 2 * n_aug_ + 1;
+  n_aug_ = MotionModel::kStateDim + MotionModel::kNoiseDim;
 
   // set radar meas. dimensions
   n_z_radar_ = 3;
@@ -34,6 +38,17 @@ UKF::UKF() {
   //define spreading parameter
   lambda_ = 3 - n_aug_;
 
+  //number of sigma points of the rule
+  n_sig_ = kSigmaCount;
+
+  //unit sigma points and weights of the rule
+  MatrixXd sigma_unit;
+  VectorXd weights;
+  SigmaRule::Generate(n_aug_, &sigma_unit, &weights);
+  sigma_unit_ = sigma_unit;
+  weights_ = weights;
+  sqrt_weights_ = weights_.template tail<kSigmaCount - 1>().cwiseSqrt();
+
   // Initial time in us
   time_us_ = 0;
 
@@ -43,17 +58,43 @@ UKF::UKF() {
   // Initial NIS for lidar
   NIS_laser_ = 0.0;
 
+  // no update yet
+  log_likelihood_ = 0.0;
+
   // if this is false, laser measurements will be ignored (except during init)
   use_laser_ = true;
 
   // if this is false, radar measurements will be ignored (except during init)
   use_radar_ = true;
 
+  // fuse laser and radar measurements that share a timestamp
+  use_fused_update_ = true;
+
+  // time steps below 1 ms are treated as simultaneous (no prediction)
+  fusion_dt_threshold_ = 0.001;
+
+  // no sigma points have been drawn yet
+  sigma_points_valid_ = false;
+
+  // always use the unscented transform unless asked otherwise
+  use_hybrid_ = false;
+
+  // linearize the prediction below ~3 deg of yaw spread
+  hybrid_max_yaw_spread_ = 0.05;
+
+  // linearize the radar update when the position spread is below 2% of range
+  hybrid_max_range_spread_ = 0.02;
+
+  hybrid_stats_.ekf_predictions = 0;
+  hybrid_stats_.ukf_predictions = 0;
+  hybrid_stats_.ekf_updates = 0;
+  hybrid_stats_.ukf_updates = 0;
+
   // initial state vector
-  x_ = VectorXd::Zero(n_x_);
+  x_ = StateVector::Zero();
 
   // initial covariance matrix
-  P_ = MatrixXd::Identity(n_x_,n_x_);
+  P_ = StateMatrix::Identity();
 
   // Process noise standard deviation longitudinal acceleration in m/s^2
   std_a_ = 0.25;
@@ -68,7 +109,6 @@ UKF::UKF() {
   std_laspy_ = 0.15;
 
   // Set laser noise covariance matrix
-  R_lidar_ = MatrixXd(n_z_laser_,n_z_laser_);
   R_lidar_ <<    std_laspx_*std_laspx_, 0,
           0, std_laspy_*std_laspy_;
 
@@ -83,20 +123,20 @@ UKF::UKF() {
   std_radrd_ = 0.3;
 
   // Set radar noise covariance matrix
-  R_radar_ = MatrixXd(n_z_radar_,n_z_radar_);
-
   R_radar_ <<    std_radr_*std_radr_, 0, 0,
           0, std_radphi_*std_radphi_, 0,
           0, 0,std_radrd_*std_radrd_;
 }
 
-UKF::~UKF() {}
+template <class MotionModel, class SigmaRule>
+ModelUKF<MotionModel, SigmaRule>::~ModelUKF() {}
 
 /**
  * @param {MeasurementPackage} meas_package The latest measurement data of
  * either radar or laser.
  */
-void UKF::ProcessMeasurement(MeasurementPackage meas_package) {
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::ProcessMeasurement(const MeasurementPackage& meas_package) {
 
 
   /**
@@ -118,7 +158,11 @@ void UKF::ProcessMeasurement(MeasurementPackage meas_package) {
       float phi = meas_package.raw_measurements_(1);
       // NOTE: ro_dot is not the actual speed (magnitude or direction), it is the speed in the direction of ro (range) vector
       float ro_dot = meas_package.raw_measurements_(2);
-      x_ << ro * cos(phi), ro * sin(phi), ro_dot, 0, 0; //estimate the initial speed, too.
+      MotionModel::InitFromRadar(ro, phi, ro_dot, &x_); //estimate the initial speed, too.
+      if (meas_package.sensor_origin_.size() > 0) {
+        x_(0) += meas_package.sensor_origin_(0);
+        x_(1) += meas_package.sensor_origin_(1);
+      }
       is_initialized_ = true;
 
     }
@@ -127,7 +171,8 @@ void UKF::ProcessMeasurement(MeasurementPackage meas_package) {
       Initialize state.
       */
       //set the state with the initial location and zero velocity
-      x_ << meas_package.raw_measurements_(0), meas_package.raw_measurements_(1), 0, 0, 0;
+      MotionModel::InitFromPosition(meas_package.raw_measurements_(0),
+                                    meas_package.raw_measurements_(1), &x_);
       is_initialized_ = true;
 
     }
@@ -145,17 +190,7 @@ void UKF::ProcessMeasurement(MeasurementPackage meas_package) {
    *  Prediction
    ****************************************************************************/
 
-  /**
-     * Update the state transition matrix F according to the new elapsed time.
-      - Time is measured in seconds.
-   */
-
-  //compute the time elapsed between the current and previous measurements
-  const float delta_t = (meas_package.timestamp_ - time_us_) / 1000000.0; //dt - expressed in seconds
-  time_us_ = meas_package.timestamp_;
-
-
-  Prediction(delta_t);
+  AdvanceTo(meas_package.timestamp_);
 
   /*****************************************************************************
    *  Update
@@ -181,194 +216,615 @@ void UKF::ProcessMeasurement(MeasurementPackage meas_package) {
 //  cout << "P_ = " << P_ << endl;
 }
 
+/**
+ * Coalesces a laser and a radar measurement with (nearly) the same timestamp
+ * into one prediction and one joint update.
+ * @param {MeasurementPackage} laser_package
+ * @param {MeasurementPackage} radar_package
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::ProcessFusedMeasurement(const MeasurementPackage& laser_package,
+                                  const MeasurementPackage& radar_package) {
+
+  // the fused model needs both sensors and an initialized state
+  if (!is_initialized_ || !use_laser_ || !use_radar_) {
+    ProcessMeasurement(laser_package);
+    ProcessMeasurement(radar_package);
+    return;
+  }
+
+  // predict to the later of the two timestamps
+  AdvanceTo(max(laser_package.timestamp_, radar_package.timestamp_));
+
+  UpdateFused(laser_package, radar_package);
+}
+
+/**
+ * Predicts the state to the given timestamp. Time steps below
+ * fusion_dt_threshold_ skip the prediction and leave time_us_ where it is,
+ * so the skipped time is part of the next step; the sigma points are then
+ * only redrawn if an update has invalidated them.
+ * @param {long long} timestamp in us
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::AdvanceTo(long long timestamp) {
+
+  /**
+     * Update the state transition matrix F according to the new elapsed time.
+      - Time is measured in seconds.
+   */
+
+  //compute the time elapsed since the state time
+  const double delta_t = (timestamp - time_us_) / 1000000.0; //dt - expressed in seconds
+
+  if (fabs(delta_t) < fusion_dt_threshold_) {
+    // simultaneous measurement: nothing to propagate
+    EnsureSigmaPoints();
+    return;
+  }
+
+  time_us_ = timestamp;
+  Prediction(delta_t);
+}
+
 /**
  * Predicts sigma points, the state, and the state covariance matrix.
  * @param {double} delta_t the change in time (in seconds) between the last
  * measurement and this one.
  */
-void UKF::Prediction(double delta_t) {
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::Prediction(double delta_t) {
   /**
   Estimate the object's location. Modify the state
   vector, x_. Predict sigma points, the state, and the state covariance matrix.
   */
 
-  //create sigma point matrix
-  MatrixXd Xsig_aug = MatrixXd(n_aug_, n_sig_);
-  AugmentedSigmaPoints(&Xsig_aug);
-  SigmaPointPrediction(&Xsig_pred_, Xsig_aug, delta_t);
-  PredictMeanAndCovariance(&x_, &P_, &weights_);
+  // nearly linear step, for CTRV: yaw uncertainty plus the turn over the
+  // step is small
+  if (use_hybrid_) {
+    if (MotionModel::Nonlinearity(x_, P_, delta_t) < hybrid_max_yaw_spread_) {
+      PredictionLinearized(delta_t);
+      ++hybrid_stats_.ekf_predictions;
+      return;
+    }
+  }
+
+  AugmentedSigmaPoints(x_, P_, &workspace_);
+  SigmaPointPrediction(&Xsig_pred_, workspace_.Xsig_aug, delta_t);
+  PredictMeanAndCovariance(Xsig_pred_, &x_, &P_);
+  sigma_points_valid_ = true;
+  ++hybrid_stats_.ukf_predictions;
+}
+
+/**
+ * First-order (EKF) prediction with the Jacobians of the motion model. The
+ * sigma points are left invalid and are only redrawn if an unscented update
+ * follows.
+ * @param {double} delta_t the change in time (in seconds)
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::PredictionLinearized(double delta_t) {
+
+  //predicted mean, state transition Jacobian F and noise gain G
+  StateVector x;
+  StateMatrix F;
+  typename MotionModel::NoiseGain G;
+  MotionModel::Linearize(x_, delta_t, &x, &F, &G);
+
+  //scale G by the noise standard deviations
+  typename MotionModel::NoiseVector noise_std;
+  MotionModel::NoiseStd(std_a_, std_yawdd_, &noise_std);
+  G = G * noise_std.asDiagonal();
+
+  //P = F*P*F^T + G*G^T
+  StateMatrix P = F * P_.template selfadjointView<Eigen::Lower>() * F.transpose();
+  P.template selfadjointView<Eigen::Lower>().rankUpdate(G);
+  P.template triangularView<Eigen::StrictlyUpper>() = P.transpose();
+
+  x_ = x;
+  P_ = P;
+  sigma_points_valid_ = false;
+}
+
+/**
+ * Extrapolates the state to the given time without modifying the filter.
+ * @param {long long} timestamp the query time in us
+ * @param {StateVector} x_out the predicted state
+ * @param {StateMatrix} P_out the predicted state covariance
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::PredictAt(long long timestamp, StateVector* x_out,
+                                      StateMatrix* P_out) const {
+
+  Workspace workspace;
+  PredictAt(timestamp, &workspace, x_out, P_out);
+}
+
+/**
+ * Extrapolates the state to the given time without modifying the filter,
+ * reusing the buffers of a caller-owned workspace.
+ * @param {long long} timestamp the query time in us
+ * @param {Workspace} workspace scratch buffers
+ * @param {StateVector} x_out the predicted state
+ * @param {StateMatrix} P_out the predicted state covariance
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::PredictAt(long long timestamp, Workspace* workspace,
+                                      StateVector* x_out, StateMatrix* P_out) const {
+
+  const double delta_t = (timestamp - time_us_) / 1000000.0;
+
+  // nothing to extrapolate before initialization or for simultaneous queries
+  if (!is_initialized_ || fabs(delta_t) < fusion_dt_threshold_) {
+    *x_out = x_;
+    *P_out = P_;
+    return;
+  }
+
+  AugmentedSigmaPoints(x_, P_, workspace);
+  SigmaPointPrediction(&workspace->Xsig_pred, workspace->Xsig_aug, delta_t);
+  PredictMeanAndCovariance(workspace->Xsig_pred, x_out, P_out);
+}
+
+/**
+ * Answers a batch of extrapolation queries, query i predicts tracks[i] to
+ * timestamps[i]. One workspace is shared by all queries.
+ * @param {vector<const ModelUKF*>} tracks the filters to query
+ * @param {vector<long long>} timestamps the query times in us
+ * @param {vector<StateVector>} x_out the predicted states
+ * @param {vector<StateMatrix>} P_out the predicted state covariances
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::PredictAtBatch(const vector<const ModelUKF*>& tracks,
+                                           const vector<long long>& timestamps,
+                                           vector<StateVector>* x_out,
+                                           vector<StateMatrix>* P_out) {
+
+  const size_t n_queries = min(tracks.size(), timestamps.size());
+  x_out->resize(n_queries);
+  P_out->resize(n_queries);
+
+  Workspace workspace;
+  for (size_t i = 0; i < n_queries; ++i) {
+    tracks[i]->PredictAt(timestamps[i], &workspace, &(*x_out)[i], &(*P_out)[i]);
+  }
+}
+
+/**
+ * Advances a set of filters to one frame time. Simultaneous and (with
+ * use_hybrid_) nearly linear steps are handled per track exactly as in
+ * AdvanceTo; the augmented sigma points of all remaining tracks are stacked
+ * side by side and propagated by a single kernel call, then each column
+ * block becomes the track's Xsig_pred_ and is reduced to its x_ and P_.
+ * @param {vector<ModelUKF*>} tracks the filters to advance
+ * @param {long long} timestamp the frame time in us
+ * @param {Workspace} workspace scratch buffers
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::PredictFrame(const vector<ModelUKF*>& tracks, long long timestamp,
+                                         Workspace* workspace) {
+  PredictFrame(tracks, 0, tracks.size(), timestamp, workspace);
+}
+
+/**
+ * PredictFrame of the filters tracks[begin, end), so blocks of one frame can
+ * be predicted without copying the track list.
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::PredictFrame(const vector<ModelUKF*>& tracks, size_t begin,
+                                         size_t end, long long timestamp,
+                                         Workspace* workspace) {
+
+  //tracks that need sigma points and their time steps as in AdvanceTo
+  vector<int>& batch_tracks = workspace->batch_tracks;
+  vector<double>& batch_dt = workspace->batch_dt;
+  batch_tracks.clear();
+  batch_dt.clear();
+  for (size_t t = begin; t < end; ++t) {
+    ModelUKF& track = *tracks[t];
+    if (!track.is_initialized_) {
+      continue;
+    }
+
+    const double delta_t = (timestamp - track.time_us_) / 1000000.0;
+    if (fabs(delta_t) < track.fusion_dt_threshold_) {
+      track.EnsureSigmaPoints();
+      continue;
+    }
+    track.time_us_ = timestamp;
+
+    if (track.use_hybrid_ &&
+        MotionModel::Nonlinearity(track.x_, track.P_, delta_t) < track.hybrid_max_yaw_spread_) {
+      track.PredictionLinearized(delta_t);
+      ++track.hybrid_stats_.ekf_predictions;
+      continue;
+    }
+
+    batch_tracks.push_back(t);
+    batch_dt.push_back(delta_t);
+  }
+
+  if (batch_tracks.empty()) {
+    return;
+  }
+
+  //stack the sigma points of all tracks, column block b belongs to track
+  //batch_tracks[b]
+  const int n_batch = batch_tracks.size();
+  const int n_cols = n_batch * kSigmaCount;
+  typename SigmaTypes::AugSigmaBatch& Xsig_batch = workspace->Xsig_batch;
+  typename SigmaTypes::TimeBatch& dt_batch = workspace->dt_batch;
+  if (Xsig_batch.cols() < n_cols) {
+    Xsig_batch.resize(SigmaTypes::kAugDim, n_cols);
+    dt_batch.resize(n_cols);
+  }
+
+  for (int b = 0; b < n_batch; ++b) {
+    const ModelUKF& track = *tracks[batch_tracks[b]];
+    track.AugmentedSigmaPoints(track.x_, track.P_, workspace);
+    Xsig_batch.middleCols(b * kSigmaCount, kSigmaCount) = workspace->Xsig_aug;
+    dt_batch.segment(b * kSigmaCount, kSigmaCount).setConstant(batch_dt[b]);
+  }
+
+  //propagate every sigma point of every track at once
+  tracks[batch_tracks[0]]->PropagateBatch(n_cols, workspace);
+
+  for (int b = 0; b < n_batch; ++b) {
+    ModelUKF& track = *tracks[batch_tracks[b]];
+    track.Xsig_pred_ = workspace->Xsig_pred_batch.middleCols(b * kSigmaCount, kSigmaCount);
+    track.PredictMeanAndCovariance(track.Xsig_pred_, &track.x_, &track.P_);
+    track.sigma_points_valid_ = true;
+    ++track.hybrid_stats_.ukf_predictions;
+  }
+}
+
+/**
+ * Number of doubles that Rollout writes per time step: the state mean
+ * followed by the column-major state covariance.
+ */
+template <class MotionModel, class SigmaRule>
+int ModelUKF<MotionModel, SigmaRule>::RolloutStride() const {
+  return n_x_ + n_x_ * n_x_;
+}
+
+/**
+ * Predicts the state mean and covariance at num_steps times
+ * start_timestamp + k * step_s, k = 0 .. num_steps-1, without modifying the
+ * filter. The augmented sigma points are drawn once and every step
+ * propagates them over the full horizon, so each step equals
+ * PredictAt(start_timestamp + k * step_s).
+ * @param {long long} start_timestamp time of the first step in us
+ * @param {double} step_s time between steps in s
+ * @param {int} num_steps number of steps
+ * @param {Workspace} workspace scratch buffers
+ * @param {double*} buffer num_steps * RolloutStride() doubles
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::Rollout(long long start_timestamp, double step_s, int num_steps,
+                                    Workspace* workspace, double* buffer) const {
+
+  vector<const ModelUKF*> tracks(1, this);
+  RolloutBatch(tracks, start_timestamp, step_s, num_steps, workspace, buffer);
+}
+
+/**
+ * Rollout for many tracks in one batch. The sigma points of all tracks and
+ * steps are stacked side by side and propagated by a single kernel call.
+ * Track i writes its steps at buffer + i * num_steps * RolloutStride().
+ * @param {vector<const ModelUKF*>} tracks the filters to roll out
+ * @param {long long} start_timestamp time of the first step in us
+ * @param {double} step_s time between steps in s
+ * @param {int} num_steps number of steps
+ * @param {Workspace} workspace scratch buffers
+ * @param {double*} buffer tracks.size() * num_steps * RolloutStride() doubles
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::RolloutBatch(const vector<const ModelUKF*>& tracks,
+                                         long long start_timestamp,
+                                         double step_s, int num_steps,
+                                         Workspace* workspace, double* buffer) {
+
+  if (tracks.empty() || num_steps <= 0) {
+    return;
+  }
+
+  //every track and step has kSigmaCount columns
+  const int n_x = tracks[0]->n_x_;
+  const int stride = tracks[0]->RolloutStride();
+  const int n_tracks = tracks.size();
+  const int n_cols = n_tracks * num_steps * kSigmaCount;
+
+  //stack all tracks and steps: column block (t, k) holds the sigma points of
+  //track t with the time step of step k
+  typename SigmaTypes::AugSigmaBatch& Xsig_batch = workspace->Xsig_batch;
+  typename SigmaTypes::TimeBatch& dt_batch = workspace->dt_batch;
+  if (Xsig_batch.cols() < n_cols) {
+    Xsig_batch.resize(SigmaTypes::kAugDim, n_cols);
+    dt_batch.resize(n_cols);
+  }
+
+  for (int t = 0; t < n_tracks; ++t) {
+    const ModelUKF& track = *tracks[t];
+    track.AugmentedSigmaPoints(track.x_, track.P_, workspace);
+
+    const double dt_0 = (start_timestamp - track.time_us_) / 1000000.0;
+    for (int k = 0; k < num_steps; ++k) {
+      const int col = (t * num_steps + k) * kSigmaCount;
+      Xsig_batch.middleCols(col, kSigmaCount) = workspace->Xsig_aug;
+      dt_batch.segment(col, kSigmaCount).setConstant(dt_0 + k * step_s);
+    }
+  }
+
+  //propagate every sigma point of every track and step at once
+  tracks[0]->PropagateBatch(n_cols, workspace);
+
+  //reduce each column block to its mean and covariance
+  StateVector x;
+  StateMatrix P;
+  for (int t = 0; t < n_tracks; ++t) {
+    const ModelUKF& track = *tracks[t];
+    for (int k = 0; k < num_steps; ++k) {
+      double* out = buffer + (t * num_steps + k) * stride;
+      Eigen::Map<VectorXd> x_out(out, n_x);
+      Eigen::Map<MatrixXd> P_out(out + n_x, n_x, n_x);
+
+      if (!track.is_initialized_) {
+        x_out = track.x_;
+        P_out = track.P_;
+        continue;
+      }
+
+      workspace->Xsig_pred = workspace->Xsig_pred_batch.middleCols(
+          (t * num_steps + k) * kSigmaCount, kSigmaCount);
+      track.PredictMeanAndCovariance(workspace->Xsig_pred, &x, &P);
+      x_out = x;
+      P_out = P;
+    }
+  }
+}
+
+/**
+ * Stores the state in its compact form.
+ * @param {TrackState} state_out
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::SaveState(TrackState<MotionModel::kStateDim>* state_out) const {
+
+  state_out->time_us = time_us_;
+  Eigen::Map<VectorXd>(state_out->x, n_x_) = x_;
+  state_out->P.Pack(P_);
+}
+
+/**
+ * Restores a compact state. The covariance is unpacked symmetrically and the
+ * sigma points are redrawn on demand.
+ * @param {TrackState} state
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::LoadState(const TrackState<MotionModel::kStateDim>& state) {
+
+  time_us_ = state.time_us;
+  x_ = Eigen::Map<const VectorXd>(state.x, n_x_);
+  state.P.Unpack(&P_);
+  is_initialized_ = true;
+  sigma_points_valid_ = false;
+}
+
+/**
+* Draws the predicted sigma points directly from x_ and P_ for a zero time
+* step. The process noise has no effect on a zero step, so only the n_x x n_x
+* state covariance has to be factorized and no process model is evaluated.
+* The result equals Prediction(0) without touching x_ and P_.
+*/
+
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::RedrawSigmaPoints() {
+
+  //create square root matrix
+  Eigen::LLT<StateMatrix> llt(P_);
+
+  //the augmented square root is block diagonal, so the state rows of the
+  //sigma points only depend on the state rows of the unit points
+  Xsig_pred_ = x_.template replicate<1, kSigmaCount>();
+  Xsig_pred_.noalias() += llt.matrixL() * sigma_unit_.topRows(n_x_);
+
+  sigma_points_valid_ = true;
+}
+
+/**
+* Redraws the sigma points if an update or a linearized prediction has
+* invalidated them.
+*/
+
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::EnsureSigmaPoints() {
+  if (!sigma_points_valid_) {
+    RedrawSigmaPoints();
+  }
 }
 
 /**
 * Creates augmented mean state, remember mean of noise is zero
 * Creates augmented covariance matrix
 * Creates square root matrix
-* Creates and returns augmented sigma points
-* @param {MatrixXd} Xsig_out
+* Creates augmented sigma points in workspace->Xsig_aug
+* @param {StateVector} x the state mean
+* @param {StateMatrix} P the state covariance
+* @param {Workspace} workspace
 */
 
-void UKF::AugmentedSigmaPoints(MatrixXd* Xsig_out) {
-
-  //create augmented mean vector
-  VectorXd x_aug = VectorXd(n_aug_);
-
-  //create augmented state covariance
-  MatrixXd P_aug = MatrixXd(n_aug_, n_aug_);
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::AugmentedSigmaPoints(const StateVector& x, const StateMatrix& P,
+                                                 Workspace* workspace) const {
 
-  //create sigma point matrix
-  MatrixXd Xsig_aug = MatrixXd(n_aug_, n_sig_);
+  typename SigmaTypes::AugVector& x_aug = workspace->x_aug;
+  typename SigmaTypes::AugMatrix& P_aug = workspace->P_aug;
+  typename SigmaTypes::AugSigmaMatrix& Xsig_aug = workspace->Xsig_aug;
 
   //create augmented mean state
-  x_aug.head(5) = x_;
-  x_aug(5) = 0;
-  x_aug(6) = 0;
+  x_aug.resize(n_aug_);
+  x_aug.head(n_x_) = x;
+  x_aug.tail(MotionModel::kNoiseDim).setZero();
 
   //create augmented covariance matrix
-  P_aug.fill(0.0);
-  P_aug.topLeftCorner(5,5) = P_;
-  P_aug(5,5) = std_a_*std_a_;
-  P_aug(6,6) = std_yawdd_*std_yawdd_;
+  typename MotionModel::NoiseVector noise_std;
+  MotionModel::NoiseStd(std_a_, std_yawdd_, &noise_std);
+  P_aug.setZero(n_aug_, n_aug_);
+  P_aug.topLeftCorner(n_x_, n_x_) = P;
+  P_aug.bottomRightCorner(MotionModel::kNoiseDim, MotionModel::kNoiseDim) =
+      noise_std.cwiseAbs2().asDiagonal();
 
   //create square root matrix
-  MatrixXd L = P_aug.llt().matrixL();
-
-  //create augmented sigma points
-  Xsig_aug.col(0)  = x_aug;
-  for (int i = 0; i< n_aug_; i++)
-  {
-    Xsig_aug.col(i+1)       = x_aug + sqrt(lambda_+n_aug_) * L.col(i);
-    Xsig_aug.col(i+1+n_aug_) = x_aug - sqrt(lambda_+n_aug_) * L.col(i);
-  }
+  workspace->llt.compute(P_aug);
+
+  //create augmented sigma points x_aug + L * U of the selected rule
+  Xsig_aug = x_aug.template replicate<1, kSigmaCount>();
+  Xsig_aug.noalias() += workspace->llt.matrixL() * sigma_unit_;
 
   //print result
 //  std::cout << "Xsig_aug = " << std::endl << Xsig_aug << std::endl;
 
-  //write result
-  *Xsig_out = Xsig_aug;
-
 }
 
 /**
 * Predict sigma points while avoiding division by zero
-* @param {MatrixXd} Xsig_out
+* @param {SigmaMatrix} Xsig_out
+* @param {AugSigmaMatrix} Xsig_aug augmented sigma points
+* @param {double} delta_t time step in s
 */
 
-void UKF::SigmaPointPrediction(MatrixXd* Xsig_out,const MatrixXd& Xsig_aug, const double delta_t) {
-
-  //create matrix with predicted sigma points as columns
-  MatrixXd Xsig_pred = MatrixXd(n_x_, n_sig_);
-
-  //predict sigma points
-  for (int i = 0; i<n_sig_; i++)
-  {
-    //extract values for better readability
-    double p_x = Xsig_aug(0,i);
-    double p_y = Xsig_aug(1,i);
-    double v = Xsig_aug(2,i);
-    double yaw = Xsig_aug(3,i);
-    double yawd = Xsig_aug(4,i);
-    double nu_a = Xsig_aug(5,i);
-    double nu_yawdd = Xsig_aug(6,i);
-
-    //predicted state values
-    double px_p, py_p;
-
-    //avoid division by zero
-    if (fabs(yawd) > 0.001) {
-        px_p = p_x + v/yawd * ( sin (yaw + yawd*delta_t) - sin(yaw));
-        py_p = p_y + v/yawd * ( cos(yaw) - cos(yaw+yawd*delta_t) );
-    }
-    else {
-        px_p = p_x + v*delta_t*cos(yaw);
-        py_p = p_y + v*delta_t*sin(yaw);
-    }
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::SigmaPointPrediction(SigmaMatrix* Xsig_out,
+    const typename SigmaTypes::AugSigmaMatrix& Xsig_aug, const double delta_t) const {
 
-    double v_p = v;
-    double yaw_p = yaw + yawd*delta_t;
-    double yawd_p = yawd;
+  const typename MotionModel::template TimeSteps<kSigmaCount> dt =
+      MotionModel::template TimeSteps<kSigmaCount>::Constant(delta_t);
+  MotionModel::Propagate(Xsig_aug, dt, Xsig_out);
+}
 
-    //add noise
-    px_p = px_p + 0.5*nu_a*delta_t*delta_t * cos(yaw);
-    py_p = py_p + 0.5*nu_a*delta_t*delta_t * sin(yaw);
-    v_p = v_p + nu_a*delta_t;
+/**
+* Predict sigma points with an individual time step per column, see the
+* motion model's Propagate: the first n_cols columns of workspace->Xsig_batch
+* with the time steps in workspace->dt_batch into workspace->Xsig_pred_batch
+* (e.g. the sigma points of many tracks or many time steps side by side).
+* The columns are propagated in chunks of the fixed-size batch kernel, so no
+* temporaries are allocated; the last chunk is padded with zero columns.
+* @param {int} n_cols number of columns
+* @param {Workspace} workspace batch buffers
+*/
 
-    yaw_p = yaw_p + 0.5*nu_yawdd*delta_t*delta_t;
-    yawd_p = yawd_p + nu_yawdd*delta_t;
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::PropagateBatch(int n_cols, Workspace* workspace) const {
 
-    //write predicted sigma point into right column
-    Xsig_pred(0,i) = px_p;
-    Xsig_pred(1,i) = py_p;
-    Xsig_pred(2,i) = v_p;
-    Xsig_pred(3,i) = yaw_p;
-    Xsig_pred(4,i) = yawd_p;
+  static const int kChunk = MotionModel::kBatchChunk;
+  typename SigmaTypes::SigmaBatch& Xsig_pred_batch = workspace->Xsig_pred_batch;
+  if (Xsig_pred_batch.cols() < n_cols) {
+    Xsig_pred_batch.resize(n_x_, n_cols);
   }
 
-  //print result
-//  std::cout << "Xsig_pred = " << std::endl << Xsig_pred << std::endl;
+  for (int begin = 0; begin < n_cols; begin += kChunk) {
+    const int n = min(kChunk, n_cols - begin);
+    workspace->Xsig_chunk.leftCols(n) = workspace->Xsig_batch.middleCols(begin, n);
+    workspace->dt_chunk.head(n) = workspace->dt_batch.segment(begin, n);
+    if (n < kChunk) {
+      workspace->Xsig_chunk.rightCols(kChunk - n).setZero();
+      workspace->dt_chunk.tail(kChunk - n).setZero();
+    }
+    MotionModel::Propagate(workspace->Xsig_chunk, workspace->dt_chunk,
+                           &workspace->Xsig_pred_chunk);
+    Xsig_pred_batch.middleCols(begin, n) = workspace->Xsig_pred_chunk.leftCols(n);
+  }
 
-  //write result
-  *Xsig_out = Xsig_pred;
+  //print result
+//  std::cout << "Xsig_pred = " << std::endl << Xsig_pred_batch.leftCols(n_cols) << std::endl;
 
 }
 
 /**
-* Set weights
 * Predict state mean and covariance
-* @param {VectorXd} x_out
-* @param {MatrixXd} P_out
+* @param {SigmaMatrix} Xsig_pred the predicted sigma points
+* @param {StateVector} x_out
+* @param {StateMatrix} P_out
 */
 
-void UKF::PredictMeanAndCovariance(VectorXd* x_out, MatrixXd* P_out, VectorXd* weights_out) {
-
-  //create vector for weights
-  VectorXd weights = VectorXd(n_sig_);
-
-  //create vector for predicted state
-  VectorXd x = VectorXd(n_x_);
-
-  //create covariance matrix for prediction
-  MatrixXd P = MatrixXd(n_x_, n_x_);
-
-  // set weights
-  double weight_0 = lambda_/(lambda_+n_aug_);
-  weights.fill(0.5 / (lambda_ + n_aug_));
-  weights(0) = weight_0;
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::PredictMeanAndCovariance(const SigmaMatrix& Xsig_pred, StateVector* x_out, StateMatrix* P_out) const {
 
+  StateVector& x = *x_out;
+  StateMatrix& P = *P_out;
 
   //predicted state mean
-  x.fill(0.0);
-  x = x + Xsig_pred_* weights;
+  x.noalias() = Xsig_pred * weights_;
 
+  //state differences, one column per sigma point
+  SigmaMatrix X_diff = Xsig_pred.colwise() - x;
+  //angle normalization
+  NormalizeStateAngles(&X_diff);
 
   //predicted state covariance matrix
-  P.fill(0.0);
-  for (int i = 0; i < n_sig_; i++) {  //iterate over sigma points
-
-    // state difference
-    VectorXd x_diff = Xsig_pred_.col(i) - x;
-    //angle normalization
-    Tools::NormalizeAngle(x_diff(3));
-
-    P = P + weights(i) * x_diff * x_diff.transpose() ;
-  }
+  WeightedCovariance(X_diff, &P);
 
   //print result
 //  std::cout << "Predicted state" << std::endl;
 //  std::cout << x << std::endl;
 //  std::cout << "Predicted covariance matrix" << std::endl;
 //  std::cout << P << std::endl;
+}
+
+/**
+* Weighted covariance of deviation columns, C = sum_i w_i * d_i * d_i^T.
+* Instead of one rank-1 update per sigma point, the non-negative weights
+* 1..n_sig-1 are folded into the columns as square roots, so the sum becomes
+* a single symmetric rank-k update (syrk) of the lower triangle. The centre
+* weight, which is negative for the unscented rule, is added as one signed
+* rank-1 update. All rules in sigma_points.h have non-negative weights
+* except possibly the first.
+* @param {DeviationType} D deviations from the mean, one column per sigma point
+* @param {MatrixType} C_out the weighted covariance, dynamic or of fixed size
+*/
+
+template <class MotionModel, class SigmaRule>
+template <typename DeviationType, typename MatrixType>
+void ModelUKF<MotionModel, SigmaRule>::WeightedCovariance(const DeviationType& D, MatrixType* C_out) const {
+
+  const int n = D.rows();
+  MatrixType& C = *C_out;
+
+  //scale the deviations by the square roots of their weights
+  const Eigen::Matrix<double, DeviationType::RowsAtCompileTime, kSigmaCount - 1, 0,
+                      DeviationType::MaxRowsAtCompileTime, kSigmaCount - 1> D_w =
+      D.template rightCols<kSigmaCount - 1>() * sqrt_weights_.asDiagonal();
+
+  C.setZero(n, n);
+  C.template selfadjointView<Eigen::Lower>().rankUpdate(D_w);
+  C.template selfadjointView<Eigen::Lower>().rankUpdate(D.col(0), weights_(0));
+
+  //mirror the lower triangle
+  C.template triangularView<Eigen::StrictlyUpper>() = C.transpose();
+}
+
+/**
+* Wraps the angles of the motion model (see kAngleMask) in the state rows of
+* a deviation matrix.
+* @param {DeviationType} D deviations, one column per sigma point
+*/
 
-  //write result
-  *x_out = x;
-  *P_out = P;
-  *weights_out = weights;
+template <class MotionModel, class SigmaRule>
+template <typename DeviationType>
+void ModelUKF<MotionModel, SigmaRule>::NormalizeStateAngles(DeviationType* D) {
+  for (int i = 0; i < MotionModel::kStateDim; ++i) {
+    if (MotionModel::kAngleMask & (1 << i)) {
+      Tools::NormalizeAngleRow(D, i);
+    }
+  }
 }
 
 /**
  * Updates the state and the state covariance matrix using a laser measurement.
  * @param {MeasurementPackage} meas_package
  */
-void UKF::UpdateLidar(MeasurementPackage meas_package) {
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::UpdateLidar(const MeasurementPackage& meas_package) {
   /**
   Use lidar data to update the belief about the object's
   position. Modify the state vector, x_, and covariance, P_.
@@ -376,80 +832,43 @@ void UKF::UpdateLidar(MeasurementPackage meas_package) {
   You'll also need to calculate the lidar NIS.
   */
 
-  VectorXd z = meas_package.raw_measurements_;
-
   /*****************************************************************************
    *  Predict Lidar Measurement
    ****************************************************************************/
 
-   //create matrix for sigma points in measurement space
-   MatrixXd Zsig = MatrixXd(n_z_laser_, n_sig_);
+   static const int n_z = MeasurementModel::kLidarDim;
+   const MeasurementVector<n_z> z = meas_package.raw_measurements_.template head<n_z>();
+   MeasurementVector<n_z> z_diff;
+   MeasurementMatrix<n_z> S;
 
-   //transform sigma points into measurement space
-   Zsig = Xsig_pred_.block(0, 0, n_z_laser_, n_sig_);
-
-   //mean predicted measurement
-   VectorXd z_pred = VectorXd(n_z_laser_);
-
-   z_pred.fill(0.0);
-   for (int i=0; i < n_sig_; i++) {
-       z_pred = z_pred + weights_(i) * Zsig.col(i);
+   //per-measurement noise, e.g. of a clustered centroid
+   MeasurementMatrix<n_z> R_lidar = R_lidar_;
+   if (meas_package.noise_covariance_.size() > 0) {
+     R_lidar = meas_package.noise_covariance_;
    }
 
-   //measurement covariance matrix S
-   MatrixXd S = MatrixXd(n_z_laser_,n_z_laser_);
-   S.fill(0.0);
-   for (int i = 0; i < n_sig_; i++) {  //2n+1 simga points
-     //residual
-     VectorXd z_diff = Zsig.col(i) - z_pred;
-
-     S = S + weights_(i) * z_diff * z_diff.transpose();
+   if (use_hybrid_) {
+     //the lidar model is linear, so the Kalman update is exact and needs no
+     //sigma points
+     const MeasurementJacobian<n_z> H = MeasurementJacobian<n_z>::Identity();
+     const MeasurementVector<n_z> z_pred = H * x_;
+     UpdateStateLinearized(z, z_pred, H, R_lidar, -1, &z_diff, &S);
+     ++hybrid_stats_.ekf_updates;
    }
-
-   //add measurement noise covariance matrix
-   S = S + R_lidar_;
-
-   //print result
-//   std::cout << "z_pred: " << std::endl << z_pred << std::endl;
-//   std::cout << "S: " << std::endl << S << std::endl;
-
-
-   /*****************************************************************************
-    *  Update State based on Lidar Measurement
-    ****************************************************************************/
-
-   //create matrix for cross correlation Tc
-   MatrixXd Tc = MatrixXd(n_x_, n_z_laser_);
-
-   //calculate cross correlation matrix
-   Tc.fill(0.0);
-   for (int i = 0; i < n_sig_; i++) {  //2n+1 simga points
-
-     //residual
-     VectorXd z_diff = Zsig.col(i) - z_pred;
-
-     // state difference
-     VectorXd x_diff = Xsig_pred_.col(i) - x_;
-     //angle normalization
-     Tools::NormalizeAngle(x_diff(3));
-
-     Tc = Tc + weights_(i) * x_diff * z_diff.transpose();
+   else {
+     //transform sigma points into measurement space
+     EnsureSigmaPoints();
+     MeasurementSigma<n_z> Zsig;
+     MeasurementModel::Lidar(Xsig_pred_, &Zsig);
+
+     /*****************************************************************************
+      *  Update State based on Lidar Measurement
+      ****************************************************************************/
+
+     UpdateState(z, Zsig, R_lidar, -1, &z_diff, &S);
+     ++hybrid_stats_.ukf_updates;
    }
 
-   //Kalman gain K;
-   MatrixXd K = Tc * S.inverse();
-
-   //residual
-   VectorXd z_diff = z - z_pred;
-
-   //update state mean and covariance matrix
-   x_ = x_ + K * z_diff;
-   P_ = P_ - K*S*K.transpose();
-
-   //print result
-//   std::cout << "Updated state x: " << std::endl << x_ << std::endl;
-//   std::cout << "Updated state covariance P: " << std::endl << P_ << std::endl;
-
    /*****************************************************************************
     *  NIS of Lidar Measurement
     ****************************************************************************/
@@ -457,6 +876,7 @@ void UKF::UpdateLidar(MeasurementPackage meas_package) {
 
    //calculate NIS value
    NIS_laser_ = z_diff.transpose()*S.inverse()*z_diff;
+   log_likelihood_ = LogLikelihood(z_diff, S);
 
    //print result
 //   std::cout << "NIS_laser: " << std::endl << NIS_laser_ << std::endl;
@@ -466,132 +886,331 @@ void UKF::UpdateLidar(MeasurementPackage meas_package) {
  * Updates the state and the state covariance matrix using a radar measurement.
  * @param {MeasurementPackage} meas_package
  */
-void UKF::UpdateRadar(MeasurementPackage meas_package) {
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::UpdateRadar(const MeasurementPackage& meas_package) {
   /**
   Use radar data to update the belief about the object's
   position. Modify the state vector, x_, and covariance, P_.
 
   You'll also need to calculate the radar NIS.
   */
-  VectorXd z = meas_package.raw_measurements_;
+
   /*****************************************************************************
    *  Predict Radar Measurement
    ****************************************************************************/
 
-   //create matrix for sigma points in measurement space
-   MatrixXd Zsig = MatrixXd(n_z_radar_, n_sig_);
+   static const int n_z = MeasurementModel::kRadarDim;
+   const MeasurementVector<n_z> z = meas_package.raw_measurements_.template head<n_z>();
+   MeasurementVector<n_z> z_diff;
+   MeasurementMatrix<n_z> S;
+
+   //the radar measures from its own position
+   typename MotionModel::template KinematicsSigma<1> k;
+   MotionModel::Kinematics(x_, &k);
+   ShiftToSensor(meas_package, &k);
+
+   //nearly linear: the position spread is small compared to the range
+   const double range = sqrt(k(0)*k(0) + k(1)*k(1));
+   const double position_spread = sqrt(P_(0,0) + P_(1,1));
+
+   if (use_hybrid_ && position_spread < hybrid_max_range_spread_ * range) {
+     MeasurementVector<n_z> z_pred;
+     MeasurementModel::Radar(k, &z_pred);
+
+     //chain rule: radar Jacobian in kinematics times kinematics Jacobian
+     MeasurementModel::RadarJacobianMatrix H_k;
+     MeasurementModel::RadarJacobian(k, &H_k);
+     typename MotionModel::KinematicsJacobianMatrix J;
+     MotionModel::KinematicsJacobian(x_, &J);
+     const MeasurementJacobian<n_z> H = H_k * J;
+     UpdateStateLinearized(z, z_pred, H, R_radar_, 1, &z_diff, &S);
+     ++hybrid_stats_.ekf_updates;
+   }
+   else {
+     //transform sigma points into measurement space
+     EnsureSigmaPoints();
+     typename SigmaTypes::KinematicsMatrix Ksig;
+     MotionModel::Kinematics(Xsig_pred_, &Ksig);
+     ShiftToSensor(meas_package, &Ksig);
+     MeasurementSigma<n_z> Zsig;
+     MeasurementModel::Radar(Ksig, &Zsig);
+
+     /*****************************************************************************
+      *  Update State based on Radar Measurement
+      ****************************************************************************/
+
+     UpdateState(z, Zsig, R_radar_, 1, &z_diff, &S);
+     ++hybrid_stats_.ukf_updates;
+   }
 
-   //transform sigma points into measurement space
-   for (int i = 0; i < n_sig_; i++) {  //2n+1 simga points
+   /*****************************************************************************
+    *  NIS of Radar Measurement
+    ****************************************************************************/
+   // Chi-Square 95-percentile  Probability for Radar with 3 degrees of freedom is 7.815
+   //calculate NIS value
+   NIS_radar_ = z_diff.transpose()*S.inverse()*z_diff;
+   log_likelihood_ = LogLikelihood(z_diff, S);
 
-     // extract values for better readibility
-     double p_x = Xsig_pred_(0,i);
-     double p_y = Xsig_pred_(1,i);
-     double v  = Xsig_pred_(2,i);
-     double yaw = Xsig_pred_(3,i);
 
-     double v1 = cos(yaw)*v;
-     double v2 = sin(yaw)*v;
+   //print result
+//   std::cout << "NIS_radar: " << std::endl << NIS_radar_ << std::endl;
+
+}
 
-     // measurement model
-     Zsig(0,i) = sqrt(p_x*p_x + p_y*p_y);                        //r
+/**
+ * Updates the state and the state covariance matrix using a laser and a radar
+ * measurement at once. Both models are stacked into one 5-dimensional
+ * measurement [px py rho phi rho_dot] with block diagonal noise.
+ * @param {MeasurementPackage} laser_package
+ * @param {MeasurementPackage} radar_package
+ */
+template <class MotionModel, class SigmaRule>
+void ModelUKF<MotionModel, SigmaRule>::UpdateFused(const MeasurementPackage& laser_package,
+                      const MeasurementPackage& radar_package) {
 
-     if((fabs(p_x) < numeric_limits<double>::epsilon()) && (fabs(p_y) < numeric_limits<double>::epsilon())) // Avoid undefined for atan2 and division by zero for r_dot
-     {
-       p_x =  numeric_limits<double>::epsilon();
-       p_y =  numeric_limits<double>::epsilon();
-     }
-     Zsig(1,i) = atan2(p_y,p_x);                                 //phi
-     Zsig(2,i) = (p_x*v1 + p_y*v2 ) / sqrt(p_x*p_x + p_y*p_y);   //r_dot
-   }
+  static const int n_z_laser = MeasurementModel::kLidarDim;
+  static const int n_z_radar = MeasurementModel::kRadarDim;
+  static const int n_z = n_z_laser + n_z_radar;
 
-   //mean predicted measurement
-   VectorXd z_pred = VectorXd(n_z_radar_);
+  /*****************************************************************************
+   *  Predict Fused Measurement
+   ****************************************************************************/
 
-   z_pred.fill(0.0);
-   for (int i=0; i < n_sig_; i++) {
-       z_pred = z_pred + weights_(i) * Zsig.col(i);
+   //stack lidar and radar sigma points in measurement space
+   EnsureSigmaPoints();
+   MeasurementSigma<n_z> Zsig;
+   Zsig.template topRows<n_z_laser>() = Xsig_pred_.template topRows<n_z_laser>();
+
+   typename SigmaTypes::KinematicsMatrix Ksig;
+   MotionModel::Kinematics(Xsig_pred_, &Ksig);
+   ShiftToSensor(radar_package, &Ksig);
+   MeasurementSigma<n_z_radar> Zsig_radar;
+   MeasurementModel::Radar(Ksig, &Zsig_radar);
+   Zsig.template bottomRows<n_z_radar>() = Zsig_radar;
+
+   //stacked measurement
+   MeasurementVector<n_z> z;
+   z << laser_package.raw_measurements_.template head<n_z_laser>(),
+        radar_package.raw_measurements_.template head<n_z_radar>();
+
+   //block diagonal measurement noise
+   MeasurementMatrix<n_z> R = MeasurementMatrix<n_z>::Zero();
+   if (laser_package.noise_covariance_.size() > 0) {
+     R.template topLeftCorner<n_z_laser, n_z_laser>() = laser_package.noise_covariance_;
+   } else {
+     R.template topLeftCorner<n_z_laser, n_z_laser>() = R_lidar_;
    }
+   R.template bottomRightCorner<n_z_radar, n_z_radar>() = R_radar_;
 
-   //measurement covariance matrix S
-   MatrixXd S = MatrixXd(n_z_radar_,n_z_radar_);
-   S.fill(0.0);
-   for (int i = 0; i < n_sig_; i++) {  //2n+1 simga points
-     //residual
-     VectorXd z_diff = Zsig.col(i) - z_pred;
+   /*****************************************************************************
+    *  Update State based on Fused Measurement
+    ****************************************************************************/
 
-     //angle normalization
-     Tools::NormalizeAngle(z_diff(1));
+   MeasurementVector<n_z> z_diff;
+   MeasurementMatrix<n_z> S;
+   UpdateState(z, Zsig, R, n_z_laser + 1, &z_diff, &S);
 
+   /*****************************************************************************
+    *  NIS of Fused Measurement
+    ****************************************************************************/
+   // report the marginal NIS of each sensor so the usual chi-square bounds apply
 
-     S = S + weights_(i) * z_diff * z_diff.transpose();
-   }
+   const MeasurementVector<n_z_laser> z_diff_laser = z_diff.template head<n_z_laser>();
+   const MeasurementMatrix<n_z_laser> S_laser = S.template topLeftCorner<n_z_laser, n_z_laser>();
+   NIS_laser_ = z_diff_laser.transpose()*S_laser.inverse()*z_diff_laser;
 
-   //add measurement noise covariance matrix
-   S = S + R_radar_;
+   const MeasurementVector<n_z_radar> z_diff_radar = z_diff.template tail<n_z_radar>();
+   const MeasurementMatrix<n_z_radar> S_radar = S.template bottomRightCorner<n_z_radar, n_z_radar>();
+   NIS_radar_ = z_diff_radar.transpose()*S_radar.inverse()*z_diff_radar;
 
-   //print result
-//   std::cout << "z_pred: " << std::endl << z_pred << std::endl;
-//   std::cout << "S: " << std::endl << S << std::endl;
+   //the joint likelihood of both measurements
+   log_likelihood_ = LogLikelihood(z_diff, S);
 
+   ++hybrid_stats_.ukf_updates;
+}
 
-   /*****************************************************************************
-    *  Update State based on Radar Measurement
-    ****************************************************************************/
+/**
+ * Gaussian log-likelihood of an innovation,
+ * -0.5 * (z_diff^T S^-1 z_diff + ln det(S) + n_z ln(2 pi)).
+ * @param {MeasurementVector} z_diff the innovation
+ * @param {MeasurementMatrix} S the innovation covariance
+ */
+template <class MotionModel, class SigmaRule>
+template <int NZ>
+double ModelUKF<MotionModel, SigmaRule>::LogLikelihood(const MeasurementVector<NZ>& z_diff,
+                                                       const MeasurementMatrix<NZ>& S) const {
+
+  Eigen::LLT<MeasurementMatrix<NZ> > llt(S);
+  if (llt.info() != Eigen::Success) {
+    return -std::numeric_limits<double>::infinity();
+  }
+  const double mahalanobis = llt.matrixL().solve(z_diff).squaredNorm();
+  const double log_det = 2.0 * llt.matrixLLT().diagonal().array().log().sum();
+  return -0.5 * (mahalanobis + log_det + z_diff.size() * log(2.0 * M_PI));
+}
 
-   //create matrix for cross correlation Tc
-   MatrixXd Tc = MatrixXd(n_x_, n_z_radar_);
+/**
+ * Moves kinematic points [px py vx vy] into the frame of a radar that is not
+ * at the origin. Only the position changes, the range rate of ego motion
+ * compensated measurements is over ground.
+ * @param {MeasurementPackage} meas_package the radar measurement
+ * @param {KinematicsType} Ksig kinematic points as columns, shifted in place
+ */
+template <class MotionModel, class SigmaRule>
+template <typename KinematicsType>
+void ModelUKF<MotionModel, SigmaRule>::ShiftToSensor(const MeasurementPackage& meas_package,
+                                                     KinematicsType* Ksig) {
+  if (meas_package.sensor_origin_.size() > 0) {
+    Ksig->row(0).array() -= meas_package.sensor_origin_(0);
+    Ksig->row(1).array() -= meas_package.sensor_origin_(1);
+  }
+}
 
-   //calculate cross correlation matrix
-   Tc.fill(0.0);
-   for (int i = 0; i < n_sig_; i++) {  //2n+1 simga points
+/**
+ * Shared unscented measurement update: predicted measurement mean, innovation
+ * covariance S, cross correlation Tc, Kalman gain and the state update.
+ * All intermediate matrices have a fixed size, so the update does not allocate.
+ * @param {MeasurementVector} z the measurement
+ * @param {MeasurementSigma} Zsig the predicted sigma points in measurement space
+ * @param {MeasurementMatrix} R the measurement noise covariance
+ * @param {int} angle_row the measurement row holding an angle, -1 if none
+ * @param {MeasurementVector} z_diff_out the normalized innovation
+ * @param {MeasurementMatrix} S_out the innovation covariance
+ */
+template <class MotionModel, class SigmaRule>
+template <int NZ>
+void ModelUKF<MotionModel, SigmaRule>::UpdateState(const MeasurementVector<NZ>& z,
+                      const MeasurementSigma<NZ>& Zsig, const MeasurementMatrix<NZ>& R,
+                      int angle_row, MeasurementVector<NZ>* z_diff_out,
+                      MeasurementMatrix<NZ>* S_out) {
 
-     //residual
-     VectorXd z_diff = Zsig.col(i) - z_pred;
-     //angle normalization
-     Tools::NormalizeAngle(z_diff(1));
+   static const int n_x = MotionModel::kStateDim;
+
+   //mean predicted measurement
+   MeasurementVector<NZ> z_pred = Zsig * weights_;
 
-     // state difference
-     VectorXd x_diff = Xsig_pred_.col(i) - x_;
-     //angle normalization
-     Tools::NormalizeAngle(x_diff(3));
+   //stacked state and measurement differences [X_diff; Z_diff]
+   Eigen::Matrix<double, n_x + NZ, kSigmaCount, Eigen::DontAlign> D;
+   D.template topRows<n_x>() = Xsig_pred_.colwise() - x_;
+   D.template bottomRows<NZ>() = Zsig.colwise() - z_pred;
 
-     Tc = Tc + weights_(i) * x_diff * z_diff.transpose();
+   //angle normalization
+   NormalizeStateAngles(&D);
+   if (angle_row >= 0) {
+     //average the angle relative to the first sigma point, so that points on
+     //both sides of +-pi do not cancel in the mean
+     const int row = n_x_ + angle_row;
+     D.row(row) = Zsig.row(angle_row).array() - Zsig(angle_row, 0);
+     Tools::NormalizeAngleRow(&D, row);
+     const double mean_offset = weights_.dot(D.row(row).transpose());
+     z_pred(angle_row) = Tools::NormalizeAngle(Zsig(angle_row, 0) + mean_offset);
+     D.row(row).array() -= mean_offset;
+     Tools::NormalizeAngleRow(&D, row);
    }
 
-   //Kalman gain K;
-   MatrixXd K = Tc * S.inverse();
+   //joint covariance of state and measurement in one pass
+   Eigen::Matrix<double, n_x + NZ, n_x + NZ, Eigen::DontAlign> C;
+   WeightedCovariance(D, &C);
+
+   //measurement covariance matrix S plus measurement noise
+   const MeasurementMatrix<NZ> S = C.template bottomRightCorner<NZ, NZ>() + R;
+
+   //cross correlation matrix Tc
+   const Eigen::Matrix<double, n_x, NZ, Eigen::DontAlign> Tc = C.template topRightCorner<n_x, NZ>();
+
+   //print result
+//   std::cout << "z_pred: " << std::endl << z_pred << std::endl;
+//   std::cout << "S: " << std::endl << S << std::endl;
+
+   //Kalman gain K = Tc * S^-1, solved with the Cholesky factor of S
+   Eigen::LLT<MeasurementMatrix<NZ> > S_llt(S);
+   const Eigen::Matrix<double, MotionModel::kStateDim, NZ, Eigen::DontAlign> K =
+       S_llt.solve(Tc.transpose()).transpose();
 
    //residual
-   VectorXd z_diff = z - z_pred;
+   MeasurementVector<NZ> z_diff = z - z_pred;
 
    //angle normalization
-   Tools::NormalizeAngle(z_diff(1));
+   if (angle_row >= 0) {
+     z_diff(angle_row) = Tools::NormalizeAngle(z_diff(angle_row));
+   }
 
    //update state mean and covariance matrix
    x_ = x_ + K * z_diff;
-   P_ = P_ - K*S*K.transpose();
-
-   //print result
-//   std::cout << "Updated state x: " << std::endl << x_ << std::endl;
-//   std::cout << "Updated state covariance P: " << std::endl << P_ << std::endl;
 
-   /*****************************************************************************
-    *  NIS of Radar Measurement
-    ****************************************************************************/
-   // Chi-Square 95-percentile  Probability for Radar with 3 degrees of freedom is 7.815
-   //calculate NIS value
-   NIS_radar_ = z_diff.transpose()*S.inverse()*z_diff;
+   //P = P - K*S*K^T = P - (K*L)*(K*L)^T with S = L*L^T, applied to the lower
+   //triangle and mirrored so that P_ stays exactly symmetric
+   const Eigen::Matrix<double, MotionModel::kStateDim, NZ, Eigen::DontAlign> KL =
+       K * S_llt.matrixL();
+   P_.template selfadjointView<Eigen::Lower>().rankUpdate(KL, -1.0);
+   P_.template triangularView<Eigen::StrictlyUpper>() = P_.transpose();
 
+   //the predicted sigma points no longer describe x_ and P_
+   sigma_points_valid_ = false;
 
    //print result
-//   std::cout << "NIS_radar: " << std::endl << NIS_radar_ << std::endl;
+//   std::cout << "Updated state x: " << std::endl << x_ << std::endl;
+//   std::cout << "Updated state covariance P: " << std::endl << P_ << std::endl;
 
+   //write result
+   *z_diff_out = z_diff;
+   *S_out = S;
 }
 
+/**
+ * First-order (EKF) measurement update around x_.
+ * @param {MeasurementVector} z the measurement
+ * @param {MeasurementVector} z_pred the measurement predicted from x_
+ * @param {MeasurementJacobian} H the measurement Jacobian at x_
+ * @param {MeasurementMatrix} R the measurement noise covariance
+ * @param {int} angle_row the measurement row holding an angle, -1 if none
+ * @param {MeasurementVector} z_diff_out the normalized innovation
+ * @param {MeasurementMatrix} S_out the innovation covariance
+ */
+template <class MotionModel, class SigmaRule>
+template <int NZ>
+void ModelUKF<MotionModel, SigmaRule>::UpdateStateLinearized(const MeasurementVector<NZ>& z,
+                                const MeasurementVector<NZ>& z_pred, const MeasurementJacobian<NZ>& H,
+                                const MeasurementMatrix<NZ>& R, int angle_row,
+                                MeasurementVector<NZ>* z_diff_out, MeasurementMatrix<NZ>* S_out) {
+
+   //cross correlation and innovation covariance
+   const Eigen::Matrix<double, MotionModel::kStateDim, NZ, Eigen::DontAlign> Tc = P_ * H.transpose();
+   const MeasurementMatrix<NZ> S = H * Tc + R;
+
+   //Kalman gain K = Tc * S^-1, solved with the Cholesky factor of S
+   Eigen::LLT<MeasurementMatrix<NZ> > S_llt(S);
+   const Eigen::Matrix<double, MotionModel::kStateDim, NZ, Eigen::DontAlign> K =
+       S_llt.solve(Tc.transpose()).transpose();
 
+   //residual
+   MeasurementVector<NZ> z_diff = z - z_pred;
 
+   //angle normalization
+   if (angle_row >= 0) {
+     z_diff(angle_row) = Tools::NormalizeAngle(z_diff(angle_row));
+   }
 
+   //update state mean and covariance matrix, see UpdateState
+   x_ = x_ + K * z_diff;
+   const Eigen::Matrix<double, MotionModel::kStateDim, NZ, Eigen::DontAlign> KL =
+       K * S_llt.matrixL();
+   P_.template selfadjointView<Eigen::Lower>().rankUpdate(KL, -1.0);
+   P_.template triangularView<Eigen::StrictlyUpper>() = P_.transpose();
 
+   sigma_points_valid_ = false;
 
+   //write result
+   *z_diff_out = z_diff;
+   *S_out = S;
+}
 
+template class ModelUKF<CVModel>;
+template class ModelUKF<CTRVModel>;
+template class ModelUKF<CTRAModel>;
+template class ModelUKF<CVModel, CubatureRule>;
+template class ModelUKF<CTRVModel, CubatureRule>;
+template class ModelUKF<CTRAModel, CubatureRule>;
+template class ModelUKF<CVModel, SimplexRule>;
+template class ModelUKF<CTRVModel, SimplexRule>;
+template class ModelUKF<CTRAModel, SimplexRule>;
@@ -7,13 +7,127 @@
 #include <string>
 #include <fstream>
 #include "tools.h"
+#include "track_state.h"
+#include "sigma_points.h"
+#include "motion_models.h"
+#include "measurement_model.h"
 
 using Eigen::MatrixXd;
 using Eigen::VectorXd;
 
-class UKF {
+/**
+ * Dimensions and fixed-size sigma point matrices of a motion model and a
+ * sigma point rule (see sigma_points.h).
+ */
+template <class MotionModel, class SigmaRule>
+struct SigmaPointTypes {
+  ///* state and augmented state dimensions
+  static const int kStateDim = MotionModel::kStateDim;
+  static const int kAugDim = MotionModel::kStateDim + MotionModel::kNoiseDim;
+
+  ///* number of sigma points
+  static const int kCount = SigmaRule::Count(kAugDim);
+
+  typedef Eigen::Matrix<double, kAugDim, 1, Eigen::DontAlign> AugVector;
+  typedef Eigen::Matrix<double, kAugDim, kAugDim, Eigen::DontAlign> AugMatrix;
+  typedef typename MotionModel::template AugSigma<kCount> AugSigmaMatrix;
+  typedef typename MotionModel::template StateSigma<kCount> SigmaMatrix;
+  typedef typename MotionModel::template KinematicsSigma<kCount> KinematicsMatrix;
+  typedef Eigen::Matrix<double, kCount, 1, Eigen::DontAlign> SigmaWeights;
+
+  ///* sigma points of many tracks or time steps side by side
+  typedef typename MotionModel::template AugSigma<Eigen::Dynamic> AugSigmaBatch;
+  typedef typename MotionModel::template StateSigma<Eigen::Dynamic> SigmaBatch;
+  typedef typename MotionModel::template TimeSteps<Eigen::Dynamic> TimeBatch;
+
+  ///* the columns of a batch that one kernel call propagates
+  typedef typename MotionModel::template AugSigma<MotionModel::kBatchChunk> AugSigmaChunk;
+  typedef typename MotionModel::template StateSigma<MotionModel::kBatchChunk> SigmaChunk;
+  typedef typename MotionModel::template TimeSteps<MotionModel::kBatchChunk> TimeChunk;
+};
+
+/**
+ * Scratch buffers of the sigma point prediction. Reusing one workspace across
+ * calls keeps the prediction queries free of allocations; the batch buffers
+ * grow to the largest batch and are then reused, batches are propagated in
+ * fixed-size chunks.
+ */
+template <class MotionModel, class SigmaRule>
+struct ModelPredictionWorkspace {
+  typedef SigmaPointTypes<MotionModel, SigmaRule> Types;
+
+  ///* augmented mean state
+  typename Types::AugVector x_aug;
+
+  ///* augmented state covariance
+  typename Types::AugMatrix P_aug;
+
+  ///* factorization of P_aug
+  Eigen::LLT<typename Types::AugMatrix> llt;
+
+  ///* augmented sigma points
+  typename Types::AugSigmaMatrix Xsig_aug;
+
+  ///* predicted sigma points
+  typename Types::SigmaMatrix Xsig_pred;
+
+  ///* stacked augmented sigma points, time steps and predicted sigma points
+  ///* of a batched prediction or rollout; only the leading columns of a
+  ///* batch are used, the buffers are never shrunk
+  typename Types::AugSigmaBatch Xsig_batch;
+  typename Types::TimeBatch dt_batch;
+  typename Types::SigmaBatch Xsig_pred_batch;
+
+  ///* one chunk of the batch at a time, see ModelUKF::PropagateBatch
+  typename Types::AugSigmaChunk Xsig_chunk;
+  typename Types::TimeChunk dt_chunk;
+  typename Types::SigmaChunk Xsig_pred_chunk;
+
+  ///* tracks of a batched frame prediction that need sigma points, and
+  ///* their time steps
+  std::vector<int> batch_tracks;
+  std::vector<double> batch_dt;
+};
+
+/**
+ * Counts of the prediction and update paths taken, see ModelUKF::use_hybrid_.
+ */
+struct HybridStatistics {
+  long long ekf_predictions;
+  long long ukf_predictions;
+  long long ekf_updates;
+  long long ukf_updates;
+};
+
+/**
+ * Unscented Kalman filter for the motion model and the sigma point rule given
+ * as template arguments (see motion_models.h and sigma_points.h). State,
+ * covariance and sigma point matrices all have a fixed size.
+ */
+template <class MotionModel, class SigmaRule = UnscentedRule>
+class ModelUKF {
 public:
 
+  typedef typename MotionModel::StateVector StateVector;
+  typedef typename MotionModel::StateMatrix StateMatrix;
+  typedef SigmaPointTypes<MotionModel, SigmaRule> SigmaTypes;
+  typedef typename SigmaTypes::SigmaMatrix SigmaMatrix;
+  typedef ModelPredictionWorkspace<MotionModel, SigmaRule> Workspace;
+
+  ///* Number of sigma points of the rule
+  static const int kSigmaCount = SigmaTypes::kCount;
+
+  ///* measurement vector, covariance, Jacobian and sigma points of an
+  ///* NZ-dimensional measurement model
+  template <int NZ>
+  using MeasurementVector = Eigen::Matrix<double, NZ, 1, Eigen::DontAlign>;
+  template <int NZ>
+  using MeasurementMatrix = Eigen::Matrix<double, NZ, NZ, Eigen::DontAlign>;
+  template <int NZ>
+  using MeasurementJacobian = Eigen::Matrix<double, NZ, MotionModel::kStateDim, Eigen::DontAlign>;
+  template <int NZ>
+  using MeasurementSigma = Eigen::Matrix<double, NZ, kSigmaCount, Eigen::DontAlign>;
+
   ///* initially set to false, set to true in first call of ProcessMeasurement
   bool is_initialized_;
 
@@ -23,14 +137,15 @@ public:
   ///* if this is false, radar measurements will be ignored (except for init)
   bool use_radar_;
 
-  ///* state vector: [pos1 pos2 vel_abs yaw_angle yaw_rate] in SI units and rad
-  VectorXd x_;
+  ///* state vector of the motion model, for CTRV:
+  ///* [pos1 pos2 vel_abs yaw_angle yaw_rate] in SI units and rad
+  StateVector x_;
 
   ///* state covariance matrix
-  MatrixXd P_;
+  StateMatrix P_;
 
   ///* predicted sigma points matrix
-  MatrixXd Xsig_pred_;
+  SigmaMatrix Xsig_pred_;
 
   ///* time when the state is true, in us
   long long time_us_;
@@ -48,7 +163,7 @@ public:
   double std_laspy_;
 
   ///* Laser measurement noise covariance matrix
-  MatrixXd R_lidar_;
+  MeasurementMatrix<MeasurementModel::kLidarDim> R_lidar_;
 
   ///* Radar measurement noise standard deviation radius in m
   double std_radr_;
@@ -60,10 +175,10 @@ public:
   double std_radrd_ ;
 
   ///* Radar measurement noise covariance matrix
-  MatrixXd R_radar_;
+  MeasurementMatrix<MeasurementModel::kRadarDim> R_radar_;
 
   ///* Weights of sigma points
-  VectorXd weights_;
+  typename SigmaTypes::SigmaWeights weights_;
 
   ///* State dimension
   int n_x_;
@@ -71,7 +186,7 @@ public:
   ///* Augmented state dimension
   int n_aug_;
 
-  ///* Number of sigma points
+  ///* Number of sigma points, kSigmaCount
   int n_sig_;
 
   // Measurement dimension for radar
@@ -88,21 +203,48 @@ public:
   ///* the current NIS for laser
   double NIS_laser_;
 
+  ///* Gaussian log-likelihood of the innovation of the last update,
+  ///* -0.5 * (NIS + ln det(2 pi S)), used to score measurement associations
+  double log_likelihood_;
+
+  ///* if this is true, laser and radar measurements sharing a timestamp are
+  ///* fused into one joint update (see ProcessFusedMeasurement)
+  bool use_fused_update_;
+
+  ///* time steps below this threshold in s skip the prediction step
+  double fusion_dt_threshold_;
+
+  ///* if this is true, steps that are nearly linear use the first-order
+  ///* (EKF) prediction and radar update instead of sigma points, and lidar
+  ///* updates always use the exact linear Kalman update
+  bool use_hybrid_;
+
+  ///* maximum yaw uncertainty plus yaw change over a step in rad for which
+  ///* the hybrid prediction is linearized
+  double hybrid_max_yaw_spread_;
+
+  ///* maximum position standard deviation relative to the range for which
+  ///* the hybrid radar update is linearized
+  double hybrid_max_range_spread_;
+
+  ///* how often each path ran
+  HybridStatistics hybrid_stats_;
+
   /**
    * Constructor
    */
-  UKF();
+  ModelUKF();
 
   /**
    * Destructor
    */
-  virtual ~UKF();
+  virtual ~ModelUKF();
 
   /**
    * ProcessMeasurement
    * @param meas_package The latest measurement data of either radar or laser
    */
-  void ProcessMeasurement(MeasurementPackage meas_package);
+  void ProcessMeasurement(const MeasurementPackage& meas_package);
 
   /**
    * Prediction Predicts sigma points, the state, and the state covariance
@@ -111,24 +253,194 @@ public:
    */
   void Prediction(double delta_t);
 
+  /**
+   * PredictAt Extrapolates the state to an arbitrary timestamp without
+   * modifying x_, P_ or Xsig_pred_
+   * @param timestamp The query time in us
+   * @param x_out The predicted state
+   * @param P_out The predicted state covariance
+   */
+  void PredictAt(long long timestamp, StateVector* x_out, StateMatrix* P_out) const;
+
+  /**
+   * PredictAt Same as above, using the buffers of a caller-owned workspace
+   * @param timestamp The query time in us
+   * @param workspace Scratch buffers, reusable across calls and filters
+   * @param x_out The predicted state
+   * @param P_out The predicted state covariance
+   */
+  void PredictAt(long long timestamp, Workspace* workspace,
+                 StateVector* x_out, StateMatrix* P_out) const;
+
+  /**
+   * PredictAtBatch Answers many queries at once, query i extrapolates
+   * tracks[i] to timestamps[i]
+   * @param tracks The filters to query
+   * @param timestamps The query times in us
+   * @param x_out The predicted states
+   * @param P_out The predicted state covariances
+   */
+  static void PredictAtBatch(const std::vector<const ModelUKF*>& tracks,
+                             const std::vector<long long>& timestamps,
+                             std::vector<StateVector>* x_out,
+                             std::vector<StateMatrix>* P_out);
+
+  /**
+   * PredictFrame Advances many filters to a common frame time, the sigma
+   * points of all tracks are propagated by one kernel call. Each filter ends
+   * up as after its own prediction step to the frame time, so measurements
+   * of the frame can then be processed without predicting again.
+   * Uninitialized filters are left unchanged.
+   * @param tracks The filters to advance
+   * @param timestamp The frame time in us
+   * @param workspace Scratch buffers
+   */
+  static void PredictFrame(const std::vector<ModelUKF*>& tracks, long long timestamp,
+                           Workspace* workspace);
+
+  /**
+   * PredictFrame of the filters tracks[begin, end)
+   */
+  static void PredictFrame(const std::vector<ModelUKF*>& tracks, size_t begin, size_t end,
+                           long long timestamp, Workspace* workspace);
+
   /**
    * Updates the state and the state covariance matrix using a laser measurement
    * @param meas_package The measurement at k+1
    */
-  void UpdateLidar(MeasurementPackage meas_package);
+  void UpdateLidar(const MeasurementPackage& meas_package);
 
   /**
    * Updates the state and the state covariance matrix using a radar measurement
    * @param meas_package The measurement at k+1
    */
-  void UpdateRadar(MeasurementPackage meas_package);
+  void UpdateRadar(const MeasurementPackage& meas_package);
+
+  /**
+   * ProcessFusedMeasurement Predicts once and performs a single joint update
+   * for a laser and a radar measurement taken at (nearly) the same time
+   * @param laser_package The laser measurement
+   * @param radar_package The radar measurement
+   */
+  void ProcessFusedMeasurement(const MeasurementPackage& laser_package,
+                               const MeasurementPackage& radar_package);
+
+  /**
+   * Updates the state and the state covariance matrix using the stacked
+   * 5-dimensional [px py rho phi rho_dot] laser/radar measurement model
+   * @param laser_package The laser measurement at k+1
+   * @param radar_package The radar measurement at k+1
+   */
+  void UpdateFused(const MeasurementPackage& laser_package,
+                   const MeasurementPackage& radar_package);
+
+  /**
+   * RolloutStride Number of doubles written per rollout step (state mean
+   * followed by the column-major state covariance)
+   */
+  int RolloutStride() const;
+
+  /**
+   * Rollout Predicts mean and covariance at start_timestamp + k * step_s for
+   * k = 0 .. num_steps-1 without modifying the filter
+   * @param start_timestamp Time of the first step in us
+   * @param step_s Time between steps in s
+   * @param num_steps Number of steps
+   * @param workspace Scratch buffers
+   * @param buffer Output, num_steps * RolloutStride() doubles
+   */
+  void Rollout(long long start_timestamp, double step_s, int num_steps,
+               Workspace* workspace, double* buffer) const;
+
+  /**
+   * RolloutBatch Rollout of many tracks in one vectorized batch; track i
+   * writes to buffer + i * num_steps * RolloutStride()
+   * @param tracks The filters to roll out
+   * @param start_timestamp Time of the first step in us
+   * @param step_s Time between steps in s
+   * @param num_steps Number of steps
+   * @param workspace Scratch buffers
+   * @param buffer Output, tracks.size() * num_steps * RolloutStride() doubles
+   */
+  static void RolloutBatch(const std::vector<const ModelUKF*>& tracks,
+                           long long start_timestamp, double step_s,
+                           int num_steps, Workspace* workspace,
+                           double* buffer);
+
+  /**
+   * SaveState Stores time, state and the upper triangle of the covariance
+   * @param state_out The compact track state
+   */
+  void SaveState(TrackState<MotionModel::kStateDim>* state_out) const;
+
+  /**
+   * LoadState Restores a stored track state, the filter counts as initialized
+   * @param state The compact track state
+   */
+  void LoadState(const TrackState<MotionModel::kStateDim>& state);
 
 private:
+  ///* true while Xsig_pred_ represents the current x_ and P_
+  bool sigma_points_valid_;
+
+  ///* square roots of the sigma point weights 1..n_sig_-1
+  Eigen::Matrix<double, kSigmaCount - 1, 1, Eigen::DontAlign> sqrt_weights_;
+
+  ///* unit sigma points of the rule, n_aug_ x n_sig_
+  typename SigmaTypes::AugSigmaMatrix sigma_unit_;
+
+  ///* scratch buffers of Prediction
+  Workspace workspace_;
+
+
   //void GenerateSigmaPoints(MatrixXd* Xsig_out);
-  void AugmentedSigmaPoints(MatrixXd* Xsig_out);
-  void SigmaPointPrediction(MatrixXd* Xsig_out,const MatrixXd& Xsig_aug,const double delta_t);
-  void PredictMeanAndCovariance(VectorXd* x_pred, MatrixXd* P_pred, VectorXd* weights_out);
+  void AugmentedSigmaPoints(const StateVector& x, const StateMatrix& P, Workspace* workspace) const;
+  void SigmaPointPrediction(SigmaMatrix* Xsig_out, const typename SigmaTypes::AugSigmaMatrix& Xsig_aug, const double delta_t) const;
+  void PropagateBatch(int n_cols, Workspace* workspace) const;
+  void PredictMeanAndCovariance(const SigmaMatrix& Xsig_pred, StateVector* x_pred, StateMatrix* P_pred) const;
+  template <typename DeviationType, typename MatrixType>
+  void WeightedCovariance(const DeviationType& D, MatrixType* C_out) const;
+  template <typename DeviationType>
+  static void NormalizeStateAngles(DeviationType* D);
+  void RedrawSigmaPoints();
+  void EnsureSigmaPoints();
+  void PredictionLinearized(double delta_t);
+  template <int NZ>
+  void UpdateStateLinearized(const MeasurementVector<NZ>& z, const MeasurementVector<NZ>& z_pred,
+                             const MeasurementJacobian<NZ>& H, const MeasurementMatrix<NZ>& R,
+                             int angle_row, MeasurementVector<NZ>* z_diff_out,
+                             MeasurementMatrix<NZ>* S_out);
+  void AdvanceTo(long long timestamp);
+  template <int NZ>
+  void UpdateState(const MeasurementVector<NZ>& z, const MeasurementSigma<NZ>& Zsig,
+                   const MeasurementMatrix<NZ>& R, int angle_row,
+                   MeasurementVector<NZ>* z_diff_out, MeasurementMatrix<NZ>* S_out);
+  template <int NZ>
+  double LogLikelihood(const MeasurementVector<NZ>& z_diff, const MeasurementMatrix<NZ>& S) const;
+  template <typename KinematicsType>
+  static void ShiftToSensor(const MeasurementPackage& meas_package, KinematicsType* Ksig);
 
 };
 
+extern template class ModelUKF<CVModel>;
+extern template class ModelUKF<CTRVModel>;
+extern template class ModelUKF<CTRAModel>;
+extern template class ModelUKF<CVModel, CubatureRule>;
+extern template class ModelUKF<CTRVModel, CubatureRule>;
+extern template class ModelUKF<CTRAModel, CubatureRule>;
+extern template class ModelUKF<CVModel, SimplexRule>;
+extern template class ModelUKF<CTRVModel, SimplexRule>;
+extern template class ModelUKF<CTRAModel, SimplexRule>;
+
+///* the CTRV filter
+typedef ModelUKF<CTRVModel> UKF;
+
+///* CTRV filters with the cubature and the spherical simplex rule
+typedef ModelUKF<CTRVModel, CubatureRule> CubatureUKF;
+typedef ModelUKF<CTRVModel, SimplexRule> SimplexUKF;
+
+///* constant velocity and constant turn rate and acceleration filters
+typedef ModelUKF<CVModel> CVUKF;
+typedef ModelUKF<CTRAModel> CTRAUKF;
+
 #endif /* UKF_H */
@@ -0,0 +1,126 @@
+#ifndef VOXEL_HASH_H_
+#define VOXEL_HASH_H_
+
+#include <cstdint>
+#include <vector>
+
+/**
+* Open-addressing hash from integer voxel coordinates to dense voxel IDs
+* 0, 1, 2, ... in insertion order. The table keeps its storage across
+* Clear calls, so rebuilding it for every sweep does not allocate.
+* Coordinates must lie within +-2^20.
+*/
+class VoxelHash {
+public:
+
+  VoxelHash() : size_(0), mask_(0) {}
+
+  /**
+  * Packs voxel coordinates into a key.
+  */
+  static uint64_t Key(int ix, int iy, int iz) {
+    const uint64_t kOffset = 1 << 20;
+    const uint64_t kMask = (1 << 21) - 1;
+    return ((ix + kOffset) & kMask) | (((iy + kOffset) & kMask) << 21) |
+           (((iz + kOffset) & kMask) << 42);
+  }
+
+  /**
+  * Removes all voxels.
+  * @param expected_voxels Number of voxels about to be inserted
+  */
+  void Clear(size_t expected_voxels) {
+    // at most half full
+    size_t capacity = 16;
+    while (capacity < 2 * expected_voxels) {
+      capacity *= 2;
+    }
+    keys_.assign(capacity, kEmpty);
+    ids_.resize(capacity);
+    mask_ = capacity - 1;
+    size_ = 0;
+  }
+
+  /**
+  * @param key The voxel, see Key
+  * @return The ID of the voxel, a new one if it was not in the table
+  */
+  int Insert(uint64_t key) {
+    if (2 * ((size_t) size_ + 1) > keys_.size()) {
+      Grow();
+    }
+    size_t slot = Hash(key) & mask_;
+    while (keys_[slot] != kEmpty) {
+      if (keys_[slot] == key) {
+        return ids_[slot];
+      }
+      slot = (slot + 1) & mask_;
+    }
+    keys_[slot] = key;
+    ids_[slot] = size_;
+    return size_++;
+  }
+
+  /**
+  * @param key The voxel, see Key
+  * @return The ID of the voxel, -1 if it is not in the table
+  */
+  int Find(uint64_t key) const {
+    if (keys_.empty()) {
+      return -1;
+    }
+    size_t slot = Hash(key) & mask_;
+    while (keys_[slot] != kEmpty) {
+      if (keys_[slot] == key) {
+        return ids_[slot];
+      }
+      slot = (slot + 1) & mask_;
+    }
+    return -1;
+  }
+
+  /**
+  * Number of voxels.
+  */
+  int size() const {
+    return size_;
+  }
+
+private:
+  // an enum, so that passing it by reference needs no definition
+  enum : uint64_t { kEmpty = ~0ull };
+
+  static size_t Hash(uint64_t key) {
+    // Fibonacci hashing, the high bits are the best mixed
+    return (key * 0x9E3779B97F4A7C15ull) >> 20;
+  }
+
+  void Grow() {
+    std::vector<uint64_t> keys;
+    std::vector<int> ids;
+    keys.swap(keys_);
+    ids.swap(ids_);
+    const int size = size_;
+    keys_.assign(2 * keys.size() > 16 ? 2 * keys.size() : 16, kEmpty);
+    ids_.resize(keys_.size());
+    mask_ = keys_.size() - 1;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i] != kEmpty) {
+        size_t slot = Hash(keys[i]) & mask_;
+        while (keys_[slot] != kEmpty) {
+          slot = (slot + 1) & mask_;
+        }
+        keys_[slot] = keys[i];
+        ids_[slot] = ids[i];
+      }
+    }
+    size_ = size;
+  }
+
+  std::vector<uint64_t> keys_;
+  std::vector<int> ids_;
+  int size_;
+  size_t mask_;
+};
+
+#endif /* VOXEL_HASH_H_ */